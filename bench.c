@@ -0,0 +1,413 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "frame_table.h"
+#include "generator.h"
+#include "simulator.h"
+#include "sweep.h"
+#include "threadpool.h"
+#include "timing.h"
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// Times every policy on fixed, seeded workloads so engine regressions show
+// up as numbers. On POSIX each measurement runs in a forked child, which
+// gives every policy its own peak RSS: what the run added to the child
+// beyond the references it inherited.
+
+#define BENCH_DEFAULT_ACCESSES 2000000
+#define BENCH_DEFAULT_FRAMES 1024
+#define BENCH_DEFAULT_REPEAT 3
+#define BENCH_SEED 42
+
+// Workloads in terms of the memory size, so every frame count sees the
+// same shape of locality
+typedef struct {
+    const char *name;
+    GenPattern pattern;
+    int processes;
+    int footprint;  // Pages per process, as a multiple of frames
+    int quantum;
+} BenchWorkload;
+
+static const BenchWorkload workloads[] = {
+    {"loop", GEN_SEQUENTIAL, 1, 2, 0},   // Scan over twice the memory: LRU and FIFO always miss
+    {"uniform", GEN_UNIFORM, 4, 2, 100},
+    {"hot-cold", GEN_HOT_COLD, 1, 16, 0},
+    {"zipf", GEN_ZIPF, 2, 16, 1000},
+    {"phased", GEN_PHASED, 2, 16, 1000},
+};
+
+static int generate_workload(const BenchWorkload *w, PageReference *refs, int n, int frames) {
+    GenProcessSpec specs[MAX_PROCESSES];
+    for (int i = 0; i < w->processes; i++) {
+        gen_process_defaults(&specs[i], w->pattern, (long long)w->footprint * frames);
+        specs[i].working_set = frames / 2 > 0 ? frames / 2 : 1;
+        specs[i].phase_length = 50000;
+    }
+    Generator gen;
+    if (generator_init(&gen, specs, w->processes, n, w->quantum, BENCH_SEED) != 0)
+        return -1;
+    size_t produced = 0, got;
+    while ((got = generator_read(&gen, refs + produced, (size_t)n - produced)) > 0)
+        produced += got;
+    return 0;
+}
+
+typedef struct {
+    double seconds; // Best of the repeats
+    long long faults;
+    long peak_rss_kb; // Beyond the references in a child, all of it otherwise
+    int status;
+} BenchResult;
+
+static BenchResult measure(const ReplacementPolicy *policy, const PageReference *refs, int n, int frames, int repeat) {
+    BenchResult result = {0, 0, 0, -1};
+    Simulator *sim = simulator_create(frames, 1);
+    if (!sim || simulator_set_algorithm(sim, policy->name) != 0) {
+        simulator_destroy(sim);
+        return result;
+    }
+    simulator_set_verbosity(sim, SIM_VERBOSITY_NONE);
+    result.status = 0;
+    for (int r = 0; r < repeat && result.status == 0; r++) {
+        double start = timing_wall_seconds();
+        result.status = simulator_run_references(sim, refs, n);
+        double elapsed = timing_wall_seconds() - start;
+        if (r == 0 || elapsed < result.seconds)
+            result.seconds = elapsed;
+    }
+    result.faults = sim->faults;
+    simulator_destroy(sim);
+    result.peak_rss_kb = timing_peak_rss_kb();
+    return result;
+}
+
+#ifndef _WIN32
+// Measures in a child process so peak RSS belongs to this policy alone
+static BenchResult measure_isolated(const ReplacementPolicy *policy, const PageReference *refs, int n, int frames,
+                                    int repeat) {
+    BenchResult result = {0, 0, 0, -1};
+    int fds[2];
+    if (pipe(fds) != 0)
+        return result;
+    pid_t child = fork();
+    if (child < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return result;
+    }
+    if (child == 0) {
+        // The child starts with the parent's resident pages, the
+        // references among them; only what the run adds is its own
+        close(fds[0]);
+        long baseline = timing_peak_rss_kb();
+        BenchResult r = measure(policy, refs, n, frames, repeat);
+        r.peak_rss_kb = r.peak_rss_kb > baseline ? r.peak_rss_kb - baseline : 0;
+        ssize_t written = write(fds[1], &r, sizeof(r));
+        _exit(written == (ssize_t)sizeof(r) ? 0 : 1);
+    }
+    close(fds[1]);
+    ssize_t got = read(fds[0], &result, sizeof(result));
+    close(fds[0]);
+    int wstatus;
+    if (waitpid(child, &wstatus, 0) < 0 || got != (ssize_t)sizeof(result) || !WIFEXITED(wstatus) ||
+        WEXITSTATUS(wstatus) != 0)
+        result.status = -1;
+    return result;
+}
+#endif
+
+// ---- Residency probe microbenchmark ----
+
+#define PROBE_LOOKUPS (1 << 20)
+#define PROBE_ROUNDS 16
+
+// The frame-table scan every lookup used to be: compare each PageFrame
+static int __attribute__((noinline)) find_aos(const PageFrame *frames, int count, int pid, long long page) {
+    for (int i = 0; i < count; i++) {
+        if (frames[i].process_id == pid && frames[i].page == page)
+            return i;
+    }
+    return -1;
+}
+
+// Half the lookups hit a uniformly chosen frame, half miss
+static void probe_lookups(const FrameTable *ft, uint64_t *rng, int *pids, long long *pages) {
+    for (int i = 0; i < PROBE_LOOKUPS; i++) {
+        *rng = *rng * 6364136223846793005ULL + 1442695040888963407ULL;
+        int frame = (int)((*rng >> 33) % (uint64_t)ft->frame_count);
+        pids[i] = ft->frames[frame].process_id;
+        pages[i] = ft->frames[frame].page + ((*rng >> 32) & 1 ? 0 : 1 << 20);
+    }
+}
+
+static double probe_time(const FrameTable *ft, int kernel, const int *pids, const long long *pages, long long *sink) {
+    double best = 0;
+    for (int round = 0; round < PROBE_ROUNDS; round++) {
+        long long found = 0;
+        double start = timing_wall_seconds();
+        for (int i = 0; i < PROBE_LOOKUPS; i++) {
+            if (kernel == -2)
+                found += find_aos(ft->frames, ft->frame_count, pids[i], pages[i]);
+            else if (kernel == -1)
+                found += pagemap_lookup(&ft->index, page_key(pids[i], pages[i])) != NULL;
+            else
+                found += key_probe_at(kernel)->find(ft->keys, ft->key_slots, page_key(pids[i], pages[i]));
+        }
+        double elapsed = timing_wall_seconds() - start;
+        if (round == 0 || elapsed < best)
+            best = elapsed;
+        *sink += found;
+    }
+    return 1e9 * best / PROBE_LOOKUPS;
+}
+
+// ns per lookup of every residency check, from 4 to 256 frames
+static int run_probe_bench(int csv) {
+    static const int sizes[] = {4, 8, 16, 32, 64, 128, 256};
+    int *pids = malloc(PROBE_LOOKUPS * sizeof(int));
+    long long *pages = malloc(PROBE_LOOKUPS * sizeof(long long));
+    if (!pids || !pages) {
+        free(pids);
+        free(pages);
+        return 1;
+    }
+    if (csv) {
+        printf("frames,kernel,ns_per_lookup\n");
+    } else {
+        printf("%-8s %10s %10s", "frames", "aos-loop", "hash");
+        for (int k = 0; k < key_probe_count(); k++)
+            printf(" %10s", key_probe_at(k)->name);
+        printf("\n");
+    }
+    uint64_t rng = BENCH_SEED;
+    long long sink = 0;
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        FrameTable ft;
+        if (frame_table_init(&ft, sizes[s]) != 0)
+            break;
+        frame_table_set_probe(&ft, NULL); // Keep the hash index filled as well
+        for (int f = 0; f < sizes[s]; f++)
+            frame_table_insert(&ft, f % 4, 1000 + 37LL * f);
+        probe_lookups(&ft, &rng, pids, pages);
+        if (!csv)
+            printf("%-8d", sizes[s]);
+        for (int k = -2; k < key_probe_count(); k++) {
+            double ns = probe_time(&ft, k, pids, pages, &sink);
+            const char *name = k == -2 ? "aos-loop" : k == -1 ? "hash" : key_probe_at(k)->name;
+            if (csv)
+                printf("%d,%s,%.2f\n", sizes[s], name, ns);
+            else
+                printf(" %10.2f", ns);
+        }
+        if (!csv)
+            printf("\n");
+        fflush(stdout);
+        frame_table_free(&ft);
+    }
+    free(pids);
+    free(pages);
+    return sink == 42 ? 1 : 0; // Keeps the lookups from being optimized away
+}
+
+static void usage(FILE *out) {
+    fprintf(out,
+            "Usage: vmsim-bench [options]\n"
+            "  --accesses N      References per workload (default %d)\n"
+            "  --frames N        Physical frames (default %d)\n"
+            "  --repeat N        Runs per measurement, best time kept (default %d)\n"
+            "  --algo NAME       Only this policy (repeatable)\n"
+            "  --workload NAME   Only this workload: loop, uniform, hot-cold, zipf or phased (repeatable)\n"
+            "  --probe           Time residency lookups (ns) from 4 to 256 frames instead\n"
+            "  --sweep           Time a parameter sweep over the first workload on 1 to\n"
+            "                    one-per-CPU threads instead, and its speedup\n"
+            "  --csv             Machine-readable output\n",
+            BENCH_DEFAULT_ACCESSES, BENCH_DEFAULT_FRAMES, BENCH_DEFAULT_REPEAT);
+}
+
+static int workload_known(const char *name) {
+    for (size_t w = 0; w < sizeof(workloads) / sizeof(workloads[0]); w++) {
+        if (strcmp(workloads[w].name, name) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+static int selected(const char *name, const char *const *names, int count) {
+    if (count == 0)
+        return 1;
+    for (int i = 0; i < count; i++) {
+        if (strcmp(names[i], name) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+// ---- Sweep scaling ----
+
+// One sweep of every selected policy at four memory sizes over the first
+// selected workload, on 1, 2, 4... threads up to one per CPU
+static int run_sweep_bench(const PageReference *refs, int n, int frames, const char *const *algos, int algo_count,
+                           int repeat, int csv) {
+    static const int page_sizes[] = {1};
+    const char *names[64];
+    int name_count = 0;
+    for (int p = 0; p < policy_count() && name_count < 64; p++) {
+        if (selected(policy_at(p)->name, algos, algo_count))
+            names[name_count++] = policy_at(p)->name;
+    }
+    int frame_counts[] = {frames / 4 > 0 ? frames / 4 : 1, frames / 2 > 0 ? frames / 2 : 1, frames, 2 * frames};
+    int cpus = threadpool_cpu_count();
+    if (csv)
+        printf("threads,runs,seconds,speedup\n");
+    else
+        printf("%-8s %8s %12s %10s\n", "threads", "runs", "seconds", "speedup");
+    double serial = 0;
+    for (int threads = 1;; threads = threads * 2 < cpus ? threads * 2 : cpus) {
+        SweepSpec spec = {page_sizes, 1, frame_counts, 4, names, name_count, threads};
+        double best = 0;
+        int runs = 0;
+        for (int r = 0; r < repeat; r++) {
+            SweepTable table;
+            if (sweep_run(refs, n, &spec, &table) != 0)
+                return -1;
+            for (int i = 0; i < table.count; i++) {
+                if (table.results[i].status != 0) {
+                    sweep_table_free(&table);
+                    return -1;
+                }
+            }
+            if (r == 0 || table.wall_seconds < best)
+                best = table.wall_seconds;
+            runs = table.count;
+            sweep_table_free(&table);
+        }
+        if (threads == 1)
+            serial = best;
+        double speedup = best > 0 ? serial / best : 0;
+        if (csv)
+            printf("%d,%d,%.6f,%.2f\n", threads, runs, best, speedup);
+        else
+            printf("%-8d %8d %12.3f %9.2fx\n", threads, runs, best, speedup);
+        fflush(stdout);
+        if (threads >= cpus)
+            return 0;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int accesses = BENCH_DEFAULT_ACCESSES, frames = BENCH_DEFAULT_FRAMES, repeat = BENCH_DEFAULT_REPEAT, csv = 0;
+    int probe = 0, sweep = 0;
+    const char *algos[32], *loads[8];
+    int algo_count = 0, load_count = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char *opt = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(opt, "--csv") == 0) {
+            csv = 1;
+            continue;
+        }
+        if (strcmp(opt, "--probe") == 0) {
+            probe = 1;
+            continue;
+        }
+        if (strcmp(opt, "--sweep") == 0) {
+            sweep = 1;
+            continue;
+        }
+        if (strcmp(opt, "--help") == 0 || strcmp(opt, "-h") == 0) {
+            usage(stdout);
+            return 0;
+        }
+        int bad = 0;
+        if (!value)
+            bad = 1;
+        else if (strcmp(opt, "--accesses") == 0)
+            bad = (accesses = atoi(value)) <= 0;
+        else if (strcmp(opt, "--frames") == 0)
+            bad = (frames = atoi(value)) <= 0;
+        else if (strcmp(opt, "--repeat") == 0)
+            bad = (repeat = atoi(value)) <= 0;
+        else if (strcmp(opt, "--algo") == 0 && algo_count < 32)
+            bad = !policy_find(algos[algo_count++] = value);
+        else if (strcmp(opt, "--workload") == 0 && load_count < 8)
+            bad = !workload_known(loads[load_count++] = value);
+        else
+            bad = 1;
+        if (bad) {
+            fprintf(stderr, "vmsim-bench: invalid option or value: %s\n", opt);
+            usage(stderr);
+            return 2;
+        }
+        i++;
+    }
+
+    if (probe)
+        return run_probe_bench(csv);
+
+    PageReference *refs = malloc((size_t)accesses * sizeof(PageReference));
+    if (!refs) {
+        fprintf(stderr, "vmsim-bench: out of memory\n");
+        return 1;
+    }
+    if (sweep) {
+        const BenchWorkload *w = NULL;
+        for (size_t i = 0; i < sizeof(workloads) / sizeof(workloads[0]) && !w; i++) {
+            if (selected(workloads[i].name, loads, load_count))
+                w = &workloads[i];
+        }
+        // Page numbers serve as the addresses of page size 1
+        int status = generate_workload(w, refs, accesses, frames) == 0 ?
+                     run_sweep_bench(refs, accesses, frames, algos, algo_count, repeat, csv) : -1;
+        if (status != 0)
+            fprintf(stderr, "vmsim-bench: the %s sweep failed\n", w->name);
+        free(refs);
+        return status == 0 ? 0 : 1;
+    }
+    if (csv)
+        printf("workload,policy,accesses,frames,seconds,accesses_per_sec,ns_per_access,peak_rss_kb,faults\n");
+    else
+        printf("%-10s %-14s %14s %12s %14s %12s\n", "workload", "policy", "accesses/s", "ns/access", "peak RSS KB",
+               "faults");
+
+    int failures = 0;
+    for (size_t w = 0; w < sizeof(workloads) / sizeof(workloads[0]); w++) {
+        if (!selected(workloads[w].name, loads, load_count))
+            continue;
+        if (generate_workload(&workloads[w], refs, accesses, frames) != 0) {
+            fprintf(stderr, "vmsim-bench: cannot generate %s\n", workloads[w].name);
+            failures++;
+            continue;
+        }
+        for (int p = 0; p < policy_count(); p++) {
+            const ReplacementPolicy *policy = policy_at(p);
+            if (!selected(policy->name, algos, algo_count))
+                continue;
+#ifdef _WIN32
+            BenchResult r = measure(policy, refs, accesses, frames, repeat);
+#else
+            BenchResult r = measure_isolated(policy, refs, accesses, frames, repeat);
+#endif
+            if (r.status != 0) {
+                fprintf(stderr, "vmsim-bench: %s on %s failed\n", policy->name, workloads[w].name);
+                failures++;
+                continue;
+            }
+            double per_sec = r.seconds > 0 ? accesses / r.seconds : 0;
+            double ns = 1e9 * r.seconds / accesses;
+            if (csv)
+                printf("%s,%s,%d,%d,%.6f,%.0f,%.2f,%ld,%lld\n", workloads[w].name, policy->name, accesses, frames,
+                       r.seconds, per_sec, ns, r.peak_rss_kb, r.faults);
+            else
+                printf("%-10s %-14s %14.0f %12.2f %14ld %12lld\n", workloads[w].name, policy->name, per_sec, ns,
+                       r.peak_rss_kb, r.faults);
+            fflush(stdout);
+        }
+    }
+    free(refs);
+    return failures ? 1 : 0;
+}
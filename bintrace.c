@@ -0,0 +1,441 @@
+#include "bintrace.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BINTRACE_MAX_PIDS 65536 // Same bound as the text reader
+#define VARINT_MAX_BYTES 10
+
+static uint32_t crc_table[8][256];
+static pthread_once_t crc_table_once = PTHREAD_ONCE_INIT; // Readers may verify from several threads at once
+
+static void crc_table_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++)
+            c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        crc_table[0][i] = c;
+    }
+    for (int t = 1; t < 8; t++) {
+        for (int i = 0; i < 256; i++)
+            crc_table[t][i] = crc_table[0][crc_table[t - 1][i] & 0xFF] ^ (crc_table[t - 1][i] >> 8);
+    }
+}
+
+// CRC-32 (IEEE), continuing from crc; start a new checksum with 0. Eight
+// bytes per step (slicing-by-8) so verification keeps up with decoding.
+uint32_t bintrace_crc32(uint32_t crc, const unsigned char *data, size_t len) {
+    pthread_once(&crc_table_once, crc_table_init);
+    crc = ~crc;
+    for (; len >= 8; data += 8, len -= 8) {
+        uint32_t lo = crc ^ ((uint32_t)data[0] | (uint32_t)data[1] << 8 | (uint32_t)data[2] << 16 |
+                             (uint32_t)data[3] << 24);
+        crc = crc_table[7][lo & 0xFF] ^ crc_table[6][(lo >> 8) & 0xFF] ^ crc_table[5][(lo >> 16) & 0xFF] ^
+              crc_table[4][lo >> 24] ^ crc_table[3][data[4]] ^ crc_table[2][data[5]] ^ crc_table[1][data[6]] ^
+              crc_table[0][data[7]];
+    }
+    for (; len > 0; data++, len--)
+        crc = crc_table[0][(crc ^ *data) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void put_u32(unsigned char *p, uint32_t v) {
+    for (int i = 0; i < 4; i++)
+        p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static void put_u64(unsigned char *p, uint64_t v) {
+    for (int i = 0; i < 8; i++)
+        p[i] = (unsigned char)(v >> (8 * i));
+}
+
+static uint32_t get_u32(const unsigned char *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint64_t get_u64(const unsigned char *p) {
+    return (uint64_t)get_u32(p) | (uint64_t)get_u32(p + 4) << 32;
+}
+
+static inline uint64_t zigzag(long long delta) {
+    return ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+}
+
+static inline long long unzigzag(uint64_t v) {
+    return (long long)(v >> 1) ^ -(long long)(v & 1);
+}
+
+// ---- Writer ----
+
+static int write_bytes(BinTraceWriter *w, const void *data, size_t len) {
+    if (w->failed || fwrite(data, 1, len, w->out) != len) {
+        w->failed = 1;
+        return -1;
+    }
+    w->offset += len;
+    return 0;
+}
+
+static void encode_header(const BinTraceWriter *w, uint64_t index_offset, unsigned char *h) {
+    memcpy(h, BINTRACE_MAGIC, 8);
+    put_u32(h + 8, BINTRACE_VERSION);
+    put_u32(h + 12, w->flags);
+    put_u32(h + 16, w->page_size);
+    put_u32(h + 20, (uint32_t)w->pid_count);
+    put_u64(h + 24, w->record_count);
+    put_u64(h + 32, index_offset);
+    put_u32(h + 40, w->block_count);
+    put_u32(h + 44, w->block_records);
+}
+
+// Creates path and writes a placeholder header that close() fills in.
+// block_records <= 0 picks BINTRACE_DEFAULT_BLOCK_RECORDS.
+int bintrace_writer_open(BinTraceWriter *w, const char *path, int page_size, uint32_t flags, int block_records) {
+    memset(w, 0, sizeof(*w));
+    w->flags = flags & BINTRACE_FLAG_CRC;
+    w->page_size = page_size > 0 ? (uint32_t)page_size : 4096;
+    w->block_records = block_records > 0 ? (uint32_t)block_records : BINTRACE_DEFAULT_BLOCK_RECORDS;
+    w->out = fopen(path, "wb");
+    if (!w->out)
+        return -1;
+    unsigned char header[BINTRACE_HEADER_SIZE];
+    encode_header(w, 0, header);
+    if (write_bytes(w, header, sizeof(header)) != 0) {
+        fclose(w->out);
+        w->out = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+static int flush_block(BinTraceWriter *w) {
+    if (w->block_count_records == 0)
+        return 0;
+    if (w->block_count == w->block_capacity) {
+        uint32_t capacity = w->block_capacity ? w->block_capacity * 2 : 64;
+        BinTraceBlock *blocks = realloc(w->blocks, capacity * sizeof(*blocks));
+        if (!blocks) {
+            w->failed = 1;
+            return -1;
+        }
+        w->blocks = blocks;
+        w->block_capacity = capacity;
+    }
+    w->blocks[w->block_count].offset = w->offset;
+    w->blocks[w->block_count].first_record = w->record_count - w->block_count_records;
+    w->block_count++;
+
+    unsigned char header[BINTRACE_BLOCK_HEADER_SIZE];
+    put_u32(header, w->block_count_records);
+    put_u32(header + 4, (uint32_t)w->payload_len);
+    put_u32(header + 8, w->flags & BINTRACE_FLAG_CRC ? bintrace_crc32(0, w->payload, w->payload_len) : 0);
+    if (write_bytes(w, header, sizeof(header)) != 0 || write_bytes(w, w->payload, w->payload_len) != 0)
+        return -1;
+
+    // The next block decodes without this one
+    w->payload_len = 0;
+    w->block_count_records = 0;
+    w->current_pid = 0;
+    memset(w->last_page, 0, (size_t)w->pid_capacity * sizeof(long long));
+    return 0;
+}
+
+static int grow_pids(BinTraceWriter *w, int pid) {
+    int capacity = w->pid_capacity ? w->pid_capacity : 16;
+    while (capacity <= pid)
+        capacity *= 2;
+    long long *pages = realloc(w->last_page, (size_t)capacity * sizeof(long long));
+    if (!pages)
+        return -1;
+    memset(pages + w->pid_capacity, 0, (size_t)(capacity - w->pid_capacity) * sizeof(long long));
+    w->last_page = pages;
+    w->pid_capacity = capacity;
+    return 0;
+}
+
+static inline size_t put_varint(unsigned char *p, uint64_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        p[n++] = (unsigned char)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (unsigned char)v;
+    return n;
+}
+
+// Appends references in order. Returns -1 on a write error, or on a pid
+// or page the format cannot hold; the writer is unusable afterwards.
+int bintrace_writer_append(BinTraceWriter *w, const PageReference *refs, size_t count) {
+    if (w->failed)
+        return -1;
+    for (size_t i = 0; i < count; i++) {
+        const PageReference *ref = &refs[i];
+        if (ref->pid < 0 || ref->pid >= BINTRACE_MAX_PIDS || !page_fits_key(ref->page_num)) {
+            w->failed = 1;
+            return -1;
+        }
+        if (ref->pid >= w->pid_capacity && grow_pids(w, ref->pid) != 0) {
+            w->failed = 1;
+            return -1;
+        }
+        if (w->payload_capacity - w->payload_len < 2 * VARINT_MAX_BYTES) {
+            size_t capacity = w->payload_capacity ? w->payload_capacity * 2 : 4096;
+            unsigned char *payload = realloc(w->payload, capacity);
+            if (!payload) {
+                w->failed = 1;
+                return -1;
+            }
+            w->payload = payload;
+            w->payload_capacity = capacity;
+        }
+
+        uint64_t delta = zigzag(ref->page_num - w->last_page[ref->pid]);
+        if (delta >> 62) {
+            w->failed = 1;
+            return -1;
+        }
+        int pid_changed = ref->pid != w->current_pid;
+        uint64_t v = delta << 2 | (uint64_t)(ref->write != 0) << 1 | (uint64_t)pid_changed;
+        w->payload_len += put_varint(w->payload + w->payload_len, v);
+        if (pid_changed)
+            w->payload_len += put_varint(w->payload + w->payload_len, (uint64_t)ref->pid);
+        w->current_pid = ref->pid;
+        w->last_page[ref->pid] = ref->page_num;
+        if (ref->pid >= w->pid_count)
+            w->pid_count = ref->pid + 1;
+        w->record_count++;
+        if (++w->block_count_records == w->block_records && flush_block(w) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+// Writes the last block and the index, then the final header. Returns -1
+// if anything failed along the way; the file is incomplete in that case.
+// record_count and offset keep their final values for reporting.
+int bintrace_writer_close(BinTraceWriter *w) {
+    int status = flush_block(w);
+    uint64_t index_offset = w->offset;
+    for (uint32_t b = 0; status == 0 && b < w->block_count; b++) {
+        unsigned char entry[16];
+        put_u64(entry, w->blocks[b].offset);
+        put_u64(entry + 8, w->blocks[b].first_record);
+        status = write_bytes(w, entry, sizeof(entry));
+    }
+    if (status == 0 && !w->failed) {
+        unsigned char header[BINTRACE_HEADER_SIZE];
+        encode_header(w, index_offset, header);
+        if (fseek(w->out, 0, SEEK_SET) != 0 || fwrite(header, 1, sizeof(header), w->out) != sizeof(header))
+            status = -1;
+    }
+    if (fclose(w->out) != 0 || w->failed)
+        status = -1;
+    free(w->payload);
+    free(w->last_page);
+    free(w->blocks);
+    w->out = NULL;
+    w->payload = NULL;
+    w->last_page = NULL;
+    w->blocks = NULL;
+    return status;
+}
+
+// ---- Reader ----
+
+int bintrace_is_binary(const char *path) {
+    char magic[8];
+    FILE *in = fopen(path, "rb");
+    if (!in)
+        return 0;
+    int binary = fread(magic, 1, sizeof(magic), in) == sizeof(magic) && memcmp(magic, BINTRACE_MAGIC, 8) == 0;
+    fclose(in);
+    return binary;
+}
+
+static size_t source_read(RefSource *src, PageReference *out, size_t max) {
+    return bintrace_reader_read((BinTraceReader *)src, out, max);
+}
+
+// Maps path and checks its header and index. page_size must be a multiple
+// of the page size the file was written with; returns -1 otherwise, or if
+// the file is not a valid binary trace.
+int bintrace_reader_open(BinTraceReader *r, const char *path, int page_size) {
+    memset(r, 0, sizeof(*r));
+    if (mapped_file_open(&r->file, path) != 0)
+        return -1;
+    const unsigned char *data = (const unsigned char *)r->file.data;
+    size_t size = r->file.size;
+    if (size < BINTRACE_HEADER_SIZE || memcmp(data, BINTRACE_MAGIC, 8) != 0 || get_u32(data + 8) != BINTRACE_VERSION)
+        goto fail;
+    r->flags = get_u32(data + 12);
+    r->page_size = get_u32(data + 16);
+    r->pid_count = get_u32(data + 20);
+    r->record_count = get_u64(data + 24);
+    uint64_t index_offset = get_u64(data + 32);
+    r->block_count = get_u32(data + 40);
+    if (r->page_size == 0 || r->pid_count > BINTRACE_MAX_PIDS || index_offset < BINTRACE_HEADER_SIZE ||
+        index_offset > size || (size - index_offset) / 16 < r->block_count)
+        goto fail;
+    r->index = data + index_offset;
+
+    long long wanted = page_size > 0 ? page_size : 4096;
+    if (wanted % r->page_size != 0)
+        goto fail;
+    r->page_ratio = wanted / r->page_size;
+    r->page_shift = -1;
+    if ((r->page_ratio & (r->page_ratio - 1)) == 0) {
+        r->page_shift = 0;
+        while ((1LL << r->page_shift) < r->page_ratio)
+            r->page_shift++;
+    }
+
+    r->last_page = calloc(r->pid_count ? r->pid_count : 1, sizeof(long long));
+    if (!r->last_page)
+        goto fail;
+    r->source.read = source_read;
+    if (bintrace_reader_seek(r, 0) != 0 && r->record_count > 0) {
+        free(r->last_page);
+        goto fail;
+    }
+    return 0;
+
+fail:
+    mapped_file_close(&r->file);
+    return -1;
+}
+
+void bintrace_reader_close(BinTraceReader *r) {
+    mapped_file_close(&r->file);
+    free(r->last_page);
+    r->last_page = NULL;
+}
+
+// Positions the decoder at the start of block b after checking its bounds
+// and, when the file carries them, its checksum
+static int open_block(BinTraceReader *r, uint32_t b) {
+    const unsigned char *data = (const unsigned char *)r->file.data;
+    uint64_t offset = get_u64(r->index + 16 * (size_t)b);
+    size_t limit = (size_t)(r->index - data);
+    if (offset < BINTRACE_HEADER_SIZE || offset > limit || limit - offset < BINTRACE_BLOCK_HEADER_SIZE)
+        return -1;
+    const unsigned char *header = data + offset;
+    uint32_t records = get_u32(header);
+    uint32_t payload_bytes = get_u32(header + 4);
+    if (payload_bytes > limit - offset - BINTRACE_BLOCK_HEADER_SIZE)
+        return -1;
+    const unsigned char *payload = header + BINTRACE_BLOCK_HEADER_SIZE;
+    if ((r->flags & BINTRACE_FLAG_CRC) && bintrace_crc32(0, payload, payload_bytes) != get_u32(header + 8))
+        return -1;
+
+    // Let the OS drop blocks behind us, as the text reader does
+    size_t consumed = (size_t)offset / TRACE_RELEASE_BYTES * TRACE_RELEASE_BYTES;
+    if (consumed > r->released) {
+        mapped_file_release(&r->file, r->released, consumed - r->released);
+        r->released = consumed;
+    }
+
+    r->in = payload;
+    r->in_end = payload + payload_bytes;
+    r->block_left = records;
+    r->block = b + 1;
+    r->current_pid = 0;
+    memset(r->last_page, 0, (r->pid_count ? r->pid_count : 1) * sizeof(long long));
+    return 0;
+}
+
+static inline int get_varint(const unsigned char **pp, const unsigned char *end, uint64_t *out) {
+    const unsigned char *p = *pp;
+    if (p < end && *p < 0x80) { // Most records are a single byte
+        *out = *p;
+        *pp = p + 1;
+        return 0;
+    }
+    uint64_t v = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        unsigned char byte = *p++;
+        v |= (uint64_t)(byte & 0x7F) << shift;
+        if (byte < 0x80) {
+            *out = v;
+            *pp = p;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Decodes up to max references from the current position; returns 0 at
+// the end of the trace or at the first corrupt block (see r->corrupt)
+size_t bintrace_reader_read(BinTraceReader *r, PageReference *out, size_t max) {
+    size_t produced = 0;
+    while (produced < max && !r->corrupt) {
+        if (r->block_left == 0) {
+            if (r->block >= r->block_count)
+                break;
+            if (open_block(r, r->block) != 0) {
+                r->corrupt = 1;
+                break;
+            }
+            continue;
+        }
+        const unsigned char *in = r->in, *end = r->in_end;
+        int pid = r->current_pid;
+        long long *last_page = r->last_page;
+        size_t n = max - produced < r->block_left ? max - produced : r->block_left;
+        size_t i;
+        for (i = 0; i < n; i++) {
+            uint64_t v;
+            if (get_varint(&in, end, &v) != 0)
+                break;
+            if (v & 1) {
+                uint64_t raw;
+                if (get_varint(&in, end, &raw) != 0 || raw >= r->pid_count)
+                    break;
+                pid = (int)raw;
+            }
+            long long page = last_page[pid] + unzigzag(v >> 2);
+            last_page[pid] = page;
+            PageReference *ref = &out[produced + i];
+            ref->pid = pid;
+            ref->write = (unsigned char)(v >> 1 & 1);
+            ref->page_num = r->page_shift >= 0 ? page >> r->page_shift : page / r->page_ratio;
+            if (!page_fits_key(ref->page_num))
+                break; // The writer never stores one
+        }
+        if (i < n)
+            r->corrupt = 1;
+        r->in = in;
+        r->current_pid = pid;
+        r->block_left -= (uint32_t)i;
+        r->position += i;
+        produced += i;
+    }
+    return produced;
+}
+
+// Moves to the record-th reference using the block index, decoding at most
+// one block's worth to get there. Returns -1 past the end or on corruption.
+int bintrace_reader_seek(BinTraceReader *r, uint64_t record) {
+    if (record >= r->record_count || r->block_count == 0)
+        return -1;
+    uint32_t lo = 0, hi = r->block_count - 1;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo + 1) / 2;
+        if (get_u64(r->index + 16 * (size_t)mid + 8) <= record)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    r->corrupt = 0;
+    if (open_block(r, lo) != 0) {
+        r->corrupt = 1;
+        return -1;
+    }
+    r->position = get_u64(r->index + 16 * (size_t)lo + 8);
+    PageReference skip[256];
+    while (r->position < record) {
+        uint64_t left = record - r->position;
+        if (bintrace_reader_read(r, skip, left < 256 ? (size_t)left : 256) == 0)
+            return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,98 @@
+#ifndef BINTRACE_H
+#define BINTRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "simulator.h"
+#include "trace.h"
+
+// Binary trace format (all integers little-endian):
+//
+//   header   "VMTRACE1", u32 version, u32 flags, u32 page_size,
+//            u32 pid_count, u64 record_count, u64 index_offset,
+//            u32 block_count, u32 block_records
+//   blocks   u32 records, u32 payload_bytes, u32 crc32 (0 without
+//            BINTRACE_FLAG_CRC), then the payload
+//   index    block_count x {u64 file offset, u64 first record}
+//
+// Each record is one varint v = zigzag(page delta) << 2 | write << 1 |
+// pid_changed, followed by a varint pid when pid_changed is set. The page
+// delta is against the previous page of the same pid within the block.
+// Every block starts from pid 0 and all previous pages 0, so any block
+// decodes on its own.
+
+#define BINTRACE_MAGIC "VMTRACE1"
+#define BINTRACE_VERSION 1
+#define BINTRACE_HEADER_SIZE 48
+#define BINTRACE_BLOCK_HEADER_SIZE 12
+#define BINTRACE_DEFAULT_BLOCK_RECORDS 65536
+#define BINTRACE_FLAG_CRC 1u
+
+typedef struct {
+    uint64_t offset;
+    uint64_t first_record;
+} BinTraceBlock;
+
+typedef struct {
+    FILE *out;
+    uint32_t flags;
+    uint32_t page_size;
+    uint32_t block_records;
+    uint64_t record_count;
+    uint64_t offset;           // Bytes written so far
+
+    unsigned char *payload;    // Current block
+    size_t payload_len;
+    size_t payload_capacity;
+    uint32_t block_count_records;
+    int current_pid;
+    long long *last_page;      // Per pid, within the current block
+    int pid_capacity;
+    int pid_count;             // Highest pid seen + 1
+
+    BinTraceBlock *blocks;
+    uint32_t block_count;
+    uint32_t block_capacity;
+    int failed;
+} BinTraceWriter;
+
+int bintrace_writer_open(BinTraceWriter *w, const char *path, int page_size, uint32_t flags, int block_records);
+int bintrace_writer_append(BinTraceWriter *w, const PageReference *refs, size_t count);
+int bintrace_writer_close(BinTraceWriter *w);
+
+// Decodes blocks straight out of a memory-mapped file into the simulation
+// loop. Pages are rescaled when the reader asks for a larger page size
+// than the file was written with.
+typedef struct {
+    RefSource source; // Must stay first: simulator_run_source() takes &source
+    MappedFile file;
+    uint32_t flags;
+    uint32_t page_size;   // Of the stored page numbers
+    long long page_ratio; // Requested page size / page_size
+    int page_shift;       // log2(page_ratio), -1 when it is not a power of two
+    uint32_t pid_count;
+    uint64_t record_count;
+    uint32_t block_count;
+    const unsigned char *index;
+
+    // Decoder position
+    uint32_t block;       // Next block to open
+    const unsigned char *in;
+    const unsigned char *in_end;
+    uint32_t block_left;  // Records left in the open block
+    int current_pid;
+    long long *last_page;
+    uint64_t position;    // Index of the next record
+    size_t released;
+    int corrupt;          // Set when a checksum or structural check fails
+} BinTraceReader;
+
+int bintrace_is_binary(const char *path);
+int bintrace_reader_open(BinTraceReader *r, const char *path, int page_size);
+void bintrace_reader_close(BinTraceReader *r);
+size_t bintrace_reader_read(BinTraceReader *r, PageReference *out, size_t max);
+int bintrace_reader_seek(BinTraceReader *r, uint64_t record);
+
+uint32_t bintrace_crc32(uint32_t crc, const unsigned char *data, size_t len);
+
+#endif
@@ -0,0 +1,187 @@
+#include "checkpoint.h"
+#include <stdlib.h>
+#include <string.h>
+#include "simulator.h"
+
+int checkpoint_write(FILE *out, const void *data, size_t size) {
+    return fwrite(data, 1, size, out) == size ? 0 : -1;
+}
+
+int checkpoint_read(FILE *in, void *data, size_t size) {
+    return fread(data, 1, size, in) == size ? 0 : -1;
+}
+
+typedef struct {
+    char magic[8];
+    uint32_t byte_order;
+    uint32_t long_size;
+    char algorithm[16];
+    int32_t frames;
+    int32_t page_size;
+    int64_t position;
+    uint64_t trace_hash;
+    long long hits;
+    long long faults;
+    long long evictions;
+    long long writebacks;
+} CheckpointHeader;
+
+// ---- Statistics ----
+
+static int save_stats(const SimStats *stats, FILE *out) {
+    uint64_t windows = stats->window_count;
+    if (checkpoint_write(out, &stats->process_count, sizeof(int)) != 0 ||
+        checkpoint_write(out, &stats->processes_incomplete, sizeof(int)) != 0 ||
+        checkpoint_write(out, stats->processes, (size_t)stats->process_count * sizeof(SimCounts)) != 0 ||
+        checkpoint_write(out, &stats->frame_count, sizeof(int)) != 0 ||
+        checkpoint_write(out, stats->frames, (size_t)stats->frame_count * sizeof(SimCounts)) != 0 ||
+        checkpoint_write(out, &stats->window, sizeof(long long)) != 0 ||
+        checkpoint_write(out, &stats->window_accesses, sizeof(long long)) != 0 ||
+        checkpoint_write(out, &stats->window_faults, sizeof(long long)) != 0 ||
+        checkpoint_write(out, &stats->windows_incomplete, sizeof(int)) != 0 ||
+        checkpoint_write(out, &windows, sizeof(windows)) != 0 ||
+        checkpoint_write(out, stats->window_fault_counts, stats->window_count * sizeof(int)) != 0)
+        return -1;
+    return 0;
+}
+
+// Into statistics just reset for the run, which have its frame count;
+// every window holds at least one of the run's accesses
+static int load_stats(SimStats *stats, long long accesses, FILE *in) {
+    int processes, frames;
+    uint64_t windows;
+    if (checkpoint_read(in, &processes, sizeof(int)) != 0 || processes < 0 || processes > UINT16_MAX + 1 ||
+        (processes > stats->process_capacity && sim_stats_grow_processes(stats, processes - 1) != 0) ||
+        checkpoint_read(in, &stats->processes_incomplete, sizeof(int)) != 0 ||
+        checkpoint_read(in, stats->processes, (size_t)processes * sizeof(SimCounts)) != 0 ||
+        checkpoint_read(in, &frames, sizeof(int)) != 0 || frames != stats->frame_count ||
+        checkpoint_read(in, stats->frames, (size_t)frames * sizeof(SimCounts)) != 0 ||
+        checkpoint_read(in, &stats->window, sizeof(long long)) != 0 ||
+        checkpoint_read(in, &stats->window_accesses, sizeof(long long)) != 0 ||
+        checkpoint_read(in, &stats->window_faults, sizeof(long long)) != 0 ||
+        checkpoint_read(in, &stats->windows_incomplete, sizeof(int)) != 0 ||
+        checkpoint_read(in, &windows, sizeof(windows)) != 0 || windows > (uint64_t)accesses)
+        return -1;
+    stats->process_count = processes;
+    if (windows > stats->window_capacity) {
+        int *grown = realloc(stats->window_fault_counts, (size_t)windows * sizeof(int));
+        if (!grown)
+            return -1;
+        stats->window_fault_counts = grown;
+        stats->window_capacity = (size_t)windows;
+    }
+    stats->window_count = (size_t)windows;
+    return checkpoint_read(in, stats->window_fault_counts, (size_t)windows * sizeof(int));
+}
+
+// ---- Simulator state ----
+
+// Writes a checkpoint of a run the progress callback stopped, or of one
+// that has finished. Returns -1 if the run cannot be checkpointed (see
+// checkpoint.h) or on a write error.
+int simulator_save_checkpoint(const Simulator *sim, FILE *out) {
+    if (!sim->policy->save || sim->policy->needs_future || sim->swap.enabled || sim->mmu.enabled || sim->prefetcher)
+        return -1;
+    CheckpointHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, CHECKPOINT_MAGIC, sizeof(h.magic));
+    h.byte_order = CHECKPOINT_BYTE_ORDER;
+    h.long_size = sizeof(long);
+    strncpy(h.algorithm, sim->policy->name, sizeof(h.algorithm) - 1);
+    h.frames = sim->memory.frame_count;
+    h.page_size = sim->page_size;
+    h.position = sim->access_time;
+    h.trace_hash = sim->trace_hash;
+    h.hits = sim->hits;
+    h.faults = sim->faults;
+    h.evictions = sim->evictions;
+    h.writebacks = sim->writebacks;
+    if (checkpoint_write(out, &h, sizeof(h)) != 0 || save_stats(&sim->stats, out) != 0 ||
+        frame_table_save(&sim->memory, out) != 0 || sim->policy->save(sim->policy_state, out) != 0)
+        return -1;
+    return fflush(out) == 0 ? 0 : -1;
+}
+
+// Restores a checkpoint into sim, switching it to the checkpoint's
+// algorithm, frame count and page size. The run stays stopped until
+// simulator_continue_source() or simulator_continue_references(); from a
+// trace, simulator_skip_source() first moves the trace past what it has
+// simulated. Returns -1, with sim reset to an empty run, on a file that
+// is not a checkpoint from this kind of machine, on one whose frames,
+// lists or indices do not add up, or if memory runs out, and also if sim
+// has a model on that checkpoints do not cover.
+int simulator_load_checkpoint(Simulator *sim, FILE *in) {
+    CheckpointHeader h;
+    if (sim->swap.enabled || sim->mmu.enabled || sim->prefetcher || checkpoint_read(in, &h, sizeof(h)) != 0 ||
+        memcmp(h.magic, CHECKPOINT_MAGIC, sizeof(h.magic)) != 0 || h.byte_order != CHECKPOINT_BYTE_ORDER ||
+        h.long_size != sizeof(long) || h.frames <= 0 || h.page_size <= 0 || h.position < 0)
+        return -1;
+    h.algorithm[sizeof(h.algorithm) - 1] = '\0';
+    const ReplacementPolicy *policy = policy_find(h.algorithm);
+    if (!policy || !policy->load || simulator_set_algorithm(sim, h.algorithm) != 0 ||
+        simulator_set_frame_count(sim, h.frames) != 0)
+        return -1;
+    simulator_set_page_size(sim, h.page_size);
+    if (simulator_begin_run(sim, NULL, 0) != 0)
+        return -1;
+
+    // The policy's state is checked against the frames the table holds.
+    // No run with prefetching is saved, so no frame can be a prefetch.
+    int status = load_stats(&sim->stats, h.position, in) == 0 && frame_table_load(&sim->memory, in) == 0 ? 0 : -1;
+    unsigned char *resident = status == 0 ? malloc((size_t)h.frames) : NULL;
+    for (int f = 0; resident && f < h.frames; f++) {
+        resident[f] = sim->memory.frames[f].process_id >= 0;
+        if (sim->memory.prefetched[f])
+            status = -1;
+    }
+    if (!resident || status != 0 || sim->policy->load(sim->policy_state, in, resident) != 0)
+        status = -1;
+    free(resident);
+    if (status != 0) {
+        simulator_begin_run(sim, NULL, 0);
+        return -1;
+    }
+    sim->access_time = (long)h.position;
+    sim->trace_hash = h.trace_hash;
+    sim->hits = h.hits;
+    sim->faults = h.faults;
+    sim->evictions = h.evictions;
+    sim->writebacks = h.writebacks;
+    if (timeline_reset(&sim->timeline, &sim->memory, h.position) != 0) {
+        simulator_begin_run(sim, NULL, 0);
+        return -1;
+    }
+    return 0;
+}
+
+// ---- Results cache ----
+
+// Hash of a file's bytes, to key cached results on a trace's content
+int checkpoint_hash_file(const char *path, uint64_t *out) {
+    FILE *in = fopen(path, "rb");
+    if (!in)
+        return -1;
+    unsigned char buf[64 * 1024];
+    uint64_t hash = CHECKPOINT_HASH_SEED;
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
+        hash = checkpoint_hash_bytes(hash, buf, n);
+    int status = ferror(in) ? -1 : 0;
+    fclose(in);
+    *out = hash;
+    return status;
+}
+
+// Where the cache in dir keeps the checkpoint of a finished run of
+// algorithm with frames, page_size and stats_window over the trace with
+// trace_hash. Returns -1 if the path does not fit in buf.
+int checkpoint_cache_path(char *buf, size_t size, const char *dir, uint64_t trace_hash, const char *algorithm,
+                          int frames, int page_size, long long stats_window) {
+    uint64_t key = checkpoint_hash_bytes(CHECKPOINT_HASH_SEED, &trace_hash, sizeof(trace_hash));
+    key = checkpoint_hash_bytes(key, algorithm, strlen(algorithm));
+    key = checkpoint_hash_bytes(key, &frames, sizeof(frames));
+    key = checkpoint_hash_bytes(key, &page_size, sizeof(page_size));
+    key = checkpoint_hash_bytes(key, &stats_window, sizeof(stats_window));
+    int len = snprintf(buf, size, "%s/%016llx.ckpt", dir, (unsigned long long)key);
+    return len >= 0 && (size_t)len < size ? 0 : -1;
+}
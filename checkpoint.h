@@ -0,0 +1,57 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Checkpoints of a stopped or finished run: its settings, counters,
+// statistics, resident frames and the replacement policy's own state,
+// plus how many references it has simulated and a hash of them. A run
+// restored from one picks up where it stopped, over any source whose
+// first references hash the same, so a longer trace that starts with the
+// checkpointed one resumes rather than starting over.
+//
+// File layout, in the byte order and word sizes of the machine that wrote
+// it (the header records them, and a reader rejects a mismatch):
+//
+//   header    "VMCKPT02", u32 byte-order mark, u32 sizeof(long),
+//             char algorithm[16], i32 frames, i32 page size,
+//             i64 references simulated, u64 their hash
+//   counters  hits, faults, evictions, write-backs
+//   stats     per process, per frame and per window counts
+//   memory    the frame table, free list and load order included
+//   policy    whatever the policy's save op writes
+//
+// Runs with the swap, TLB or prefetch model on, or with a policy that
+// needs the future, cannot be checkpointed.
+
+#define CHECKPOINT_MAGIC "VMCKPT02"
+#define CHECKPOINT_BYTE_ORDER 0x01020304u
+
+// Starting value of the hashes below
+#define CHECKPOINT_HASH_SEED 0xcbf29ce484222325ULL
+
+// FNV-1a, 64-bit
+static inline uint64_t checkpoint_hash_bytes(uint64_t hash, const void *data, size_t size) {
+    const unsigned char *p = data;
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ p[i]) * 0x100000001b3ULL;
+    return hash;
+}
+
+// One reference: FNV-1a over whole words, which is enough to tell traces apart
+static inline uint64_t checkpoint_hash_reference(uint64_t hash, int pid, long long page, int write) {
+    hash = (hash ^ (uint64_t)page) * 0x100000001b3ULL;
+    return (hash ^ ((uint64_t)(uint32_t)pid << 1 | (uint64_t)(write != 0))) * 0x100000001b3ULL;
+}
+
+// Writes or reads size bytes; -1 on a short transfer
+int checkpoint_write(FILE *out, const void *data, size_t size);
+int checkpoint_read(FILE *in, void *data, size_t size);
+
+int checkpoint_hash_file(const char *path, uint64_t *out);
+int checkpoint_cache_path(char *buf, size_t size, const char *dir, uint64_t trace_hash, const char *algorithm,
+                          int frames, int page_size, long long stats_window);
+
+#endif
@@ -0,0 +1,237 @@
+#include "compare.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "timing.h"
+
+// References each policy takes in a row. Longer than a simulator batch so
+// that switching between the policies' own state, which is far bigger than
+// the batch, happens less often; still small enough to stay in L2.
+#define COMPARE_BATCH (16 * SIM_BATCH_SIZE)
+
+typedef struct {
+    Simulator **sims;
+    int count;
+    int needs_future; // Some policy needs the whole run up front
+} CompareSet;
+
+static void set_free(CompareSet *set) {
+    for (int i = 0; i < set->count; i++)
+        simulator_destroy(set->sims[i]);
+    free(set->sims);
+    set->sims = NULL;
+}
+
+// One quiet simulator per algorithm; -1 on bad spec or allocation failure
+static int set_init(CompareSet *set, const CompareSpec *spec, CompareTable *table) {
+    memset(set, 0, sizeof(*set));
+    memset(table, 0, sizeof(*table));
+    if (spec->frames <= 0 || spec->algorithm_count <= 0)
+        return -1;
+    for (int i = 0; i < spec->algorithm_count; i++) {
+        if (!policy_find(spec->algorithms[i]))
+            return -1;
+    }
+    set->sims = calloc((size_t)spec->algorithm_count, sizeof(Simulator *));
+    table->results = calloc((size_t)spec->algorithm_count, sizeof(CompareResult));
+    if (!set->sims || !table->results) {
+        free(set->sims);
+        compare_table_free(table);
+        return -1;
+    }
+    table->count = spec->algorithm_count;
+    table->frames = spec->frames;
+    table->modeled = spec->swap != NULL;
+    for (int i = 0; i < spec->algorithm_count; i++) {
+        Simulator *sim = simulator_create(spec->frames, 1);
+        if (sim)
+            set->sims[set->count++] = sim; // set_free() destroys it if it cannot be set up
+        if (!sim || simulator_set_algorithm(sim, spec->algorithms[i]) != 0 ||
+            simulator_set_swap(sim, spec->swap) != 0 ||
+            (spec->prefetcher && simulator_set_prefetcher(sim, spec->prefetcher, spec->prefetch_degree) != 0)) {
+            set_free(set);
+            compare_table_free(table);
+            return -1;
+        }
+        simulator_set_verbosity(sim, SIM_VERBOSITY_NONE);
+        simulator_set_stats_window(sim, 0);
+        table->results[i].policy = sim->policy;
+        set->needs_future |= sim->policy->needs_future;
+    }
+    return 0;
+}
+
+static int begin_all(CompareSet *set, const PageReference *refs, int len) {
+    for (int i = 0; i < set->count; i++) {
+        if (simulator_begin_run(set->sims[i], refs, len) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+// The batch goes through every policy back to back, so after the first
+// one it is read from cache rather than memory. Returns -1 if a policy
+// could not take it.
+static int step_all(CompareSet *set, CompareTable *table, const PageReference *refs, int count,
+                    long long first_index) {
+    for (int i = 0; i < set->count; i++) {
+        double start = timing_cpu_seconds();
+        int status = simulator_step(set->sims[i], refs, count, first_index);
+        table->results[i].cpu_seconds += timing_cpu_seconds() - start;
+        if (status != 0)
+            return -1;
+    }
+    table->accesses += count;
+    return 0;
+}
+
+static int batch_done(const CompareSpec *spec, long long done, long long total) {
+    if (spec->progress && spec->progress(done, total, spec->progress_data))
+        return SIM_CANCELLED;
+    return 0;
+}
+
+static void end_all(CompareSet *set, CompareTable *table) {
+    for (int i = 0; i < set->count; i++) {
+        Simulator *sim = set->sims[i];
+        simulator_end_run(sim);
+        table->results[i].hits = sim->hits;
+        table->results[i].faults = sim->faults;
+        table->results[i].evictions = sim->evictions;
+        table->results[i].writebacks = sim->writebacks;
+        table->results[i].modeled_seconds = sim->swap.now / 1e9;
+        table->results[i].stall_seconds = sim->swap.stall_ns / 1e9;
+        table->results[i].prefetching = sim->prefetching;
+        table->results[i].prefetch = sim->prefetch;
+        table->prefetching |= sim->prefetching;
+    }
+}
+
+static int run_array(CompareSet *set, const PageReference *refs, int len, const CompareSpec *spec,
+                     CompareTable *table) {
+    if (begin_all(set, refs, len) != 0)
+        return -1;
+    int status = 0;
+    for (int done = 0; done < len && status == 0;) {
+        int count = len - done < COMPARE_BATCH ? len - done : COMPARE_BATCH;
+        status = step_all(set, table, refs + done, count, done);
+        done += count;
+        if (status == 0)
+            status = batch_done(spec, done, len);
+    }
+    end_all(set, table);
+    return status;
+}
+
+// Runs every algorithm in spec over refs. Returns -1 on a bad spec or if
+// memory runs out, SIM_CANCELLED if the progress callback stopped it; the
+// table is only left to free on success.
+int compare_run_references(const PageReference *refs, int len, const CompareSpec *spec, CompareTable *table) {
+    CompareSet set;
+    if (len < 0 || set_init(&set, spec, table) != 0)
+        return -1;
+    double start = timing_wall_seconds();
+    int status = run_array(&set, refs, len, spec, table);
+    table->wall_seconds = timing_wall_seconds() - start;
+    set_free(&set);
+    if (status != 0)
+        compare_table_free(table);
+    return status;
+}
+
+// Like compare_run_references() over references pulled from src. With a
+// policy such as Optimal in the set the whole stream is collected first,
+// once, and replayed for all of them.
+int compare_run_source(RefSource *src, const CompareSpec *spec, CompareTable *table) {
+    CompareSet set;
+    if (set_init(&set, spec, table) != 0)
+        return -1;
+    double start = timing_wall_seconds();
+    int status;
+    if (set.needs_future) {
+        Simulator *owner = set.sims[0];
+        status = simulator_load_source(owner, src);
+        table->read_seconds = owner->stats.phases[SIM_PHASE_GENERATE].wall_seconds;
+        if (status == 0)
+            status = run_array(&set, owner->reference_string, owner->reference_string_len, spec, table);
+    } else {
+        PageReference *batch = malloc(COMPARE_BATCH * sizeof(PageReference));
+        if (!batch || begin_all(&set, NULL, 0) != 0) {
+            free(batch);
+            set_free(&set);
+            compare_table_free(table);
+            return -1;
+        }
+        status = 0;
+        while (status == 0) {
+            double read_start = timing_wall_seconds();
+            size_t n = 0, got;
+            while (n < COMPARE_BATCH && (got = src->read(src, batch + n, COMPARE_BATCH - n)) > 0)
+                n += got;
+            table->read_seconds += timing_wall_seconds() - read_start;
+            if (n == 0)
+                break;
+            status = step_all(&set, table, batch, (int)n, table->accesses);
+            if (status == 0)
+                status = batch_done(spec, table->accesses, -1);
+        }
+        free(batch);
+        end_all(&set, table);
+    }
+    table->wall_seconds = timing_wall_seconds() - start;
+    set_free(&set);
+    if (status != 0)
+        compare_table_free(table);
+    return status;
+}
+
+void compare_table_free(CompareTable *table) {
+    free(table->results);
+    table->results = NULL;
+    table->count = 0;
+}
+
+// What a row is ranked on: modeled time under the swap model, else faults
+static double compare_cost(const CompareTable *table, const CompareResult *r) {
+    return table->modeled ? r->modeled_seconds : (double)r->faults;
+}
+
+// Formats one line of the side-by-side table: row -1 is the header, then
+// one row per result. Each row's faults, or modeled time under the swap
+// model, are also given relative to the best any policy did.
+size_t compare_format_line(const CompareTable *table, int row, char *buf, size_t size) {
+    int len;
+    if (row < 0) {
+        len = snprintf(buf, size, "%-14s %12s %12s %12s %12s %10s %9s %8s%s%s\n", "Algorithm", "Faults", "Hits",
+                       "Evictions", "Write-backs", "Fault Rate", "vs Best", "CPU s",
+                       table->modeled ? "    Stall s  Modeled s" : "", table->prefetching ? "  PF Acc  PF Cov" : "");
+    } else {
+        const CompareResult *r = &table->results[row];
+        double cost = compare_cost(table, r), best = cost;
+        for (int i = 0; i < table->count; i++) {
+            if (compare_cost(table, &table->results[i]) < best)
+                best = compare_cost(table, &table->results[i]);
+        }
+        double rate = table->accesses > 0 ? 100.0 * (double)r->faults / (double)table->accesses : 0.0;
+        char versus[16];
+        if (cost == best)
+            snprintf(versus, sizeof(versus), "best");
+        else
+            snprintf(versus, sizeof(versus), "+%.1f%%", 100.0 * (cost - best) / (best > 0 ? best : 1));
+        char model[32] = "", prefetch[32] = "";
+        if (table->modeled)
+            snprintf(model, sizeof(model), " %10.3f %10.3f", r->stall_seconds, r->modeled_seconds);
+        const PrefetchCounts *pf = &r->prefetch;
+        if (r->prefetching)
+            snprintf(prefetch, sizeof(prefetch), " %6.1f%% %6.1f%%",
+                     pf->issued > 0 ? 100.0 * (double)pf->hits / (double)pf->issued : 0.0,
+                     pf->hits + r->faults > 0 ? 100.0 * (double)pf->hits / (double)(pf->hits + r->faults) : 0.0);
+        else if (table->prefetching)
+            snprintf(prefetch, sizeof(prefetch), " %7s %7s", "-", "-");
+        len = snprintf(buf, size, "%-14s %12lld %12lld %12lld %12lld %9.2f%% %9s %8.3f%s%s\n", r->policy->name,
+                       r->faults, r->hits, r->evictions, r->writebacks, rate, versus, r->cpu_seconds, model, prefetch);
+    }
+    if (len < 0)
+        return 0;
+    return (size_t)len < size ? (size_t)len : size - 1;
+}
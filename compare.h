@@ -0,0 +1,53 @@
+#ifndef COMPARE_H
+#define COMPARE_H
+
+#include <stddef.h>
+#include "simulator.h"
+
+// Several policies over one pass of the references. Each batch is read or
+// decoded once and then simulated by every policy in turn while it is still
+// in cache; the policies keep independent frame tables and state.
+typedef struct {
+    int frames;
+    const char *const *algorithms; // Registry names
+    int algorithm_count;
+    SimProgressFn progress;        // Optional, called after every batch
+    void *progress_data;
+    const SwapConfig *swap;        // Optional cost model, the same for every policy
+    const char *prefetcher;        // Optional, for every policy that can take one
+    int prefetch_degree;           // 0 for the prefetcher's default
+} CompareSpec;
+
+typedef struct {
+    const ReplacementPolicy *policy;
+    long long hits;
+    long long faults;
+    long long evictions;
+    long long writebacks;
+    double modeled_seconds; // Under the swap model, when there is one
+    double stall_seconds;
+    double cpu_seconds;     // This policy's share of the simulation
+    int prefetching;
+    PrefetchCounts prefetch;
+} CompareResult;
+
+// Results in the order the spec lists the algorithms
+typedef struct {
+    CompareResult *results;
+    int count;
+    int frames;
+    int modeled;     // Ranked by modeled time rather than faults
+    int prefetching; // Some policy ran with the prefetcher
+    long long accesses;
+    double read_seconds; // Reading the source, paid once for all policies
+    double wall_seconds;
+} CompareTable;
+
+#define COMPARE_LINE_MAX 160 // Enough for any line of the formatted table
+
+int compare_run_references(const PageReference *refs, int len, const CompareSpec *spec, CompareTable *table);
+int compare_run_source(RefSource *src, const CompareSpec *spec, CompareTable *table);
+void compare_table_free(CompareTable *table);
+size_t compare_format_line(const CompareTable *table, int row, char *buf, size_t size);
+
+#endif
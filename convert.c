@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bintrace.h"
+#include "simulator.h"
+#include "trace.h"
+
+// Converts a text or lackey trace, or the built-in workload's reference
+// string, into the indexed binary trace format that vmsim reads directly
+
+static void usage(FILE *out) {
+    fprintf(out,
+            "Usage: vmsim-convert [options] -o OUTPUT\n"
+            "  --trace FILE        Text or lackey address trace to convert\n"
+            "  --trace-format F    auto, text or lackey (default auto)\n"
+            "  --process KB        Convert the synthetic workload instead; repeat per process\n"
+            "  --page-size BYTES   Page size the records are stored in (default 4096)\n"
+            "  --block N           Records per block (default %d)\n"
+            "  --crc               Store a CRC-32 per block\n"
+            "  -o, --output FILE   Binary trace to write\n"
+            "  --help              Show this help\n",
+            BINTRACE_DEFAULT_BLOCK_RECORDS);
+}
+
+static int parse_int(const char *text, int *out) {
+    char *end;
+    long value = strtol(text, &end, 10);
+    if (*text == '\0' || *end != '\0' || value <= 0 || value > 1 << 30)
+        return -1;
+    *out = (int)value;
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    const char *trace_path = NULL, *output = NULL;
+    TraceFormat trace_format = TRACE_FORMAT_AUTO;
+    int page_size = 4096, block_records = BINTRACE_DEFAULT_BLOCK_RECORDS;
+    int process_sizes[MAX_PROCESSES], process_count = 0;
+    uint32_t flags = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char *opt = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        int bad = 0;
+        if (strcmp(opt, "--help") == 0 || strcmp(opt, "-h") == 0) {
+            usage(stdout);
+            return 0;
+        } else if (strcmp(opt, "--crc") == 0) {
+            flags |= BINTRACE_FLAG_CRC;
+            continue;
+        } else if (!value) {
+            bad = 1;
+        } else if (strcmp(opt, "--trace") == 0) {
+            trace_path = value;
+        } else if (strcmp(opt, "--trace-format") == 0) {
+            if (strcmp(value, "auto") == 0)
+                trace_format = TRACE_FORMAT_AUTO;
+            else if (strcmp(value, "text") == 0)
+                trace_format = TRACE_FORMAT_TEXT;
+            else if (strcmp(value, "lackey") == 0)
+                trace_format = TRACE_FORMAT_LACKEY;
+            else
+                bad = 1;
+        } else if (strcmp(opt, "--process") == 0) {
+            bad = process_count == MAX_PROCESSES || parse_int(value, &process_sizes[process_count++]) != 0;
+        } else if (strcmp(opt, "--page-size") == 0) {
+            bad = parse_int(value, &page_size) != 0;
+        } else if (strcmp(opt, "--block") == 0) {
+            bad = parse_int(value, &block_records) != 0;
+        } else if (strcmp(opt, "-o") == 0 || strcmp(opt, "--output") == 0) {
+            output = value;
+        } else {
+            bad = 1;
+        }
+        if (bad) {
+            fprintf(stderr, "vmsim-convert: invalid option or value: %s%s%s\n", opt, value ? " " : "",
+                    value ? value : "");
+            usage(stderr);
+            return 2;
+        }
+        i++;
+    }
+    if (!output || (!trace_path) == (process_count == 0)) {
+        fprintf(stderr, "vmsim-convert: give -o and either a --trace file or --process sizes\n");
+        return 2;
+    }
+
+    BinTraceWriter writer;
+    if (bintrace_writer_open(&writer, output, page_size, flags, block_records) != 0) {
+        fprintf(stderr, "vmsim-convert: cannot create %s\n", output);
+        return 1;
+    }
+
+    int status = 0;
+    if (trace_path) {
+        TraceReader trace;
+        if (trace_reader_open(&trace, trace_path, trace_format, page_size) != 0) {
+            fprintf(stderr, "vmsim-convert: cannot open trace file %s\n", trace_path);
+            bintrace_writer_close(&writer);
+            remove(output);
+            return 1;
+        }
+        PageReference *batch = malloc(SIM_BATCH_SIZE * sizeof(PageReference));
+        size_t got;
+        status = batch ? 0 : -1;
+        while (status == 0 && (got = trace_reader_read(&trace, batch, SIM_BATCH_SIZE)) > 0)
+            status = bintrace_writer_append(&writer, batch, got);
+        if (status == 0)
+            fprintf(stderr, "%s: %lld lines, %lld skipped\n", trace_path, trace.lines, trace.skipped);
+        free(batch);
+        trace_reader_close(&trace);
+    } else {
+        Simulator *sim = simulator_create(FRAME_COUNT, 0);
+        status = sim ? 0 : -1;
+        if (sim) {
+            simulator_set_page_size(sim, page_size);
+            simulator_set_process_count(sim, process_count);
+            for (int i = 0; i < process_count; i++)
+                simulator_set_process_size(sim, i, process_sizes[i]);
+            status = simulator_generate_references(sim);
+            if (status == 0)
+                status = bintrace_writer_append(&writer, sim->reference_string, (size_t)sim->reference_string_len);
+        }
+        simulator_destroy(sim);
+    }
+
+    if (bintrace_writer_close(&writer) != 0 || status != 0) {
+        fprintf(stderr, "vmsim-convert: writing %s failed\n", output);
+        remove(output);
+        return 1;
+    }
+    unsigned long long records = writer.record_count, bytes = writer.offset;
+    fprintf(stderr, "%s: %llu references, %llu bytes (%.2f bytes/reference)\n", output, records, bytes,
+            records ? (double)bytes / (double)records : 0.0);
+    return 0;
+}
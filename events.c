@@ -0,0 +1,168 @@
+#include "events.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int event_ring_init(EventRing *ring, size_t capacity) {
+    memset(ring, 0, sizeof(*ring));
+    size_t rounded = 1;
+    while (rounded < capacity)
+        rounded <<= 1;
+    ring->events = malloc(rounded * sizeof(SimEvent));
+    if (!ring->events)
+        return -1;
+    ring->capacity = rounded;
+    return 0;
+}
+
+void event_ring_free(EventRing *ring) {
+    free(ring->events);
+    ring->events = NULL;
+    ring->capacity = 0;
+}
+
+void event_ring_reset(EventRing *ring) {
+    ring->head = ring->tail = 0;
+    ring->dropped = 0;
+}
+
+// Hands every held event to the sink, oldest first, in at most two slices
+void event_ring_flush(EventRing *ring) {
+    if (!ring->sink)
+        return;
+    while (ring->tail != ring->head) {
+        size_t start = ring->tail & (ring->capacity - 1);
+        size_t count = ring->head - ring->tail;
+        if (start + count > ring->capacity)
+            count = ring->capacity - start;
+        ring->sink(&ring->events[start], count, ring->sink_data);
+        ring->tail += count;
+    }
+}
+
+int log_formatter_init(LogFormatter *lf, int frame_count, const char *algorithm, int show_state) {
+    memset(lf, 0, sizeof(*lf));
+    lf->algorithm = algorithm;
+    lf->frame_count = frame_count;
+    lf->oldest = lf->newest = -1;
+    if (!show_state || frame_count > LOG_STATE_MAX_FRAMES)
+        return 0;
+
+    lf->pid = malloc((size_t)frame_count * sizeof(int));
+    lf->page = malloc((size_t)frame_count * sizeof(long long));
+    lf->last_access = malloc((size_t)frame_count * sizeof(long long));
+    lf->prev = malloc((size_t)frame_count * sizeof(int));
+    lf->next = malloc((size_t)frame_count * sizeof(int));
+    if (!lf->pid || !lf->page || !lf->last_access || !lf->prev || !lf->next) {
+        log_formatter_free(lf);
+        return -1;
+    }
+    lf->show_state = 1;
+    return 0;
+}
+
+void log_formatter_free(LogFormatter *lf) {
+    free(lf->pid);
+    free(lf->page);
+    free(lf->last_access);
+    free(lf->prev);
+    free(lf->next);
+    lf->pid = lf->prev = lf->next = NULL;
+    lf->page = lf->last_access = NULL;
+    lf->show_state = 0;
+}
+
+// Shadow memory, kept in load order like the simulator's frame table
+static void shadow_load(LogFormatter *lf, const SimEvent *ev) {
+    int f = ev->frame;
+    lf->pid[f] = ev->pid;
+    lf->page[f] = ev->page;
+    lf->last_access[f] = ev->time;
+    lf->prev[f] = lf->newest;
+    lf->next[f] = -1;
+    if (lf->newest >= 0)
+        lf->next[lf->newest] = f;
+    else
+        lf->oldest = f;
+    lf->newest = f;
+}
+
+static void shadow_evict(LogFormatter *lf, int f) {
+    if (lf->prev[f] >= 0)
+        lf->next[lf->prev[f]] = lf->next[f];
+    else
+        lf->oldest = lf->next[f];
+    if (lf->next[f] >= 0)
+        lf->prev[lf->next[f]] = lf->prev[f];
+    else
+        lf->newest = lf->prev[f];
+}
+
+static size_t format_state(const LogFormatter *lf, char *buf, size_t size) {
+    size_t len = 0;
+    len += (size_t)snprintf(buf, size, "Current Memory State: [");
+    int f = lf->oldest;
+    for (int j = 0; j < lf->frame_count && len < size; j++) {
+        if (f != -1) {
+            len += (size_t)snprintf(buf + len, size - len, "F%d:P%d.P%lld(T%lld)",
+                                    f, lf->pid[f], lf->page[f], lf->last_access[f]);
+            f = lf->next[f];
+        } else {
+            len += (size_t)snprintf(buf + len, size - len, "Empty");
+        }
+        if (j < lf->frame_count - 1 && len < size)
+            len += (size_t)snprintf(buf + len, size - len, ", ");
+    }
+    if (len < size)
+        len += (size_t)snprintf(buf + len, size - len, "]\n\n");
+    return len < size ? len : size - 1;
+}
+
+// Adds a page that is already in memory to the shadow, for a run that goes
+// on from a checkpoint; call in load order, oldest first
+void log_formatter_resident(LogFormatter *lf, int frame, int pid, long long page, long long last_access) {
+    if (!lf->show_state)
+        return;
+    SimEvent ev = {last_access, page, frame, pid, SIM_EVENT_FAULT};
+    shadow_load(lf, &ev);
+}
+
+// Formats one event into buf and returns the number of characters written
+size_t log_formatter_format(LogFormatter *lf, const SimEvent *ev, char *buf, size_t size) {
+    int len = 0;
+
+    switch (ev->type) {
+    case SIM_EVENT_ACCESS:
+        len = snprintf(buf, size, "Accessing P%d, Page %lld (Time %lld)\n", ev->pid, ev->page, ev->time);
+        break;
+    case SIM_EVENT_HIT:
+        len = snprintf(buf, size, "Access:   Process %d Page %lld (In Memory)\n", ev->pid, ev->page);
+        if (lf->show_state)
+            lf->last_access[ev->frame] = ev->time;
+        break;
+    case SIM_EVENT_FAULT:
+        len = snprintf(buf, size, "Page-In:  Process %d Page %lld -> Frame %d\n", ev->pid, ev->page, ev->frame);
+        if (lf->show_state)
+            shadow_load(lf, ev);
+        break;
+    case SIM_EVENT_EVICT:
+        len = snprintf(buf, size, "Page-Out: Process %d Page %lld from Frame %d (Algorithm: %s)\n",
+                       ev->pid, ev->page, ev->frame, lf->algorithm);
+        if (lf->show_state)
+            shadow_evict(lf, ev->frame);
+        break;
+    case SIM_EVENT_PREFETCH:
+        len = snprintf(buf, size, "Prefetch: Process %d Page %lld -> Frame %d\n", ev->pid, ev->page, ev->frame);
+        if (lf->show_state)
+            shadow_load(lf, ev);
+        break;
+    }
+    if (len < 0)
+        return 0;
+    if ((size_t)len >= size)
+        return size - 1;
+
+    if (lf->show_state && (ev->type == SIM_EVENT_HIT || ev->type == SIM_EVENT_FAULT))
+        len += (int)format_state(lf, buf + len, size - (size_t)len);
+    return (size_t)len;
+}
@@ -0,0 +1,96 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    SIM_EVENT_ACCESS,  // Page referenced
+    SIM_EVENT_HIT,     // Page was already resident
+    SIM_EVENT_FAULT,   // Page-in into `frame`
+    SIM_EVENT_EVICT,   // Page-out from `frame`
+    SIM_EVENT_PREFETCH // Speculative page-in into `frame`
+} SimEventType;
+
+typedef enum {
+    SIM_VERBOSITY_NONE,    // No events, no summary
+    SIM_VERBOSITY_SUMMARY, // Counters only; nothing recorded per access
+    SIM_VERBOSITY_FAULTS,  // Fault and eviction events
+    SIM_VERBOSITY_FULL     // Every access, plus memory state when formatted
+} SimVerbosity;
+
+// Compact fixed-size record; text is only produced by a LogFormatter
+typedef struct {
+    long long time;
+    long long page;
+    int frame;
+    uint16_t pid; // As many bits as page_key() keeps
+    unsigned char type;
+} SimEvent;
+
+typedef void (*SimEventSink)(const SimEvent *events, size_t count, void *user_data);
+
+// Preallocated ring of events. With a sink attached the ring is drained into
+// it whenever it fills; without one the oldest events are overwritten.
+typedef struct {
+    SimEvent *events;
+    size_t capacity; // Always a power of two
+    size_t head;     // Total events written
+    size_t tail;     // Oldest event still held
+    unsigned long long dropped;
+    SimEventSink sink;
+    void *sink_data;
+} EventRing;
+
+#define EVENT_RING_DEFAULT_CAPACITY 65536
+
+int event_ring_init(EventRing *ring, size_t capacity);
+void event_ring_free(EventRing *ring);
+void event_ring_reset(EventRing *ring);
+void event_ring_flush(EventRing *ring);
+
+static inline void event_ring_push(EventRing *ring, const SimEvent *ev) {
+    if (ring->head - ring->tail == ring->capacity) {
+        if (ring->sink) {
+            event_ring_flush(ring);
+        } else {
+            ring->tail++;
+            ring->dropped++;
+        }
+    }
+    ring->events[ring->head++ & (ring->capacity - 1)] = *ev;
+}
+
+static inline size_t event_ring_count(const EventRing *ring) {
+    return ring->head - ring->tail;
+}
+
+// i-th oldest event still held in the ring
+static inline const SimEvent *event_ring_at(const EventRing *ring, size_t i) {
+    return &ring->events[(ring->tail + i) & (ring->capacity - 1)];
+}
+
+#define LOG_STATE_MAX_FRAMES 32 // Memory state lines are only printed up to this many frames
+#define LOG_LINE_MAX 2048       // Enough for any single formatted event
+
+// Turns events back into the simulator's text log. For small frame counts it
+// keeps a shadow of memory so FULL logs can show the state after each access.
+typedef struct {
+    const char *algorithm;
+    int frame_count;
+    int show_state;
+    int *pid;
+    long long *page;
+    long long *last_access;
+    int *prev;
+    int *next;
+    int oldest;
+    int newest;
+} LogFormatter;
+
+int log_formatter_init(LogFormatter *lf, int frame_count, const char *algorithm, int show_state);
+void log_formatter_free(LogFormatter *lf);
+size_t log_formatter_format(LogFormatter *lf, const SimEvent *ev, char *buf, size_t size);
+void log_formatter_resident(LogFormatter *lf, int frame, int pid, long long page, long long last_access);
+
+#endif
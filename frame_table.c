@@ -0,0 +1,201 @@
+#include "frame_table.h"
+#include "checkpoint.h"
+#include "framelist.h"
+#include <stdlib.h>
+#include <string.h>
+
+int frame_table_init(FrameTable *ft, int frame_count) {
+    memset(ft, 0, sizeof(*ft));
+    ft->frames = malloc((size_t)frame_count * sizeof(PageFrame));
+    ft->load_prev = malloc((size_t)frame_count * sizeof(int));
+    ft->load_next = malloc((size_t)frame_count * sizeof(int));
+    ft->free_frames = malloc((size_t)frame_count * sizeof(int));
+    ft->dirty = malloc((size_t)frame_count);
+    ft->prefetched = malloc((size_t)frame_count);
+    ft->key_slots = (frame_count + KEY_PROBE_PAD - 1) / KEY_PROBE_PAD * KEY_PROBE_PAD;
+    ft->keys = malloc((size_t)ft->key_slots * sizeof(uint64_t));
+    if (!ft->frames || !ft->load_prev || !ft->load_next || !ft->free_frames || !ft->dirty || !ft->prefetched ||
+        !ft->keys || pagemap_init(&ft->index, (size_t)frame_count) != 0) {
+        frame_table_free(ft);
+        return -1;
+    }
+    ft->frame_count = frame_count;
+    ft->probe = frame_count <= FRAME_TABLE_PROBE_MAX ? key_probe_best()->find : NULL;
+    frame_table_reset(ft);
+    return 0;
+}
+
+// Switches lookups to another scan kernel, or to the hash index with NULL
+void frame_table_set_probe(FrameTable *ft, KeyProbeFn probe) {
+    if (!probe && ft->probe) {
+        // The index was not kept up to date while scanning
+        pagemap_clear(&ft->index);
+        for (int f = 0; f < ft->frame_count; f++) {
+            if (ft->keys[f] != PAGEMAP_EMPTY)
+                pagemap_put(&ft->index, ft->keys[f], f);
+        }
+    }
+    ft->probe = probe;
+}
+
+void frame_table_free(FrameTable *ft) {
+    free(ft->frames);
+    free(ft->load_prev);
+    free(ft->load_next);
+    free(ft->free_frames);
+    free(ft->dirty);
+    free(ft->prefetched);
+    free(ft->keys);
+    pagemap_free(&ft->index);
+    memset(ft, 0, sizeof(*ft));
+}
+
+// Empties every frame; frames are handed out again from frame 0 upwards
+void frame_table_reset(FrameTable *ft) {
+    for (int f = 0; f < ft->frame_count; f++) {
+        ft->frames[f] = (PageFrame){-1, 0, f, 0};
+        ft->free_frames[f] = ft->frame_count - 1 - f;
+    }
+    memset(ft->dirty, 0, (size_t)ft->frame_count);
+    memset(ft->prefetched, 0, (size_t)ft->frame_count);
+    for (int k = 0; k < ft->key_slots; k++)
+        ft->keys[k] = PAGEMAP_EMPTY;
+    ft->free_count = ft->frame_count;
+    ft->used = 0;
+    ft->oldest = ft->newest = -1;
+    pagemap_clear(&ft->index);
+}
+
+// Returns the frame holding (pid, page), or -1 if it is not resident
+int frame_table_lookup(const FrameTable *ft, int pid, long long page) {
+    uint64_t key = page_key(pid, page);
+    if (ft->probe)
+        return ft->probe(ft->keys, ft->key_slots, key);
+    int *frame = pagemap_lookup(&ft->index, key);
+    return frame ? *frame : -1;
+}
+
+// Places (pid, page) in a free frame and returns it; -1 if memory is full
+int frame_table_insert(FrameTable *ft, int pid, long long page) {
+    if (ft->free_count == 0)
+        return -1;
+    int frame = ft->free_frames[--ft->free_count];
+    uint64_t key = page_key(pid, page);
+    if (!ft->probe && pagemap_put(&ft->index, key, frame) != 0) {
+        ft->free_count++;
+        return -1;
+    }
+    ft->keys[frame] = key;
+    ft->dirty[frame] = 0;
+    ft->prefetched[frame] = 0;
+
+    ft->frames[frame].process_id = pid;
+    ft->frames[frame].page = page;
+    ft->load_prev[frame] = ft->newest;
+    ft->load_next[frame] = -1;
+    if (ft->newest >= 0)
+        ft->load_next[ft->newest] = frame;
+    else
+        ft->oldest = frame;
+    ft->newest = frame;
+    ft->used++;
+    return frame;
+}
+
+// Releases a resident frame without disturbing any other frame
+void frame_table_remove(FrameTable *ft, int frame) {
+    PageFrame *pf = &ft->frames[frame];
+    if (!ft->probe)
+        pagemap_remove(&ft->index, ft->keys[frame]);
+    ft->keys[frame] = PAGEMAP_EMPTY;
+    pf->process_id = -1;
+
+    int prev = ft->load_prev[frame], next = ft->load_next[frame];
+    if (prev >= 0)
+        ft->load_next[prev] = next;
+    else
+        ft->oldest = next;
+    if (next >= 0)
+        ft->load_prev[next] = prev;
+    else
+        ft->newest = prev;
+
+    ft->free_frames[ft->free_count++] = frame;
+    ft->used--;
+}
+
+// Writes the whole table but the hash index, which frame_table_load()
+// rebuilds from the keys
+int frame_table_save(const FrameTable *ft, FILE *out) {
+    size_t frames = (size_t)ft->frame_count;
+    if (checkpoint_write(out, ft->frames, frames * sizeof(PageFrame)) != 0 ||
+        checkpoint_write(out, ft->load_prev, frames * sizeof(int)) != 0 ||
+        checkpoint_write(out, ft->load_next, frames * sizeof(int)) != 0 ||
+        checkpoint_write(out, ft->free_frames, frames * sizeof(int)) != 0 ||
+        checkpoint_write(out, ft->dirty, frames) != 0 || checkpoint_write(out, ft->prefetched, frames) != 0 ||
+        checkpoint_write(out, ft->keys, frames * sizeof(uint64_t)) != 0 ||
+        checkpoint_write(out, &ft->oldest, sizeof(ft->oldest)) != 0 ||
+        checkpoint_write(out, &ft->newest, sizeof(ft->newest)) != 0 ||
+        checkpoint_write(out, &ft->free_count, sizeof(ft->free_count)) != 0 ||
+        checkpoint_write(out, &ft->used, sizeof(ft->used)) != 0)
+        return -1;
+    return 0;
+}
+
+// The load order holds exactly the frames in use, each with a pid that
+// fits its key and that key; every other frame is on the free stack once
+static int frame_table_check(const FrameTable *ft, unsigned char *seen) {
+    FrameList order = {ft->oldest, ft->newest, ft->used};
+    if (ft->used < 0 || ft->free_count < 0 || ft->used + ft->free_count != ft->frame_count ||
+        framelist_check(&order, ft->load_prev, ft->load_next, ft->frame_count, seen, 1) != 0)
+        return -1;
+    for (int i = 0; i < ft->free_count; i++) {
+        int f = ft->free_frames[i];
+        if (f < 0 || f >= ft->frame_count || seen[f])
+            return -1;
+        seen[f] = 2;
+    }
+    for (int f = 0; f < ft->frame_count; f++) {
+        const PageFrame *pf = &ft->frames[f];
+        if (pf->frame != f)
+            return -1;
+        if (seen[f] == 1 ? pf->process_id < 0 || pf->process_id > UINT16_MAX || !page_fits_key(pf->page) ||
+                               ft->keys[f] != page_key(pf->process_id, pf->page)
+                         : pf->process_id != -1 || ft->keys[f] != PAGEMAP_EMPTY)
+            return -1;
+    }
+    return 0;
+}
+
+// Reads a table saved with the same frame count into ft; -1 on a short
+// read, a table that does not hang together or two frames with one page,
+// leaving ft to be reset
+int frame_table_load(FrameTable *ft, FILE *in) {
+    size_t frames = (size_t)ft->frame_count;
+    if (checkpoint_read(in, ft->frames, frames * sizeof(PageFrame)) != 0 ||
+        checkpoint_read(in, ft->load_prev, frames * sizeof(int)) != 0 ||
+        checkpoint_read(in, ft->load_next, frames * sizeof(int)) != 0 ||
+        checkpoint_read(in, ft->free_frames, frames * sizeof(int)) != 0 ||
+        checkpoint_read(in, ft->dirty, frames) != 0 || checkpoint_read(in, ft->prefetched, frames) != 0 ||
+        checkpoint_read(in, ft->keys, frames * sizeof(uint64_t)) != 0 ||
+        checkpoint_read(in, &ft->oldest, sizeof(ft->oldest)) != 0 ||
+        checkpoint_read(in, &ft->newest, sizeof(ft->newest)) != 0 ||
+        checkpoint_read(in, &ft->free_count, sizeof(ft->free_count)) != 0 ||
+        checkpoint_read(in, &ft->used, sizeof(ft->used)) != 0)
+        return -1;
+    unsigned char *seen = calloc(frames, 1);
+    int status = seen ? frame_table_check(ft, seen) : -1;
+    free(seen);
+    if (status != 0)
+        return -1;
+    pagemap_clear(&ft->index);
+    for (int f = 0; f < ft->frame_count && !ft->probe; f++) {
+        if (ft->keys[f] != PAGEMAP_EMPTY && pagemap_put(&ft->index, ft->keys[f], f) != 0)
+            return -1;
+    }
+    for (int f = ft->oldest; f >= 0; f = ft->load_next[f]) {
+        if (frame_table_lookup(ft, ft->frames[f].process_id, ft->frames[f].page) != f)
+            return -1;
+    }
+    return 0;
+}
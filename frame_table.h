@@ -0,0 +1,51 @@
+#ifndef FRAME_TABLE_H
+#define FRAME_TABLE_H
+
+#include <stdio.h>
+#include "pagemap.h"
+#include "probe.h"
+
+typedef struct {
+    int process_id;
+    long long page;
+    int frame;
+    long last_access_time;
+} PageFrame;
+
+// Up to this many frames, lookups scan the packed keys with SIMD instead of
+// hashing; vmsim-bench --probe shows where the two cross over
+#define FRAME_TABLE_PROBE_MAX 32
+
+// Physical memory: a frame table indexed by frame number plus a hash index
+// from (pid, page) to frame, so lookup, insert and evict are O(1) expected.
+// Small tables replace the hash index with a vector scan of keys[].
+// Resident frames are also threaded on a list in load order (oldest first).
+typedef struct {
+    PageFrame *frames;  // frames[f].process_id is -1 while f is free
+    int *load_prev;     // Load-order list links, -1 terminated
+    int *load_next;
+    int oldest;
+    int newest;
+    int *free_frames;   // Stack of free frame numbers, lowest on top
+    int free_count;
+    int frame_count;
+    int used;
+    unsigned char *dirty;      // Per frame: stored to since it was loaded or last written back
+    unsigned char *prefetched; // Per frame: brought in by a prefetch and not used yet
+    uint64_t *keys;     // keys[f] is page_key() of frame f, PAGEMAP_EMPTY while free
+    int key_slots;      // frame_count rounded up to KEY_PROBE_PAD
+    KeyProbeFn probe;   // Set when lookups scan keys; NULL uses index
+    PageMap index;
+} FrameTable;
+
+int frame_table_init(FrameTable *ft, int frame_count);
+void frame_table_set_probe(FrameTable *ft, KeyProbeFn probe);
+void frame_table_free(FrameTable *ft);
+void frame_table_reset(FrameTable *ft);
+int frame_table_lookup(const FrameTable *ft, int pid, long long page);
+int frame_table_insert(FrameTable *ft, int pid, long long page);
+void frame_table_remove(FrameTable *ft, int frame);
+int frame_table_save(const FrameTable *ft, FILE *out);
+int frame_table_load(FrameTable *ft, FILE *in);
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef FRAMELIST_H
+#define FRAMELIST_H
+
+// Intrusive doubly linked lists over small integer ids (frame numbers or
+// slot numbers). The links live in caller-owned prev/next arrays, so one
+// pair of arrays can back several lists as long as an id is in one at a time.
+// head is the most recently inserted end, tail the oldest.
+typedef struct {
+    int head;
+    int tail;
+    int size;
+} FrameList;
+
+static inline void framelist_init(FrameList *list) {
+    list->head = list->tail = -1;
+    list->size = 0;
+}
+
+static inline void framelist_push_head(FrameList *list, int *prev, int *next, int id) {
+    prev[id] = -1;
+    next[id] = list->head;
+    if (list->head >= 0)
+        prev[list->head] = id;
+    else
+        list->tail = id;
+    list->head = id;
+    list->size++;
+}
+
+static inline void framelist_remove(FrameList *list, int *prev, int *next, int id) {
+    if (prev[id] >= 0)
+        next[prev[id]] = next[id];
+    else
+        list->head = next[id];
+    if (next[id] >= 0)
+        prev[next[id]] = prev[id];
+    else
+        list->tail = prev[id];
+    list->size--;
+}
+
+// Removes and returns the oldest id, or -1 if the list is empty
+static inline int framelist_pop_tail(FrameList *list, int *prev, int *next) {
+    int id = list->tail;
+    if (id >= 0)
+        framelist_remove(list, prev, next, id);
+    return id;
+}
+
+// The oldest id other than pinned, or -1 if the list has no other
+static inline int framelist_oldest_except(const FrameList *list, const int *prev, int pinned) {
+    return list->tail >= 0 && list->tail == pinned ? prev[pinned] : list->tail;
+}
+
+// Checks a list read back from a checkpoint: size ids from head to tail,
+// each in [0, limit), linked both ways and on no list already marked in
+// seen. Marks them in seen with mark (nonzero). Returns -1 if it is not so.
+static inline int framelist_check(const FrameList *list, const int *prev, const int *next, int limit,
+                                  unsigned char *seen, unsigned char mark) {
+    if (list->size < 0 || list->size > limit)
+        return -1;
+    int id = list->head, last = -1;
+    for (int i = 0; i < list->size; i++) {
+        if (id < 0 || id >= limit || seen[id] || prev[id] != last)
+            return -1;
+        seen[id] = mark;
+        last = id;
+        id = next[id];
+    }
+    return id == -1 && list->tail == last ? 0 : -1;
+}
+
+#endif
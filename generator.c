@@ -0,0 +1,225 @@
+#include "generator.h"
+#include <math.h>
+#include <string.h>
+
+static const char *const pattern_names[] = {"sequential", "stride", "uniform", "zipf", "hot-cold", "phased"};
+
+const char *gen_pattern_name(GenPattern pattern) {
+    return pattern_names[pattern];
+}
+
+int gen_pattern_parse(const char *name, GenPattern *out) {
+    for (int i = 0; i < (int)(sizeof(pattern_names) / sizeof(pattern_names[0])); i++) {
+        if (strcmp(name, pattern_names[i]) == 0) {
+            *out = (GenPattern)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Fills in the pattern parameters a caller does not care about
+void gen_process_defaults(GenProcessSpec *spec, GenPattern pattern, long long pages) {
+    memset(spec, 0, sizeof(*spec));
+    spec->pattern = pattern;
+    spec->pages = pages > 0 ? pages : 1;
+    spec->length = GEN_UNLIMITED;
+    spec->stride = 7;
+    spec->zipf_s = 1.0;
+    spec->hot_access = 0.9;
+    spec->hot_pages = 0.1;
+    spec->working_set = spec->pages / 8 > 0 ? spec->pages / 8 : 1;
+    spec->phase_length = 100000;
+}
+
+static uint64_t splitmix64(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static inline uint64_t rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+// xoshiro256**: a few cycles per number and identical on every platform
+static inline uint64_t next_random(uint64_t *s) {
+    uint64_t result = rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+}
+
+static inline double random_unit(uint64_t *s) {
+    return (double)(next_random(s) >> 11) * 0x1.0p-53;
+}
+
+static inline long long random_below(uint64_t *s, long long n) {
+    return (long long)(random_unit(s) * (double)n);
+}
+
+// Zipf by rejection-inversion (Hoermann & Derflinger 1996): O(1) time and
+// memory per sample for any number of pages, unlike a CDF table
+static double zipf_helper1(double x) {
+    return fabs(x) > 1e-8 ? log1p(x) / x : 1.0 - x * (0.5 - x * (1.0 / 3.0 - x * 0.25));
+}
+
+static double zipf_helper2(double x) {
+    return fabs(x) > 1e-8 ? expm1(x) / x : 1.0 + x * 0.5 * (1.0 + x * (1.0 / 3.0) * (1.0 + x * 0.25));
+}
+
+static double zipf_h(double s, double x) {
+    return exp(-s * log(x));
+}
+
+static double zipf_h_integral(double s, double x) {
+    double log_x = log(x);
+    return zipf_helper2((1.0 - s) * log_x) * log_x;
+}
+
+static double zipf_h_integral_inverse(double s, double x) {
+    double t = x * (1.0 - s);
+    if (t < -1.0)
+        t = -1.0;
+    return exp(zipf_helper1(t) * x);
+}
+
+static void zipf_prepare(GenProcess *p) {
+    double s = p->spec.zipf_s;
+    p->zipf_hx1 = zipf_h_integral(s, 1.5) - 1.0;
+    p->zipf_hn = zipf_h_integral(s, (double)p->spec.pages + 0.5);
+    p->zipf_sval = 2.0 - zipf_h_integral_inverse(s, zipf_h_integral(s, 2.5) - zipf_h(s, 2.0));
+}
+
+// Rank in 0..pages-1, rank 0 the most popular
+static long long zipf_sample(GenProcess *p) {
+    double s = p->spec.zipf_s;
+    for (;;) {
+        double u = p->zipf_hn + random_unit(p->rng) * (p->zipf_hx1 - p->zipf_hn);
+        double x = zipf_h_integral_inverse(s, u);
+        long long k = (long long)(x + 0.5);
+        if (k < 1)
+            k = 1;
+        else if (k > p->spec.pages)
+            k = p->spec.pages;
+        if ((double)k - x <= p->zipf_sval || u >= zipf_h_integral(s, (double)k + 0.5) - zipf_h(s, (double)k))
+            return k - 1;
+    }
+}
+
+static long long next_page(GenProcess *p) {
+    const GenProcessSpec *spec = &p->spec;
+    long long page;
+    switch (spec->pattern) {
+    case GEN_SEQUENTIAL:
+        page = p->cursor;
+        p->cursor = p->cursor + 1 < spec->pages ? p->cursor + 1 : 0;
+        return page;
+    case GEN_STRIDE:
+        page = p->cursor;
+        p->cursor = (p->cursor + spec->stride) % spec->pages;
+        return page;
+    case GEN_UNIFORM:
+        return random_below(p->rng, spec->pages);
+    case GEN_ZIPF:
+        return zipf_sample(p);
+    case GEN_HOT_COLD:
+        if (random_unit(p->rng) < spec->hot_access || p->hot_count == spec->pages)
+            return random_below(p->rng, p->hot_count);
+        return p->hot_count + random_below(p->rng, spec->pages - p->hot_count);
+    case GEN_PHASED:
+        if (p->produced % spec->phase_length == 0)
+            p->phase_base = random_below(p->rng, spec->pages - spec->working_set + 1);
+        return p->phase_base + random_below(p->rng, spec->working_set);
+    }
+    return 0;
+}
+
+static size_t source_read(RefSource *src, PageReference *out, size_t max) {
+    return generator_read((Generator *)src, out, max);
+}
+
+// Sets up a generator over process_count processes. Each process draws from
+// its own stream derived from seed, so its references do not depend on how
+// the processes are interleaved. Returns -1 on invalid parameters.
+int generator_init(Generator *gen, const GenProcessSpec *specs, int process_count, long long total, int quantum,
+                   uint64_t seed) {
+    if (process_count <= 0 || process_count > MAX_PROCESSES || total < 0 || quantum < 0)
+        return -1;
+    memset(gen, 0, sizeof(*gen));
+    gen->source.read = source_read;
+    gen->process_count = process_count;
+    gen->total = total;
+    gen->quantum = quantum;
+
+    uint64_t mix = seed;
+    for (int i = 0; i < process_count; i++) {
+        GenProcess *p = &gen->processes[i];
+        const GenProcessSpec *spec = &specs[i];
+        p->spec = *spec;
+        for (int w = 0; w < 4; w++)
+            p->rng[w] = splitmix64(&mix);
+        if (spec->length == 0)
+            continue; // Never scheduled, so the pattern does not matter
+        if (spec->pages <= 0 || spec->length < GEN_UNLIMITED ||
+            (spec->pattern == GEN_STRIDE && spec->stride <= 0) ||
+            (spec->pattern == GEN_ZIPF && !(spec->zipf_s > 0)) ||
+            (spec->pattern == GEN_HOT_COLD && !(spec->hot_pages > 0 && spec->hot_pages <= 1)) ||
+            (spec->pattern == GEN_PHASED &&
+             (spec->working_set <= 0 || spec->working_set > spec->pages || spec->phase_length <= 0)))
+            return -1;
+        if (spec->pattern == GEN_ZIPF)
+            zipf_prepare(p);
+        if (spec->pattern == GEN_HOT_COLD) {
+            p->hot_count = (long long)(spec->hot_pages * (double)spec->pages);
+            if (p->hot_count < 1)
+                p->hot_count = 1;
+        }
+    }
+    gen->quantum_left = quantum;
+    return 0;
+}
+
+static int process_done(const GenProcess *p) {
+    return p->spec.length != GEN_UNLIMITED && p->produced >= p->spec.length;
+}
+
+// Moves to the next process that still has references; 0 when all are done
+static int advance_process(Generator *gen) {
+    for (int tried = 0; tried < gen->process_count; tried++) {
+        gen->current = (gen->current + 1) % gen->process_count;
+        if (!process_done(&gen->processes[gen->current])) {
+            gen->quantum_left = gen->quantum;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Produces up to max references, round-robin by quantum across processes
+size_t generator_read(Generator *gen, PageReference *out, size_t max) {
+    size_t n = 0;
+    while (n < max && (gen->total == 0 || gen->produced < gen->total)) {
+        GenProcess *p = &gen->processes[gen->current];
+        if (process_done(p) || (gen->quantum > 0 && gen->quantum_left == 0)) {
+            if (!advance_process(gen))
+                break;
+            continue;
+        }
+        out[n].pid = gen->current;
+        // No draw at all without writes, so read-only streams stay as they were
+        out[n].write = p->spec.write_fraction > 0 && random_unit(p->rng) < p->spec.write_fraction;
+        out[n].page_num = next_page(p);
+        p->produced++;
+        gen->produced++;
+        gen->quantum_left--;
+        n++;
+    }
+    return n;
+}
@@ -0,0 +1,66 @@
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include <stdint.h>
+#include "simulator.h"
+
+// Synthetic workloads produced lazily as a RefSource: state is a few words
+// per process, so a billion-access run needs no more memory than a short
+// one, and the same seed always yields the same references.
+
+typedef enum {
+    GEN_SEQUENTIAL, // Pages 0..pages-1 in order, then again
+    GEN_STRIDE,     // Every stride-th page, wrapping around the footprint
+    GEN_UNIFORM,    // Uniformly random over the footprint
+    GEN_ZIPF,       // Page k+1 is 1/(k+1)^zipf_s as popular as page 0
+    GEN_HOT_COLD,   // hot_access of the references go to the first hot_pages of the footprint
+    GEN_PHASED      // Uniform over a working set that moves every phase_length references
+} GenPattern;
+
+#define GEN_UNLIMITED (-1LL)
+
+typedef struct {
+    GenPattern pattern;
+    long long pages;        // Footprint in pages
+    long long length;       // References from this process, or GEN_UNLIMITED
+    long long stride;       // GEN_STRIDE
+    double zipf_s;          // GEN_ZIPF exponent, > 0
+    double hot_access;      // GEN_HOT_COLD, e.g. 0.9
+    double hot_pages;       // GEN_HOT_COLD, e.g. 0.1
+    long long working_set;  // GEN_PHASED pages per phase
+    long long phase_length; // GEN_PHASED references per phase
+    double write_fraction;  // Share of references that are stores, 0 for none
+} GenProcessSpec;
+
+// Per-process generator state
+typedef struct {
+    GenProcessSpec spec;
+    uint64_t rng[4];
+    long long produced;
+    long long cursor;     // Sequential/stride position
+    long long phase_base; // First page of the current working set
+    long long hot_count;
+    double zipf_hx1;      // Rejection-inversion constants for GEN_ZIPF
+    double zipf_hn;
+    double zipf_sval;
+} GenProcess;
+
+typedef struct {
+    RefSource source; // Must stay first: simulator_run_source() takes &source
+    GenProcess processes[MAX_PROCESSES];
+    int process_count;
+    long long total;  // Stop after this many references, 0 for no limit
+    long long produced;
+    int quantum;      // References per process turn; 0 runs each process to its end
+    int current;
+    int quantum_left;
+} Generator;
+
+void gen_process_defaults(GenProcessSpec *spec, GenPattern pattern, long long pages);
+int generator_init(Generator *gen, const GenProcessSpec *specs, int process_count, long long total, int quantum,
+                   uint64_t seed);
+size_t generator_read(Generator *gen, PageReference *out, size_t max);
+const char *gen_pattern_name(GenPattern pattern);
+int gen_pattern_parse(const char *name, GenPattern *out);
+
+#endif
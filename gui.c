@@ -1,59 +1,1036 @@
 #include "gui.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include "bintrace.h"
+#include "checkpoint.h"
+#include "compare.h"
+#include "mrc.h"
 #include "simulator.h"
+#include "trace.h"
 
-static GtkWidget *process_dropdown, *page_size_entry, *algorithm_combo;
-static GtkWidget *process_size_entries[MAX_PROCESSES];
+#define GUI_MAX_POLICIES 16
+
+static GtkWidget *process_dropdown, *page_size_entry, *frame_count_entry, *algorithm_combo, *verbosity_combo;
+static GtkWidget *process_size_entries[MAX_PROCESSES], *process_size_labels[MAX_PROCESSES];
+static GtkWidget *trace_chooser;
+static GtkWidget *compare_checks[GUI_MAX_POLICIES]; // One per registered policy
 static GtkWidget *output_view;
 
 static void on_algorithm_changed(GtkComboBoxText *combo, gpointer user_data) {
     Simulator *sim = (Simulator *)user_data;
-    simulator_set_algorithm(sim, gtk_combo_box_text_get_active_text(combo));
+    gchar *name = gtk_combo_box_text_get_active_text(combo);
+    if (name)
+        simulator_set_algorithm(sim, name);
+    g_free(name);
+}
+
+static void on_verbosity_changed(GtkComboBox *combo, gpointer user_data) {
+    Simulator *sim = (Simulator *)user_data;
+    // Combo lists levels from most to least detailed
+    simulator_set_verbosity(sim, (SimVerbosity)(SIM_VERBOSITY_FULL - gtk_combo_box_get_active(combo)));
 }
 
 static void on_process_count_changed(GtkComboBoxText *combo, gpointer user_data) {
     Simulator *sim = (Simulator *)user_data;
-    simulator_set_process_count(sim, atoi(gtk_combo_box_text_get_active_text(combo)));
-    for (int i = 0; i < MAX_PROCESSES; i++)
+    gchar *count = gtk_combo_box_text_get_active_text(combo);
+    if (!count)
+        return;
+    simulator_set_process_count(sim, atoi(count));
+    g_free(count);
+    for (int i = 0; i < MAX_PROCESSES; i++) {
+        gtk_widget_set_visible(process_size_labels[i], i < sim->process_count);
         gtk_widget_set_visible(process_size_entries[i], i < sim->process_count);
+    }
 }
 
-static void on_start_simulation(GtkButton *button, gpointer user_data) {
-    Simulator *sim = (Simulator *)user_data;
+#define GUI_CHUNK_BYTES (64 * 1024) // Log text handed to the UI at a time
+#define GUI_CHUNKS_PER_IDLE 8        // Chunks inserted per main-loop visit
+#define GUI_MAX_QUEUED_CHUNKS 64     // The worker waits while the UI is this far behind
+#define GUI_CACHE_MAX 32             // Finished runs kept; the cache starts over when full
+#define GUI_TIMELINE_INTERVAL_US 100000 // The worker copies the timeline for drawing at most this often
+#define GUI_TIMELINE_MIN_VIEW 64        // Fewest accesses the timeline zooms in to
+
+// One simulation on the worker thread. The worker formats events into
+// chunks and queues them; idle callbacks on the main loop append them to
+// the output and update the progress bar. Reference counted because idle
+// callbacks may still be queued when the run finishes.
+typedef struct {
+    Simulator *sim;
+    LogFormatter formatter;
+    GString *chunk;      // Worker-side text not yet queued
+    GAsyncQueue *chunks; // GString * from worker to main loop
+    TraceReader trace;       // A text trace
+    BinTraceReader bintrace; // Or a binary one, told apart as vmsim does
+    int binary;
+    RefSource *source;       // The open one's, NULL without a trace
+    gchar *trace_path;
+    const char *compare[GUI_MAX_POLICIES]; // Policies of a side-by-side run, none for a normal one
+    int compare_count;
+    int mrc_frames;          // Largest memory of a miss-ratio curve run, 0 for a simulation
+    MissRatioCurve *mrc;     // Its curve, for the main loop to show
+    GThread *thread;
+    int status;
+    int finalized;       // Main loop only
+    int paused;          // Stopped by Pause; set by the worker, read once it is joined
+    int continuing;      // Picks a paused run up instead of starting over
+    gint cancel;         // Set by Cancel and Pause, polled between batches
+    gint pause;
+    gint permille;       // Progress, -1 while unknown
+    gint finished;
+    gint flush_pending;
+    gint refs;
+} GuiRun;
+
+static GtkWidget *input_frame, *start_btn, *compare_btn, *mrc_btn, *pause_btn, *cancel_btn, *stats_btn, *progress_bar;
+static GuiRun *active_run, *paused_run;
+
+// Checkpoints of finished runs by input hash, algorithm, frames, page
+// size and stats window, each followed by the run's timeline, restored
+// instead of simulated when a run is repeated. Worker side; there is one
+// worker at a time.
+static GHashTable *result_cache;
+// The last trace hashed for the cache key, reused while its size and
+// modification time stay the same. Worker side too.
+static struct {
+    gchar *path;
+    goffset size;
+    gint64 mtime;
+    uint64_t hash;
+} trace_hashed;
+// Page size and process sizes reference_string holds the built-in workload for
+static gchar *generated_for;
+
+// What the timeline view draws: a copy of the simulator's timeline that
+// the worker takes between batches, and the stretch of the run in view,
+// in accesses since the timeline started. The view follows the whole run
+// until it is zoomed.
+static Timeline timeline_shown;
+static GMutex timeline_lock;
+static gint timeline_changed;
+static gint64 timeline_copied_at;
+static GtkWidget *timeline_area;
+static long long view_from, view_to;
+static int view_follow = 1;
+static double drag_x;
+static long long drag_from;
+
+static gboolean flush_output(gpointer data);
+static void show_mrc(GtkWidget *parent, MissRatioCurve *mrc);
+
+// Whether the run simulates with sim itself, log and timeline included,
+// rather than comparing on simulators of its own or plotting a curve
+static int simulates(const GuiRun *run) {
+    return run->compare_count == 0 && run->mrc_frames == 0;
+}
+
+// Opens the trace at run->trace_path, binary or text
+static int open_trace(GuiRun *run, int page_size) {
+    run->binary = bintrace_is_binary(run->trace_path);
+    if (run->binary ? bintrace_reader_open(&run->bintrace, run->trace_path, page_size) != 0
+                    : trace_reader_open(&run->trace, run->trace_path, TRACE_FORMAT_AUTO, page_size) != 0)
+        return -1;
+    run->source = run->binary ? &run->bintrace.source : &run->trace.source;
+    return 0;
+}
+
+static void close_trace(GuiRun *run) {
+    if (run->binary)
+        bintrace_reader_close(&run->bintrace);
+    else
+        trace_reader_close(&run->trace);
+    run->source = NULL;
+}
+
+static void gui_run_unref(GuiRun *run) {
+    if (!g_atomic_int_dec_and_test(&run->refs))
+        return;
+    GString *chunk;
+    while ((chunk = g_async_queue_try_pop(run->chunks)))
+        g_string_free(chunk, TRUE);
+    g_async_queue_unref(run->chunks);
+    g_free(run);
+}
+
+// Queues a main-loop flush unless one is already waiting
+static void schedule_flush(GuiRun *run) {
+    if (g_atomic_int_compare_and_exchange(&run->flush_pending, 0, 1)) {
+        g_atomic_int_inc(&run->refs);
+        g_idle_add(flush_output, run);
+    }
+}
+
+// Worker: passes the current chunk to the main loop, waiting first while
+// the UI is far behind so memory stays bounded
+static void hand_off_chunk(GuiRun *run) {
+    if (run->chunk->len == 0)
+        return;
+    while (g_async_queue_length(run->chunks) >= GUI_MAX_QUEUED_CHUNKS && !g_atomic_int_get(&run->cancel))
+        g_usleep(1000);
+    g_async_queue_push(run->chunks, run->chunk);
+    run->chunk = g_string_sized_new(GUI_CHUNK_BYTES);
+    schedule_flush(run);
+}
+
+// Event sink on the worker: formats each batch of events as it is drained from the ring
+static void append_events(const SimEvent *events, size_t count, void *user_data) {
+    GuiRun *run = (GuiRun *)user_data;
+    char line[LOG_LINE_MAX];
+    for (size_t i = 0; i < count; i++) {
+        size_t len = log_formatter_format(&run->formatter, &events[i], line, sizeof(line));
+        g_string_append_len(run->chunk, line, (gssize)len);
+        if (run->chunk->len >= GUI_CHUNK_BYTES)
+            hand_off_chunk(run);
+    }
+}
+
+// Worker: refreshes the copy the timeline view draws, at most every
+// GUI_TIMELINE_INTERVAL_US unless forced
+static void copy_timeline(const Simulator *sim, int force) {
+    gint64 now = g_get_monotonic_time();
+    if (!force && now - timeline_copied_at < GUI_TIMELINE_INTERVAL_US)
+        return;
+    g_mutex_lock(&timeline_lock);
+    timeline_copy(&timeline_shown, &sim->timeline);
+    g_mutex_unlock(&timeline_lock);
+    timeline_copied_at = now;
+    g_atomic_int_set(&timeline_changed, 1);
+}
+
+static int report_progress(long long done, long long total, void *user_data) {
+    GuiRun *run = (GuiRun *)user_data;
+    int permille = -1;
+    if (total > 0)
+        permille = (int)(done * 1000 / total);
+    else if (run->binary && run->bintrace.record_count > 0)
+        permille = (int)(run->bintrace.position * 1000 / run->bintrace.record_count);
+    else if (run->source && run->trace.file.size > 0)
+        permille = (int)((long long)run->trace.cursor * 1000 / (long long)run->trace.file.size);
+    g_atomic_int_set(&run->permille, permille);
+    if (simulates(run))
+        copy_timeline(run->sim, 0);
+    hand_off_chunk(run);
+    schedule_flush(run);
+    return g_atomic_int_get(&run->cancel);
+}
+
+// Worker: fills reference_string with the built-in workload unless it
+// already holds it for the same page and process sizes. Sets *reused then.
+static int generate_references(Simulator *sim, int *reused) {
+    GString *key = g_string_new(NULL);
+    g_string_printf(key, "%d", sim->page_size);
+    for (int i = 0; i < sim->process_count; i++)
+        g_string_append_printf(key, " %d", sim->process_sizes[i]);
+    *reused = generated_for && strcmp(generated_for, key->str) == 0;
+    if (*reused) {
+        g_string_free(key, TRUE);
+        return 0;
+    }
+    g_free(generated_for);
+    generated_for = NULL;
+    int status = simulator_generate_references(sim);
+    if (status == 0)
+        generated_for = g_string_free(key, FALSE);
+    else
+        g_string_free(key, TRUE);
+    return status;
+}
+
+// After reference_string was filled from a trace
+static void forget_references(void) {
+    g_free(generated_for);
+    generated_for = NULL;
+}
+
+// Worker: hashes the trace at path unless it is the one hashed last and
+// looks unchanged
+static int hash_trace(const gchar *path, uint64_t *out) {
+    GStatBuf st;
+    if (g_stat(path, &st) != 0)
+        return -1;
+    if (!trace_hashed.path || strcmp(trace_hashed.path, path) != 0 || trace_hashed.size != (goffset)st.st_size ||
+        trace_hashed.mtime != (gint64)st.st_mtime) {
+        g_free(trace_hashed.path);
+        trace_hashed.path = NULL;
+        if (checkpoint_hash_file(path, &trace_hashed.hash) != 0)
+            return -1;
+        trace_hashed.path = g_strdup(path);
+        trace_hashed.size = (goffset)st.st_size;
+        trace_hashed.mtime = (gint64)st.st_mtime;
+    }
+    *out = trace_hashed.hash;
+    return 0;
+}
+
+// Worker: what a run is cached under, NULL if its trace cannot be read
+static gchar *cache_key(const GuiRun *run) {
+    const Simulator *sim = run->sim;
+    uint64_t hash;
+    if (run->trace_path) {
+        if (hash_trace(run->trace_path, &hash) != 0)
+            return NULL;
+    } else {
+        hash = checkpoint_hash_bytes(CHECKPOINT_HASH_SEED, &sim->process_count, sizeof(sim->process_count));
+        hash = checkpoint_hash_bytes(hash, sim->process_sizes,
+                                     (size_t)sim->process_count * sizeof(sim->process_sizes[0]));
+    }
+    return g_strdup_printf("%016llx %s %d %d %lld", (unsigned long long)hash, sim->algorithm,
+                           sim->memory.frame_count, sim->page_size, sim->stats.window);
+}
+
+// Cached results go through tmpfile(), which every C library has, unlike
+// fmemopen() and open_memstream(). The checkpoint leaves the timeline
+// empty, so the one saved after it takes its place.
+static int restore_result(Simulator *sim, GBytes *saved) {
+    gsize size;
+    const void *data = g_bytes_get_data(saved, &size);
+    FILE *in = tmpfile();
+    if (!in)
+        return -1;
+    int status = -1;
+    if (fwrite(data, 1, size, in) == size && fseek(in, 0, SEEK_SET) == 0)
+        status = simulator_load_checkpoint(sim, in);
+    if (status == 0 && timeline_load(&sim->timeline, in) != 0) {
+        simulator_set_timeline(sim, 1, TIMELINE_DEFAULT_RATE_WINDOW); // The run is simulated after all
+        status = -1;
+    }
+    fclose(in);
+    return status;
+}
+
+static void cache_result(const gchar *key, const Simulator *sim) {
+    FILE *out = tmpfile();
+    if (!out)
+        return;
+    long size = simulator_save_checkpoint(sim, out) == 0 && timeline_save(&sim->timeline, out) == 0 ? ftell(out) : -1;
+    gpointer data = size > 0 && fseek(out, 0, SEEK_SET) == 0 ? g_malloc((gsize)size) : NULL;
+    if (data && fread(data, 1, (size_t)size, out) != (size_t)size) {
+        g_free(data);
+        data = NULL;
+    }
+    fclose(out);
+    if (!data)
+        return;
+    if (!result_cache)
+        result_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, (GDestroyNotify)g_bytes_unref);
+    if (g_hash_table_size(result_cache) >= GUI_CACHE_MAX)
+        g_hash_table_remove_all(result_cache);
+    g_hash_table_insert(result_cache, g_strdup(key), g_bytes_new_take(data, (gsize)size));
+}
+
+// Worker side of Compare: every checked policy over one pass, then the table
+static void run_comparison(GuiRun *run) {
+    Simulator *sim = run->sim;
+    CompareSpec spec = {sim->memory.frame_count, run->compare, run->compare_count, report_progress, run, NULL, NULL, 0};
+    CompareTable table;
+    int reused;
+    if (run->trace_path) {
+        run->status = compare_run_source(run->source, &spec, &table);
+    } else {
+        run->status = generate_references(sim, &reused);
+        if (run->status == 0)
+            run->status = compare_run_references(sim->reference_string, sim->reference_string_len, &spec, &table);
+    }
+
+    if (run->status == SIM_CANCELLED) {
+        g_string_append(run->chunk, "\nComparison cancelled.\n");
+    } else if (run->status != 0) {
+        g_string_append(run->chunk, "Error: Not enough memory for this comparison.\n");
+    } else {
+        char line[COMPARE_LINE_MAX];
+        g_string_append_printf(run->chunk, "Total Accesses: %lld\n\n", table.accesses);
+        for (int row = -1; row < table.count; row++) {
+            compare_format_line(&table, row, line, sizeof(line));
+            g_string_append(run->chunk, line);
+        }
+        g_string_append_printf(run->chunk, "\nRead once in %.3f s; %.3f s in all\n", table.read_seconds,
+                               table.wall_seconds);
+        compare_table_free(&table);
+    }
+}
+
+// Worker side of Plot Miss-Ratio Curve: the references a run would see,
+// collected without simulating, then LRU and Optimal at every memory size
+static void run_mrc(GuiRun *run) {
+    Simulator *sim = run->sim;
+    int reused;
+    if (run->source) {
+        forget_references();
+        run->status = simulator_load_source(sim, run->source);
+    } else {
+        run->status = generate_references(sim, &reused);
+    }
+    if (run->status == 0) {
+        run->mrc = g_new0(MissRatioCurve, 1);
+        run->status = mrc_compute_progress(sim->reference_string, sim->reference_string_len, run->mrc_frames, 1,
+                                           report_progress, run, run->mrc);
+        if (run->status != 0) {
+            g_free(run->mrc);
+            run->mrc = NULL;
+        }
+    }
+
+    if (run->status == SIM_CANCELLED)
+        g_string_append(run->chunk, "\nMiss-ratio curve cancelled.\n");
+    else if (run->status != 0)
+        g_string_append(run->chunk, "Error: Cannot compute the miss-ratio curve.\n");
+    else
+        g_string_append_printf(run->chunk, "Miss-ratio curve over %d references, 1 to %d frames.\n",
+                               sim->reference_string_len, run->mrc_frames);
+}
+
+static gpointer simulation_thread(gpointer data) {
+    GuiRun *run = (GuiRun *)data;
+    Simulator *sim = run->sim;
+    char line[LOG_LINE_MAX];
+    gchar *key = NULL;
+    int cached = 0, reused;
+
+    if (simulates(run) && !run->continuing && sim->policy->save) {
+        key = cache_key(run);
+        GBytes *saved = key && result_cache ? g_hash_table_lookup(result_cache, key) : NULL;
+        // A logged run has to be simulated to show its events
+        cached = saved && sim->verbosity <= SIM_VERBOSITY_SUMMARY && restore_result(sim, saved) == 0;
+    }
+
+    if (cached) {
+        run->status = 0;
+        g_string_append(run->chunk, "Same input and settings as an earlier run; its results follow.\n");
+    } else if (run->compare_count > 0) {
+        run_comparison(run);
+    } else if (run->mrc_frames > 0) {
+        run_mrc(run);
+    } else if (run->continuing) {
+        g_string_append_printf(run->chunk, "Continuing after %ld references.\n\n", sim->access_time);
+        if (run->source)
+            run->status = simulator_continue_source(sim, run->source);
+        else
+            run->status = simulator_continue_references(sim, sim->reference_string, sim->reference_string_len);
+    } else if (run->source) {
+        forget_references(); // Policies that need the future load the trace into reference_string
+        run->status = simulator_run_source(sim, run->source);
+    } else {
+        run->status = generate_references(sim, &reused);
+        if (run->status == 0) {
+            snprintf(line, sizeof(line), "Reference String %s. Total Accesses: %d\n\n",
+                     reused ? "Reused" : "Generated", sim->reference_string_len);
+            g_string_append(run->chunk, line);
+            run->status = simulator_run_references(sim, sim->reference_string, sim->reference_string_len);
+        }
+    }
+
+    if (!simulates(run)) {
+        // Reported by run_comparison() or run_mrc()
+    } else if (run->status == SIM_CANCELLED && g_atomic_int_get(&run->pause)) {
+        run->paused = 1;
+        g_string_append_printf(run->chunk, "\nPaused after %ld references.\n", sim->access_time);
+    } else if (run->status == SIM_CANCELLED) {
+        g_string_append(run->chunk, "\nSimulation cancelled.\n");
+    } else if (run->status != 0) {
+        g_string_append(run->chunk, "Error: Not enough memory for this simulation.\n");
+    } else {
+        if (key && !cached)
+            cache_result(key, sim);
+        if (run->trace_path && cached)
+            g_string_append_printf(run->chunk, "\nTrace: %s\nTotal Accesses: %lld\n\n", run->trace_path,
+                                   sim->hits + sim->faults);
+        else if (run->trace_path)
+            g_string_append_printf(run->chunk, "\nTrace: %s (%d processes%s)\nTotal Accesses: %lld\n\n",
+                                   run->trace_path, run->binary ? (int)run->bintrace.pid_count : run->trace.pid_count,
+                                   run->binary ? ", binary" : "", sim->hits + sim->faults);
+        if (sim->verbosity >= SIM_VERBOSITY_SUMMARY) {
+            simulator_format_summary(sim, line, sizeof(line));
+            g_string_append(run->chunk, line);
+        }
+    }
+    g_free(key);
+    if (run->binary && run->bintrace.corrupt)
+        g_string_append_printf(run->chunk, "Error: %s is corrupt after reference %llu.\n", run->trace_path,
+                               (unsigned long long)run->bintrace.position);
+    if (!run->paused)
+        g_string_append(run->chunk, "--- Simulation End ---\n");
+    if (simulates(run))
+        copy_timeline(sim, 1);
+    hand_off_chunk(run);
+
+    // The last flush sees finished set and wraps the run up
+    g_atomic_int_set(&run->finished, 1);
+    g_atomic_int_inc(&run->refs);
+    g_idle_add(flush_output, run);
+    return NULL;
+}
+
+static void set_running(gboolean running) {
+    gtk_widget_set_sensitive(input_frame, !running);
+    gtk_widget_set_sensitive(start_btn, !running);
+    gtk_widget_set_sensitive(compare_btn, !running);
+    gtk_widget_set_sensitive(mrc_btn, !running);
+    gtk_widget_set_sensitive(pause_btn, running);
+    gtk_button_set_label(GTK_BUTTON(pause_btn), "Pause");
+    gtk_widget_set_sensitive(cancel_btn, running);
+    gtk_widget_set_sensitive(stats_btn, FALSE);
+}
+
+static void release_run(GuiRun *run) {
+    simulator_set_event_sink(run->sim, NULL, NULL);
+    simulator_set_progress(run->sim, NULL, NULL);
+    log_formatter_free(&run->formatter);
+    g_string_free(run->chunk, TRUE);
+    if (run->source)
+        close_trace(run);
+    g_free(run->trace_path);
+    if (run->mrc) {
+        mrc_free(run->mrc);
+        g_free(run->mrc);
+    }
+    gui_run_unref(run);
+}
+
+// Main loop: drops a paused run, whose state the next run replaces
+static void discard_paused_run(void) {
+    if (!paused_run)
+        return;
+    GuiRun *run = paused_run;
+    paused_run = NULL;
+    set_running(FALSE);
+    release_run(run);
+}
+
+// Main loop, once the worker is done and its output is all shown. A paused
+// run keeps its trace, log formatter and simulator state for Continue.
+static void finish_run(GuiRun *run) {
+    g_thread_join(run->thread);
+    run->finalized = 1;
+    active_run = NULL;
+    if (run->paused) {
+        gtk_progress_bar_set_text(GTK_PROGRESS_BAR(progress_bar), "Paused");
+        set_running(FALSE);
+        gtk_widget_set_sensitive(input_frame, FALSE); // Changing settings would reset the simulator
+        gtk_widget_set_sensitive(pause_btn, TRUE);
+        gtk_button_set_label(GTK_BUTTON(pause_btn), "Continue");
+        gtk_widget_set_sensitive(cancel_btn, TRUE);
+        paused_run = run;
+        return;
+    }
+    gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(progress_bar), run->status == 0 ? 1.0 : 0.0);
+    gtk_progress_bar_set_text(GTK_PROGRESS_BAR(progress_bar),
+                              run->status == 0 ? "Done" : run->status == SIM_CANCELLED ? "Cancelled" : "Failed");
+    set_running(FALSE);
+    gtk_widget_set_sensitive(stats_btn, run->status == 0 && simulates(run)); // The others leave sim's stats alone
+    if (run->mrc) {
+        show_mrc(gtk_widget_get_toplevel(start_btn), run->mrc);
+        run->mrc = NULL;
+    }
+    release_run(run);
+}
+
+// Main loop: picks a paused run up where it stopped, on a new worker
+static void continue_run(GuiRun *run) {
+    paused_run = NULL;
+    run->paused = 0;
+    run->continuing = 1;
+    run->finalized = 0;
+    g_atomic_int_set(&run->pause, 0);
+    g_atomic_int_set(&run->cancel, 0);
+    g_atomic_int_set(&run->finished, 0);
+    gtk_progress_bar_set_text(GTK_PROGRESS_BAR(progress_bar), NULL);
+    set_running(TRUE);
+    active_run = run;
+    run->thread = g_thread_new("simulation", simulation_thread, run);
+}
+
+// Main loop: appends a bounded number of queued chunks so the window keeps
+// handling input, and comes back for the rest
+static gboolean flush_output(gpointer data) {
+    GuiRun *run = (GuiRun *)data;
+    g_atomic_int_set(&run->flush_pending, 0);
     GtkTextBuffer *buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(output_view));
-    gtk_text_buffer_set_text(buffer, "", -1);
+    GString *chunk;
+    for (int i = 0; i < GUI_CHUNKS_PER_IDLE && (chunk = g_async_queue_try_pop(run->chunks)); i++) {
+        GtkTextIter end;
+        gtk_text_buffer_get_end_iter(buffer, &end);
+        gtk_text_buffer_insert(buffer, &end, chunk->str, (gint)chunk->len);
+        g_string_free(chunk, TRUE);
+    }
+
+    int permille = g_atomic_int_get(&run->permille);
+    if (permille >= 0)
+        gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(progress_bar), permille / 1000.0);
+    else
+        gtk_progress_bar_pulse(GTK_PROGRESS_BAR(progress_bar));
+    if (g_atomic_int_compare_and_exchange(&timeline_changed, 1, 0))
+        gtk_widget_queue_draw(timeline_area);
+
+    if (g_async_queue_length(run->chunks) > 0)
+        schedule_flush(run);
+    else if (g_atomic_int_get(&run->finished) && !run->finalized)
+        finish_run(run);
+    gui_run_unref(run);
+    return G_SOURCE_REMOVE;
+}
+
+static void on_cancel_simulation(GtkButton *button, gpointer user_data) {
+    (void)button;
+    (void)user_data;
+    if (active_run) {
+        g_atomic_int_set(&active_run->cancel, 1);
+    } else if (paused_run) {
+        discard_paused_run();
+        gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(progress_bar), 0.0);
+        gtk_progress_bar_set_text(GTK_PROGRESS_BAR(progress_bar), "Cancelled");
+    }
+}
+
+// Pause stops the run after the current batch; Continue goes on from there
+static void on_pause_simulation(GtkButton *button, gpointer user_data) {
+    (void)button;
+    (void)user_data;
+    if (active_run) {
+        g_atomic_int_set(&active_run->pause, 1);
+        g_atomic_int_set(&active_run->cancel, 1);
+    } else if (paused_run) {
+        continue_run(paused_run);
+    }
+}
+
+// Starts a run on the worker thread: the selected algorithm with its log,
+// with compare_count > 0 those policies side by side, or with mrc_frames
+// > 0 the miss-ratio curve up to that many frames
+static void start_run(Simulator *sim, const char *const *compare, int compare_count, int mrc_frames) {
+    GtkTextBuffer *buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(output_view));
+    if (active_run)
+        return;
+    discard_paused_run();
 
     simulator_set_page_size(sim, atoi(gtk_entry_get_text(GTK_ENTRY(page_size_entry))));
+    simulator_set_frame_count(sim, atoi(gtk_entry_get_text(GTK_ENTRY(frame_count_entry))));
     for (int i = 0; i < sim->process_count; i++)
         simulator_set_process_size(sim, i, atoi(gtk_entry_get_text(GTK_ENTRY(process_size_entries[i]))));
 
-    char result[4096];
-    snprintf(result, sizeof(result), "Algorithm: %s\nPage Size: %d KB\nProcesses: %d\n",
-             sim->algorithm, sim->page_size / 1024, sim->process_count);
-    for (int i = 0; i < sim->process_count; i++) {
-        char temp[64];
-        snprintf(temp, sizeof(temp), "Process %d Size: %d KB\n", i + 1, sim->process_sizes[i]);
-        strcat(result, temp);
+    GString *header = g_string_new(NULL);
+    if (mrc_frames > 0) {
+        g_string_append_printf(header, "Miss-Ratio Curve: LRU and Optimal, 1 to %d frames\n", mrc_frames);
+    } else if (compare_count > 0) {
+        g_string_append(header, "Comparing:");
+        for (int i = 0; i < compare_count; i++)
+            g_string_append_printf(header, "%s %s", i > 0 ? "," : "", compare[i]);
+        g_string_append_c(header, '\n');
+    } else {
+        g_string_append_printf(header, "Algorithm: %s\n", sim->algorithm);
+    }
+    g_string_append_printf(header, "Page Size: %d KB\nFrames: %d\nProcesses: %d\n", sim->page_size / 1024,
+                           sim->memory.frame_count, sim->process_count);
+    for (int i = 0; i < sim->process_count; i++)
+        g_string_append_printf(header, "Process %d Size: %d KB\n", i + 1, sim->process_sizes[i]);
+    g_string_append(header, "\n--- Simulation Start ---\n");
+
+    GuiRun *run = g_new0(GuiRun, 1);
+    run->sim = sim;
+    run->refs = 1;
+    run->permille = -1;
+    run->chunks = g_async_queue_new();
+    run->chunk = g_string_sized_new(GUI_CHUNK_BYTES);
+    for (int i = 0; i < compare_count; i++)
+        run->compare[i] = compare[i];
+    run->compare_count = compare_count;
+    run->mrc_frames = mrc_frames;
+
+    // A selected trace file replaces the generated reference string
+    run->trace_path = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(trace_chooser));
+    if (run->trace_path && open_trace(run, sim->page_size) != 0) {
+        g_string_append_printf(header, "Error: Cannot open trace file %s\n--- Simulation End ---\n", run->trace_path);
+        gtk_text_buffer_set_text(buffer, header->str, (gint)header->len);
+        g_string_free(header, TRUE);
+        g_free(run->trace_path);
+        g_string_free(run->chunk, TRUE);
+        gui_run_unref(run);
+        return;
+    }
+    gtk_text_buffer_set_text(buffer, header->str, (gint)header->len);
+    g_string_free(header, TRUE);
+
+    if (simulates(run)) {
+        view_follow = 1;
+        timeline_copied_at = 0;
+        log_formatter_init(&run->formatter, sim->memory.frame_count, sim->algorithm,
+                           sim->verbosity == SIM_VERBOSITY_FULL);
+        simulator_set_event_sink(sim, append_events, run);
+        simulator_set_progress(sim, report_progress, run);
+    }
+
+    gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(progress_bar), 0.0);
+    gtk_progress_bar_set_text(GTK_PROGRESS_BAR(progress_bar), NULL);
+    set_running(TRUE);
+    gtk_widget_set_sensitive(pause_btn, simulates(run));
+    active_run = run;
+    run->thread = g_thread_new("simulation", simulation_thread, run);
+}
+
+static void on_start_simulation(GtkButton *button, gpointer user_data) {
+    (void)button;
+    start_run((Simulator *)user_data, NULL, 0, 0);
+}
+
+// Runs every checked policy in one pass over the references
+static void on_compare_algorithms(GtkButton *button, gpointer user_data) {
+    const char *names[GUI_MAX_POLICIES];
+    int count = 0;
+    (void)button;
+    for (int i = 0; i < policy_count() && i < GUI_MAX_POLICIES; i++) {
+        if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(compare_checks[i])))
+            names[count++] = policy_at(i)->name;
+    }
+    if (count == 0) {
+        GtkTextBuffer *buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(output_view));
+        gtk_text_buffer_set_text(buffer, "Error: Check at least one algorithm to compare.\n", -1);
+        return;
+    }
+    start_run((Simulator *)user_data, names, count, 0);
+}
+
+// Saves the last run's statistics: CSV for a .csv name, JSON otherwise
+static void on_export_stats(GtkButton *button, gpointer user_data) {
+    const Simulator *sim = (const Simulator *)user_data;
+    GtkWidget *dialog = gtk_file_chooser_dialog_new("Export Statistics", GTK_WINDOW(gtk_widget_get_toplevel(GTK_WIDGET(button))),
+                                                    GTK_FILE_CHOOSER_ACTION_SAVE, "_Cancel", GTK_RESPONSE_CANCEL,
+                                                    "_Save", GTK_RESPONSE_ACCEPT, NULL);
+    gtk_file_chooser_set_do_overwrite_confirmation(GTK_FILE_CHOOSER(dialog), TRUE);
+    gtk_file_chooser_set_current_name(GTK_FILE_CHOOSER(dialog), "stats.json");
+    if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT) {
+        gchar *path = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dialog));
+        FILE *out = fopen(path, "w");
+        if (out) {
+            if (g_str_has_suffix(path, ".csv"))
+                simulator_write_stats_csv(sim, out);
+            else
+                simulator_write_stats_json(sim, out);
+            fclose(out);
+        }
+        g_free(path);
+    }
+    gtk_widget_destroy(dialog);
+}
+
+// Stops a running simulation before the simulator it uses goes away
+static void on_main_window_destroy(GtkWidget *window, gpointer user_data) {
+    Simulator *sim = (Simulator *)user_data;
+    (void)window;
+    if (active_run) {
+        g_atomic_int_set(&active_run->cancel, 1);
+        g_thread_join(active_run->thread);
+        active_run = NULL;
+    }
+    if (paused_run) {
+        release_run(paused_run);
+        paused_run = NULL;
+    }
+    if (result_cache)
+        g_hash_table_destroy(result_cache);
+    g_free(trace_hashed.path);
+    forget_references();
+    timeline_free(&timeline_shown);
+    simulator_destroy(sim);
+    gtk_main_quit();
+}
+
+// Miss-ratio curve window: LRU and Optimal faults for 1..Frames frames
+static gboolean draw_mrc(GtkWidget *area, cairo_t *cr, gpointer user_data) {
+    const MissRatioCurve *mrc = (const MissRatioCurve *)user_data;
+    double width = gtk_widget_get_allocated_width(area), height = gtk_widget_get_allocated_height(area);
+    double margin = 40, plot_w = width - 2 * margin, plot_h = height - 2 * margin;
+    double accesses = mrc->accesses > 0 ? (double)mrc->accesses : 1.0;
+
+    cairo_set_source_rgb(cr, 1, 1, 1);
+    cairo_paint(cr);
+    cairo_set_source_rgb(cr, 0, 0, 0);
+    cairo_set_line_width(cr, 1);
+    cairo_move_to(cr, margin, margin);
+    cairo_line_to(cr, margin, height - margin);
+    cairo_line_to(cr, width - margin, height - margin);
+    cairo_stroke(cr);
+
+    char label[32];
+    cairo_move_to(cr, 4, margin);
+    cairo_show_text(cr, "1.0");
+    cairo_move_to(cr, 4, height - margin);
+    cairo_show_text(cr, "0.0");
+    cairo_move_to(cr, margin, height - margin / 3);
+    cairo_show_text(cr, "1");
+    snprintf(label, sizeof(label), "%d frames", mrc->max_frames);
+    cairo_move_to(cr, width - margin - 50, height - margin / 3);
+    cairo_show_text(cr, label);
+
+    const long long *curves[2] = {mrc->lru_faults, mrc->opt_faults};
+    const double colors[2][3] = {{0.8, 0.1, 0.1}, {0.1, 0.3, 0.8}};
+    const char *names[2] = {"LRU", "Optimal"};
+    for (int k = 0; k < 2; k++) {
+        if (!curves[k])
+            continue;
+        cairo_set_source_rgb(cr, colors[k][0], colors[k][1], colors[k][2]);
+        cairo_set_line_width(cr, 2);
+        for (int c = 1; c <= mrc->max_frames; c++) {
+            double x = margin + (mrc->max_frames > 1 ? plot_w * (c - 1) / (mrc->max_frames - 1) : 0);
+            double y = height - margin - plot_h * ((double)curves[k][c] / accesses);
+            if (c == 1)
+                cairo_move_to(cr, x, y);
+            else
+                cairo_line_to(cr, x, y);
+        }
+        cairo_stroke(cr);
+        cairo_move_to(cr, width - margin - 60, margin + 14 * k);
+        cairo_show_text(cr, names[k]);
+    }
+    return FALSE;
+}
+
+static void on_save_mrc_csv(GtkButton *button, gpointer user_data) {
+    const MissRatioCurve *mrc = (const MissRatioCurve *)user_data;
+    GtkWidget *dialog = gtk_file_chooser_dialog_new("Save Miss-Ratio Curve", GTK_WINDOW(gtk_widget_get_toplevel(GTK_WIDGET(button))),
+                                                    GTK_FILE_CHOOSER_ACTION_SAVE, "_Cancel", GTK_RESPONSE_CANCEL,
+                                                    "_Save", GTK_RESPONSE_ACCEPT, NULL);
+    gtk_file_chooser_set_do_overwrite_confirmation(GTK_FILE_CHOOSER(dialog), TRUE);
+    gtk_file_chooser_set_current_name(GTK_FILE_CHOOSER(dialog), "mrc.csv");
+    if (gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT) {
+        gchar *path = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dialog));
+        FILE *out = fopen(path, "w");
+        if (out) {
+            mrc_write_csv(mrc, out);
+            fclose(out);
+        }
+        g_free(path);
+    }
+    gtk_widget_destroy(dialog);
+}
+
+static void free_mrc(gpointer data) {
+    mrc_free((MissRatioCurve *)data);
+    g_free(data);
+}
+
+// Main loop: a window plotting mrc, which it takes over
+static void show_mrc(GtkWidget *parent, MissRatioCurve *mrc) {
+    GtkWidget *window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+    gtk_window_set_title(GTK_WINDOW(window), "Miss-Ratio Curve (red: LRU, blue: Optimal)");
+    gtk_window_set_default_size(GTK_WINDOW(window), 600, 400);
+    gtk_window_set_transient_for(GTK_WINDOW(window), GTK_WINDOW(parent));
+    g_object_set_data_full(G_OBJECT(window), "mrc", mrc, free_mrc);
+
+    GtkWidget *box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 6);
+    GtkWidget *area = gtk_drawing_area_new();
+    g_signal_connect(area, "draw", G_CALLBACK(draw_mrc), mrc);
+    gtk_box_pack_start(GTK_BOX(box), area, TRUE, TRUE, 0);
+    GtkWidget *save_btn = gtk_button_new_with_label("Save CSV");
+    g_signal_connect(save_btn, "clicked", G_CALLBACK(on_save_mrc_csv), mrc);
+    gtk_box_pack_end(GTK_BOX(box), save_btn, FALSE, FALSE, 6);
+    gtk_container_add(GTK_CONTAINER(window), box);
+    gtk_widget_show_all(window);
+}
+
+// Computes the curve on the worker, with progress and Cancel like a run;
+// the window opens when it is done
+static void on_plot_mrc(GtkButton *button, gpointer user_data) {
+    int max_frames = atoi(gtk_entry_get_text(GTK_ENTRY(frame_count_entry)));
+    (void)button;
+    if (max_frames <= 0) {
+        GtkTextBuffer *buffer = gtk_text_view_get_buffer(GTK_TEXT_VIEW(output_view));
+        gtk_text_buffer_set_text(buffer, "Error: Physical Frames must be positive.\n", -1);
+        return;
+    }
+    start_run((Simulator *)user_data, NULL, 0, max_frames);
+}
+
+// Timeline view: frames top to bottom over time left to right, then the
+// rolling fault rate. Each process has its colour, rows that held pages of
+// several processes are grey, and fuller rows are more opaque.
+static void pid_color(int pid, double *red, double *green, double *blue) {
+    gtk_hsv_to_rgb((pid * 37 % 100) / 100.0, 0.55, 0.9, red, green, blue);
+}
+
+static int row_frames(const Timeline *tl, int row) {
+    long long first = ((long long)row * tl->frame_count + tl->rows - 1) / tl->rows;
+    long long next = ((long long)(row + 1) * tl->frame_count + tl->rows - 1) / tl->rows;
+    return (int)(next - first);
+}
+
+// One bucket between x0 and x1. Faults are marked in red, opaque once
+// there were as many in a row as it has frames.
+static void draw_bucket(cairo_t *cr, const Timeline *tl, const TimelineBucket *b, const TimelineCell *cells,
+                        double x0, double x1, double map_h, double rate_h) {
+    double w = x1 - x0 < 1 ? 1 : x1 - x0, row_h = map_h / tl->rows;
+    for (int r = 0; r < tl->rows; r++) {
+        const TimelineCell *c = &cells[r];
+        if (c->min_pid < 0)
+            continue;
+        double red = 0.6, green = 0.6, blue = 0.6, frames = row_frames(tl, r);
+        if (c->min_pid == c->max_pid)
+            pid_color(c->min_pid, &red, &green, &blue);
+        cairo_set_source_rgba(cr, red, green, blue, 0.25 + 0.75 * c->used / frames);
+        cairo_rectangle(cr, x0, r * row_h, w, row_h);
+        cairo_fill(cr);
+        if (c->faults > 0) {
+            double churn = c->faults / frames;
+            cairo_set_source_rgba(cr, 0.9, 0.1, 0.1, churn < 1 ? 0.2 + 0.8 * churn : 1.0);
+            cairo_rectangle(cr, x0, r * row_h + row_h / 4, w, row_h / 2);
+            cairo_fill(cr);
+        }
+    }
+
+    // Range of the rolling rate, the bucket's own fault rate and, in green,
+    // its prefetches per access
+    double base = map_h + rate_h;
+    cairo_set_source_rgb(cr, 0.55, 0.65, 0.9);
+    cairo_rectangle(cr, x0, base - rate_h * b->max_rate, w, rate_h * (b->max_rate - b->min_rate) + 1);
+    cairo_fill(cr);
+    if (b->prefetches > 0) {
+        double rate = (double)b->prefetches / b->accesses;
+        cairo_set_source_rgb(cr, 0.3, 0.85, 0.4);
+        cairo_rectangle(cr, x0, base - rate_h * (rate < 1 ? rate : 1) - 1, w, 2);
+        cairo_fill(cr);
+    }
+    cairo_set_source_rgb(cr, 1, 1, 1);
+    cairo_rectangle(cr, x0, base - rate_h * b->faults / b->accesses - 1, w, 2);
+    cairo_fill(cr);
+}
+
+// Keeps the view inside the run; a view of all of it follows the run
+static void clamp_view(long long total) {
+    long long length = view_to - view_from;
+    if (view_follow || length >= total || length <= 0) {
+        view_follow = 1;
+        view_from = 0;
+        view_to = total;
+        return;
+    }
+    if (length < GUI_TIMELINE_MIN_VIEW)
+        length = GUI_TIMELINE_MIN_VIEW < total ? GUI_TIMELINE_MIN_VIEW : total;
+    if (view_from < 0)
+        view_from = 0;
+    if (view_from + length > total)
+        view_from = total - length;
+    view_to = view_from + length;
+}
+
+// Draws from the level with about one bucket per pixel column, then the
+// finest buckets the coarser level does not cover yet
+static gboolean draw_timeline(GtkWidget *area, cairo_t *cr, gpointer user_data) {
+    (void)user_data;
+    double width = gtk_widget_get_allocated_width(area), height = gtk_widget_get_allocated_height(area);
+    double map_h = (height - 16) * 0.7, rate_h = (height - 16) - map_h;
+    cairo_set_source_rgb(cr, 0.12, 0.12, 0.12);
+    cairo_paint(cr);
+
+    g_mutex_lock(&timeline_lock);
+    const Timeline *tl = &timeline_shown;
+    if (!tl->enabled || tl->time == 0) {
+        g_mutex_unlock(&timeline_lock);
+        cairo_set_source_rgb(cr, 0.8, 0.8, 0.8);
+        cairo_move_to(cr, 8, 20);
+        cairo_show_text(cr, "Frames over time appear here while a simulation runs.");
+        return FALSE;
+    }
+    clamp_view(tl->time);
+    long long from = view_from, to = view_to;
+    double scale = width / (double)(to - from);
+    int k = timeline_pick_level(tl, to - from, (int)width);
+    const TimelineLevel *level = &tl->levels[k], *finest = &tl->levels[0];
+    long long bw = tl->span << k;
+    for (long long i = from / bw; i < level->count && i * bw < to; i++)
+        draw_bucket(cr, tl, &level->buckets[i], level->cells + i * tl->rows, (i * bw - from) * scale,
+                    ((i + 1) * bw - from) * scale, map_h, rate_h);
+    long long i = (long long)level->count << k;
+    if (i < from / tl->span)
+        i = from / tl->span;
+    for (; i <= finest->count && i * tl->span < to; i++) {
+        const TimelineBucket *b = i < finest->count ? &finest->buckets[i] : &tl->open;
+        const TimelineCell *cells = i < finest->count ? finest->cells + i * tl->rows : tl->open_cells;
+        if (b->accesses > 0)
+            draw_bucket(cr, tl, b, cells, (i * tl->span - from) * scale, (i * tl->span + b->accesses - from) * scale,
+                        map_h, rate_h);
     }
 
-    strcat(result, "\n--- Simulation Start ---\n");
-    simulator_run(sim, result);
-    strcat(result, "--- Simulation End ---\n");
-    gtk_text_buffer_set_text(buffer, result, -1);
+    char label[96];
+    cairo_set_source_rgb(cr, 0.8, 0.8, 0.8);
+    snprintf(label, sizeof(label), "%lld", tl->start + from);
+    cairo_move_to(cr, 4, height - 4);
+    cairo_show_text(cr, label);
+    snprintf(label, sizeof(label), "%d frames; %lld accesses a bucket; fault rate below", tl->frame_count, bw);
+    cairo_move_to(cr, width / 2 - 140, height - 4);
+    cairo_show_text(cr, label);
+    snprintf(label, sizeof(label), "%lld", tl->start + to);
+    cairo_text_extents_t extents;
+    cairo_text_extents(cr, label, &extents);
+    cairo_move_to(cr, width - extents.x_advance - 4, height - 4);
+    cairo_show_text(cr, label);
+    g_mutex_unlock(&timeline_lock);
+    return FALSE;
+}
+
+static long long timeline_length(void) {
+    g_mutex_lock(&timeline_lock);
+    long long total = timeline_shown.enabled ? timeline_shown.time : 0;
+    g_mutex_unlock(&timeline_lock);
+    return total;
+}
+
+// The wheel zooms around the pointer
+static gboolean on_timeline_scroll(GtkWidget *area, GdkEventScroll *event, gpointer user_data) {
+    (void)user_data;
+    double factor = event->direction == GDK_SCROLL_UP ? 0.8 : event->direction == GDK_SCROLL_DOWN ? 1.25 : 0;
+    long long total = timeline_length();
+    if (factor == 0 || total == 0)
+        return FALSE;
+    clamp_view(total);
+    long long length = view_to - view_from;
+    long long at = view_from + (long long)(length * event->x / gtk_widget_get_allocated_width(area));
+    view_from = at - (long long)((at - view_from) * factor);
+    view_to = view_from + (long long)(length * factor);
+    view_follow = 0;
+    clamp_view(total);
+    gtk_widget_queue_draw(area);
+    return TRUE;
+}
+
+// Dragging pans; a double click shows the whole run again
+static gboolean on_timeline_press(GtkWidget *area, GdkEventButton *event, gpointer user_data) {
+    (void)user_data;
+    if (event->button != 1)
+        return FALSE;
+    if (event->type == GDK_2BUTTON_PRESS) {
+        view_follow = 1;
+        gtk_widget_queue_draw(area);
+    }
+    drag_x = event->x;
+    drag_from = view_from;
+    return TRUE;
+}
+
+static gboolean on_timeline_motion(GtkWidget *area, GdkEventMotion *event, gpointer user_data) {
+    (void)user_data;
+    long long total = timeline_length();
+    if (view_follow || total == 0)
+        return FALSE;
+    long long length = view_to - view_from;
+    view_from = drag_from - (long long)((event->x - drag_x) * length / gtk_widget_get_allocated_width(area));
+    view_to = view_from + length;
+    clamp_view(total);
+    gtk_widget_queue_draw(area);
+    return TRUE;
 }
 
 void create_main_window(void) {
-    Simulator *sim = malloc(sizeof(Simulator));
-    simulator_init(sim);
+    Simulator *sim = simulator_create(FRAME_COUNT, 0);
+    simulator_set_timeline(sim, 1, TIMELINE_DEFAULT_RATE_WINDOW);
 
     GtkWidget *window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
     gtk_window_set_title(GTK_WINDOW(window), "Virtual Memory Simulator");
-    gtk_window_set_default_size(GTK_WINDOW(window), 600, 500);
-    g_signal_connect(window, "destroy", G_CALLBACK(gtk_main_quit), NULL);
+    gtk_window_set_default_size(GTK_WINDOW(window), 600, 720);
+    g_signal_connect(window, "destroy", G_CALLBACK(on_main_window_destroy), sim);
 
     GtkWidget *main_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 6);
     gtk_container_add(GTK_CONTAINER(window), main_box);
 
-    GtkWidget *input_frame = gtk_frame_new("Input Parameters");
+    input_frame = gtk_frame_new("Input Parameters");
     GtkWidget *input_grid = gtk_grid_new();
     gtk_container_add(GTK_CONTAINER(input_frame), input_grid);
 
@@ -73,22 +1050,67 @@ void create_main_window(void) {
     page_size_entry = gtk_entry_new();
     gtk_entry_set_text(GTK_ENTRY(page_size_entry), "4096");
 
+    // Frame Count Entry
+    GtkWidget *frame_count_label = gtk_label_new("Physical Frames:");
+    frame_count_entry = gtk_entry_new();
+    char frames_text[16];
+    snprintf(frames_text, sizeof(frames_text), "%d", FRAME_COUNT);
+    gtk_entry_set_text(GTK_ENTRY(frame_count_entry), frames_text);
+
     // Algorithm Combo
     GtkWidget *algo_label = gtk_label_new("Replacement Algorithm:");
     algorithm_combo = gtk_combo_box_text_new();
-    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(algorithm_combo), "lru");
-    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(algorithm_combo), "fifo");
-    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(algorithm_combo), "optimal");
+    for (int i = 0; i < policy_count(); i++)
+        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(algorithm_combo), policy_at(i)->name);
     gtk_combo_box_set_active(GTK_COMBO_BOX(algorithm_combo), 0);
     g_signal_connect(algorithm_combo, "changed", G_CALLBACK(on_algorithm_changed), sim);
 
+    // Policies for Compare, several at once; LRU, FIFO and Optimal to start
+    GtkWidget *compare_label = gtk_label_new("Compare Algorithms:");
+    GtkWidget *compare_box = gtk_flow_box_new();
+    gtk_flow_box_set_selection_mode(GTK_FLOW_BOX(compare_box), GTK_SELECTION_NONE);
+    for (int i = 0; i < policy_count() && i < GUI_MAX_POLICIES; i++) {
+        const char *name = policy_at(i)->name;
+        compare_checks[i] = gtk_check_button_new_with_label(name);
+        gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(compare_checks[i]), strcmp(name, "lru") == 0 ||
+                                     strcmp(name, "fifo") == 0 || strcmp(name, "optimal") == 0);
+        gtk_container_add(GTK_CONTAINER(compare_box), compare_checks[i]);
+    }
+
+    // Optional address trace; replaces the generated reference string
+    GtkWidget *trace_label = gtk_label_new("Trace File (optional):");
+    GtkWidget *trace_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+    trace_chooser = gtk_file_chooser_button_new("Select Address Trace", GTK_FILE_CHOOSER_ACTION_OPEN);
+    GtkWidget *trace_clear = gtk_button_new_with_label("Clear");
+    g_signal_connect_swapped(trace_clear, "clicked", G_CALLBACK(gtk_file_chooser_unselect_all), trace_chooser);
+    gtk_box_pack_start(GTK_BOX(trace_box), trace_chooser, TRUE, TRUE, 0);
+    gtk_box_pack_start(GTK_BOX(trace_box), trace_clear, FALSE, FALSE, 0);
+
+    // Verbosity Combo
+    GtkWidget *verbosity_label = gtk_label_new("Log Detail:");
+    verbosity_combo = gtk_combo_box_text_new();
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(verbosity_combo), "Full");
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(verbosity_combo), "Faults only");
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(verbosity_combo), "Summary");
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(verbosity_combo), "None");
+    gtk_combo_box_set_active(GTK_COMBO_BOX(verbosity_combo), 0);
+    g_signal_connect(verbosity_combo, "changed", G_CALLBACK(on_verbosity_changed), sim);
+
     // Attach widgets to grid
     gtk_grid_attach(GTK_GRID(input_grid), proc_label, 0, 0, 1, 1);
     gtk_grid_attach(GTK_GRID(input_grid), process_dropdown, 1, 0, 1, 1);
     gtk_grid_attach(GTK_GRID(input_grid), page_size_label, 0, 1, 1, 1);
     gtk_grid_attach(GTK_GRID(input_grid), page_size_entry, 1, 1, 1, 1);
-    gtk_grid_attach(GTK_GRID(input_grid), algo_label, 0, 2, 1, 1);
-    gtk_grid_attach(GTK_GRID(input_grid), algorithm_combo, 1, 2, 1, 1);
+    gtk_grid_attach(GTK_GRID(input_grid), frame_count_label, 0, 2, 1, 1);
+    gtk_grid_attach(GTK_GRID(input_grid), frame_count_entry, 1, 2, 1, 1);
+    gtk_grid_attach(GTK_GRID(input_grid), algo_label, 0, 3, 1, 1);
+    gtk_grid_attach(GTK_GRID(input_grid), algorithm_combo, 1, 3, 1, 1);
+    gtk_grid_attach(GTK_GRID(input_grid), verbosity_label, 0, 4, 1, 1);
+    gtk_grid_attach(GTK_GRID(input_grid), verbosity_combo, 1, 4, 1, 1);
+    gtk_grid_attach(GTK_GRID(input_grid), trace_label, 0, 5, 1, 1);
+    gtk_grid_attach(GTK_GRID(input_grid), trace_box, 1, 5, 1, 1);
+    gtk_grid_attach(GTK_GRID(input_grid), compare_label, 0, 6, 1, 1);
+    gtk_grid_attach(GTK_GRID(input_grid), compare_box, 1, 6, 1, 1);
 
     // Process size entries
     for (int i = 0; i < MAX_PROCESSES; i++) {
@@ -97,8 +1119,12 @@ void create_main_window(void) {
         GtkWidget *entry_label = gtk_label_new(label);
         GtkWidget *entry = gtk_entry_new();
         process_size_entries[i] = entry;
-        gtk_grid_attach(GTK_GRID(input_grid), entry_label, 0, 3 + i, 1, 1);
-        gtk_grid_attach(GTK_GRID(input_grid), entry, 1, 3 + i, 1, 1);
+        process_size_labels[i] = entry_label;
+        gtk_grid_attach(GTK_GRID(input_grid), entry_label, 0, 7 + i, 1, 1);
+        gtk_grid_attach(GTK_GRID(input_grid), entry, 1, 7 + i, 1, 1);
+        // Shown by on_process_count_changed, not by gtk_widget_show_all
+        gtk_widget_set_no_show_all(entry_label, TRUE);
+        gtk_widget_set_no_show_all(entry, TRUE);
         gtk_widget_set_visible(entry_label, i == 0);
         gtk_widget_set_visible(entry, i == 0);
     }
@@ -109,16 +1135,50 @@ void create_main_window(void) {
     GtkWidget *sim_frame = gtk_frame_new("Simulation Output");
     output_view = gtk_text_view_new();
     gtk_text_view_set_editable(GTK_TEXT_VIEW(output_view), FALSE);
+    gtk_text_view_set_monospace(GTK_TEXT_VIEW(output_view), TRUE); // Keeps the Compare table aligned
     GtkWidget *scroll = gtk_scrolled_window_new(NULL, NULL);
     gtk_container_add(GTK_CONTAINER(scroll), output_view);
     gtk_container_add(GTK_CONTAINER(sim_frame), scroll);
     gtk_box_pack_start(GTK_BOX(main_box), sim_frame, TRUE, TRUE, 6);
 
-    // Start Button
+    // Frames over time, drawn from the run's timeline
+    GtkWidget *timeline_frame = gtk_frame_new("Timeline (scroll to zoom, drag to pan, double-click for the whole run)");
+    timeline_area = gtk_drawing_area_new();
+    gtk_widget_set_size_request(timeline_area, -1, 220);
+    gtk_widget_add_events(timeline_area, GDK_SCROLL_MASK | GDK_BUTTON_PRESS_MASK | GDK_BUTTON1_MOTION_MASK);
+    g_signal_connect(timeline_area, "draw", G_CALLBACK(draw_timeline), NULL);
+    g_signal_connect(timeline_area, "scroll-event", G_CALLBACK(on_timeline_scroll), NULL);
+    g_signal_connect(timeline_area, "button-press-event", G_CALLBACK(on_timeline_press), NULL);
+    g_signal_connect(timeline_area, "motion-notify-event", G_CALLBACK(on_timeline_motion), NULL);
+    gtk_container_add(GTK_CONTAINER(timeline_frame), timeline_area);
+    gtk_box_pack_start(GTK_BOX(main_box), timeline_frame, FALSE, FALSE, 6);
+
+    // Start, Pause and Cancel Buttons, progress of the running simulation
     GtkWidget *btn_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
-    GtkWidget *start_btn = gtk_button_new_with_label("Start Simulation");
+    progress_bar = gtk_progress_bar_new();
+    gtk_progress_bar_set_show_text(GTK_PROGRESS_BAR(progress_bar), TRUE);
+    gtk_box_pack_start(GTK_BOX(btn_box), progress_bar, TRUE, TRUE, 6);
+    cancel_btn = gtk_button_new_with_label("Cancel");
+    gtk_widget_set_sensitive(cancel_btn, FALSE);
+    g_signal_connect(cancel_btn, "clicked", G_CALLBACK(on_cancel_simulation), NULL);
+    gtk_box_pack_end(GTK_BOX(btn_box), cancel_btn, FALSE, FALSE, 6);
+    pause_btn = gtk_button_new_with_label("Pause");
+    gtk_widget_set_sensitive(pause_btn, FALSE);
+    g_signal_connect(pause_btn, "clicked", G_CALLBACK(on_pause_simulation), NULL);
+    gtk_box_pack_end(GTK_BOX(btn_box), pause_btn, FALSE, FALSE, 6);
+    start_btn = gtk_button_new_with_label("Start Simulation");
     g_signal_connect(start_btn, "clicked", G_CALLBACK(on_start_simulation), sim);
     gtk_box_pack_end(GTK_BOX(btn_box), start_btn, FALSE, FALSE, 6);
+    compare_btn = gtk_button_new_with_label("Compare");
+    g_signal_connect(compare_btn, "clicked", G_CALLBACK(on_compare_algorithms), sim);
+    gtk_box_pack_end(GTK_BOX(btn_box), compare_btn, FALSE, FALSE, 6);
+    mrc_btn = gtk_button_new_with_label("Plot Miss-Ratio Curve");
+    g_signal_connect(mrc_btn, "clicked", G_CALLBACK(on_plot_mrc), sim);
+    gtk_box_pack_end(GTK_BOX(btn_box), mrc_btn, FALSE, FALSE, 6);
+    stats_btn = gtk_button_new_with_label("Export Stats");
+    gtk_widget_set_sensitive(stats_btn, FALSE);
+    g_signal_connect(stats_btn, "clicked", G_CALLBACK(on_export_stats), sim);
+    gtk_box_pack_end(GTK_BOX(btn_box), stats_btn, FALSE, FALSE, 6);
     gtk_box_pack_start(GTK_BOX(main_box), btn_box, FALSE, FALSE, 6);
 
     gtk_widget_show_all(window);
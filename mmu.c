@@ -0,0 +1,217 @@
+#include "mmu.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define MMU_BASE_SHIFT 12  // The radix tree maps 4 KiB pages
+#define MMU_LEVEL_BITS 9   // Index bits per level
+#define MMU_TAG_VALID (1ULL << 63)
+
+static const char *const page_class_names[MMU_PAGE_CLASSES] = {"4k", "2m", "1g"};
+
+void mmu_config_defaults(MmuConfig *config) {
+    memset(config, 0, sizeof(*config));
+    config->tlb_entries = MMU_DEFAULT_TLB_ENTRIES;
+    config->tlb_ways = MMU_DEFAULT_TLB_WAYS;
+    config->levels = MMU_DEFAULT_LEVELS;
+    config->pwc_entries = MMU_DEFAULT_PWC_ENTRIES;
+    config->walk_ref_ns = MMU_DEFAULT_WALK_REF_NS;
+    config->default_page = MMU_PAGE_4K;
+}
+
+// ---- Tag stores ----
+
+static void cache_free(MmuCache *c) {
+    free(c->tags);
+    free(c->stamp);
+    memset(c, 0, sizeof(*c));
+}
+
+static int cache_init(MmuCache *c, int entries, int ways) {
+    memset(c, 0, sizeof(*c));
+    if (entries == 0)
+        return 0;
+    c->tags = calloc((size_t)entries, sizeof(uint64_t));
+    c->stamp = calloc((size_t)entries, sizeof(uint64_t));
+    if (!c->tags || !c->stamp) {
+        cache_free(c);
+        return -1;
+    }
+    c->ways = ways;
+    c->sets = entries / ways;
+    return 0;
+}
+
+static void cache_clear(MmuCache *c) {
+    if (c->sets == 0)
+        return;
+    memset(c->tags, 0, (size_t)c->sets * (size_t)c->ways * sizeof(uint64_t));
+    memset(c->stamp, 0, (size_t)c->sets * (size_t)c->ways * sizeof(uint64_t));
+    c->clock = 0;
+}
+
+// First way of tag's set
+static size_t cache_set(const MmuCache *c, uint64_t tag) {
+    return (size_t)(((tag * 0x9E3779B97F4A7C15ULL) >> 32) % (uint64_t)c->sets) * (size_t)c->ways;
+}
+
+// Whether tag is held; a hit makes it the most recently used of its set
+static int cache_lookup(MmuCache *c, uint64_t tag) {
+    if (c->sets == 0)
+        return 0;
+    size_t base = cache_set(c, tag);
+    for (int w = 0; w < c->ways; w++) {
+        if (c->tags[base + (size_t)w] == tag) {
+            c->stamp[base + (size_t)w] = ++c->clock;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Adds tag over the least recently used way of its set
+static void cache_insert(MmuCache *c, uint64_t tag) {
+    if (c->sets == 0)
+        return;
+    size_t base = cache_set(c, tag), victim = base;
+    for (int w = 1; w < c->ways; w++) {
+        if (c->stamp[base + (size_t)w] < c->stamp[victim])
+            victim = base + (size_t)w;
+    }
+    c->tags[victim] = tag;
+    c->stamp[victim] = ++c->clock;
+}
+
+static int cache_remove(MmuCache *c, uint64_t tag) {
+    if (c->sets == 0)
+        return 0;
+    size_t base = cache_set(c, tag);
+    for (int w = 0; w < c->ways; w++) {
+        if (c->tags[base + (size_t)w] == tag) {
+            c->tags[base + (size_t)w] = 0;
+            c->stamp[base + (size_t)w] = 0;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// ---- Translation ----
+
+void mmu_free(Mmu *mmu) {
+    cache_free(&mmu->tlb);
+    for (int l = 0; l < MMU_MAX_LEVELS - 1; l++)
+        cache_free(&mmu->pwc[l]);
+    memset(mmu, 0, sizeof(*mmu));
+}
+
+// Turns translation on with config, or off when config is NULL. Returns -1
+// and leaves it off if config is out of range or memory runs out.
+int mmu_configure(Mmu *mmu, const MmuConfig *config) {
+    mmu_free(mmu);
+    if (!config)
+        return 0;
+    if (config->tlb_entries <= 0 || config->tlb_ways <= 0 || config->tlb_entries % config->tlb_ways != 0 ||
+        config->levels < 2 || config->levels > MMU_MAX_LEVELS || config->pwc_entries < 0 ||
+        config->walk_ref_ns < 0)
+        return -1;
+    int status = cache_init(&mmu->tlb, config->tlb_entries, config->tlb_ways);
+    for (int l = 0; l < config->levels - 1 && status == 0; l++)
+        status = cache_init(&mmu->pwc[l], config->pwc_entries, config->pwc_entries > 0 ? config->pwc_entries : 1);
+    if (status != 0) {
+        mmu_free(mmu);
+        return -1;
+    }
+    mmu->config = *config;
+    mmu->enabled = 1;
+    return 0;
+}
+
+// Empties the TLB and walk caches before a run over pages of page_size bytes
+void mmu_reset(Mmu *mmu, int page_size) {
+    if (!mmu->enabled)
+        return;
+    cache_clear(&mmu->tlb);
+    for (int l = 0; l < mmu->config.levels - 1; l++)
+        cache_clear(&mmu->pwc[l]);
+    memset(&mmu->counts, 0, sizeof(mmu->counts));
+    mmu->page_size = page_size;
+    mmu->page_shift = -1;
+    if ((page_size & (page_size - 1)) == 0) {
+        mmu->page_shift = 0;
+        while ((1 << mmu->page_shift) < page_size)
+            mmu->page_shift++;
+    }
+}
+
+// The page size pid maps with, demoted when the tree is too shallow for it
+static MmuPageClass page_class(const Mmu *mmu, int pid) {
+    int c = pid >= 0 && pid < MMU_MAX_PIDS && mmu->config.pid_page[pid] ? mmu->config.pid_page[pid] - 1
+                                                                         : (int)mmu->config.default_page;
+    return (MmuPageClass)(c < mmu->config.levels ? c : mmu->config.levels - 1);
+}
+
+// 4 KiB page number of the start of the simulator's page, cut to the bits
+// the tree translates
+static uint64_t base_vpn(const Mmu *mmu, long long page) {
+    uint64_t va = mmu->page_shift >= 0 ? (uint64_t)page << mmu->page_shift : (uint64_t)page * (uint64_t)mmu->page_size;
+    return (va >> MMU_BASE_SHIFT) & ((1ULL << (MMU_LEVEL_BITS * mmu->config.levels)) - 1);
+}
+
+// Tag of the entry that maps vpn's page of class c, or its table at level
+// `level` (1 is the root) for a walk cache
+static uint64_t prefix_tag(const Mmu *mmu, int pid, uint64_t vpn, int level, int c) {
+    uint64_t prefix = vpn >> (MMU_LEVEL_BITS * (mmu->config.levels - level));
+    return MMU_TAG_VALID | ((uint64_t)(uint16_t)pid << 46) | ((uint64_t)c << 44) | prefix;
+}
+
+// Translates an access: a TLB hit costs nothing more; a miss walks from the
+// deepest level a walk cache still knows the table of down to the leaf,
+// one memory reference per level, then fills the caches it missed in
+void mmu_translate(Mmu *mmu, int pid, long long page) {
+    MmuPageClass c = page_class(mmu, pid);
+    int leaf = mmu->config.levels - (int)c;
+    uint64_t vpn = base_vpn(mmu, page);
+    uint64_t tag = prefix_tag(mmu, pid, vpn, leaf, c);
+    if (cache_lookup(&mmu->tlb, tag)) {
+        mmu->counts.tlb_hits++;
+        return;
+    }
+    mmu->counts.tlb_misses++;
+    mmu->counts.misses[c]++;
+
+    int known = 0; // Deepest level whose table below is cached
+    for (int level = leaf - 1; level >= 1; level--) {
+        if (cache_lookup(&mmu->pwc[level - 1], prefix_tag(mmu, pid, vpn, level, 0))) {
+            known = level;
+            mmu->counts.pwc_hits++;
+            break;
+        }
+    }
+    mmu->counts.walk_refs += leaf - known;
+    for (int level = known + 1; level < leaf; level++)
+        cache_insert(&mmu->pwc[level - 1], prefix_tag(mmu, pid, vpn, level, 0));
+    cache_insert(&mmu->tlb, tag);
+}
+
+// Drops the translation of an evicted page. Only 4 KiB mappings go: a huge
+// mapping stands for pages the simulator pages one at a time.
+void mmu_invalidate(Mmu *mmu, int pid, long long page) {
+    if (page_class(mmu, pid) != MMU_PAGE_4K)
+        return;
+    uint64_t vpn = base_vpn(mmu, page);
+    mmu->counts.invalidations += cache_remove(&mmu->tlb, prefix_tag(mmu, pid, vpn, mmu->config.levels, MMU_PAGE_4K));
+}
+
+const char *mmu_page_class_name(MmuPageClass page_class) {
+    return page_class >= 0 && page_class < MMU_PAGE_CLASSES ? page_class_names[page_class] : "?";
+}
+
+int mmu_page_class_parse(const char *text, MmuPageClass *out) {
+    for (int c = 0; c < MMU_PAGE_CLASSES; c++) {
+        if (strcmp(text, page_class_names[c]) == 0) {
+            *out = (MmuPageClass)c;
+            return 0;
+        }
+    }
+    return -1;
+}
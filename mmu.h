@@ -0,0 +1,76 @@
+#ifndef MMU_H
+#define MMU_H
+
+#include <stdint.h>
+
+// Address translation in front of the simulator: a set-associative TLB
+// backed by an x86-64 style radix page table of 2 to 4 levels, 9 index
+// bits each over 4 KiB pages, with a small walk cache per upper level.
+// A process may map 2 MiB or 1 GiB pages instead, which end the walk one
+// or two levels early. Paging itself stays at the simulator's page size;
+// huge pages only change translation reach and walk length.
+
+typedef enum {
+    MMU_PAGE_4K,
+    MMU_PAGE_2M,
+    MMU_PAGE_1G,
+    MMU_PAGE_CLASSES
+} MmuPageClass;
+
+#define MMU_MAX_LEVELS 4
+#define MMU_MAX_PIDS 64 // Processes that can be given their own page size
+
+#define MMU_DEFAULT_TLB_ENTRIES 64
+#define MMU_DEFAULT_TLB_WAYS 4
+#define MMU_DEFAULT_LEVELS 4
+#define MMU_DEFAULT_PWC_ENTRIES 16
+#define MMU_DEFAULT_WALK_REF_NS 20.0
+
+typedef struct {
+    int tlb_entries;
+    int tlb_ways;              // tlb_entries for a fully associative TLB
+    int levels;                // 2 to 4
+    int pwc_entries;           // Per upper level, 0 for no walk caches
+    double walk_ref_ns;        // Cost of one page-table reference
+    MmuPageClass default_page; // For pids without their own entry below
+    unsigned char pid_page[MMU_MAX_PIDS]; // MmuPageClass + 1, 0 for default_page
+} MmuConfig;
+
+// Set-associative tag store with LRU replacement inside each set
+typedef struct {
+    uint64_t *tags;  // 0 marks an empty way; real tags always have bit 63 set
+    uint64_t *stamp; // Last use, for LRU
+    int sets;
+    int ways;
+    uint64_t clock;
+} MmuCache;
+
+typedef struct {
+    long long tlb_hits;
+    long long tlb_misses;
+    long long misses[MMU_PAGE_CLASSES]; // TLB misses by page size of the mapping
+    long long walk_refs;                // Page-table references made by walks
+    long long pwc_hits;                 // Walks shortened by a walk cache
+    long long invalidations;            // TLB entries dropped on eviction
+} MmuCounts;
+
+typedef struct {
+    MmuConfig config;
+    int enabled;
+    MmuCache tlb;
+    MmuCache pwc[MMU_MAX_LEVELS - 1]; // pwc[l] caches the table below level l + 1
+    int page_shift;                   // log2 of the simulator's page size, -1 if not a power of two
+    int page_size;
+    MmuCounts counts;
+} Mmu;
+
+void mmu_config_defaults(MmuConfig *config);
+int mmu_configure(Mmu *mmu, const MmuConfig *config);
+void mmu_free(Mmu *mmu);
+void mmu_reset(Mmu *mmu, int page_size);
+void mmu_translate(Mmu *mmu, int pid, long long page);
+void mmu_invalidate(Mmu *mmu, int pid, long long page);
+const char *mmu_page_class_name(MmuPageClass page_class);
+int mmu_page_class_parse(const char *text, MmuPageClass *out);
+
+#endif
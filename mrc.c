@@ -0,0 +1,339 @@
+#include "mrc.h"
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void fenwick_add(int *tree, int size, int pos, int delta) {
+    for (int i = pos + 1; i <= size; i += i & -i)
+        tree[i] += delta;
+}
+
+// Number of marks at positions 0..pos inclusive
+static int fenwick_prefix(const int *tree, int pos) {
+    int sum = 0;
+    for (int i = pos + 1; i > 0; i -= i & -i)
+        sum += tree[i];
+    return sum;
+}
+
+int stackdist_init(StackDistance *sd, int expected_keys) {
+    memset(sd, 0, sizeof(*sd));
+    sd->capacity = expected_keys > 512 ? expected_keys * 2 : 1024;
+    sd->tree = calloc((size_t)sd->capacity + 1, sizeof(int));
+    sd->pos_key = malloc((size_t)sd->capacity * sizeof(uint64_t));
+    if (!sd->tree || !sd->pos_key || pagemap_init(&sd->last_pos, (size_t)expected_keys) != 0) {
+        stackdist_free(sd);
+        return -1;
+    }
+    for (int p = 0; p < sd->capacity; p++)
+        sd->pos_key[p] = PAGEMAP_EMPTY;
+    return 0;
+}
+
+void stackdist_free(StackDistance *sd) {
+    free(sd->tree);
+    free(sd->pos_key);
+    pagemap_free(&sd->last_pos);
+    memset(sd, 0, sizeof(*sd));
+}
+
+// Out of positions: renumber live marks 0..live-1 in access order, growing
+// first if more than half the positions are live
+static int stackdist_compact(StackDistance *sd) {
+    if (sd->live * 2 > sd->capacity) {
+        int capacity = sd->capacity * 2;
+        int *tree = realloc(sd->tree, ((size_t)capacity + 1) * sizeof(int));
+        if (!tree)
+            return -1;
+        sd->tree = tree;
+        uint64_t *pos_key = realloc(sd->pos_key, (size_t)capacity * sizeof(uint64_t));
+        if (!pos_key)
+            return -1;
+        sd->pos_key = pos_key;
+        for (int p = sd->capacity; p < capacity; p++)
+            pos_key[p] = PAGEMAP_EMPTY;
+        sd->capacity = capacity;
+    }
+
+    int n = 0;
+    for (int p = 0; p < sd->next_pos; p++) {
+        if (sd->pos_key[p] == PAGEMAP_EMPTY)
+            continue;
+        sd->pos_key[n] = sd->pos_key[p];
+        *pagemap_lookup(&sd->last_pos, sd->pos_key[n]) = n;
+        n++;
+    }
+    for (int p = n; p < sd->capacity; p++)
+        sd->pos_key[p] = PAGEMAP_EMPTY;
+
+    // Linear-time Fenwick build with positions 0..n-1 marked
+    for (int i = 1; i <= sd->capacity; i++)
+        sd->tree[i] = i <= n ? 1 : 0;
+    for (int i = 1; i <= sd->capacity; i++) {
+        int parent = i + (i & -i);
+        if (parent <= sd->capacity)
+            sd->tree[parent] += sd->tree[i];
+    }
+    sd->next_pos = n;
+    return 0;
+}
+
+// Records an access and returns its LRU stack distance: 1 if key was the
+// most recently used page, STACK_DISTANCE_COLD on first access, -2 on
+// allocation failure. A cache of c frames hits exactly when distance <= c.
+long long stackdist_access(StackDistance *sd, uint64_t key) {
+    if (sd->next_pos == sd->capacity && stackdist_compact(sd) != 0)
+        return -2;
+
+    long long distance = STACK_DISTANCE_COLD;
+    int *last = pagemap_lookup(&sd->last_pos, key);
+    if (last) {
+        distance = sd->live - fenwick_prefix(sd->tree, *last) + 1;
+        fenwick_add(sd->tree, sd->capacity, *last, -1);
+        sd->pos_key[*last] = PAGEMAP_EMPTY;
+        *last = sd->next_pos;
+    } else {
+        if (pagemap_put(&sd->last_pos, key, sd->next_pos) != 0)
+            return -2;
+        sd->live++;
+    }
+    fenwick_add(sd->tree, sd->capacity, sd->next_pos, 1);
+    sd->pos_key[sd->next_pos++] = key;
+    return distance;
+}
+
+// Drops key from the stack as if it had never been seen
+void stackdist_forget(StackDistance *sd, uint64_t key) {
+    int *last = pagemap_lookup(&sd->last_pos, key);
+    if (!last)
+        return;
+    fenwick_add(sd->tree, sd->capacity, *last, -1);
+    sd->pos_key[*last] = PAGEMAP_EMPTY;
+    pagemap_remove(&sd->last_pos, key);
+    sd->live--;
+}
+
+static int mrc_alloc(MissRatioCurve *mrc, int max_frames, int with_opt) {
+    memset(mrc, 0, sizeof(*mrc));
+    mrc->max_frames = max_frames;
+    mrc->lru_faults = calloc((size_t)max_frames + 1, sizeof(long long));
+    if (with_opt)
+        mrc->opt_faults = calloc((size_t)max_frames + 1, sizeof(long long));
+    if (!mrc->lru_faults || (with_opt && !mrc->opt_faults)) {
+        mrc_free(mrc);
+        return -1;
+    }
+    return 0;
+}
+
+void mrc_free(MissRatioCurve *mrc) {
+    free(mrc->lru_faults);
+    free(mrc->opt_faults);
+    mrc->lru_faults = mrc->opt_faults = NULL;
+}
+
+// Turns per-distance hit counts (hits[d] for d in 1..max) into fault counts per size
+static void hits_to_faults(const long long *hits, long long accesses, int max_frames, long long *faults) {
+    long long cumulative = 0;
+    for (int c = 1; c <= max_frames; c++) {
+        cumulative += hits[c];
+        faults[c] = accesses - cumulative;
+    }
+}
+
+// Progress of mrc_compute_progress(), in references of the passes it
+// makes: one for LRU, two for Optimal
+typedef struct {
+    SimProgressFn fn;
+    void *user_data;
+    long long done;
+    long long total;
+    int cancelled;
+} MrcProgress;
+
+// Counts one reference; every SIM_BATCH_SIZE of them asks the callback
+// whether to go on. Returns 0 once the run is cancelled.
+static int progress_step(MrcProgress *p) {
+    if (++p->done % SIM_BATCH_SIZE == 0 && p->fn && p->fn(p->done, p->total, p->user_data))
+        p->cancelled = 1;
+    return !p->cancelled;
+}
+
+// Optimal is also a stack algorithm: the top c entries of Mattson's
+// priority stack, ordered by next use, are exactly OPT's c-frame memory.
+// Entries below max_frames are dropped, so this costs O(n * max_frames).
+static int opt_hits(const PageReference *refs, int len, int max_frames, long long *hits, MrcProgress *progress) {
+    int *next_use = malloc((size_t)(len > 0 ? len : 1) * sizeof(int));
+    uint64_t *stack_key = malloc((size_t)max_frames * sizeof(uint64_t));
+    int *stack_next = malloc((size_t)max_frames * sizeof(int));
+    PageMap depth_of, seen;
+    int ok = next_use && stack_key && stack_next;
+    if (!ok || pagemap_init(&seen, 1024) != 0) {
+        free(next_use);
+        free(stack_key);
+        free(stack_next);
+        return -1;
+    }
+    if (pagemap_init(&depth_of, (size_t)max_frames) != 0) {
+        pagemap_free(&seen);
+        free(next_use);
+        free(stack_key);
+        free(stack_next);
+        return -1;
+    }
+
+    for (int i = len - 1; i >= 0 && ok && progress_step(progress); i--) {
+        uint64_t key = page_key(refs[i].pid, refs[i].page_num);
+        int *later = pagemap_lookup(&seen, key);
+        next_use[i] = later ? *later : INT_MAX;
+        ok = pagemap_put(&seen, key, i) == 0;
+    }
+    pagemap_free(&seen);
+
+    int depth = 0;
+    for (int t = 0; t < len && ok && progress_step(progress); t++) {
+        uint64_t key = page_key(refs[t].pid, refs[t].page_num);
+        int *found = pagemap_lookup(&depth_of, key);
+        int d = found ? *found : -1;
+        if (d >= 0)
+            hits[d + 1]++;
+        if (d == 0) {
+            stack_next[0] = next_use[t];
+            continue;
+        }
+        if (depth == 0) {
+            stack_key[0] = key;
+            stack_next[0] = next_use[t];
+            ok = pagemap_put(&depth_of, key, 0) == 0;
+            depth = 1;
+            continue;
+        }
+
+        // The referenced page goes on top; the old top sinks, and at each
+        // level the entry needed later keeps sinking
+        uint64_t carry_key = stack_key[0];
+        int carry_next = stack_next[0];
+        stack_key[0] = key;
+        stack_next[0] = next_use[t];
+        ok = pagemap_put(&depth_of, key, 0) == 0;
+
+        int limit = d >= 0 ? d : depth;
+        for (int i = 1; i < limit; i++) {
+            if (stack_next[i] > carry_next) {
+                uint64_t k = stack_key[i];
+                int n = stack_next[i];
+                stack_key[i] = carry_key;
+                stack_next[i] = carry_next;
+                *pagemap_lookup(&depth_of, carry_key) = i;
+                carry_key = k;
+                carry_next = n;
+            }
+        }
+
+        if (d < 0 && depth == max_frames) {
+            pagemap_remove(&depth_of, carry_key);
+            continue;
+        }
+        int slot = d >= 0 ? d : depth++;
+        stack_key[slot] = carry_key;
+        stack_next[slot] = carry_next;
+        *pagemap_lookup(&depth_of, carry_key) = slot;
+    }
+
+    pagemap_free(&depth_of);
+    free(next_use);
+    free(stack_key);
+    free(stack_next);
+    return ok ? 0 : -1;
+}
+
+// Full miss-ratio curve in one pass: LRU in O(n log n), and Optimal in
+// O(n * max_frames) when with_opt is set
+int mrc_compute(const PageReference *refs, int len, int max_frames, int with_opt, MissRatioCurve *mrc) {
+    return mrc_compute_progress(refs, len, max_frames, with_opt, NULL, NULL, mrc);
+}
+
+// mrc_compute() with a callback every SIM_BATCH_SIZE references of each
+// pass; SIM_CANCELLED, with nothing in mrc, if it asks to stop
+int mrc_compute_progress(const PageReference *refs, int len, int max_frames, int with_opt, SimProgressFn progress,
+                         void *user_data, MissRatioCurve *mrc) {
+    if (max_frames <= 0 || mrc_alloc(mrc, max_frames, with_opt) != 0)
+        return -1;
+    long long *hits = calloc((size_t)max_frames + 1, sizeof(long long));
+    StackDistance sd;
+    if (!hits || stackdist_init(&sd, 1024) != 0) {
+        free(hits);
+        mrc_free(mrc);
+        return -1;
+    }
+
+    MrcProgress steps = {progress, user_data, 0, (long long)len * (with_opt ? 3 : 1), 0};
+    int ok = 1;
+    for (int i = 0; i < len && ok && progress_step(&steps); i++) {
+        long long d = stackdist_access(&sd, page_key(refs[i].pid, refs[i].page_num));
+        if (d == -2)
+            ok = 0;
+        else if (d != STACK_DISTANCE_COLD && d <= max_frames)
+            hits[d]++;
+    }
+    stackdist_free(&sd);
+    mrc->accesses = len;
+    hits_to_faults(hits, len, max_frames, mrc->lru_faults);
+
+    if (ok && !steps.cancelled && with_opt) {
+        memset(hits, 0, ((size_t)max_frames + 1) * sizeof(long long));
+        ok = opt_hits(refs, len, max_frames, hits, &steps) == 0;
+        hits_to_faults(hits, len, max_frames, mrc->opt_faults);
+    }
+    free(hits);
+    if (!ok || steps.cancelled)
+        mrc_free(mrc);
+    return steps.cancelled ? SIM_CANCELLED : ok ? 0 : -1;
+}
+
+// LRU curve straight from a stream; Optimal would need the whole trace
+int mrc_compute_source(RefSource *src, int max_frames, MissRatioCurve *mrc) {
+    if (max_frames <= 0 || mrc_alloc(mrc, max_frames, 0) != 0)
+        return -1;
+    long long *hits = calloc((size_t)max_frames + 1, sizeof(long long));
+    PageReference *batch = malloc(SIM_BATCH_SIZE * sizeof(PageReference));
+    StackDistance sd;
+    if (!hits || !batch || stackdist_init(&sd, 1024) != 0) {
+        free(hits);
+        free(batch);
+        mrc_free(mrc);
+        return -1;
+    }
+
+    int ok = 1;
+    size_t n;
+    while (ok && (n = src->read(src, batch, SIM_BATCH_SIZE)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            long long d = stackdist_access(&sd, page_key(batch[i].pid, batch[i].page_num));
+            if (d == -2)
+                ok = 0;
+            else if (d != STACK_DISTANCE_COLD && d <= max_frames)
+                hits[d]++;
+        }
+        mrc->accesses += (long long)n;
+    }
+    hits_to_faults(hits, mrc->accesses, max_frames, mrc->lru_faults);
+    stackdist_free(&sd);
+    free(batch);
+    free(hits);
+    if (!ok)
+        mrc_free(mrc);
+    return ok ? 0 : -1;
+}
+
+void mrc_write_csv(const MissRatioCurve *mrc, FILE *out) {
+    double accesses = mrc->accesses > 0 ? (double)mrc->accesses : 1.0;
+    fprintf(out, mrc->opt_faults ? "frames,lru_faults,lru_miss_ratio,opt_faults,opt_miss_ratio\n"
+                                 : "frames,lru_faults,lru_miss_ratio\n");
+    for (int c = 1; c <= mrc->max_frames; c++) {
+        fprintf(out, "%d,%lld,%.6f", c, mrc->lru_faults[c], (double)mrc->lru_faults[c] / accesses);
+        if (mrc->opt_faults)
+            fprintf(out, ",%lld,%.6f", mrc->opt_faults[c], (double)mrc->opt_faults[c] / accesses);
+        fputc('\n', out);
+    }
+}
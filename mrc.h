@@ -0,0 +1,44 @@
+#ifndef MRC_H
+#define MRC_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "pagemap.h"
+#include "simulator.h"
+
+// LRU stack distances (Mattson): a Fenwick tree over access positions holds
+// a mark at each page's most recent access, so the number of distinct pages
+// touched since a page's last access is a prefix sum. Positions are
+// renumbered when the tree fills, keeping memory O(distinct pages).
+typedef struct {
+    PageMap last_pos;  // key -> position of its most recent access
+    int *tree;         // Fenwick tree over positions, 1-based
+    uint64_t *pos_key; // Key marked at each position, PAGEMAP_EMPTY if none
+    int capacity;
+    int next_pos;
+    int live;          // Marked positions == distinct keys tracked
+} StackDistance;
+
+#define STACK_DISTANCE_COLD (-1LL) // First access: infinite distance
+
+int stackdist_init(StackDistance *sd, int expected_keys);
+void stackdist_free(StackDistance *sd);
+long long stackdist_access(StackDistance *sd, uint64_t key);
+void stackdist_forget(StackDistance *sd, uint64_t key);
+
+// Fault counts for every memory size from 1 to max_frames frames
+typedef struct {
+    int max_frames;
+    long long accesses;
+    long long *lru_faults; // lru_faults[c] for c in 1..max_frames
+    long long *opt_faults; // Same for Optimal; NULL when not computed
+} MissRatioCurve;
+
+int mrc_compute(const PageReference *refs, int len, int max_frames, int with_opt, MissRatioCurve *mrc);
+int mrc_compute_progress(const PageReference *refs, int len, int max_frames, int with_opt, SimProgressFn progress,
+                         void *user_data, MissRatioCurve *mrc);
+int mrc_compute_source(RefSource *src, int max_frames, MissRatioCurve *mrc);
+void mrc_free(MissRatioCurve *mrc);
+void mrc_write_csv(const MissRatioCurve *mrc, FILE *out);
+
+#endif
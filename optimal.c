@@ -0,0 +1,154 @@
+#include "optimal.h"
+#include "pagemap.h"
+#include "policy.h"
+#include "simulator.h"
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Frame a should be evicted before frame b: used farther in the future,
+// or both never used again and a was loaded first
+static int evicts_before(const OptimalEngine *opt, int a, int b) {
+    if (opt->frame_next[a] != opt->frame_next[b])
+        return opt->frame_next[a] > opt->frame_next[b];
+    return opt->frame_seq[a] < opt->frame_seq[b];
+}
+
+static void heap_swap(OptimalEngine *opt, int i, int j) {
+    int fi = opt->heap[i], fj = opt->heap[j];
+    opt->heap[i] = fj;
+    opt->heap[j] = fi;
+    opt->heap_pos[fj] = i;
+    opt->heap_pos[fi] = j;
+}
+
+static void heap_sift_up(OptimalEngine *opt, int i) {
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!evicts_before(opt, opt->heap[i], opt->heap[parent]))
+            break;
+        heap_swap(opt, i, parent);
+        i = parent;
+    }
+}
+
+static void heap_sift_down(OptimalEngine *opt, int i) {
+    for (;;) {
+        int left = 2 * i + 1, right = left + 1, top = i;
+        if (left < opt->heap_size && evicts_before(opt, opt->heap[left], opt->heap[top]))
+            top = left;
+        if (right < opt->heap_size && evicts_before(opt, opt->heap[right], opt->heap[top]))
+            top = right;
+        if (top == i)
+            break;
+        heap_swap(opt, i, top);
+        i = top;
+    }
+}
+
+void optimal_free(OptimalEngine *opt) {
+    free(opt->next_use);
+    free(opt->heap);
+    free(opt->heap_pos);
+    free(opt->frame_next);
+    free(opt->frame_seq);
+    memset(opt, 0, sizeof(*opt));
+}
+
+// Builds the next-use index in one backward pass and sizes the heap
+int optimal_prepare(OptimalEngine *opt, const struct PageReference *refs, int len, int frame_count) {
+    optimal_free(opt);
+
+    opt->next_use = malloc((size_t)(len > 0 ? len : 1) * sizeof(int));
+    opt->heap = malloc((size_t)frame_count * sizeof(int));
+    opt->heap_pos = malloc((size_t)frame_count * sizeof(int));
+    opt->frame_next = malloc((size_t)frame_count * sizeof(int));
+    opt->frame_seq = malloc((size_t)frame_count * sizeof(long));
+    if (!opt->next_use || !opt->heap || !opt->heap_pos || !opt->frame_next || !opt->frame_seq) {
+        optimal_free(opt);
+        return -1;
+    }
+    opt->reference_len = len;
+    opt->frame_count = frame_count;
+    for (int f = 0; f < frame_count; f++)
+        opt->heap_pos[f] = -1;
+
+    PageMap last_seen;
+    if (pagemap_init(&last_seen, 1024) != 0) {
+        optimal_free(opt);
+        return -1;
+    }
+    for (int i = len - 1; i >= 0; i--) {
+        uint64_t key = page_key(refs[i].pid, refs[i].page_num);
+        int *seen = pagemap_lookup(&last_seen, key);
+        opt->next_use[i] = seen ? *seen : INT_MAX;
+        if (pagemap_put(&last_seen, key, i) != 0) {
+            pagemap_free(&last_seen);
+            optimal_free(opt);
+            return -1;
+        }
+    }
+    pagemap_free(&last_seen);
+    return 0;
+}
+
+// Page referenced at ref_idx was loaded into frame
+void optimal_on_load(OptimalEngine *opt, int frame, int ref_idx) {
+    opt->frame_next[frame] = opt->next_use[ref_idx];
+    opt->frame_seq[frame] = opt->load_seq++;
+    opt->heap[opt->heap_size] = frame;
+    opt->heap_pos[frame] = opt->heap_size++;
+    heap_sift_up(opt, opt->heap_pos[frame]);
+}
+
+// Page in frame was hit at ref_idx; its next use only moves later
+void optimal_on_hit(OptimalEngine *opt, int frame, int ref_idx) {
+    opt->frame_next[frame] = opt->next_use[ref_idx];
+    heap_sift_up(opt, opt->heap_pos[frame]);
+}
+
+// Removes and returns the frame whose page is needed farthest in the future
+int optimal_victim(OptimalEngine *opt) {
+    int victim = opt->heap[0];
+    heap_swap(opt, 0, --opt->heap_size);
+    opt->heap_pos[victim] = -1;
+    heap_sift_down(opt, 0);
+    return victim;
+}
+
+static void *optimal_create(int frame_count) {
+    OptimalEngine *opt = calloc(1, sizeof(OptimalEngine));
+    if (opt)
+        opt->frame_count = frame_count;
+    return opt;
+}
+
+static void optimal_destroy(void *state) {
+    optimal_free(state);
+    free(state);
+}
+
+static int optimal_reset(void *state, const struct PageReference *refs, int len) {
+    OptimalEngine *opt = state;
+    if (!refs && len > 0)
+        return -1;
+    return optimal_prepare(opt, refs, len, opt->frame_count);
+}
+
+static void optimal_policy_on_hit(void *state, int frame, const PolicyAccess *access) {
+    optimal_on_hit(state, frame, (int)access->index);
+}
+
+static void optimal_policy_on_miss(void *state, int frame, const PolicyAccess *access) {
+    optimal_on_load(state, frame, (int)access->index);
+}
+
+static int optimal_choose_victim(void *state, const PolicyAccess *access) {
+    (void)access;
+    return optimal_victim(state);
+}
+
+const ReplacementPolicy policy_optimal = {
+    "optimal", optimal_create, optimal_destroy, optimal_reset,
+    optimal_policy_on_hit, optimal_policy_on_miss, optimal_choose_victim, NULL, NULL, 1
+};
@@ -0,0 +1,27 @@
+#ifndef OPTIMAL_H
+#define OPTIMAL_H
+
+struct PageReference;
+
+// Belady's Optimal engine: next-use index over the whole reference string
+// plus a max-heap of resident frames keyed on when they are needed next.
+typedef struct {
+    int *next_use;     // next_use[i]: index of the next reference to the same page, INT_MAX if none
+    int reference_len;
+
+    int *heap;         // Frame numbers, farthest next use at heap[0]
+    int *heap_pos;     // heap_pos[frame]: slot of frame in heap, -1 if not resident
+    int *frame_next;   // Next use of the page currently held in each frame
+    long *frame_seq;   // Load order of each frame, breaks ties between never-used-again pages
+    int heap_size;
+    int frame_count;
+    long load_seq;
+} OptimalEngine;
+
+int optimal_prepare(OptimalEngine *opt, const struct PageReference *refs, int len, int frame_count);
+void optimal_free(OptimalEngine *opt);
+void optimal_on_load(OptimalEngine *opt, int frame, int ref_idx);
+void optimal_on_hit(OptimalEngine *opt, int frame, int ref_idx);
+int optimal_victim(OptimalEngine *opt);
+
+#endif
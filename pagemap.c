@@ -0,0 +1,114 @@
+#include "pagemap.h"
+#include <stdlib.h>
+
+// Fibonacci hashing spreads the packed pid/page bits across the table
+static size_t pagemap_slot(const PageMap *map, uint64_t key) {
+    return (size_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & (map->capacity - 1);
+}
+
+static int pagemap_alloc(PageMap *map, size_t capacity) {
+    map->keys = malloc(capacity * sizeof(uint64_t));
+    map->values = malloc(capacity * sizeof(int));
+    if (!map->keys || !map->values) {
+        free(map->keys);
+        free(map->values);
+        map->keys = NULL;
+        map->values = NULL;
+        return -1;
+    }
+    map->capacity = capacity;
+    map->count = 0;
+    for (size_t i = 0; i < capacity; i++)
+        map->keys[i] = PAGEMAP_EMPTY;
+    return 0;
+}
+
+// Sizes the table so that `expected` entries stay below half load
+int pagemap_init(PageMap *map, size_t expected) {
+    size_t capacity = 16;
+    while (capacity < expected * 2)
+        capacity <<= 1;
+    return pagemap_alloc(map, capacity);
+}
+
+void pagemap_free(PageMap *map) {
+    free(map->keys);
+    free(map->values);
+    map->keys = NULL;
+    map->values = NULL;
+    map->capacity = 0;
+    map->count = 0;
+}
+
+void pagemap_clear(PageMap *map) {
+    for (size_t i = 0; i < map->capacity; i++)
+        map->keys[i] = PAGEMAP_EMPTY;
+    map->count = 0;
+}
+
+// Returns a pointer to the value stored for key, or NULL if absent
+int *pagemap_lookup(const PageMap *map, uint64_t key) {
+    size_t mask = map->capacity - 1;
+    for (size_t i = pagemap_slot(map, key);; i = (i + 1) & mask) {
+        if (map->keys[i] == key)
+            return &map->values[i];
+        if (map->keys[i] == PAGEMAP_EMPTY)
+            return NULL;
+    }
+}
+
+static int pagemap_grow(PageMap *map) {
+    PageMap bigger;
+    if (pagemap_alloc(&bigger, map->capacity * 2) != 0)
+        return -1;
+    for (size_t i = 0; i < map->capacity; i++) {
+        if (map->keys[i] != PAGEMAP_EMPTY)
+            pagemap_put(&bigger, map->keys[i], map->values[i]);
+    }
+    pagemap_free(map);
+    *map = bigger;
+    return 0;
+}
+
+// Inserts key or overwrites its value; returns -1 on allocation failure
+int pagemap_put(PageMap *map, uint64_t key, int value) {
+    if ((map->count + 1) * 2 > map->capacity && pagemap_grow(map) != 0)
+        return -1;
+
+    size_t mask = map->capacity - 1;
+    size_t i = pagemap_slot(map, key);
+    while (map->keys[i] != PAGEMAP_EMPTY && map->keys[i] != key)
+        i = (i + 1) & mask;
+    if (map->keys[i] == PAGEMAP_EMPTY) {
+        map->keys[i] = key;
+        map->count++;
+    }
+    map->values[i] = value;
+    return 0;
+}
+
+// Deletes key by shifting later probe-chain entries back, so no tombstones
+// accumulate; returns -1 if key was absent
+int pagemap_remove(PageMap *map, uint64_t key) {
+    size_t mask = map->capacity - 1;
+    size_t i = pagemap_slot(map, key);
+    while (map->keys[i] != key) {
+        if (map->keys[i] == PAGEMAP_EMPTY)
+            return -1;
+        i = (i + 1) & mask;
+    }
+
+    for (size_t j = (i + 1) & mask; map->keys[j] != PAGEMAP_EMPTY; j = (j + 1) & mask) {
+        size_t home = pagemap_slot(map, map->keys[j]);
+        // Entry at j may only move back if its home slot is not within (i, j]
+        int stays = (i < j) ? (home > i && home <= j) : (home > i || home <= j);
+        if (stays)
+            continue;
+        map->keys[i] = map->keys[j];
+        map->values[i] = map->values[j];
+        i = j;
+    }
+    map->keys[i] = PAGEMAP_EMPTY;
+    map->count--;
+    return 0;
+}
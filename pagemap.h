@@ -0,0 +1,41 @@
+#ifndef PAGEMAP_H
+#define PAGEMAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define PAGEMAP_EMPTY UINT64_MAX
+
+#define PAGE_NUMBER_BITS 48 // Bits of the page number a key keeps
+// Page numbers below this have a key of their own. The all-ones one is
+// left out: with pid 65535 its key would be PAGEMAP_EMPTY.
+#define PAGE_NUMBER_LIMIT ((1LL << PAGE_NUMBER_BITS) - 1)
+
+// Packs a (pid, page) pair into a single 64-bit hash key: pid in the top 16 bits
+static inline uint64_t page_key(int pid, long long page) {
+    return ((uint64_t)(uint16_t)pid << PAGE_NUMBER_BITS) |
+           ((uint64_t)page & ((1ULL << PAGE_NUMBER_BITS) - 1));
+}
+
+// Whether page has a key of its own; a larger or negative page number
+// would share one with another page
+static inline int page_fits_key(long long page) {
+    return page >= 0 && page < PAGE_NUMBER_LIMIT;
+}
+
+// Open-addressing (linear probing) hash map from page keys to int values
+typedef struct {
+    uint64_t *keys;
+    int *values;
+    size_t capacity; // Always a power of two
+    size_t count;
+} PageMap;
+
+int pagemap_init(PageMap *map, size_t expected);
+void pagemap_free(PageMap *map);
+void pagemap_clear(PageMap *map);
+int *pagemap_lookup(const PageMap *map, uint64_t key);
+int pagemap_put(PageMap *map, uint64_t key, int value);
+int pagemap_remove(PageMap *map, uint64_t key);
+
+#endif
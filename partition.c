@@ -0,0 +1,531 @@
+#include "partition.h"
+#include <stdlib.h>
+#include <string.h>
+#include "pagemap.h"
+#include "threadpool.h"
+#include "timing.h"
+
+// A suspended process that has this many epochs of the stream queued goes
+// back in ahead of the others, so no queue grows without bound
+#define PARTITION_BACKLOG_EPOCHS 4
+
+static const char *const allocator_names[] = {"fixed", "ws", "pff"};
+
+typedef struct {
+    int pid;
+    Simulator *sim;
+
+    // References that arrived for this process and have not run yet; a
+    // suspended process keeps collecting them until it is let back in
+    PageReference *queue;
+    size_t queued;
+    size_t queue_capacity;
+    long long time; // References it has run, its virtual time
+
+    int allocation; // Frames this epoch, 0 while suspended
+    int demand;     // What the allocator asked for; PFF grows and shrinks it
+    int suspended;
+    long long suspended_at; // Suspension order, for resuming first in first out
+    long long epoch_accesses;
+    long long epoch_faults;
+    int failed; // Its simulator could not take the epoch's references
+
+    // The last ws_window pages it used, oldest first from window_head, and
+    // how many times each page occurs among them
+    uint64_t *window;
+    long long window_len;
+    long long window_head;
+    PageMap window_counts;
+
+    PartitionTotals *totals;
+} Partition;
+
+typedef struct {
+    const PartitionSpec *spec;
+    PartitionReport *report;
+    Partition **parts;
+    int count;
+    int capacity;
+    PageMap index; // pid -> parts[]
+    long long suspensions;
+} PartitionSet;
+
+void partition_spec_defaults(PartitionSpec *spec, int frames, const char *algorithm) {
+    memset(spec, 0, sizeof(*spec));
+    spec->frames = frames;
+    spec->algorithm = algorithm;
+    spec->allocator = PARTITION_FIXED;
+    spec->epoch = PARTITION_DEFAULT_EPOCH;
+    spec->ws_window = PARTITION_DEFAULT_WS_WINDOW;
+    spec->pff_low = PARTITION_DEFAULT_PFF_LOW;
+    spec->pff_high = PARTITION_DEFAULT_PFF_HIGH;
+}
+
+static void part_free(Partition *p) {
+    simulator_destroy(p->sim);
+    free(p->queue);
+    free(p->window);
+    pagemap_free(&p->window_counts);
+    free(p);
+}
+
+static void set_free(PartitionSet *set) {
+    for (int i = 0; i < set->count; i++)
+        part_free(set->parts[i]);
+    free(set->parts);
+    pagemap_free(&set->index);
+    set->parts = NULL;
+    set->count = 0;
+}
+
+// A quiet simulator with one frame; the allocator sizes it before it runs
+static Partition *part_create(const PartitionSpec *spec, int pid) {
+    Partition *p = calloc(1, sizeof(Partition));
+    if (!p)
+        return NULL;
+    p->pid = pid;
+    p->sim = simulator_create(1, 1);
+    int windowed = spec->allocator == PARTITION_WORKING_SET;
+    if (windowed)
+        p->window = malloc((size_t)spec->ws_window * sizeof(uint64_t));
+    if (!p->sim || simulator_set_algorithm(p->sim, spec->algorithm) != 0 ||
+        (windowed && (!p->window || pagemap_init(&p->window_counts, 64) != 0))) {
+        part_free(p);
+        return NULL;
+    }
+    simulator_set_verbosity(p->sim, SIM_VERBOSITY_NONE);
+    simulator_set_stats_window(p->sim, 0);
+    if (simulator_begin_run(p->sim, NULL, 0) != 0) {
+        part_free(p);
+        return NULL;
+    }
+    return p;
+}
+
+static int report_grow_processes(PartitionReport *report, int count) {
+    PartitionTotals *processes = realloc(report->processes, (size_t)count * sizeof(PartitionTotals));
+    if (!processes)
+        return -1;
+    report->processes = processes;
+    return 0;
+}
+
+// The partition of pid, created on its first reference
+static Partition *set_partition(PartitionSet *set, int pid) {
+    int *slot = pagemap_lookup(&set->index, (uint64_t)(unsigned)pid);
+    if (slot)
+        return set->parts[*slot];
+    if (set->count == set->capacity) {
+        int capacity = set->capacity ? set->capacity * 2 : 8;
+        Partition **parts = realloc(set->parts, (size_t)capacity * sizeof(Partition *));
+        if (!parts || report_grow_processes(set->report, capacity) != 0) {
+            if (parts)
+                set->parts = parts;
+            return NULL;
+        }
+        set->parts = parts;
+        set->capacity = capacity;
+        // The totals moved; point the partitions at their new home
+        for (int i = 0; i < set->count; i++)
+            set->parts[i]->totals = &set->report->processes[i];
+    }
+    Partition *p = part_create(set->spec, pid);
+    if (!p || pagemap_put(&set->index, (uint64_t)(unsigned)pid, set->count) != 0) {
+        if (p)
+            part_free(p);
+        return NULL;
+    }
+    p->totals = &set->report->processes[set->count];
+    memset(p->totals, 0, sizeof(*p->totals));
+    p->totals->pid = pid;
+    set->parts[set->count++] = p;
+    set->report->process_count = set->count;
+    return p;
+}
+
+static int part_enqueue(Partition *p, const PageReference *ref) {
+    if (p->queued == p->queue_capacity) {
+        size_t capacity = p->queue_capacity ? p->queue_capacity * 2 : 1024;
+        PageReference *queue = realloc(p->queue, capacity * sizeof(PageReference));
+        if (!queue)
+            return -1;
+        p->queue = queue;
+        p->queue_capacity = capacity;
+    }
+    p->queue[p->queued++] = *ref;
+    return 0;
+}
+
+// ---- Allocation ----
+
+// Slides the working-set window over the references just run
+static void window_advance(Partition *p, long long tau, const PageReference *refs, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        uint64_t key = page_key(refs[i].pid, refs[i].page_num);
+        if (p->window_len == tau) {
+            uint64_t old = p->window[p->window_head];
+            int *n = pagemap_lookup(&p->window_counts, old);
+            if (n && --*n == 0)
+                pagemap_remove(&p->window_counts, old);
+            p->window[p->window_head] = key;
+            p->window_head = (p->window_head + 1) % tau;
+        } else {
+            p->window[p->window_len++] = key;
+        }
+        int *n = pagemap_lookup(&p->window_counts, key);
+        if (n)
+            ++*n;
+        else
+            pagemap_put(&p->window_counts, key, 1);
+    }
+}
+
+// Frames each live process would like next epoch, before memory is checked
+static void compute_demand(PartitionSet *set, int live) {
+    const PartitionSpec *spec = set->spec;
+    int share = spec->frames / (live > 0 ? live : 1), extra = spec->frames % (live > 0 ? live : 1);
+    for (int i = 0, n = 0; i < set->count; i++) {
+        Partition *p = set->parts[i];
+        if (p->demand < 0)
+            continue; // Finished
+        int fair = share + (n++ < extra);
+        if (fair < 1)
+            fair = 1;
+        if (spec->allocator == PARTITION_FIXED || p->time == 0) {
+            p->demand = fair;
+        } else if (spec->allocator == PARTITION_WORKING_SET) {
+            p->demand = (int)(p->window_counts.count > 0 ? p->window_counts.count : 1);
+        } else if (!p->suspended && p->epoch_accesses > 0) {
+            double rate = (double)p->epoch_faults / (double)p->epoch_accesses;
+            if (rate > spec->pff_high)
+                p->demand += p->demand / 4 > 1 ? p->demand / 4 : 1;
+            else if (rate < spec->pff_low && p->demand > 1)
+                p->demand -= p->demand / 8 > 1 ? p->demand / 8 : 1;
+        }
+        if (p->demand > spec->frames)
+            p->demand = spec->frames;
+    }
+}
+
+// Empties p's frames and takes it out of the running; what it had
+// resident is evicted, so it faults it back in when resumed
+static int suspend(PartitionSet *set, Partition *p) {
+    if (simulator_resize_memory(p->sim, 1, 0) != 0)
+        return -1;
+    p->suspended = 1;
+    p->allocation = 0;
+    p->suspended_at = set->suspensions++;
+    p->totals->suspensions++;
+    return 0;
+}
+
+static int backlogged(const PartitionSet *set, const Partition *p) {
+    return (long long)p->queued >= PARTITION_BACKLOG_EPOCHS * set->spec->epoch;
+}
+
+// The suspended process that has waited longest, of the backlogged ones
+// only if only_backlogged is set
+static Partition *longest_waiting(PartitionSet *set, int only_backlogged) {
+    Partition *next = NULL;
+    for (int i = 0; i < set->count; i++) {
+        Partition *p = set->parts[i];
+        if (p->demand >= 0 && p->suspended && (!only_backlogged || backlogged(set, p)) &&
+            (!next || p->suspended_at < next->suspended_at))
+            next = p;
+    }
+    return next;
+}
+
+// Gives every running process its frames for the next epoch, at least one
+// each and no more than memory in all. When their demand exceeds memory the
+// epoch counts as thrashing; with load control the process asking for most
+// is suspended until the rest fit, otherwise everyone is scaled down to fit.
+// Either way processes are suspended while there are more than frames.
+// Suspended processes come back, longest waiting first, once their demand
+// fits beside the others'; one whose backlog has reached
+// PARTITION_BACKLOG_EPOCHS comes back first whatever it asks for.
+static int allocate(PartitionSet *set, int live) {
+    const PartitionSpec *spec = set->spec;
+    compute_demand(set, live);
+    long long total = 0;
+    int running = 0;
+    for (int i = 0; i < set->count; i++) {
+        Partition *p = set->parts[i];
+        if (p->demand >= 0 && !p->suspended) {
+            total += p->demand;
+            running++;
+        }
+    }
+    if (total > spec->frames)
+        set->report->thrashing_epochs++;
+
+    // A running process's queue empties every epoch, so only these are backlogged
+    Partition *next;
+    for (int forced = 0; forced < spec->frames && (next = longest_waiting(set, 1)); forced++) {
+        next->suspended = 0;
+        total += next->demand;
+        running++;
+    }
+    while ((spec->load_control && total > spec->frames && running > 1) || running > spec->frames) {
+        Partition *largest = NULL;
+        for (int i = 0; i < set->count; i++) {
+            Partition *p = set->parts[i];
+            if (p->demand >= 0 && !p->suspended && !backlogged(set, p) && (!largest || p->demand > largest->demand))
+                largest = p;
+        }
+        if (!largest)
+            break;
+        if (suspend(set, largest) != 0)
+            return -1;
+        total -= largest->demand;
+        running--;
+    }
+    while ((next = longest_waiting(set, 0)) && running < spec->frames &&
+           (running == 0 || total + next->demand <= spec->frames)) {
+        next->suspended = 0;
+        total += next->demand;
+        running++;
+    }
+
+    for (int i = 0; i < set->count; i++) {
+        Partition *p = set->parts[i];
+        if (p->demand < 0 || p->suspended)
+            continue;
+        // Past memory, each keeps its one frame and shares out the rest in
+        // proportion to what it asked for beyond that
+        int frames = p->demand;
+        if (total > spec->frames)
+            frames = 1 + (int)((long long)(p->demand - 1) * (spec->frames - running) / (total - running));
+        if (frames != p->sim->memory.frame_count && simulator_resize_memory(p->sim, frames, frames) != 0)
+            return -1;
+        p->allocation = frames;
+    }
+    return 0;
+}
+
+// ---- Epochs ----
+
+typedef struct {
+    Partition *part;
+    long long ws_window;
+} PartitionTask;
+
+static void run_task(void *arg) {
+    PartitionTask *task = arg;
+    Partition *p = task->part;
+    long long hits = p->sim->hits, faults = p->sim->faults;
+    for (size_t done = 0; done < p->queued;) {
+        int count = p->queued - done < SIM_BATCH_SIZE ? (int)(p->queued - done) : SIM_BATCH_SIZE;
+        if (simulator_step(p->sim, p->queue + done, count, p->time) != 0) {
+            p->failed = 1;
+            break;
+        }
+        if (p->window)
+            window_advance(p, task->ws_window, p->queue + done, (size_t)count);
+        p->time += count;
+        done += (size_t)count;
+    }
+    p->epoch_accesses = p->sim->hits + p->sim->faults - hits - faults;
+    p->epoch_faults = p->sim->faults - faults;
+    p->queued = 0;
+}
+
+static int record_sample(PartitionReport *report, const Partition *p) {
+    if (report->sample_count == report->sample_capacity) {
+        size_t capacity = report->sample_capacity ? report->sample_capacity * 2 : 256;
+        PartitionSample *samples = realloc(report->samples, capacity * sizeof(PartitionSample));
+        if (!samples)
+            return -1;
+        report->samples = samples;
+        report->sample_capacity = capacity;
+    }
+    report->samples[report->sample_count++] = (PartitionSample){
+        report->epochs, p->pid, p->epoch_accesses, p->epoch_faults, p->allocation, p->demand,
+        p->suspended ? 0 : p->sim->memory.used, p->suspended
+    };
+    return 0;
+}
+
+// Runs one epoch of every running partition, one task each
+static int run_epoch(PartitionSet *set, ThreadPool *pool, PartitionTask *tasks) {
+    int status = 0;
+    for (int i = 0; i < set->count; i++) {
+        Partition *p = set->parts[i];
+        p->epoch_accesses = p->epoch_faults = 0;
+        if (p->demand < 0 || p->suspended || p->queued == 0)
+            continue;
+        tasks[i] = (PartitionTask){p, set->spec->ws_window};
+        if (status == 0)
+            status = threadpool_submit(pool, run_task, &tasks[i]);
+    }
+    threadpool_wait(pool);
+    for (int i = 0; i < set->count && status == 0; i++) {
+        Partition *p = set->parts[i];
+        if (p->failed)
+            status = -1;
+        if (p->demand < 0 || status != 0)
+            continue;
+        if (p->suspended)
+            p->totals->suspended_epochs++;
+        else if (p->sim->memory.used > p->totals->peak_resident)
+            p->totals->peak_resident = p->sim->memory.used;
+        status = record_sample(set->report, p);
+    }
+    set->report->epochs++;
+    return status;
+}
+
+static void collect_totals(PartitionSet *set) {
+    for (int i = 0; i < set->count; i++) {
+        Partition *p = set->parts[i];
+        simulator_end_run(p->sim);
+        p->totals->hits = p->sim->hits;
+        p->totals->faults = p->sim->faults;
+        p->totals->accesses = p->sim->hits + p->sim->faults;
+        p->totals->evictions = p->sim->evictions;
+    }
+}
+
+// Simulates src with every process in a partition of its own, spec->epoch
+// references of the stream at a time. Returns -1 on a bad spec, a policy
+// that needs the future, or if memory runs out.
+int partition_run_source(RefSource *src, const PartitionSpec *spec, PartitionReport *report) {
+    memset(report, 0, sizeof(*report));
+    const ReplacementPolicy *policy = policy_find(spec->algorithm);
+    if (spec->frames <= 0 || spec->epoch <= 0 || spec->epoch > 1 << 30 || !policy || policy->needs_future ||
+        (spec->allocator == PARTITION_WORKING_SET && spec->ws_window <= 0) || spec->pff_low > spec->pff_high)
+        return -1;
+
+    PartitionSet set = {spec, report, NULL, 0, 0, {0}, 0};
+    PageReference *batch = malloc((size_t)spec->epoch * sizeof(PageReference));
+    ThreadPool *pool = batch ? threadpool_create(spec->threads) : NULL;
+    PartitionTask *tasks = NULL;
+    if (!pool || pagemap_init(&set.index, 16) != 0) {
+        free(batch);
+        threadpool_destroy(pool);
+        return -1;
+    }
+    double start = timing_wall_seconds();
+    int status = 0, eof = 0;
+    while (status == 0) {
+        size_t n = 0, got = 0;
+        while (!eof && n < (size_t)spec->epoch) {
+            got = src->read(src, batch + n, (size_t)spec->epoch - n);
+            eof = got == 0;
+            n += got;
+        }
+        for (size_t i = 0; i < n && status == 0; i++) {
+            Partition *p = set_partition(&set, batch[i].pid);
+            status = p ? part_enqueue(p, &batch[i]) : -1;
+        }
+        report->accesses += (long long)n;
+
+        // Once the stream is over, a process with nothing left to run is
+        // done and gives its frames back
+        int live = 0, pending = 0;
+        for (int i = 0; i < set.count; i++) {
+            Partition *p = set.parts[i];
+            if (eof && p->queued == 0)
+                p->demand = -1;
+            live += p->demand >= 0;
+            pending += p->demand >= 0 && p->queued > 0;
+        }
+        if (status != 0 || pending == 0)
+            break;
+        PartitionTask *grown = realloc(tasks, (size_t)set.count * sizeof(PartitionTask));
+        if (!grown) {
+            status = -1;
+            break;
+        }
+        tasks = grown;
+        status = allocate(&set, live);
+        if (status == 0)
+            status = run_epoch(&set, pool, tasks);
+    }
+    threadpool_destroy(pool);
+    collect_totals(&set);
+    report->wall_seconds = timing_wall_seconds() - start;
+    free(tasks);
+    free(batch);
+    set_free(&set);
+    if (status != 0)
+        partition_report_free(report);
+    return status;
+}
+
+typedef struct {
+    RefSource source;
+    const PageReference *refs;
+    size_t len;
+    size_t next;
+} ArraySource;
+
+static size_t array_read(RefSource *src, PageReference *out, size_t max) {
+    ArraySource *a = (ArraySource *)src;
+    size_t n = a->len - a->next < max ? a->len - a->next : max;
+    memcpy(out, a->refs + a->next, n * sizeof(PageReference));
+    a->next += n;
+    return n;
+}
+
+// Like partition_run_source() over an array of references
+int partition_run_references(const PageReference *refs, int len, const PartitionSpec *spec,
+                             PartitionReport *report) {
+    if (len < 0)
+        return -1;
+    ArraySource src = {{array_read}, refs, (size_t)len, 0};
+    return partition_run_source(&src.source, spec, report);
+}
+
+void partition_report_free(PartitionReport *report) {
+    free(report->processes);
+    free(report->samples);
+    report->processes = NULL;
+    report->samples = NULL;
+    report->process_count = 0;
+    report->sample_count = report->sample_capacity = 0;
+}
+
+// Formats one line of the per-process table: row -1 is the header, then
+// one row per process in order of first reference
+size_t partition_format_line(const PartitionReport *report, int row, char *buf, size_t size) {
+    int len;
+    if (row < 0) {
+        len = snprintf(buf, size, "%-8s %12s %12s %12s %10s %10s %11s %11s\n", "PID", "Accesses", "Faults",
+                       "Evictions", "Fault Rate", "Peak RSS", "Suspensions", "Susp Epochs");
+    } else {
+        const PartitionTotals *t = &report->processes[row];
+        double rate = t->accesses > 0 ? 100.0 * (double)t->faults / (double)t->accesses : 0.0;
+        len = snprintf(buf, size, "%-8d %12lld %12lld %12lld %9.2f%% %10d %11lld %11lld\n", t->pid, t->accesses,
+                       t->faults, t->evictions, rate, t->peak_resident, t->suspensions, t->suspended_epochs);
+    }
+    if (len < 0)
+        return 0;
+    return (size_t)len < size ? (size_t)len : size - 1;
+}
+
+// Every process's fault rate and resident set, epoch by epoch
+int partition_write_csv(const PartitionReport *report, FILE *out) {
+    fprintf(out, "epoch,pid,accesses,faults,fault_rate,allocation,demand,resident,suspended\n");
+    for (size_t i = 0; i < report->sample_count; i++) {
+        const PartitionSample *s = &report->samples[i];
+        fprintf(out, "%lld,%d,%lld,%lld,%.6f,%d,%d,%d,%d\n", s->epoch, s->pid, s->accesses, s->faults,
+                s->accesses > 0 ? (double)s->faults / (double)s->accesses : 0.0, s->allocation, s->demand,
+                s->resident, s->suspended);
+    }
+    return ferror(out) ? -1 : 0;
+}
+
+const char *partition_allocator_name(PartitionAllocator allocator) {
+    return allocator >= PARTITION_FIXED && allocator <= PARTITION_PFF ? allocator_names[allocator] : "?";
+}
+
+int partition_allocator_parse(const char *name, PartitionAllocator *out) {
+    for (int a = PARTITION_FIXED; a <= PARTITION_PFF; a++) {
+        if (strcmp(name, allocator_names[a]) == 0) {
+            *out = (PartitionAllocator)a;
+            return 0;
+        }
+    }
+    return -1;
+}
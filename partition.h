@@ -0,0 +1,84 @@
+#ifndef PARTITION_H
+#define PARTITION_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include "simulator.h"
+
+// Per-process frame partitions with local replacement. Every process gets
+// a Simulator of its own, so it only ever evicts its own pages. The run
+// goes in epochs: between epochs an allocator resizes the partitions out
+// of the shared frames, and within one every partition with references
+// to simulate runs as its own task on a thread pool.
+
+typedef enum {
+    PARTITION_FIXED,       // An equal share for every live process
+    PARTITION_WORKING_SET, // Pages the process used in its last ws_window references
+    PARTITION_PFF          // Grown or shrunk by the process's fault rate in the last epoch
+} PartitionAllocator;
+
+#define PARTITION_DEFAULT_EPOCH 10000
+#define PARTITION_DEFAULT_WS_WINDOW 10000
+#define PARTITION_DEFAULT_PFF_LOW 0.01
+#define PARTITION_DEFAULT_PFF_HIGH 0.05
+
+typedef struct {
+    int frames;                   // Shared by all partitions
+    const char *algorithm;        // Local replacement policy, registry name
+    PartitionAllocator allocator;
+    long long epoch;              // References of the whole stream per epoch
+    long long ws_window;          // PARTITION_WORKING_SET tau, in the process's own references
+    double pff_low;               // PARTITION_PFF shrinks below this fault rate...
+    double pff_high;              // ...and grows above this one
+    int load_control;             // Suspend processes instead of overcommitting memory
+    int threads;                  // 0: one per online CPU
+} PartitionSpec;
+
+// One process in one epoch
+typedef struct {
+    long long epoch;
+    int pid;
+    long long accesses;
+    long long faults;
+    int allocation; // Frames it was given
+    int demand;     // Frames the allocator wanted for it
+    int resident;   // Frames in use at the end of the epoch
+    int suspended;
+} PartitionSample;
+
+typedef struct {
+    int pid;
+    long long accesses;
+    long long hits;
+    long long faults;
+    long long evictions;
+    int peak_resident;
+    long long suspensions;
+    long long suspended_epochs;
+} PartitionTotals;
+
+typedef struct {
+    PartitionTotals *processes; // In order of first reference
+    int process_count;
+    PartitionSample *samples;   // Epoch by epoch, each in process order
+    size_t sample_count;
+    size_t sample_capacity;
+    long long epochs;
+    long long thrashing_epochs; // Demand exceeded memory
+    long long accesses;
+    double wall_seconds;
+} PartitionReport;
+
+#define PARTITION_LINE_MAX 128 // Enough for any line of the formatted table
+
+void partition_spec_defaults(PartitionSpec *spec, int frames, const char *algorithm);
+int partition_run_source(RefSource *src, const PartitionSpec *spec, PartitionReport *report);
+int partition_run_references(const PageReference *refs, int len, const PartitionSpec *spec,
+                             PartitionReport *report);
+void partition_report_free(PartitionReport *report);
+size_t partition_format_line(const PartitionReport *report, int row, char *buf, size_t size);
+int partition_write_csv(const PartitionReport *report, FILE *out);
+const char *partition_allocator_name(PartitionAllocator allocator);
+int partition_allocator_parse(const char *name, PartitionAllocator *out);
+
+#endif
@@ -0,0 +1,178 @@
+#include "pipeline.h"
+#include <pthread.h>
+#include <string.h>
+#include "spsc.h"
+#include "threadpool.h"
+#include "timing.h"
+
+// Spinning only pays when every stage has a core to spin on
+void pipeline_config_defaults(PipelineConfig *config) {
+    config->ref_slots = PIPELINE_DEFAULT_SLOTS;
+    config->event_slots = PIPELINE_DEFAULT_SLOTS;
+    config->spin = threadpool_cpu_count() >= 3 ? PIPELINE_DEFAULT_SPIN : 0;
+    config->backpressure = PIPELINE_BLOCK;
+}
+
+// ---- Decoder: inner source -> reference ring ----
+
+// The simulator's side is a RefSource over the ring, so the ordinary
+// streaming loop (and the Optimal collection pass) run unchanged
+typedef struct {
+    RefSource source; // Must stay first: simulator_run_source() takes &source
+    RefSource *inner;
+    SpscRing ring;
+    const PageReference *current; // Slot being read, NULL between slots
+    size_t current_count;
+    size_t offset;
+    double busy_seconds;
+    pthread_t thread;
+} Decoder;
+
+static void *decoder_main(void *arg) {
+    Decoder *d = arg;
+    PageReference *slot;
+    while ((slot = spsc_ring_begin_write(&d->ring)) != NULL) {
+        size_t n = d->inner->read(d->inner, slot, SIM_BATCH_SIZE);
+        if (n == 0)
+            break;
+        spsc_ring_commit_write(&d->ring, n);
+    }
+    d->busy_seconds = timing_cpu_seconds();
+    spsc_ring_close(&d->ring);
+    return NULL;
+}
+
+// Copies out the rest of the current slot, or of the next one
+static size_t decoder_read(RefSource *src, PageReference *out, size_t max) {
+    Decoder *d = (Decoder *)src;
+    if (!d->current) {
+        d->current = spsc_ring_begin_read(&d->ring, &d->current_count);
+        d->offset = 0;
+        if (!d->current)
+            return 0;
+    }
+    size_t n = d->current_count - d->offset < max ? d->current_count - d->offset : max;
+    memcpy(out, d->current + d->offset, n * sizeof(PageReference));
+    d->offset += n;
+    if (d->offset == d->current_count) {
+        spsc_ring_end_read(&d->ring);
+        d->current = NULL;
+    }
+    return n;
+}
+
+// ---- Reporter: event ring -> caller's sink ----
+
+typedef struct {
+    SpscRing ring;
+    SimEventSink sink;
+    void *sink_data;
+    PipelineBackpressure backpressure;
+    unsigned long long dropped;
+    double busy_seconds;
+    pthread_t thread;
+} Reporter;
+
+static void *reporter_main(void *arg) {
+    Reporter *r = arg;
+    const SimEvent *events;
+    size_t count;
+    while ((events = spsc_ring_begin_read(&r->ring, &count)) != NULL) {
+        r->sink(events, count, r->sink_data);
+        spsc_ring_end_read(&r->ring);
+    }
+    r->busy_seconds = timing_cpu_seconds();
+    return NULL;
+}
+
+// The simulator's event sink: copies each flush into reporter slots
+static void report_events(const SimEvent *events, size_t count, void *user_data) {
+    Reporter *r = user_data;
+    while (count > 0) {
+        size_t n = count < PIPELINE_EVENT_BATCH ? count : PIPELINE_EVENT_BATCH;
+        SimEvent *slot = r->backpressure == PIPELINE_DROP ? spsc_ring_try_write(&r->ring)
+                                                          : spsc_ring_begin_write(&r->ring);
+        if (slot) {
+            memcpy(slot, events, n * sizeof(SimEvent));
+            spsc_ring_commit_write(&r->ring, n);
+        } else {
+            r->dropped += n;
+        }
+        events += n;
+        count -= n;
+    }
+}
+
+// Runs sim over src like simulator_run_source(), with decoding and the
+// event sink on threads of their own; the reporter only starts when there
+// is a sink and events to give it. The simulation, and so the progress
+// callback and hardware counters, stay on the calling thread, where the
+// GENERATE and FORMAT phases become the time spent waiting on the other
+// stages. Returns what simulator_run_source() would, or -1 if the rings or
+// threads cannot be set up. stats may be NULL.
+int simulator_run_pipelined(Simulator *sim, RefSource *src, const PipelineConfig *config, PipelineStats *stats) {
+    PipelineConfig defaults;
+    if (stats)
+        memset(stats, 0, sizeof(*stats));
+    if (!config) {
+        pipeline_config_defaults(&defaults);
+        config = &defaults;
+    }
+    Decoder d;
+    memset(&d, 0, sizeof(d));
+    d.source.read = decoder_read;
+    d.inner = src;
+    if (spsc_ring_init(&d.ring, (size_t)(config->ref_slots > 0 ? config->ref_slots : 1),
+                       SIM_BATCH_SIZE * sizeof(PageReference), config->spin) != 0)
+        return -1;
+
+    Reporter r;
+    memset(&r, 0, sizeof(r));
+    r.sink = sim->sink;
+    r.sink_data = sim->sink_data;
+    r.backpressure = config->backpressure;
+    int reporting = sim->sink && sim->verbosity >= SIM_VERBOSITY_FAULTS;
+    if (reporting && spsc_ring_init(&r.ring, (size_t)(config->event_slots > 0 ? config->event_slots : 1),
+                                    PIPELINE_EVENT_BATCH * sizeof(SimEvent), config->spin) != 0) {
+        spsc_ring_free(&d.ring);
+        return -1;
+    }
+
+    int status = -1;
+    if (pthread_create(&d.thread, NULL, decoder_main, &d) != 0)
+        goto free_rings;
+    if (reporting && pthread_create(&r.thread, NULL, reporter_main, &r) != 0) {
+        spsc_ring_close(&d.ring);
+        pthread_join(d.thread, NULL);
+        goto free_rings;
+    }
+
+    if (reporting)
+        simulator_set_event_sink(sim, report_events, &r);
+    status = simulator_run_source(sim, &d.source);
+
+    // A run cut short leaves the decoder waiting for room; closing frees it
+    spsc_ring_close(&d.ring);
+    pthread_join(d.thread, NULL);
+    if (reporting) {
+        spsc_ring_close(&r.ring);
+        pthread_join(r.thread, NULL);
+        simulator_set_event_sink(sim, r.sink, r.sink_data);
+        sim->events.dropped += r.dropped;
+    }
+
+    if (stats) {
+        stats->decode_seconds = d.busy_seconds;
+        stats->report_seconds = r.busy_seconds;
+        stats->decoder_stalls = d.ring.full_waits;
+        stats->input_stalls = d.ring.empty_waits;
+        stats->output_stalls = r.ring.full_waits;
+        stats->events_dropped = r.dropped;
+    }
+
+free_rings:
+    spsc_ring_free(&d.ring);
+    if (reporting)
+        spsc_ring_free(&r.ring);
+    return status;
+}
@@ -0,0 +1,41 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "simulator.h"
+
+// Pipelined runs: a decoder thread reads the RefSource into batches, the
+// calling thread simulates them, and a reporter thread hands the events to
+// the sink, each pair of stages joined by an SPSC ring. With every stage on
+// its own core a run takes about as long as its slowest stage alone.
+
+#define PIPELINE_DEFAULT_SLOTS 8   // Batches in flight between two stages
+#define PIPELINE_DEFAULT_SPIN 2000 // Polls before a stalled stage sleeps
+#define PIPELINE_EVENT_BATCH 4096  // Events per reporter slot
+
+typedef enum {
+    PIPELINE_BLOCK, // The simulator waits for the reporter; no event is lost
+    PIPELINE_DROP   // The simulator drops events the reporter has no room for
+} PipelineBackpressure;
+
+typedef struct {
+    int ref_slots;   // Reference batches the decoder may run ahead
+    int event_slots; // Event batches the simulator may run ahead
+    int spin;        // 0 sleeps at once, which suits fewer cores than stages
+    PipelineBackpressure backpressure;
+} PipelineConfig;
+
+// Per-stage figures of one run. Busy time is CPU time of the stage's own
+// thread; a stall is one wait on a full or empty ring.
+typedef struct {
+    double decode_seconds;
+    double report_seconds;
+    unsigned long long decoder_stalls; // Simulator behind: no free reference slot
+    unsigned long long input_stalls;   // Decoder behind: no references ready
+    unsigned long long output_stalls;  // Reporter behind: no free event slot
+    unsigned long long events_dropped; // Under PIPELINE_DROP
+} PipelineStats;
+
+void pipeline_config_defaults(PipelineConfig *config);
+int simulator_run_pipelined(Simulator *sim, RefSource *src, const PipelineConfig *config, PipelineStats *stats);
+
+#endif
@@ -0,0 +1,514 @@
+#include "policy.h"
+#include "checkpoint.h"
+#include "framelist.h"
+#include <stdlib.h>
+#include <string.h>
+
+// FIFO and LRU share one state: a list of frames, most recent at the head.
+// FIFO orders by load, LRU also moves a frame to the head on every hit.
+typedef struct {
+    FrameList list;
+    int *prev;
+    int *next;
+    int frame_count;
+} ListState;
+
+static void *list_create(int frame_count) {
+    ListState *s = calloc(1, sizeof(ListState));
+    if (!s)
+        return NULL;
+    s->prev = malloc((size_t)frame_count * sizeof(int));
+    s->next = malloc((size_t)frame_count * sizeof(int));
+    if (!s->prev || !s->next) {
+        free(s->prev);
+        free(s->next);
+        free(s);
+        return NULL;
+    }
+    framelist_init(&s->list);
+    s->frame_count = frame_count;
+    return s;
+}
+
+static void list_destroy(void *state) {
+    ListState *s = state;
+    free(s->prev);
+    free(s->next);
+    free(s);
+}
+
+static int list_reset(void *state, const struct PageReference *refs, int len) {
+    (void)refs;
+    (void)len;
+    framelist_init(&((ListState *)state)->list);
+    return 0;
+}
+
+static void list_on_miss(void *state, int frame, const PolicyAccess *access) {
+    ListState *s = state;
+    (void)access;
+    framelist_push_head(&s->list, s->prev, s->next, frame);
+}
+
+static int list_choose_victim(void *state, const PolicyAccess *access) {
+    ListState *s = state;
+    int victim = framelist_oldest_except(&s->list, s->prev, access->pinned);
+    framelist_remove(&s->list, s->prev, s->next, victim);
+    return victim;
+}
+
+static int list_save_links(const ListState *s, FILE *out) {
+    size_t links = (size_t)s->frame_count * sizeof(int);
+    if (checkpoint_write(out, &s->list, sizeof(s->list)) != 0 || checkpoint_write(out, s->prev, links) != 0 ||
+        checkpoint_write(out, s->next, links) != 0)
+        return -1;
+    return 0;
+}
+
+// The list must hold exactly the resident frames
+static int list_load_links(ListState *s, const unsigned char *resident, FILE *in) {
+    size_t links = (size_t)s->frame_count * sizeof(int);
+    if (checkpoint_read(in, &s->list, sizeof(s->list)) != 0 || checkpoint_read(in, s->prev, links) != 0 ||
+        checkpoint_read(in, s->next, links) != 0)
+        return -1;
+    unsigned char *listed = calloc((size_t)s->frame_count, 1);
+    int status = listed ? framelist_check(&s->list, s->prev, s->next, s->frame_count, listed, 1) : -1;
+    for (int f = 0; status == 0 && f < s->frame_count; f++) {
+        if (listed[f] != (resident[f] != 0))
+            status = -1;
+    }
+    free(listed);
+    return status;
+}
+
+static int list_save(const void *state, FILE *out) {
+    return list_save_links(state, out);
+}
+
+static int list_load(void *state, FILE *in, const unsigned char *resident) {
+    return list_load_links(state, resident, in);
+}
+
+static void fifo_on_hit(void *state, int frame, const PolicyAccess *access) {
+    (void)state;
+    (void)frame;
+    (void)access;
+}
+
+static void lru_on_hit(void *state, int frame, const PolicyAccess *access) {
+    ListState *s = state;
+    (void)access;
+    framelist_remove(&s->list, s->prev, s->next, frame);
+    framelist_push_head(&s->list, s->prev, s->next, frame);
+}
+
+static const ReplacementPolicy policy_fifo = {
+    "fifo", list_create, list_destroy, list_reset, fifo_on_hit, list_on_miss, list_choose_victim,
+    list_save, list_load, 0
+};
+
+static const ReplacementPolicy policy_lru = {
+    "lru", list_create, list_destroy, list_reset, lru_on_hit, list_on_miss, list_choose_victim,
+    list_save, list_load, 0
+};
+
+// CLOCK: a hand sweeps frame numbers in order, clearing reference bits until
+// it finds a frame that was not referenced since the last sweep
+typedef struct {
+    unsigned char *referenced;
+    int frame_count;
+    int hand;
+} ClockState;
+
+static void *clock_create(int frame_count) {
+    ClockState *s = calloc(1, sizeof(ClockState));
+    if (!s)
+        return NULL;
+    s->referenced = calloc((size_t)frame_count, 1);
+    if (!s->referenced) {
+        free(s);
+        return NULL;
+    }
+    s->frame_count = frame_count;
+    return s;
+}
+
+static void clock_destroy(void *state) {
+    ClockState *s = state;
+    free(s->referenced);
+    free(s);
+}
+
+static int clock_reset(void *state, const struct PageReference *refs, int len) {
+    ClockState *s = state;
+    (void)refs;
+    (void)len;
+    memset(s->referenced, 0, (size_t)s->frame_count);
+    s->hand = 0;
+    return 0;
+}
+
+static void clock_on_access(void *state, int frame, const PolicyAccess *access) {
+    (void)access;
+    ((ClockState *)state)->referenced[frame] = 1;
+}
+
+// Only called with every frame resident, so the sweep always terminates
+static int clock_choose_victim(void *state, const PolicyAccess *access) {
+    ClockState *s = state;
+    // A pinned frame is passed over as if referenced
+    while (s->referenced[s->hand] || s->hand == access->pinned) {
+        s->referenced[s->hand] = 0;
+        s->hand = (s->hand + 1) % s->frame_count;
+    }
+    int victim = s->hand;
+    s->hand = (s->hand + 1) % s->frame_count;
+    return victim;
+}
+
+static int clock_save(const void *state, FILE *out) {
+    const ClockState *s = state;
+    if (checkpoint_write(out, s->referenced, (size_t)s->frame_count) != 0 ||
+        checkpoint_write(out, &s->hand, sizeof(s->hand)) != 0)
+        return -1;
+    return 0;
+}
+
+static int clock_load(void *state, FILE *in, const unsigned char *resident) {
+    ClockState *s = state;
+    (void)resident;
+    if (checkpoint_read(in, s->referenced, (size_t)s->frame_count) != 0 ||
+        checkpoint_read(in, &s->hand, sizeof(s->hand)) != 0 || s->hand < 0 || s->hand >= s->frame_count)
+        return -1;
+    return 0;
+}
+
+static const ReplacementPolicy policy_clock = {
+    "clock", clock_create, clock_destroy, clock_reset, clock_on_access, clock_on_access, clock_choose_victim,
+    clock_save, clock_load, 0
+};
+
+// Second-Chance: FIFO queue in load order; a referenced page at the tail is
+// moved back to the head with its bit cleared instead of being evicted
+typedef struct {
+    ListState queue;
+    unsigned char *referenced;
+} SecondChanceState;
+
+static void *second_chance_create(int frame_count) {
+    SecondChanceState *s = calloc(1, sizeof(SecondChanceState));
+    if (!s)
+        return NULL;
+    s->queue.prev = malloc((size_t)frame_count * sizeof(int));
+    s->queue.next = malloc((size_t)frame_count * sizeof(int));
+    s->referenced = calloc((size_t)frame_count, 1);
+    if (!s->queue.prev || !s->queue.next || !s->referenced) {
+        free(s->queue.prev);
+        free(s->queue.next);
+        free(s->referenced);
+        free(s);
+        return NULL;
+    }
+    framelist_init(&s->queue.list);
+    s->queue.frame_count = frame_count;
+    return s;
+}
+
+static void second_chance_destroy(void *state) {
+    SecondChanceState *s = state;
+    free(s->queue.prev);
+    free(s->queue.next);
+    free(s->referenced);
+    free(s);
+}
+
+static int second_chance_reset(void *state, const struct PageReference *refs, int len) {
+    (void)refs;
+    (void)len;
+    framelist_init(&((SecondChanceState *)state)->queue.list);
+    return 0;
+}
+
+static void second_chance_on_hit(void *state, int frame, const PolicyAccess *access) {
+    (void)access;
+    ((SecondChanceState *)state)->referenced[frame] = 1;
+}
+
+static void second_chance_on_miss(void *state, int frame, const PolicyAccess *access) {
+    SecondChanceState *s = state;
+    (void)access;
+    s->referenced[frame] = 1;
+    framelist_push_head(&s->queue.list, s->queue.prev, s->queue.next, frame);
+}
+
+static int second_chance_choose_victim(void *state, const PolicyAccess *access) {
+    SecondChanceState *s = state;
+    ListState *q = &s->queue;
+    for (;;) {
+        int oldest = framelist_pop_tail(&q->list, q->prev, q->next);
+        if (!s->referenced[oldest] && oldest != access->pinned)
+            return oldest;
+        s->referenced[oldest] = 0;
+        framelist_push_head(&q->list, q->prev, q->next, oldest);
+    }
+}
+
+static int second_chance_save(const void *state, FILE *out) {
+    const SecondChanceState *s = state;
+    if (list_save_links(&s->queue, out) != 0 ||
+        checkpoint_write(out, s->referenced, (size_t)s->queue.frame_count) != 0)
+        return -1;
+    return 0;
+}
+
+static int second_chance_load(void *state, FILE *in, const unsigned char *resident) {
+    SecondChanceState *s = state;
+    if (list_load_links(&s->queue, resident, in) != 0 ||
+        checkpoint_read(in, s->referenced, (size_t)s->queue.frame_count) != 0)
+        return -1;
+    return 0;
+}
+
+static const ReplacementPolicy policy_second_chance = {
+    "second-chance", second_chance_create, second_chance_destroy, second_chance_reset,
+    second_chance_on_hit, second_chance_on_miss, second_chance_choose_victim, second_chance_save,
+    second_chance_load, 0
+};
+
+// LFU with O(1) frequency buckets: buckets hold one count each and are
+// linked in ascending count order; every frame sits in the bucket for its
+// count. Ties inside a bucket go to the least recently used frame.
+typedef struct {
+    int *frame_bucket;   // Bucket each resident frame belongs to
+    int *frame_prev;     // Links of frames within their bucket
+    int *frame_next;
+    long long *count;    // Per bucket: access count it stands for
+    FrameList *members;  // Per bucket: its frames, most recent at head
+    int *bucket_prev;    // Links of buckets in ascending count order
+    int *bucket_next;
+    int *free_buckets;
+    int free_count;
+    int lowest;          // Bucket with the smallest count, -1 if none
+    int bucket_count;
+} LfuState;
+
+static void lfu_destroy(void *state) {
+    LfuState *s = state;
+    free(s->frame_bucket);
+    free(s->frame_prev);
+    free(s->frame_next);
+    free(s->count);
+    free(s->members);
+    free(s->bucket_prev);
+    free(s->bucket_next);
+    free(s->free_buckets);
+    free(s);
+}
+
+static void *lfu_create(int frame_count) {
+    LfuState *s = calloc(1, sizeof(LfuState));
+    if (!s)
+        return NULL;
+    // At most one bucket per frame, plus one while a frame moves up
+    int buckets = frame_count + 1;
+    s->bucket_count = buckets;
+    s->frame_bucket = malloc((size_t)frame_count * sizeof(int));
+    s->frame_prev = malloc((size_t)frame_count * sizeof(int));
+    s->frame_next = malloc((size_t)frame_count * sizeof(int));
+    s->count = malloc((size_t)buckets * sizeof(long long));
+    s->members = malloc((size_t)buckets * sizeof(FrameList));
+    s->bucket_prev = malloc((size_t)buckets * sizeof(int));
+    s->bucket_next = malloc((size_t)buckets * sizeof(int));
+    s->free_buckets = malloc((size_t)buckets * sizeof(int));
+    if (!s->frame_bucket || !s->frame_prev || !s->frame_next || !s->count || !s->members ||
+        !s->bucket_prev || !s->bucket_next || !s->free_buckets) {
+        lfu_destroy(s);
+        return NULL;
+    }
+    return s;
+}
+
+static int lfu_reset(void *state, const struct PageReference *refs, int len) {
+    LfuState *s = state;
+    (void)refs;
+    (void)len;
+    for (int b = 0; b < s->bucket_count; b++)
+        s->free_buckets[b] = b;
+    s->free_count = s->bucket_count;
+    s->lowest = -1;
+    return 0;
+}
+
+// Creates a bucket for count right after `after` (-1: at the front)
+static int lfu_new_bucket(LfuState *s, long long count, int after) {
+    int b = s->free_buckets[--s->free_count];
+    s->count[b] = count;
+    framelist_init(&s->members[b]);
+    s->bucket_prev[b] = after;
+    s->bucket_next[b] = after >= 0 ? s->bucket_next[after] : s->lowest;
+    if (s->bucket_next[b] >= 0)
+        s->bucket_prev[s->bucket_next[b]] = b;
+    if (after >= 0)
+        s->bucket_next[after] = b;
+    else
+        s->lowest = b;
+    return b;
+}
+
+static void lfu_drop_bucket_if_empty(LfuState *s, int b) {
+    if (s->members[b].size > 0)
+        return;
+    if (s->bucket_prev[b] >= 0)
+        s->bucket_next[s->bucket_prev[b]] = s->bucket_next[b];
+    else
+        s->lowest = s->bucket_next[b];
+    if (s->bucket_next[b] >= 0)
+        s->bucket_prev[s->bucket_next[b]] = s->bucket_prev[b];
+    s->free_buckets[s->free_count++] = b;
+}
+
+static void lfu_on_hit(void *state, int frame, const PolicyAccess *access) {
+    LfuState *s = state;
+    (void)access;
+    int from = s->frame_bucket[frame];
+    int to = s->bucket_next[from];
+    if (to < 0 || s->count[to] != s->count[from] + 1)
+        to = lfu_new_bucket(s, s->count[from] + 1, from);
+
+    framelist_remove(&s->members[from], s->frame_prev, s->frame_next, frame);
+    framelist_push_head(&s->members[to], s->frame_prev, s->frame_next, frame);
+    s->frame_bucket[frame] = to;
+    lfu_drop_bucket_if_empty(s, from);
+}
+
+static void lfu_on_miss(void *state, int frame, const PolicyAccess *access) {
+    LfuState *s = state;
+    (void)access;
+    int b = s->lowest;
+    if (b < 0 || s->count[b] != 1)
+        b = lfu_new_bucket(s, 1, -1);
+    framelist_push_head(&s->members[b], s->frame_prev, s->frame_next, frame);
+    s->frame_bucket[frame] = b;
+}
+
+static int lfu_choose_victim(void *state, const PolicyAccess *access) {
+    LfuState *s = state;
+    int b = s->lowest;
+    int victim = framelist_oldest_except(&s->members[b], s->frame_prev, access->pinned);
+    if (victim < 0) {
+        // The pinned frame is all the lowest bucket has
+        b = s->bucket_next[b];
+        victim = s->members[b].tail;
+    }
+    framelist_remove(&s->members[b], s->frame_prev, s->frame_next, victim);
+    lfu_drop_bucket_if_empty(s, b);
+    return victim;
+}
+
+// Every array whole, plus the free list and the lowest bucket
+static int lfu_save(const void *state, FILE *out) {
+    const LfuState *s = state;
+    size_t frames = (size_t)(s->bucket_count - 1), buckets = (size_t)s->bucket_count;
+    if (checkpoint_write(out, s->frame_bucket, frames * sizeof(int)) != 0 ||
+        checkpoint_write(out, s->frame_prev, frames * sizeof(int)) != 0 ||
+        checkpoint_write(out, s->frame_next, frames * sizeof(int)) != 0 ||
+        checkpoint_write(out, s->count, buckets * sizeof(long long)) != 0 ||
+        checkpoint_write(out, s->members, buckets * sizeof(FrameList)) != 0 ||
+        checkpoint_write(out, s->bucket_prev, buckets * sizeof(int)) != 0 ||
+        checkpoint_write(out, s->bucket_next, buckets * sizeof(int)) != 0 ||
+        checkpoint_write(out, s->free_buckets, buckets * sizeof(int)) != 0 ||
+        checkpoint_write(out, &s->free_count, sizeof(s->free_count)) != 0 ||
+        checkpoint_write(out, &s->lowest, sizeof(s->lowest)) != 0)
+        return -1;
+    return 0;
+}
+
+// Walks the buckets up from lowest: each one in range, off the free list,
+// not empty, above the one before, its frames pointing back at it. With
+// the free list they must cover every bucket, and hold the resident frames.
+static int lfu_check(const LfuState *s, const unsigned char *resident, unsigned char *bucket_seen,
+                     unsigned char *frame_seen) {
+    int frames = s->bucket_count - 1, buckets = s->bucket_count, chained = 0;
+    if (s->free_count < 0 || s->free_count > buckets)
+        return -1;
+    for (int i = 0; i < s->free_count; i++) {
+        int b = s->free_buckets[i];
+        if (b < 0 || b >= buckets || bucket_seen[b])
+            return -1;
+        bucket_seen[b] = 1;
+    }
+    for (int b = s->lowest, last = -1; b != -1; last = b, b = s->bucket_next[b]) {
+        if (b < 0 || b >= buckets || bucket_seen[b] || s->bucket_prev[b] != last || s->members[b].size == 0 ||
+            (last >= 0 && s->count[b] <= s->count[last]) ||
+            framelist_check(&s->members[b], s->frame_prev, s->frame_next, frames, frame_seen, 1) != 0)
+            return -1;
+        bucket_seen[b] = 1;
+        chained++;
+        for (int f = s->members[b].head; f >= 0; f = s->frame_next[f]) {
+            if (s->frame_bucket[f] != b)
+                return -1;
+        }
+    }
+    if (chained + s->free_count != buckets)
+        return -1;
+    for (int f = 0; f < frames; f++) {
+        if (frame_seen[f] != (resident[f] != 0))
+            return -1;
+    }
+    return 0;
+}
+
+static int lfu_load(void *state, FILE *in, const unsigned char *resident) {
+    LfuState *s = state;
+    size_t frames = (size_t)(s->bucket_count - 1), buckets = (size_t)s->bucket_count;
+    if (checkpoint_read(in, s->frame_bucket, frames * sizeof(int)) != 0 ||
+        checkpoint_read(in, s->frame_prev, frames * sizeof(int)) != 0 ||
+        checkpoint_read(in, s->frame_next, frames * sizeof(int)) != 0 ||
+        checkpoint_read(in, s->count, buckets * sizeof(long long)) != 0 ||
+        checkpoint_read(in, s->members, buckets * sizeof(FrameList)) != 0 ||
+        checkpoint_read(in, s->bucket_prev, buckets * sizeof(int)) != 0 ||
+        checkpoint_read(in, s->bucket_next, buckets * sizeof(int)) != 0 ||
+        checkpoint_read(in, s->free_buckets, buckets * sizeof(int)) != 0 ||
+        checkpoint_read(in, &s->free_count, sizeof(s->free_count)) != 0 ||
+        checkpoint_read(in, &s->lowest, sizeof(s->lowest)) != 0)
+        return -1;
+    unsigned char *bucket_seen = calloc(buckets, 1), *frame_seen = calloc(frames, 1);
+    int status = bucket_seen && frame_seen ? lfu_check(s, resident, bucket_seen, frame_seen) : -1;
+    free(bucket_seen);
+    free(frame_seen);
+    return status;
+}
+
+static const ReplacementPolicy policy_lfu = {
+    "lfu", lfu_create, lfu_destroy, lfu_reset, lfu_on_hit, lfu_on_miss, lfu_choose_victim, lfu_save, lfu_load, 0
+};
+
+// Registry in the order the GUI lists them
+static const ReplacementPolicy *const policies[] = {
+    &policy_lru,
+    &policy_fifo,
+    &policy_optimal,
+    &policy_clock,
+    &policy_second_chance,
+    &policy_lfu,
+    &policy_2q,
+    &policy_arc,
+    &policy_nru,
+    &policy_wsclock,
+};
+
+int policy_count(void) {
+    return (int)(sizeof(policies) / sizeof(policies[0]));
+}
+
+const ReplacementPolicy *policy_at(int index) {
+    return (index >= 0 && index < policy_count()) ? policies[index] : NULL;
+}
+
+const ReplacementPolicy *policy_find(const char *name) {
+    for (int i = 0; i < policy_count(); i++) {
+        if (strcmp(policies[i]->name, name) == 0)
+            return policies[i];
+    }
+    return NULL;
+}
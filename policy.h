@@ -0,0 +1,62 @@
+#ifndef POLICY_H
+#define POLICY_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+struct PageReference;
+
+// Starts writing a dirty frame back ahead of its eviction; returns 0 if the
+// write was queued (the frame then counts as clean), -1 if the device is busy
+typedef int (*PolicyCleanFn)(void *ctx, int frame);
+
+// What a policy is told about the access it is handling
+typedef struct {
+    uint64_t key;               // page_key(pid, page)
+    long long index;            // Position of the access in the run
+    int write;                  // The access stores to the page
+    const unsigned char *dirty; // Per frame, as in FrameTable
+    PolicyCleanFn clean;        // NULL unless write-back is asynchronous
+    void *clean_ctx;
+    // Frame choose_victim must not return, or -1: the demand page while a
+    // prefetch makes room, which never happens with needs_future policies.
+    // Only prefetches set it, so it also tells on_miss the page was not asked for.
+    int pinned;
+} PolicyAccess;
+
+// Page replacement policy. The simulator's FrameTable owns residency; a
+// policy only keeps per-frame metadata and decides which frame goes next.
+// Ops are looked up once when the algorithm is set, never per access.
+typedef struct {
+    const char *name;
+    void *(*create)(int frame_count);
+    void (*destroy)(void *state);
+    // Called before every run with memory empty. refs/len is the whole run
+    // when it is materialized, NULL/0 when streaming; -1 means cannot run.
+    int (*reset)(void *state, const struct PageReference *refs, int len);
+    void (*on_hit)(void *state, int frame, const PolicyAccess *access);
+    // The accessed page was just loaded into frame
+    void (*on_miss)(void *state, int frame, const PolicyAccess *access);
+    // Memory is full and access is about to fault: forget and return a resident frame
+    int (*choose_victim)(void *state, const PolicyAccess *access);
+    // Checkpoints: write the state, or read it back into a state created
+    // for the same frame count. resident marks the frames the restored
+    // FrameTable holds, for load to check the state against; -1 on I/O
+    // error or a state that does not fit. NULL where unsupported.
+    int (*save)(const void *state, FILE *out);
+    int (*load)(void *state, FILE *in, const unsigned char *resident);
+    int needs_future; // Requires the materialized reference string in reset()
+} ReplacementPolicy;
+
+int policy_count(void);
+const ReplacementPolicy *policy_at(int index);
+const ReplacementPolicy *policy_find(const char *name);
+
+// Defined in policy_adaptive.c, policy_dirty.c and optimal.c
+extern const ReplacementPolicy policy_2q;
+extern const ReplacementPolicy policy_arc;
+extern const ReplacementPolicy policy_nru;
+extern const ReplacementPolicy policy_wsclock;
+extern const ReplacementPolicy policy_optimal;
+
+#endif
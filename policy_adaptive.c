@@ -0,0 +1,422 @@
+#include "policy.h"
+#include "checkpoint.h"
+#include "framelist.h"
+#include "pagemap.h"
+#include <stdlib.h>
+
+// Ghost entries remember keys of recently evicted pages (no frame attached).
+// Slots are linked into caller-owned FrameLists and indexed by key.
+typedef struct {
+    uint64_t *keys;
+    int *prev;
+    int *next;
+    unsigned char *list; // Which ghost list a slot is on
+    int *free_slots;
+    int free_count;
+    int capacity;
+    PageMap index;
+} GhostTable;
+
+static void ghost_free(GhostTable *g) {
+    free(g->keys);
+    free(g->prev);
+    free(g->next);
+    free(g->list);
+    free(g->free_slots);
+    pagemap_free(&g->index);
+}
+
+static int ghost_init(GhostTable *g, int capacity) {
+    g->capacity = capacity;
+    g->keys = malloc((size_t)capacity * sizeof(uint64_t));
+    g->prev = malloc((size_t)capacity * sizeof(int));
+    g->next = malloc((size_t)capacity * sizeof(int));
+    g->list = malloc((size_t)capacity);
+    g->free_slots = malloc((size_t)capacity * sizeof(int));
+    if (!g->keys || !g->prev || !g->next || !g->list || !g->free_slots ||
+        pagemap_init(&g->index, (size_t)capacity) != 0) {
+        ghost_free(g);
+        return -1;
+    }
+    return 0;
+}
+
+static void ghost_reset(GhostTable *g) {
+    for (int i = 0; i < g->capacity; i++)
+        g->free_slots[i] = i;
+    g->free_count = g->capacity;
+    pagemap_clear(&g->index);
+}
+
+// Slots in use are exactly those on the lists, so the index is rebuilt
+// from them rather than saved
+static int ghost_save(const GhostTable *g, FILE *out) {
+    size_t slots = (size_t)g->capacity;
+    if (checkpoint_write(out, g->keys, slots * sizeof(uint64_t)) != 0 ||
+        checkpoint_write(out, g->prev, slots * sizeof(int)) != 0 ||
+        checkpoint_write(out, g->next, slots * sizeof(int)) != 0 || checkpoint_write(out, g->list, slots) != 0 ||
+        checkpoint_write(out, g->free_slots, slots * sizeof(int)) != 0 ||
+        checkpoint_write(out, &g->free_count, sizeof(g->free_count)) != 0)
+        return -1;
+    return 0;
+}
+
+// Every slot must be either free or on the list its list[] names, once
+static int ghost_check(const GhostTable *g, const FrameList *lists, int list_count, unsigned char *seen) {
+    int listed = 0;
+    if (g->free_count < 0 || g->free_count > g->capacity)
+        return -1;
+    for (int i = 0; i < g->free_count; i++) {
+        int slot = g->free_slots[i];
+        if (slot < 0 || slot >= g->capacity || seen[slot])
+            return -1;
+        seen[slot] = 1;
+    }
+    for (int l = 0; l < list_count; l++) {
+        if (framelist_check(&lists[l], g->prev, g->next, g->capacity, seen, 1) != 0)
+            return -1;
+        for (int slot = lists[l].head; slot >= 0; slot = g->next[slot]) {
+            if (g->list[slot] != l)
+                return -1;
+        }
+        listed += lists[l].size;
+    }
+    return listed + g->free_count == g->capacity ? 0 : -1;
+}
+
+static int ghost_load(GhostTable *g, const FrameList *lists, int list_count, FILE *in) {
+    size_t slots = (size_t)g->capacity;
+    if (checkpoint_read(in, g->keys, slots * sizeof(uint64_t)) != 0 ||
+        checkpoint_read(in, g->prev, slots * sizeof(int)) != 0 ||
+        checkpoint_read(in, g->next, slots * sizeof(int)) != 0 || checkpoint_read(in, g->list, slots) != 0 ||
+        checkpoint_read(in, g->free_slots, slots * sizeof(int)) != 0 ||
+        checkpoint_read(in, &g->free_count, sizeof(g->free_count)) != 0)
+        return -1;
+    unsigned char *seen = calloc(slots, 1);
+    int status = seen ? ghost_check(g, lists, list_count, seen) : -1;
+    free(seen);
+    if (status != 0)
+        return -1;
+    pagemap_clear(&g->index);
+    for (int l = 0; l < list_count; l++) {
+        for (int slot = lists[l].head; slot >= 0; slot = g->next[slot]) {
+            if (pagemap_lookup(&g->index, g->keys[slot]) || pagemap_put(&g->index, g->keys[slot], slot) != 0)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+// Slot remembering key, or -1
+static int ghost_find(const GhostTable *g, uint64_t key) {
+    int *slot = pagemap_lookup(&g->index, key);
+    return slot ? *slot : -1;
+}
+
+static void ghost_remove(GhostTable *g, FrameList *list, int slot) {
+    framelist_remove(list, g->prev, g->next, slot);
+    pagemap_remove(&g->index, g->keys[slot]);
+    g->free_slots[g->free_count++] = slot;
+}
+
+static void ghost_drop_oldest(GhostTable *g, FrameList *list) {
+    if (list->tail >= 0)
+        ghost_remove(g, list, list->tail);
+}
+
+// Caller makes room first; a full table silently skips the key
+static void ghost_add(GhostTable *g, FrameList *list, unsigned char list_id, uint64_t key) {
+    if (g->free_count == 0)
+        return;
+    int slot = g->free_slots[--g->free_count];
+    if (pagemap_put(&g->index, key, slot) != 0) {
+        g->free_count++;
+        return;
+    }
+    g->keys[slot] = key;
+    g->list[slot] = list_id;
+    framelist_push_head(list, g->prev, g->next, slot);
+}
+
+// State shared by 2Q and ARC: two resident lists over frame numbers
+typedef struct {
+    int *prev;
+    int *next;
+    unsigned char *frame_list; // Resident list each frame is on
+    uint64_t *frame_key;
+    FrameList resident[2];
+    GhostTable ghosts;
+    FrameList ghost_lists[2];
+    int frame_count;
+
+    // Classification of the faulting page worked out in choose_victim()
+    uint64_t pending_key;
+    int pending_list;
+    int has_pending;
+
+    int kin;  // 2Q: A1in target size
+    int p;    // ARC: target size of T1
+} TwoListState;
+
+static void two_list_destroy(void *state) {
+    TwoListState *s = state;
+    free(s->prev);
+    free(s->next);
+    free(s->frame_list);
+    free(s->frame_key);
+    ghost_free(&s->ghosts);
+    free(s);
+}
+
+static TwoListState *two_list_create(int frame_count, int ghost_capacity) {
+    TwoListState *s = calloc(1, sizeof(TwoListState));
+    if (!s)
+        return NULL;
+    s->frame_count = frame_count;
+    s->prev = malloc((size_t)frame_count * sizeof(int));
+    s->next = malloc((size_t)frame_count * sizeof(int));
+    s->frame_list = malloc((size_t)frame_count);
+    s->frame_key = malloc((size_t)frame_count * sizeof(uint64_t));
+    if (!s->prev || !s->next || !s->frame_list || !s->frame_key ||
+        ghost_init(&s->ghosts, ghost_capacity > 0 ? ghost_capacity : 1) != 0) {
+        free(s->prev);
+        free(s->next);
+        free(s->frame_list);
+        free(s->frame_key);
+        free(s);
+        return NULL;
+    }
+    return s;
+}
+
+static int two_list_reset(void *state, const struct PageReference *refs, int len) {
+    TwoListState *s = state;
+    (void)refs;
+    (void)len;
+    framelist_init(&s->resident[0]);
+    framelist_init(&s->resident[1]);
+    framelist_init(&s->ghost_lists[0]);
+    framelist_init(&s->ghost_lists[1]);
+    ghost_reset(&s->ghosts);
+    s->has_pending = 0;
+    s->p = 0;
+    return 0;
+}
+
+// Everything but the frame count and the table sizes, which come from create
+static int two_list_save(const void *state, FILE *out) {
+    const TwoListState *s = state;
+    size_t frames = (size_t)s->frame_count;
+    if (checkpoint_write(out, s->prev, frames * sizeof(int)) != 0 ||
+        checkpoint_write(out, s->next, frames * sizeof(int)) != 0 ||
+        checkpoint_write(out, s->frame_list, frames) != 0 ||
+        checkpoint_write(out, s->frame_key, frames * sizeof(uint64_t)) != 0 ||
+        checkpoint_write(out, s->resident, sizeof(s->resident)) != 0 ||
+        checkpoint_write(out, s->ghost_lists, sizeof(s->ghost_lists)) != 0 || ghost_save(&s->ghosts, out) != 0 ||
+        checkpoint_write(out, &s->pending_key, sizeof(s->pending_key)) != 0 ||
+        checkpoint_write(out, &s->pending_list, sizeof(s->pending_list)) != 0 ||
+        checkpoint_write(out, &s->has_pending, sizeof(s->has_pending)) != 0 ||
+        checkpoint_write(out, &s->kin, sizeof(s->kin)) != 0 || checkpoint_write(out, &s->p, sizeof(s->p)) != 0)
+        return -1;
+    return 0;
+}
+
+// Both resident lists together hold exactly the resident frames, each
+// frame on the list frame_list[] names
+static int resident_check(const TwoListState *s, const unsigned char *resident) {
+    unsigned char *seen = calloc((size_t)s->frame_count, 1);
+    int status = seen ? 0 : -1;
+    for (int l = 0; l < 2 && status == 0; l++)
+        status = framelist_check(&s->resident[l], s->prev, s->next, s->frame_count, seen, (unsigned char)(l + 1));
+    for (int f = 0; f < s->frame_count && status == 0; f++) {
+        if ((seen[f] != 0) != (resident[f] != 0) || (seen[f] && s->frame_list[f] != seen[f] - 1))
+            status = -1;
+    }
+    free(seen);
+    return status;
+}
+
+static int two_list_load(void *state, FILE *in, const unsigned char *resident) {
+    TwoListState *s = state;
+    size_t frames = (size_t)s->frame_count;
+    if (checkpoint_read(in, s->prev, frames * sizeof(int)) != 0 ||
+        checkpoint_read(in, s->next, frames * sizeof(int)) != 0 || checkpoint_read(in, s->frame_list, frames) != 0 ||
+        checkpoint_read(in, s->frame_key, frames * sizeof(uint64_t)) != 0 ||
+        checkpoint_read(in, s->resident, sizeof(s->resident)) != 0 ||
+        checkpoint_read(in, s->ghost_lists, sizeof(s->ghost_lists)) != 0 ||
+        ghost_load(&s->ghosts, s->ghost_lists, 2, in) != 0 ||
+        checkpoint_read(in, &s->pending_key, sizeof(s->pending_key)) != 0 ||
+        checkpoint_read(in, &s->pending_list, sizeof(s->pending_list)) != 0 ||
+        checkpoint_read(in, &s->has_pending, sizeof(s->has_pending)) != 0 ||
+        checkpoint_read(in, &s->kin, sizeof(s->kin)) != 0 || checkpoint_read(in, &s->p, sizeof(s->p)) != 0 ||
+        s->pending_list < 0 || s->pending_list > 1 || resident_check(s, resident) != 0)
+        return -1;
+    return 0;
+}
+
+static void resident_push(TwoListState *s, int list, int frame, uint64_t key) {
+    s->frame_list[frame] = (unsigned char)list;
+    s->frame_key[frame] = key;
+    framelist_push_head(&s->resident[list], s->prev, s->next, frame);
+}
+
+// Takes the oldest frame of list but pinned, or of the other list when
+// pinned is all list has; the frame's frame_list says which it came from
+static int resident_pop(TwoListState *s, int list, int pinned) {
+    int frame = framelist_oldest_except(&s->resident[list], s->prev, pinned);
+    if (frame < 0) {
+        list = 1 - list;
+        frame = framelist_oldest_except(&s->resident[list], s->prev, pinned);
+    }
+    framelist_remove(&s->resident[list], s->prev, s->next, frame);
+    return frame;
+}
+
+// Looks the faulting key up in the ghosts and forgets it there; returns the
+// ghost list it was on, or -1. A prefetch only forgets it: nobody asked for
+// the page, so it is no ghost hit and enters like a page never seen.
+static int take_ghost(TwoListState *s, const PolicyAccess *access) {
+    int slot = ghost_find(&s->ghosts, access->key);
+    if (slot < 0)
+        return -1;
+    int list = s->ghosts.list[slot];
+    ghost_remove(&s->ghosts, &s->ghost_lists[list], slot);
+    return access->pinned >= 0 ? -1 : list;
+}
+
+// 2Q (Johnson & Shasha): new pages enter the FIFO A1in; pages evicted from
+// A1in are remembered in the ghost list A1out, and a fault on a remembered
+// page promotes it to the LRU list Am.
+enum { Q_A1IN = 0, Q_AM = 1, Q_A1OUT = 0 };
+
+static void *twoq_create(int frame_count) {
+    int kout = frame_count / 2 > 0 ? frame_count / 2 : 1;
+    TwoListState *s = two_list_create(frame_count, kout);
+    if (s)
+        s->kin = frame_count / 4 > 0 ? frame_count / 4 : 1;
+    return s;
+}
+
+static void twoq_on_hit(void *state, int frame, const PolicyAccess *access) {
+    TwoListState *s = state;
+    (void)access;
+    if (s->frame_list[frame] == Q_AM) {
+        framelist_remove(&s->resident[Q_AM], s->prev, s->next, frame);
+        framelist_push_head(&s->resident[Q_AM], s->prev, s->next, frame);
+    }
+}
+
+static int twoq_choose_victim(void *state, const PolicyAccess *access) {
+    TwoListState *s = state;
+    s->pending_key = access->key;
+    s->pending_list = take_ghost(s, access) == Q_A1OUT ? Q_AM : Q_A1IN;
+    s->has_pending = 1;
+
+    int from_a1in = s->resident[Q_A1IN].size > s->kin || s->resident[Q_AM].size == 0;
+    int victim = resident_pop(s, from_a1in ? Q_A1IN : Q_AM, access->pinned);
+    if (s->frame_list[victim] == Q_A1IN) {
+        if (s->ghosts.free_count == 0)
+            ghost_drop_oldest(&s->ghosts, &s->ghost_lists[Q_A1OUT]);
+        ghost_add(&s->ghosts, &s->ghost_lists[Q_A1OUT], Q_A1OUT, s->frame_key[victim]);
+    }
+    return victim;
+}
+
+static void twoq_on_miss(void *state, int frame, const PolicyAccess *access) {
+    TwoListState *s = state;
+    int list;
+    if (s->has_pending && s->pending_key == access->key)
+        list = s->pending_list;
+    else
+        list = take_ghost(s, access) == Q_A1OUT ? Q_AM : Q_A1IN;
+    s->has_pending = 0;
+    resident_push(s, list, frame, access->key);
+}
+
+const ReplacementPolicy policy_2q = {
+    "2q", twoq_create, two_list_destroy, two_list_reset, twoq_on_hit, twoq_on_miss, twoq_choose_victim,
+    two_list_save, two_list_load, 0
+};
+
+// ARC (Megiddo & Modha): T1 holds pages seen once recently, T2 pages seen
+// at least twice; ghosts B1/B2 remember their evictions. Ghost hits move the
+// target size p of T1 towards whichever side would have kept the page.
+enum { ARC_T1 = 0, ARC_T2 = 1, ARC_B1 = 0, ARC_B2 = 1 };
+
+static void *arc_create(int frame_count) {
+    return two_list_create(frame_count, frame_count);
+}
+
+static void arc_on_hit(void *state, int frame, const PolicyAccess *access) {
+    TwoListState *s = state;
+    framelist_remove(&s->resident[s->frame_list[frame]], s->prev, s->next, frame);
+    resident_push(s, ARC_T2, frame, access->key);
+}
+
+// Evicts from T1 or T2 depending on p, remembering the page in B1 or B2
+static int arc_replace(TwoListState *s, int ghost_hit_b2, int pinned) {
+    int t1 = s->resident[ARC_T1].size;
+    int from_t1 = t1 > 0 && ((ghost_hit_b2 && t1 == s->p) || t1 > s->p);
+    if (s->resident[ARC_T2].size == 0)
+        from_t1 = 1;
+
+    int victim = resident_pop(s, from_t1 ? ARC_T1 : ARC_T2, pinned);
+    int ghost = s->frame_list[victim] == ARC_T1 ? ARC_B1 : ARC_B2;
+    if (s->ghosts.free_count == 0)
+        ghost_drop_oldest(&s->ghosts, &s->ghost_lists[s->ghost_lists[ARC_B2].size > 0 ? ARC_B2 : ARC_B1]);
+    ghost_add(&s->ghosts, &s->ghost_lists[ghost], (unsigned char)ghost, s->frame_key[victim]);
+    return victim;
+}
+
+static int arc_choose_victim(void *state, const PolicyAccess *access) {
+    TwoListState *s = state;
+    int c = s->frame_count;
+    int ghost = take_ghost(s, access);
+    // Sizes with the ghost that was hit still listed
+    int b1 = s->ghost_lists[ARC_B1].size + (ghost == ARC_B1), b2 = s->ghost_lists[ARC_B2].size + (ghost == ARC_B2);
+
+    s->pending_key = access->key;
+    s->has_pending = 1;
+    if (ghost == ARC_B1) {
+        int delta = b2 / b1 > 1 ? b2 / b1 : 1;
+        s->p = s->p + delta < c ? s->p + delta : c;
+        s->pending_list = ARC_T2;
+        return arc_replace(s, 0, access->pinned);
+    }
+    if (ghost == ARC_B2) {
+        int delta = b1 / b2 > 1 ? b1 / b2 : 1;
+        s->p = s->p - delta > 0 ? s->p - delta : 0;
+        s->pending_list = ARC_T2;
+        return arc_replace(s, 1, access->pinned);
+    }
+
+    // Page not seen recently: keep |T1| + |B1| <= c and the directory <= 2c
+    s->pending_list = ARC_T1;
+    int t1 = s->resident[ARC_T1].size;
+    if (t1 + b1 >= c) {
+        if (t1 < c) {
+            ghost_drop_oldest(&s->ghosts, &s->ghost_lists[ARC_B1]);
+            return arc_replace(s, 0, access->pinned);
+        }
+        return resident_pop(s, ARC_T1, access->pinned);
+    }
+    if (t1 + s->resident[ARC_T2].size + b1 + b2 >= 2 * c)
+        ghost_drop_oldest(&s->ghosts, &s->ghost_lists[ARC_B2]);
+    return arc_replace(s, 0, access->pinned);
+}
+
+static void arc_on_miss(void *state, int frame, const PolicyAccess *access) {
+    TwoListState *s = state;
+    int list;
+    if (s->has_pending && s->pending_key == access->key)
+        list = s->pending_list;
+    else
+        list = take_ghost(s, access) >= 0 ? ARC_T2 : ARC_T1;
+    s->has_pending = 0;
+    resident_push(s, list, frame, access->key);
+}
+
+const ReplacementPolicy policy_arc = {
+    "arc", arc_create, two_list_destroy, two_list_reset, arc_on_hit, arc_on_miss, arc_choose_victim,
+    two_list_save, two_list_load, 0
+};
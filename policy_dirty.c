@@ -0,0 +1,211 @@
+#include "policy.h"
+#include "checkpoint.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Policies that look at the dirty bit: evicting a clean page costs a read,
+// a dirty one a write as well. Both tell time by PolicyAccess.index.
+
+// Frames an NRU scan looks at before settling for the best class it saw,
+// and a WSClock scan goes on past the first old dirty frame
+#define NRU_SCAN_LIMIT 256
+#define WSCLOCK_SCAN_LIMIT 256
+
+// NRU: reference bits are cleared every frame_count accesses, which with
+// the dirty bit puts each frame in one of four classes. A scan from a
+// rotating hand takes the first frame of class 0 (not referenced, clean);
+// failing that, the first frame of the lowest class it met. Dirty frames
+// it passes that have not been referenced are cleaned ahead of need.
+typedef struct {
+    long long *referenced; // Epoch in which the frame was last referenced
+    long long epoch;
+    int frame_count;
+    int hand;
+} NruState;
+
+static void *nru_create(int frame_count) {
+    NruState *s = calloc(1, sizeof(NruState));
+    if (!s)
+        return NULL;
+    s->referenced = calloc((size_t)frame_count, sizeof(long long));
+    if (!s->referenced) {
+        free(s);
+        return NULL;
+    }
+    s->frame_count = frame_count;
+    return s;
+}
+
+static void nru_destroy(void *state) {
+    NruState *s = state;
+    free(s->referenced);
+    free(s);
+}
+
+static int nru_reset(void *state, const struct PageReference *refs, int len) {
+    NruState *s = state;
+    (void)refs;
+    (void)len;
+    memset(s->referenced, 0, (size_t)s->frame_count * sizeof(long long));
+    s->epoch = 1; // Frames start in epoch 0, i.e. unreferenced
+    s->hand = 0;
+    return 0;
+}
+
+// Moving to a new epoch clears every reference bit at once
+static void nru_on_access(void *state, int frame, const PolicyAccess *access) {
+    NruState *s = state;
+    s->epoch = 1 + (access->index + 1) / s->frame_count;
+    s->referenced[frame] = s->epoch;
+}
+
+static int nru_choose_victim(void *state, const PolicyAccess *access) {
+    NruState *s = state;
+    int best = s->hand, best_class = 4;
+    int limit = s->frame_count < NRU_SCAN_LIMIT ? s->frame_count : NRU_SCAN_LIMIT;
+    for (int i = 0; i < limit; i++) {
+        int frame = (s->hand + i) % s->frame_count;
+        if (frame == access->pinned)
+            continue;
+        int referenced = s->referenced[frame] == s->epoch;
+        int cls = 2 * referenced + access->dirty[frame];
+        if (cls == 1 && access->clean)
+            access->clean(access->clean_ctx, frame);
+        if (cls < best_class) {
+            best = frame;
+            best_class = cls;
+            if (cls == 0)
+                break;
+        }
+    }
+    s->hand = (best + 1) % s->frame_count;
+    return best;
+}
+
+static int nru_save(const void *state, FILE *out) {
+    const NruState *s = state;
+    if (checkpoint_write(out, s->referenced, (size_t)s->frame_count * sizeof(long long)) != 0 ||
+        checkpoint_write(out, &s->epoch, sizeof(s->epoch)) != 0 ||
+        checkpoint_write(out, &s->hand, sizeof(s->hand)) != 0)
+        return -1;
+    return 0;
+}
+
+static int nru_load(void *state, FILE *in, const unsigned char *resident) {
+    NruState *s = state;
+    (void)resident;
+    if (checkpoint_read(in, s->referenced, (size_t)s->frame_count * sizeof(long long)) != 0 ||
+        checkpoint_read(in, &s->epoch, sizeof(s->epoch)) != 0 ||
+        checkpoint_read(in, &s->hand, sizeof(s->hand)) != 0 || s->hand < 0 || s->hand >= s->frame_count)
+        return -1;
+    return 0;
+}
+
+const ReplacementPolicy policy_nru = {
+    "nru", nru_create, nru_destroy, nru_reset, nru_on_access, nru_on_access, nru_choose_victim, nru_save, nru_load, 0
+};
+
+// WSClock: CLOCK over frame numbers where a frame unreferenced for longer
+// than tau (frame_count accesses) has left the working set. An old clean
+// frame is evicted; an old dirty one is cleaned and passed over, so that a
+// later sweep finds it clean. A scan that finds no old clean frame within
+// WSCLOCK_SCAN_LIMIT frames of the first old dirty one takes that, and
+// after two sweeps without either it takes the least recently used frame.
+typedef struct {
+    unsigned char *referenced;
+    long long *last_use; // Index of the frame's last access, plus one
+    int frame_count;
+    int hand;
+} WsClockState;
+
+static void *wsclock_create(int frame_count) {
+    WsClockState *s = calloc(1, sizeof(WsClockState));
+    if (!s)
+        return NULL;
+    s->referenced = calloc((size_t)frame_count, 1);
+    s->last_use = calloc((size_t)frame_count, sizeof(long long));
+    if (!s->referenced || !s->last_use) {
+        free(s->referenced);
+        free(s->last_use);
+        free(s);
+        return NULL;
+    }
+    s->frame_count = frame_count;
+    return s;
+}
+
+static void wsclock_destroy(void *state) {
+    WsClockState *s = state;
+    free(s->referenced);
+    free(s->last_use);
+    free(s);
+}
+
+static int wsclock_reset(void *state, const struct PageReference *refs, int len) {
+    WsClockState *s = state;
+    (void)refs;
+    (void)len;
+    memset(s->referenced, 0, (size_t)s->frame_count);
+    memset(s->last_use, 0, (size_t)s->frame_count * sizeof(long long));
+    s->hand = 0;
+    return 0;
+}
+
+static void wsclock_on_access(void *state, int frame, const PolicyAccess *access) {
+    WsClockState *s = state;
+    s->referenced[frame] = 1;
+    s->last_use[frame] = access->index + 1;
+}
+
+static int wsclock_choose_victim(void *state, const PolicyAccess *access) {
+    WsClockState *s = state;
+    long long tau = s->frame_count;
+    int old_dirty = -1, past_dirty = 0;
+    int oldest = s->hand == access->pinned ? (s->hand + 1) % s->frame_count : s->hand;
+    for (int i = 0; i < 2 * s->frame_count && past_dirty <= WSCLOCK_SCAN_LIMIT; i++) {
+        past_dirty += old_dirty >= 0;
+        int frame = s->hand;
+        s->hand = (s->hand + 1) % s->frame_count;
+        if (s->referenced[frame] || frame == access->pinned) {
+            s->referenced[frame] = 0;
+            continue;
+        }
+        if (s->last_use[frame] < s->last_use[oldest])
+            oldest = frame;
+        if (access->index - s->last_use[frame] <= tau)
+            continue;
+        if (!access->dirty[frame])
+            return frame;
+        if (access->clean)
+            access->clean(access->clean_ctx, frame);
+        if (old_dirty < 0)
+            old_dirty = frame;
+    }
+    int victim = old_dirty >= 0 ? old_dirty : oldest;
+    s->hand = (victim + 1) % s->frame_count;
+    return victim;
+}
+
+static int wsclock_save(const void *state, FILE *out) {
+    const WsClockState *s = state;
+    if (checkpoint_write(out, s->referenced, (size_t)s->frame_count) != 0 ||
+        checkpoint_write(out, s->last_use, (size_t)s->frame_count * sizeof(long long)) != 0 ||
+        checkpoint_write(out, &s->hand, sizeof(s->hand)) != 0)
+        return -1;
+    return 0;
+}
+
+static int wsclock_load(void *state, FILE *in, const unsigned char *resident) {
+    WsClockState *s = state;
+    (void)resident;
+    if (checkpoint_read(in, s->referenced, (size_t)s->frame_count) != 0 ||
+        checkpoint_read(in, s->last_use, (size_t)s->frame_count * sizeof(long long)) != 0 ||
+        checkpoint_read(in, &s->hand, sizeof(s->hand)) != 0 || s->hand < 0 || s->hand >= s->frame_count)
+        return -1;
+    return 0;
+}
+
+const ReplacementPolicy policy_wsclock = {
+    "wsclock", wsclock_create, wsclock_destroy, wsclock_reset, wsclock_on_access, wsclock_on_access,
+    wsclock_choose_victim, wsclock_save, wsclock_load, 0
+};
@@ -0,0 +1,293 @@
+#include "prefetch.h"
+#include "pagemap.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Streams are tracked per process in a small table indexed by pid; two
+// processes that share a slot just restart each other's detection
+#define PREFETCH_STREAMS 64
+
+// ---- Sequential readahead ----
+
+// Like Linux readahead: a fault right after the previous one, or on the
+// page after the last window, opens a window that doubles with every
+// sequential fault, up to degree pages. The first page of each window is a
+// marker; using it reads the next, larger window in ahead of the process.
+// Every prefetched page evicted unused halves the window.
+#define READAHEAD_INITIAL 4
+#define READAHEAD_DEFAULT_MAX 32
+
+typedef struct {
+    int pid;
+    long long last;   // Last miss or marker use
+    long long next;   // First page after the current window
+    long long marker; // -1 when no window is open
+    int size;         // Current window, 0 for none
+} ReadaheadStream;
+
+typedef struct {
+    ReadaheadStream streams[PREFETCH_STREAMS];
+    int max;
+} ReadaheadState;
+
+static void *readahead_create(int degree) {
+    ReadaheadState *s = calloc(1, sizeof(ReadaheadState));
+    if (s)
+        s->max = degree > PREFETCH_MAX_PAGES ? PREFETCH_MAX_PAGES : degree;
+    return s;
+}
+
+static void readahead_destroy(void *state) {
+    free(state);
+}
+
+static void readahead_reset(void *state) {
+    ReadaheadState *s = state;
+    for (int i = 0; i < PREFETCH_STREAMS; i++)
+        s->streams[i] = (ReadaheadStream){-1, -2, -1, -1, 0};
+}
+
+static ReadaheadStream *readahead_stream(ReadaheadState *s, int pid) {
+    ReadaheadStream *st = &s->streams[pid & (PREFETCH_STREAMS - 1)];
+    if (st->pid != pid)
+        *st = (ReadaheadStream){pid, -2, -1, -1, 0};
+    return st;
+}
+
+// Opens the window [start, start + size) and names its pages
+static int readahead_window(ReadaheadStream *st, long long start, int size, long long *out, int max) {
+    int n = size < max ? size : max;
+    for (int i = 0; i < n; i++)
+        out[i] = start + i;
+    st->marker = start;
+    st->next = start + n;
+    st->size = n;
+    return n;
+}
+
+static int readahead_predict(void *state, int pid, long long page, int prefetched, long long *out, int max) {
+    ReadaheadState *s = state;
+    ReadaheadStream *st = readahead_stream(s, pid);
+    int sequential = page == st->last + 1 || page == st->next;
+    st->last = page;
+    if (prefetched) {
+        if (page != st->marker)
+            return 0;
+        int size = st->size * 2 < s->max ? st->size * 2 : s->max;
+        return readahead_window(st, st->next, size, out, max);
+    }
+    if (!sequential) {
+        st->size = 0;
+        st->marker = -1;
+        st->next = page + 1;
+        return 0;
+    }
+    int size = st->size == 0 ? READAHEAD_INITIAL : st->size * 2;
+    return readahead_window(st, page + 1, size < s->max ? size : s->max, out, max);
+}
+
+static void readahead_wasted(void *state, int pid, long long page) {
+    ReadaheadStream *st = &((ReadaheadState *)state)->streams[pid & (PREFETCH_STREAMS - 1)];
+    (void)page;
+    if (st->pid == pid)
+        st->size /= 2;
+}
+
+static const Prefetcher prefetch_readahead = {
+    "readahead", READAHEAD_DEFAULT_MAX, readahead_create, readahead_destroy, readahead_reset, readahead_predict,
+    readahead_wasted
+};
+
+// ---- Stride ----
+
+// Per process, the distance between consecutive misses; once the same
+// nonzero stride shows up twice in a row the next degree pages along it
+// are fetched, and each use of one of them keeps the run going
+#define STRIDE_DEFAULT_DEGREE 4
+
+typedef struct {
+    int pid;
+    long long last;
+    long long stride;
+    int confirmed;
+} StrideStream;
+
+typedef struct {
+    StrideStream streams[PREFETCH_STREAMS];
+    int degree;
+} StrideState;
+
+static void *stride_create(int degree) {
+    StrideState *s = calloc(1, sizeof(StrideState));
+    if (s)
+        s->degree = degree > PREFETCH_MAX_PAGES ? PREFETCH_MAX_PAGES : degree;
+    return s;
+}
+
+static void stride_destroy(void *state) {
+    free(state);
+}
+
+static void stride_reset(void *state) {
+    StrideState *s = state;
+    for (int i = 0; i < PREFETCH_STREAMS; i++)
+        s->streams[i] = (StrideStream){-1, 0, 0, 0};
+}
+
+static int stride_predict(void *state, int pid, long long page, int prefetched, long long *out, int max) {
+    StrideState *s = state;
+    StrideStream *st = &s->streams[pid & (PREFETCH_STREAMS - 1)];
+    (void)prefetched;
+    if (st->pid != pid)
+        *st = (StrideStream){pid, page, 0, 0};
+    long long stride = page - st->last;
+    st->confirmed = stride != 0 && stride == st->stride;
+    st->stride = stride;
+    st->last = page;
+    if (!st->confirmed)
+        return 0;
+    int n = 0;
+    for (int k = 1; k <= s->degree && n < max; k++) {
+        long long target = page + stride * k;
+        if (target < 0)
+            break;
+        out[n++] = target;
+    }
+    return n;
+}
+
+static void stride_wasted(void *state, int pid, long long page) {
+    StrideStream *st = &((StrideState *)state)->streams[pid & (PREFETCH_STREAMS - 1)];
+    (void)page;
+    if (st->pid == pid)
+        st->stride = 0;
+}
+
+static const Prefetcher prefetch_stride = {
+    "stride", STRIDE_DEFAULT_DEGREE, stride_create, stride_destroy, stride_reset, stride_predict, stride_wasted
+};
+
+// ---- Markov ----
+
+// A first-order Markov model of each process's miss stream: for every page
+// that missed, the pages that missed right after it, most recent first,
+// degree of them. A miss fetches what followed it before. The table is
+// dropped and relearned when it reaches MARKOV_MAX_ENTRIES pages.
+#define MARKOV_DEFAULT_WAYS 2
+#define MARKOV_MAX_WAYS 8
+#define MARKOV_MAX_ENTRIES (1 << 16)
+
+typedef struct {
+    PageMap index;         // page_key() -> entry
+    long long *successors; // ways per entry, -1 for none
+    int entries;
+    int ways;
+    int last_pid[PREFETCH_STREAMS];
+    long long last_page[PREFETCH_STREAMS];
+} MarkovState;
+
+static void markov_destroy(void *state) {
+    MarkovState *s = state;
+    pagemap_free(&s->index);
+    free(s->successors);
+    free(s);
+}
+
+static void *markov_create(int degree) {
+    MarkovState *s = calloc(1, sizeof(MarkovState));
+    if (!s)
+        return NULL;
+    s->ways = degree > MARKOV_MAX_WAYS ? MARKOV_MAX_WAYS : degree;
+    s->successors = malloc((size_t)MARKOV_MAX_ENTRIES * (size_t)s->ways * sizeof(long long));
+    if (!s->successors || pagemap_init(&s->index, MARKOV_MAX_ENTRIES) != 0) {
+        markov_destroy(s);
+        return NULL;
+    }
+    return s;
+}
+
+static void markov_reset(void *state) {
+    MarkovState *s = state;
+    pagemap_clear(&s->index);
+    s->entries = 0;
+    for (int i = 0; i < PREFETCH_STREAMS; i++)
+        s->last_pid[i] = -1;
+}
+
+// Puts next at the front of page's successors
+static void markov_learn(MarkovState *s, int pid, long long page, long long next) {
+    uint64_t key = page_key(pid, page);
+    int *slot = pagemap_lookup(&s->index, key);
+    int entry;
+    if (slot) {
+        entry = *slot;
+    } else {
+        if (s->entries == MARKOV_MAX_ENTRIES) {
+            pagemap_clear(&s->index);
+            s->entries = 0;
+        }
+        if (pagemap_put(&s->index, key, s->entries) != 0)
+            return;
+        entry = s->entries++;
+        for (int w = 0; w < s->ways; w++)
+            s->successors[(size_t)entry * (size_t)s->ways + (size_t)w] = -1;
+    }
+    long long *succ = &s->successors[(size_t)entry * (size_t)s->ways];
+    int w = 0;
+    while (w < s->ways - 1 && succ[w] != next)
+        w++;
+    for (; w > 0; w--)
+        succ[w] = succ[w - 1];
+    succ[0] = next;
+}
+
+static int markov_predict(void *state, int pid, long long page, int prefetched, long long *out, int max) {
+    MarkovState *s = state;
+    int stream = pid & (PREFETCH_STREAMS - 1);
+    (void)prefetched;
+    if (s->last_pid[stream] == pid && s->last_page[stream] != page)
+        markov_learn(s, pid, s->last_page[stream], page);
+    s->last_pid[stream] = pid;
+    s->last_page[stream] = page;
+
+    int *slot = pagemap_lookup(&s->index, page_key(pid, page));
+    if (!slot)
+        return 0;
+    const long long *succ = &s->successors[(size_t)*slot * (size_t)s->ways];
+    int n = 0;
+    for (int w = 0; w < s->ways && succ[w] >= 0 && n < max; w++)
+        out[n++] = succ[w];
+    return n;
+}
+
+static void markov_wasted(void *state, int pid, long long page) {
+    (void)state;
+    (void)pid;
+    (void)page;
+}
+
+static const Prefetcher prefetch_markov = {
+    "markov", MARKOV_DEFAULT_WAYS, markov_create, markov_destroy, markov_reset, markov_predict, markov_wasted
+};
+
+static const Prefetcher *const prefetchers[] = {
+    &prefetch_readahead,
+    &prefetch_stride,
+    &prefetch_markov,
+};
+
+int prefetcher_count(void) {
+    return (int)(sizeof(prefetchers) / sizeof(prefetchers[0]));
+}
+
+const Prefetcher *prefetcher_at(int index) {
+    return (index >= 0 && index < prefetcher_count()) ? prefetchers[index] : NULL;
+}
+
+const Prefetcher *prefetcher_find(const char *name) {
+    for (int i = 0; i < prefetcher_count(); i++) {
+        if (strcmp(prefetchers[i]->name, name) == 0)
+            return prefetchers[i];
+    }
+    return NULL;
+}
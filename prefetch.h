@@ -0,0 +1,36 @@
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+// Prefetchers watch the stream of would-be misses of a run, i.e. demand
+// faults and the first use of each prefetched page, and name pages of the
+// same process to bring in ahead of need. The simulator loads them through
+// the replacement policy like any other page, so they compete for frames.
+
+#define PREFETCH_MAX_PAGES 256 // Most pages one prediction may name
+
+typedef struct {
+    const char *name;
+    int default_degree; // What degree 0 means; see each prefetcher
+    void *(*create)(int degree);
+    void (*destroy)(void *state);
+    void (*reset)(void *state);
+    // pid faulted on page, or first used it after it was prefetched; writes
+    // up to max pages of pid to out and returns how many
+    int (*predict)(void *state, int pid, long long page, int prefetched, long long *out, int max);
+    // A prefetched page was evicted before it was ever used
+    void (*wasted)(void *state, int pid, long long page);
+} Prefetcher;
+
+// Outcome of the prefetches of a run
+typedef struct {
+    long long issued;    // Pages brought in by prefetch
+    long long hits;      // Of those, used before being evicted
+    long long wasted;    // Of those, evicted without being used
+    long long evictions; // Evictions made to make room for a prefetch
+} PrefetchCounts;
+
+int prefetcher_count(void);
+const Prefetcher *prefetcher_at(int index);
+const Prefetcher *prefetcher_find(const char *name);
+
+#endif
@@ -0,0 +1,83 @@
+#include "probe.h"
+
+// Vector kernels need GCC/Clang builtins; other compilers get the scalar loop
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define PROBE_SSE2 1
+#define PROBE_AVX2 1 // Compiled with a target attribute, used only if cpuid says so
+#include <immintrin.h>
+#endif
+
+static int find_scalar(const uint64_t *keys, int count, uint64_t key) {
+    for (int i = 0; i < count; i++) {
+        if (keys[i] == key)
+            return i;
+    }
+    return -1;
+}
+
+#ifdef PROBE_SSE2
+// SSE2 has no 64-bit compare: a lane matches when both 32-bit halves do
+static inline int match_mask_sse2(__m128i lanes, __m128i needle) {
+    __m128i eq = _mm_cmpeq_epi32(lanes, needle);
+    eq = _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_movemask_pd(_mm_castsi128_pd(eq));
+}
+
+// The vector kernels scan every slot and pick the match with a conditional
+// move: a fixed trip count predicts well, where exiting at the hit costs a
+// mispredict on almost every lookup
+static int find_sse2(const uint64_t *keys, int count, uint64_t key) {
+    __m128i needle = _mm_set1_epi64x((long long)key);
+    int found = -1;
+    for (int i = 0; i < count; i += 4) {
+        int mask = match_mask_sse2(_mm_loadu_si128((const __m128i *)(keys + i)), needle) |
+                   match_mask_sse2(_mm_loadu_si128((const __m128i *)(keys + i + 2)), needle) << 2;
+        int at = i + __builtin_ctz((unsigned)mask | 0x10u);
+        found = mask ? at : found;
+    }
+    return found;
+}
+#endif
+
+#ifdef PROBE_AVX2
+__attribute__((target("avx2"))) static int find_avx2(const uint64_t *keys, int count, uint64_t key) {
+    __m256i needle = _mm256_set1_epi64x((long long)key);
+    int found = -1;
+    for (int i = 0; i < count; i += 8) {
+        __m256i lo = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i *)(keys + i)), needle);
+        __m256i hi = _mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i *)(keys + i + 4)), needle);
+        int mask = _mm256_movemask_pd(_mm256_castsi256_pd(lo)) | _mm256_movemask_pd(_mm256_castsi256_pd(hi)) << 4;
+        int at = i + __builtin_ctz((unsigned)mask | 0x100u);
+        found = mask ? at : found;
+    }
+    return found;
+}
+#endif
+
+static const KeyProbe probes[] = {
+    {"scalar", find_scalar},
+#ifdef PROBE_SSE2
+    {"sse2", find_sse2},
+#endif
+#ifdef PROBE_AVX2
+    {"avx2", find_avx2},
+#endif
+};
+
+// No cached state, so simulators on several threads can ask at once
+int key_probe_count(void) {
+    int n = (int)(sizeof(probes) / sizeof(probes[0]));
+#ifdef PROBE_AVX2
+    if (!__builtin_cpu_supports("avx2"))
+        n--;
+#endif
+    return n;
+}
+
+const KeyProbe *key_probe_at(int index) {
+    return index >= 0 && index < key_probe_count() ? &probes[index] : NULL;
+}
+
+const KeyProbe *key_probe_best(void) {
+    return &probes[key_probe_count() - 1];
+}
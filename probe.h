@@ -0,0 +1,25 @@
+#ifndef PROBE_H
+#define PROBE_H
+
+#include <stdint.h>
+
+// Linear search over a packed array of 64-bit page keys. For the small
+// frame counts the GUI uses, comparing every key with SIMD beats hashing.
+
+#define KEY_PROBE_PAD 8 // Key arrays hold a multiple of this many slots
+
+// Returns the index of key in keys[0..count), or -1. count must be a
+// multiple of KEY_PROBE_PAD; unused slots hold PAGEMAP_EMPTY.
+typedef int (*KeyProbeFn)(const uint64_t *keys, int count, uint64_t key);
+
+typedef struct {
+    const char *name;
+    KeyProbeFn find;
+} KeyProbe;
+
+// Kernels this CPU can run, scalar first and the widest last
+int key_probe_count(void);
+const KeyProbe *key_probe_at(int index);
+const KeyProbe *key_probe_best(void);
+
+#endif
@@ -0,0 +1,362 @@
+#include "shards.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mrc.h"
+
+static inline uint64_t shards_hash(uint64_t key, uint64_t salt) {
+    // Keys are mostly consecutive pages, so the salt is spread over all
+    // bits first; added as is it would only shift which page hashes where
+    uint64_t z = key + (salt + 1) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static inline uint64_t hash_value(uint64_t h) {
+    return h & (SHARDS_MODULUS - 1);
+}
+
+static inline int hash_group(uint64_t h) {
+    return (int)((h >> 32) % SHARDS_GROUPS);
+}
+
+static int config_valid(const ShardsConfig *config) {
+    if (config->mode == SHARDS_FIXED_RATE)
+        return config->rate > 0 && config->rate <= 1;
+    return config->mode == SHARDS_FIXED_SIZE && config->max_keys > 0;
+}
+
+static uint64_t initial_threshold(const ShardsConfig *config) {
+    if (config->mode == SHARDS_FIXED_SIZE)
+        return SHARDS_MODULUS;
+    uint64_t threshold = (uint64_t)(config->rate * (double)SHARDS_MODULUS + 0.5);
+    return threshold > 0 ? threshold : 1;
+}
+
+// Random-group standard error of an estimate, scaled to a 95% half-width.
+// Groups without any sampled reference carry no information and are skipped.
+static double group_error(const double *group_estimate, const double *group_weight, double estimate) {
+    double sum = 0;
+    int groups = 0;
+    for (int g = 0; g < SHARDS_GROUPS; g++) {
+        if (group_weight[g] <= 0)
+            continue;
+        double diff = group_estimate[g] - estimate;
+        sum += diff * diff;
+        groups++;
+    }
+    if (groups < 2)
+        return 1.0;
+    return SHARDS_T_95 * sqrt(sum / ((double)groups * (groups - 1)));
+}
+
+// ---- Miss-ratio curve from sampled stack distances ----
+
+// Sampled keys by hash value, largest on top, for SHARDS_FIXED_SIZE
+typedef struct {
+    uint64_t *value;
+    uint64_t *key;
+    int len;
+    int capacity;
+} KeyHeap;
+
+static void heap_sift_down(KeyHeap *heap, int i) {
+    for (;;) {
+        int largest = i, left = 2 * i + 1, right = left + 1;
+        if (left < heap->len && heap->value[left] > heap->value[largest])
+            largest = left;
+        if (right < heap->len && heap->value[right] > heap->value[largest])
+            largest = right;
+        if (largest == i)
+            return;
+        uint64_t v = heap->value[i], k = heap->key[i];
+        heap->value[i] = heap->value[largest];
+        heap->key[i] = heap->key[largest];
+        heap->value[largest] = v;
+        heap->key[largest] = k;
+        i = largest;
+    }
+}
+
+static void heap_push(KeyHeap *heap, uint64_t value, uint64_t key) {
+    int i = heap->len++;
+    while (i > 0 && heap->value[(i - 1) / 2] < value) {
+        heap->value[i] = heap->value[(i - 1) / 2];
+        heap->key[i] = heap->key[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap->value[i] = value;
+    heap->key[i] = key;
+}
+
+static void heap_pop(KeyHeap *heap) {
+    heap->len--;
+    heap->value[0] = heap->value[heap->len];
+    heap->key[0] = heap->key[heap->len];
+    heap_sift_down(heap, 0);
+}
+
+typedef struct {
+    StackDistance sd;
+    KeyHeap heap;
+    uint64_t threshold;
+    int max_frames;
+    int buckets;  // Distances 1..max_frames, then one bucket for misses at every size
+    double *hist; // SHARDS_GROUPS rows of buckets
+} ShardsState;
+
+static void state_free(ShardsState *st) {
+    stackdist_free(&st->sd);
+    free(st->heap.value);
+    free(st->heap.key);
+    free(st->hist);
+}
+
+static int state_init(ShardsState *st, const ShardsConfig *config, int max_frames) {
+    memset(st, 0, sizeof(*st));
+    st->threshold = initial_threshold(config);
+    st->max_frames = max_frames;
+    st->buckets = max_frames + 2;
+    int expected = config->mode == SHARDS_FIXED_SIZE ? config->max_keys : 4096;
+    st->hist = calloc((size_t)SHARDS_GROUPS * (size_t)st->buckets, sizeof(double));
+    if (config->mode == SHARDS_FIXED_SIZE) {
+        st->heap.capacity = config->max_keys + 1;
+        st->heap.value = malloc((size_t)st->heap.capacity * sizeof(uint64_t));
+        st->heap.key = malloc((size_t)st->heap.capacity * sizeof(uint64_t));
+    }
+    if (!st->hist || stackdist_init(&st->sd, expected) != 0 ||
+        (config->mode == SHARDS_FIXED_SIZE && (!st->heap.value || !st->heap.key))) {
+        state_free(st);
+        return -1;
+    }
+    return 0;
+}
+
+// The sample outgrew max_keys: drop the keys with the largest hash value
+// and lower the threshold below them. Counts gathered at the old rate are
+// scaled to the new one, as SHARDS does.
+static void shrink_sample(ShardsState *st) {
+    uint64_t top = st->heap.value[0];
+    while (st->heap.len > 0 && st->heap.value[0] == top) {
+        stackdist_forget(&st->sd, st->heap.key[0]);
+        heap_pop(&st->heap);
+    }
+    double scale = (double)top / (double)st->threshold;
+    st->threshold = top;
+    for (size_t i = 0; i < (size_t)SHARDS_GROUPS * (size_t)st->buckets; i++)
+        st->hist[i] *= scale;
+}
+
+// Feeds one batch through the sampling filter; -1 on allocation failure
+static int sample_batch(ShardsState *st, const ShardsConfig *config, const PageReference *refs, size_t n,
+                        long long *sampled) {
+    for (size_t i = 0; i < n; i++) {
+        uint64_t key = page_key(refs[i].pid, refs[i].page_num);
+        uint64_t h = shards_hash(key, config->salt);
+        uint64_t value = hash_value(h);
+        if (value >= st->threshold)
+            continue;
+        (*sampled)++;
+
+        long long distance = stackdist_access(&st->sd, key);
+        if (distance == -2)
+            return -1;
+        int bucket = st->max_frames + 1;
+        if (distance != STACK_DISTANCE_COLD) {
+            double rate = (double)st->threshold / (double)SHARDS_MODULUS;
+            double scaled = (double)distance / rate + 0.5;
+            if (scaled < (double)st->max_frames + 1)
+                bucket = scaled < 1 ? 1 : (int)scaled;
+        } else if (config->mode == SHARDS_FIXED_SIZE) {
+            heap_push(&st->heap, value, key);
+        }
+        st->hist[(size_t)hash_group(h) * (size_t)st->buckets + (size_t)bucket] += 1;
+
+        if (config->mode == SHARDS_FIXED_SIZE && st->heap.len > config->max_keys)
+            shrink_sample(st);
+    }
+    return 0;
+}
+
+static double clamp_ratio(double r) {
+    return r < 0 ? 0.0 : r > 1 ? 1.0 : r;
+}
+
+// Estimates the LRU miss-ratio curve of src for 1..max_frames frames from
+// a hashed sample of its pages. With SHARDS_FIXED_SIZE memory stays within
+// max_keys keys whatever the trace. Returns -1 on bad parameters or
+// allocation failure.
+int shards_mrc_source(RefSource *src, const ShardsConfig *config, int max_frames, ShardsMrc *mrc) {
+    memset(mrc, 0, sizeof(*mrc));
+    if (max_frames <= 0 || !config_valid(config))
+        return -1;
+    ShardsState st;
+    if (state_init(&st, config, max_frames) != 0)
+        return -1;
+    PageReference *batch = malloc(SIM_BATCH_SIZE * sizeof(PageReference));
+    mrc->miss_ratio = calloc((size_t)max_frames + 1, sizeof(double));
+    mrc->error = calloc((size_t)max_frames + 1, sizeof(double));
+    int status = batch && mrc->miss_ratio && mrc->error ? 0 : -1;
+
+    size_t n;
+    while (status == 0 && (n = src->read(src, batch, SIM_BATCH_SIZE)) > 0) {
+        mrc->accesses += (long long)n;
+        status = sample_batch(&st, config, batch, n, &mrc->sampled);
+    }
+    free(batch);
+    if (status != 0) {
+        state_free(&st);
+        shards_mrc_free(mrc);
+        return -1;
+    }
+
+    // SHARDS-adj: a sample that came out bigger or smaller than rate *
+    // accesses is corrected in the smallest distance bucket, which is where
+    // most of that error lands. Each group gets its share of the expected
+    // size, so the groups' spread includes the error of the sample's size.
+    mrc->max_frames = max_frames;
+    mrc->rate = (double)st.threshold / (double)SHARDS_MODULUS;
+    double expected = (double)mrc->accesses * mrc->rate / SHARDS_GROUPS;
+    double group_hits[SHARDS_GROUPS], group_total[SHARDS_GROUPS], group_miss[SHARDS_GROUPS];
+    double hits = 0, total = 0;
+    for (int g = 0; g < SHARDS_GROUPS; g++) {
+        const double *row = st.hist + (size_t)g * (size_t)st.buckets;
+        double sampled = 0;
+        for (int b = 1; b < st.buckets; b++)
+            sampled += row[b];
+        group_total[g] = expected > 0 ? expected : sampled;
+        group_hits[g] = group_total[g] - sampled; // May go negative; only the running sum matters
+        hits += group_hits[g];
+        total += group_total[g];
+    }
+
+    for (int c = 1; c <= max_frames; c++) {
+        for (int g = 0; g < SHARDS_GROUPS; g++) {
+            group_hits[g] += st.hist[(size_t)g * (size_t)st.buckets + (size_t)c];
+            hits += st.hist[(size_t)g * (size_t)st.buckets + (size_t)c];
+            group_miss[g] = group_total[g] > 0 ? clamp_ratio(1.0 - group_hits[g] / group_total[g]) : 0.0;
+        }
+        mrc->miss_ratio[c] = total > 0 ? clamp_ratio(1.0 - hits / total) : 0.0;
+        mrc->error[c] = group_error(group_miss, group_total, mrc->miss_ratio[c]);
+    }
+    state_free(&st);
+    return 0;
+}
+
+void shards_mrc_free(ShardsMrc *mrc) {
+    free(mrc->miss_ratio);
+    free(mrc->error);
+    mrc->miss_ratio = mrc->error = NULL;
+}
+
+void shards_mrc_write_csv(const ShardsMrc *mrc, FILE *out) {
+    fprintf(out, "frames,lru_miss_ratio,lru_miss_ratio_error\n");
+    for (int c = 1; c <= mrc->max_frames; c++)
+        fprintf(out, "%d,%.6f,%.6f\n", c, mrc->miss_ratio[c], mrc->error[c]);
+}
+
+// ---- Miniature simulation ----
+
+// Passes on only the sampled references of inner
+typedef struct {
+    RefSource source; // Must stay first: simulator_run_source() takes &source
+    RefSource *inner;
+    PageReference *batch;
+    uint64_t threshold;
+    uint64_t salt;
+    long long accesses;
+    long long sampled;
+    double group_faults[SHARDS_GROUPS];
+} SampledSource;
+
+static size_t sampled_read(RefSource *src, PageReference *out, size_t max) {
+    SampledSource *s = (SampledSource *)src;
+    size_t produced = 0;
+    while (produced < max) {
+        size_t want = max - produced < SIM_BATCH_SIZE ? max - produced : SIM_BATCH_SIZE;
+        size_t n = s->inner->read(s->inner, s->batch, want);
+        if (n == 0)
+            break;
+        s->accesses += (long long)n;
+        for (size_t i = 0; i < n; i++) {
+            uint64_t h = shards_hash(page_key(s->batch[i].pid, s->batch[i].page_num), s->salt);
+            if (hash_value(h) >= s->threshold)
+                continue;
+            out[produced++] = s->batch[i];
+        }
+    }
+    s->sampled += (long long)produced;
+    return produced;
+}
+
+// Fault events of the miniature run, attributed to their key's group
+static void count_faults(const SimEvent *events, size_t count, void *user_data) {
+    SampledSource *s = user_data;
+    for (size_t i = 0; i < count; i++) {
+        if (events[i].type == SIM_EVENT_FAULT)
+            s->group_faults[hash_group(shards_hash(page_key(events[i].pid, events[i].page), s->salt))] += 1;
+    }
+}
+
+// Runs sim's policy on the sampled references of src with memory scaled
+// by the sampling rate, and reports the estimated fault rate of the full
+// run. Needs SHARDS_FIXED_RATE, since memory cannot shrink mid-run. sim's
+// frame count, verbosity and sink are restored afterwards.
+int shards_simulate(Simulator *sim, RefSource *src, const ShardsConfig *config, ShardsEstimate *estimate) {
+    memset(estimate, 0, sizeof(*estimate));
+    if (config->mode != SHARDS_FIXED_RATE || !config_valid(config))
+        return -1;
+
+    SampledSource s;
+    memset(&s, 0, sizeof(s));
+    s.source.read = sampled_read;
+    s.inner = src;
+    s.threshold = initial_threshold(config);
+    s.salt = config->salt;
+    s.batch = malloc(SIM_BATCH_SIZE * sizeof(PageReference));
+    if (!s.batch)
+        return -1;
+
+    double rate = (double)s.threshold / (double)SHARDS_MODULUS;
+    int frames = sim->memory.frame_count;
+    int scaled = (int)((double)frames * rate + 0.5);
+    if (scaled < 1)
+        scaled = 1;
+    SimVerbosity verbosity = sim->verbosity;
+    SimEventSink sink = sim->sink;
+    void *sink_data = sim->sink_data;
+
+    int status = simulator_set_frame_count(sim, scaled);
+    if (status == 0) {
+        simulator_set_verbosity(sim, SIM_VERBOSITY_FAULTS);
+        simulator_set_event_sink(sim, count_faults, &s);
+        status = simulator_run_source(sim, &s.source);
+        simulator_set_event_sink(sim, sink, sink_data);
+        simulator_set_verbosity(sim, verbosity);
+        if (simulator_set_frame_count(sim, frames) != 0)
+            status = -1;
+    }
+    free(s.batch);
+    if (status != 0)
+        return status;
+
+    estimate->accesses = s.accesses;
+    estimate->sampled = s.sampled;
+    estimate->sampled_faults = sim->faults;
+    estimate->rate = rate;
+    estimate->scaled_frames = scaled;
+    // SHARDS-adj again: the sample's size is off from rate * accesses
+    // mostly because of whether a few hot pages made it in, and those
+    // pages' references are hits, so faults are divided by the expected
+    // sample size rather than the actual one
+    double expected = (double)s.accesses * rate;
+    estimate->fault_rate = expected > 0 ? fmin(1.0, (double)sim->faults / expected) : 0.0;
+    double group_rate[SHARDS_GROUPS], group_expected[SHARDS_GROUPS];
+    for (int g = 0; g < SHARDS_GROUPS; g++) {
+        group_expected[g] = expected / SHARDS_GROUPS;
+        group_rate[g] = group_expected[g] > 0 ? fmin(1.0, s.group_faults[g] / group_expected[g]) : 0.0;
+    }
+    estimate->error = group_error(group_rate, group_expected, estimate->fault_rate);
+    return 0;
+}
@@ -0,0 +1,61 @@
+#ifndef SHARDS_H
+#define SHARDS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "simulator.h"
+
+// Spatially hashed sampling (SHARDS, Waldspurger et al., FAST '15): a
+// (pid, page) key is in the sample when its hash falls below a threshold,
+// so every reference to a sampled page is kept and all others are skipped
+// after one hash. Stack distances measured on the sample, divided by the
+// rate, estimate the full trace's; a policy run on the sample with memory
+// scaled by the rate estimates the full run's fault rate.
+//
+// Error bounds come from random groups: sampled keys are split by other
+// hash bits into SHARDS_GROUPS independent subsamples, and the spread of
+// their estimates gives a standard error for the whole sample.
+
+#define SHARDS_MODULUS (1ULL << 24) // Hash values compared with the threshold
+#define SHARDS_GROUPS 16
+#define SHARDS_T_95 2.131 // Student t, 15 degrees of freedom, two-sided 95%
+
+typedef enum {
+    SHARDS_FIXED_RATE, // Sample a fixed fraction of keys; memory scales with it
+    SHARDS_FIXED_SIZE  // Keep at most max_keys keys, lowering the rate as needed
+} ShardsMode;
+
+typedef struct {
+    ShardsMode mode;
+    double rate;   // SHARDS_FIXED_RATE, in (0, 1]
+    int max_keys;  // SHARDS_FIXED_SIZE
+    uint64_t salt; // Changes which keys are sampled
+} ShardsConfig;
+
+// Estimated LRU miss ratio for 1..max_frames frames, with the half-width
+// of a 95% confidence interval
+typedef struct {
+    int max_frames;
+    long long accesses; // All references read
+    long long sampled;  // References that were simulated
+    double rate;        // Sampling rate at the end
+    double *miss_ratio; // [c] for c in 1..max_frames
+    double *error;
+} ShardsMrc;
+
+typedef struct {
+    long long accesses;
+    long long sampled;
+    long long sampled_faults;
+    double rate;
+    int scaled_frames; // Memory of the miniature run
+    double fault_rate;
+    double error;      // 95% half-width
+} ShardsEstimate;
+
+int shards_mrc_source(RefSource *src, const ShardsConfig *config, int max_frames, ShardsMrc *mrc);
+void shards_mrc_free(ShardsMrc *mrc);
+void shards_mrc_write_csv(const ShardsMrc *mrc, FILE *out);
+int shards_simulate(Simulator *sim, RefSource *src, const ShardsConfig *config, ShardsEstimate *estimate);
+
+#endif
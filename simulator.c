@@ -1,27 +1,177 @@
 #include "simulator.h"
+#include "checkpoint.h"
+#include "generator.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
 
-static long global_access_time = 0; // Used by LRU to track access order
-
 // Initializes the simulator with default settings
-void simulator_init(Simulator *sim) {
+static void simulator_init(Simulator *sim) {
     sim->page_size = 4096;
     sim->process_count = 1;
     memset(sim->process_sizes, 0, sizeof(sim->process_sizes));
     strcpy(sim->algorithm, "lru");
-    memset(sim->memory, 0, sizeof(sim->memory));
-    sim->memory_usage = 0;
+    sim->policy = policy_find("lru");
+    sim->verbosity = SIM_VERBOSITY_FULL;
     sim->reference_string_len = 0;
-    global_access_time = 0;
+    sim->access_time = 0;
+}
+
+// (Re)creates the policy state for the current algorithm and frame count
+static int rebuild_policy_state(Simulator *sim, const ReplacementPolicy *policy, int frames) {
+    void *state = policy->create(frames);
+    if (!state)
+        return -1;
+    if (sim->policy_state)
+        sim->policy->destroy(sim->policy_state);
+    sim->policy = policy;
+    sim->policy_state = state;
+    return 0;
+}
+
+// Allocates a simulator with `frames` physical frames and room for `capacity`
+// references up front; the reference string grows past that on demand
+Simulator *simulator_create(int frames, int capacity) {
+    Simulator *sim = calloc(1, sizeof(Simulator));
+    if (!sim)
+        return NULL;
+    simulator_init(sim);
+
+    if (frames <= 0)
+        frames = FRAME_COUNT;
+    if (capacity <= 0)
+        capacity = DEFAULT_REFERENCE_CAPACITY;
+    sim->reference_string = malloc((size_t)capacity * sizeof(PageReference));
+    sim->reference_capacity = capacity;
+    if (!sim->reference_string || frame_table_init(&sim->memory, frames) != 0 ||
+        event_ring_init(&sim->events, EVENT_RING_DEFAULT_CAPACITY) != 0 ||
+        sim_stats_init(&sim->stats, frames) != 0 ||
+        rebuild_policy_state(sim, sim->policy, frames) != 0) {
+        simulator_destroy(sim);
+        return NULL;
+    }
+    return sim;
+}
+
+void simulator_destroy(Simulator *sim) {
+    if (!sim)
+        return;
+    if (sim->policy_state)
+        sim->policy->destroy(sim->policy_state);
+    frame_table_free(&sim->memory);
+    event_ring_free(&sim->events);
+    sim_stats_free(&sim->stats);
+    swap_device_free(&sim->swap);
+    mmu_free(&sim->mmu);
+    timeline_free(&sim->timeline);
+    if (sim->prefetch_state)
+        sim->prefetcher->destroy(sim->prefetch_state);
+    free(sim->reference_string);
+    free(sim);
+}
+
+// Resizes physical memory; returns -1 and keeps the old size on failure
+int simulator_set_frame_count(Simulator *sim, int frames) {
+    if (frames <= 0)
+        return -1;
+    if (frames == sim->memory.frame_count)
+        return 0;
+    FrameTable resized;
+    if (frame_table_init(&resized, frames) != 0)
+        return -1;
+    if (rebuild_policy_state(sim, sim->policy, frames) != 0) {
+        frame_table_free(&resized);
+        return -1;
+    }
+    frame_table_free(&sim->memory);
+    sim->memory = resized;
+    return 0;
 }
 
-// Sets the page replacement algorithm
-void simulator_set_algorithm(Simulator *sim, const char *algorithm) {
-    strncpy(sim->algorithm, algorithm, sizeof(sim->algorithm) - 1);`
+// Sets the page replacement algorithm; unknown names fall back to FIFO.
+// Returns -1 and keeps the previous algorithm if its state cannot be allocated.
+int simulator_set_algorithm(Simulator *sim, const char *algorithm) {
+    const ReplacementPolicy *policy = policy_find(algorithm);
+    if (!policy)
+        policy = policy_find("fifo");
+    if (rebuild_policy_state(sim, policy, sim->memory.frame_count) != 0)
+        return -1;
+    strncpy(sim->algorithm, algorithm, sizeof(sim->algorithm) - 1);
     sim->algorithm[sizeof(sim->algorithm) - 1] = '\0';
+    return 0;
+}
+
+// Sets how much of each run is recorded as events
+void simulator_set_verbosity(Simulator *sim, SimVerbosity verbosity) {
+    sim->verbosity = verbosity;
+}
+
+// Passes events on to the caller's sink, charging the time spent there to
+// formatting rather than to the simulation that happened to fill the ring
+static void timed_sink(const SimEvent *events, size_t count, void *user_data) {
+    Simulator *sim = user_data;
+    sim_stats_phase_end(&sim->stats, SIM_PHASE_SIMULATE);
+    sim->sink(events, count, sim->sink_data);
+    sim_stats_phase_end(&sim->stats, SIM_PHASE_FORMAT);
+}
+
+// Streams events to sink in batches instead of keeping only the most recent ones
+void simulator_set_event_sink(Simulator *sim, SimEventSink sink, void *user_data) {
+    sim->sink = sink;
+    sim->sink_data = user_data;
+    sim->events.sink = sink ? timed_sink : NULL;
+    sim->events.sink_data = sink ? sim : NULL;
+}
+
+// Reports progress after each batch and lets the callback cancel the run
+void simulator_set_progress(Simulator *sim, SimProgressFn progress, void *user_data) {
+    sim->progress = progress;
+    sim->progress_data = user_data;
+}
+
+// Sets the accesses per fault-rate window in sim->stats; 0 turns windows off
+void simulator_set_stats_window(Simulator *sim, long long window) {
+    sim->stats.window = window > 0 ? window : 0;
+}
+
+// Asks for hardware counters around the simulation loop in later runs;
+// sim->stats.perf_status says after a run whether they could be opened
+void simulator_set_perf_counters(Simulator *sim, int enabled) {
+    sim->stats.perf_requested = enabled;
+}
+
+// Prices page traffic with a swap device model in later runs; NULL turns
+// it off. Returns -1, with the model off, if config is out of range.
+int simulator_set_swap(Simulator *sim, const SwapConfig *config) {
+    return swap_device_configure(&sim->swap, config);
+}
+
+// Translates every access of later runs through a TLB and page walk
+// model; NULL turns it off. Returns -1, with it off, if config is out of range.
+int simulator_set_mmu(Simulator *sim, const MmuConfig *config) {
+    return mmu_configure(&sim->mmu, config);
+}
+
+// Summarizes later runs over time for drawing (see timeline.h), or stops
+// to. Returns -1, with it off, if rate_window is not positive or memory runs out.
+int simulator_set_timeline(Simulator *sim, int enabled, int rate_window) {
+    return timeline_configure(&sim->timeline, enabled, rate_window);
+}
+
+// Selects the prefetcher for later runs by registry name, NULL for none;
+// degree 0 takes its default. Returns -1, keeping the previous one, for an
+// unknown name or if its state cannot be allocated.
+int simulator_set_prefetcher(Simulator *sim, const char *name, int degree) {
+    const Prefetcher *prefetcher = name ? prefetcher_find(name) : NULL;
+    void *state = NULL;
+    if (name && (!prefetcher || !(state = prefetcher->create(degree > 0 ? degree : prefetcher->default_degree))))
+        return -1;
+    if (sim->prefetch_state)
+        sim->prefetcher->destroy(sim->prefetch_state);
+    sim->prefetcher = prefetcher;
+    sim->prefetch_state = state;
+    return 0;
 }
 
 // Sets the page size (default fallback is 4096)
@@ -40,172 +190,589 @@ void simulator_set_process_size(Simulator *sim, int index, int size) {
         sim->process_sizes[index] = size;
 }
 
-// Checks if a page is in memory; updates access time if LRU
-static int is_page_in_memory(Simulator *sim, int pid, int page) {
-    for (int i = 0; i < sim->memory_usage; i++) {
-        if (sim->memory[i].process_id == pid && sim->memory[i].page == page) {
-            if (strcmp(sim->algorithm, "lru") == 0) {
-                sim->memory[i].last_access_time = global_access_time;
-            }
-            return sim->memory[i].frame;
-        }
+// Checks if a page is in memory; a hit is reported to the policy
+static int is_page_in_memory(Simulator *sim, int pid, long long page, const PolicyAccess *access) {
+    int frame = frame_table_lookup(&sim->memory, pid, page);
+    if (frame == -1)
+        return -1;
+    sim->memory.frames[frame].last_access_time = sim->access_time;
+    sim->memory.dirty[frame] |= (unsigned char)access->write;
+    sim->policy->on_hit(sim->policy_state, frame, access);
+    sim_stats_hit(&sim->stats, pid, frame);
+    return frame;
+}
+
+// Records an event if the verbosity level asks for it
+static void emit_event(Simulator *sim, SimEventType type, int pid, long long page, int frame) {
+    SimEvent ev = {sim->access_time, page, frame, (uint16_t)pid, (unsigned char)type};
+    event_ring_push(&sim->events, &ev);
+}
+
+// Asks the replacement policy for a victim and evicts it; returns whether
+// the victim was dirty and so has to be written back
+static int evict_page(Simulator *sim, const PolicyAccess *access) {
+    FrameTable *ft = &sim->memory;
+    int victim_frame = sim->policy->choose_victim(sim->policy_state, access);
+
+    PageFrame *victim = &ft->frames[victim_frame];
+    if (sim->verbosity >= SIM_VERBOSITY_FAULTS)
+        emit_event(sim, SIM_EVENT_EVICT, victim->process_id, victim->page, victim_frame);
+    sim->evictions++;
+    sim_stats_evict(&sim->stats, victim->process_id, victim_frame);
+    int dirty = ft->dirty[victim_frame];
+    sim->writebacks += dirty;
+    if (sim->mmu.enabled)
+        mmu_invalidate(&sim->mmu, victim->process_id, victim->page);
+    if (ft->prefetched[victim_frame]) {
+        sim->prefetch.wasted++;
+        sim->prefetcher->wasted(sim->prefetch_state, victim->process_id, victim->page);
+    }
+
+    // Free the victim's frame in place; no other frame moves
+    frame_table_remove(ft, victim_frame);
+    return dirty;
+}
+
+// Charges a fault to the swap model: the read of the new page, behind the
+// write of a dirty victim or an early write-back of the frame still in
+// flight. The fault stalls until the read completes.
+static void swap_page_in(Simulator *sim, int frame, int victim_dirty) {
+    SwapDevice *dev = &sim->swap;
+    double start = dev->now > dev->frame_ready[frame] ? dev->now : dev->frame_ready[frame];
+    if (victim_dirty)
+        start = swap_submit(dev, start, 1);
+    double done = swap_submit(dev, start, 0);
+    dev->stall_ns += done - dev->now;
+    dev->now = done;
+}
+
+// PolicyCleanFn under asynchronous write-back: queues the write now and
+// keeps the frame from taking a new page until it completes
+static int clean_frame(void *ctx, int frame) {
+    Simulator *sim = ctx;
+    SwapDevice *dev = &sim->swap;
+    if (!sim->memory.dirty[frame])
+        return 0;
+    if (swap_queue_full(dev, dev->now)) {
+        dev->queue_full++;
+        return -1;
     }
-    return -1;
+    dev->frame_ready[frame] = swap_submit(dev, dev->now, 1);
+    sim->memory.dirty[frame] = 0;
+    sim->writebacks++;
+    return 0;
 }
 
-// Applies selected page replacement algorithm and evicts a page
-static int evict_page(Simulator *sim, char *log_output, int current_ref_idx) {
-    int victim_frame_idx = -1;
-    char msg[100];
+// Brings in a page the prefetcher named unless it is resident. It takes a
+// frame from the policy like a demand fault, but its read does not stall,
+// and the policy may not take the demand page's frame for it. Returns -1
+// if the frame table runs out of memory.
+static int prefetch_page(Simulator *sim, int pid, long long page, int demand_frame, const PolicyAccess *demand) {
+    if (!page_fits_key(page) || frame_table_lookup(&sim->memory, pid, page) != -1)
+        return 0;
+    PolicyAccess access = *demand;
+    access.key = page_key(pid, page);
+    access.write = 0;
+    access.pinned = demand_frame;
+    int victim_dirty = 0;
+    if (sim->memory.used == sim->memory.frame_count) {
+        victim_dirty = evict_page(sim, &access);
+        sim->prefetch.evictions++;
+    }
 
-    if (strcmp(sim->algorithm, "fifo") == 0) {
-        // FIFO: Evict the first page loaded
-        victim_frame_idx = 0;
+    int frame = frame_table_insert(&sim->memory, pid, page);
+    if (frame < 0)
+        return -1;
+    sim->memory.prefetched[frame] = 1;
+    if (sim->swap.enabled) {
+        SwapDevice *dev = &sim->swap;
+        double start = dev->now > dev->frame_ready[frame] ? dev->now : dev->frame_ready[frame];
+        if (victim_dirty)
+            start = swap_submit(dev, start, 1);
+        dev->frame_ready[frame] = swap_submit(dev, start, 0);
+    }
+    sim->memory.frames[frame].last_access_time = sim->access_time;
+    sim->policy->on_miss(sim->policy_state, frame, &access);
+    sim->prefetch.issued++;
+    if (sim->timeline.enabled)
+        timeline_prefetch(&sim->timeline, frame, pid);
 
-    } else if (strcmp(sim->algorithm, "lru") == 0) {
-        // LRU: Evict the page with the smallest access time
-        long min_access_time = LONG_MAX;
-        for (int i = 0; i < sim->memory_usage; i++) {
-            if (sim->memory[i].last_access_time < min_access_time) {
-                min_access_time = sim->memory[i].last_access_time;
-                victim_frame_idx = i;
-            }
-        }
+    if (sim->verbosity >= SIM_VERBOSITY_FAULTS)
+        emit_event(sim, SIM_EVENT_PREFETCH, pid, page, frame);
+    return 0;
+}
+
+// Feeds a would-be miss to the prefetcher and loads what it predicts; one
+// prediction may take at most half of memory, and never frame, which holds
+// the page just accessed
+static int run_prefetcher(Simulator *sim, int pid, long long page, int frame, int prefetched,
+                          const PolicyAccess *access) {
+    long long pages[PREFETCH_MAX_PAGES];
+    int limit = sim->memory.frame_count / 2 < PREFETCH_MAX_PAGES ? sim->memory.frame_count / 2 : PREFETCH_MAX_PAGES;
+    int n = sim->prefetcher->predict(sim->prefetch_state, pid, page, prefetched, pages, limit);
+    for (int i = 0; i < n; i++) {
+        if (prefetch_page(sim, pid, pages[i], frame, access) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+// First use of a prefetched page: it counts as a hit for the prefetcher,
+// and under the swap model the access waits for the read if it is not in
+static int prefetch_used(Simulator *sim, int pid, long long page, int frame, const PolicyAccess *access) {
+    sim->memory.prefetched[frame] = 0;
+    sim->prefetch.hits++;
+    SwapDevice *dev = &sim->swap;
+    if (dev->enabled && dev->frame_ready[frame] > dev->now) {
+        dev->stall_ns += dev->frame_ready[frame] - dev->now;
+        dev->now = dev->frame_ready[frame];
+    }
+    return run_prefetcher(sim, pid, page, frame, 1, access);
+}
+
+// Loads a page into memory; triggers eviction if memory full. Returns -1 if
+// the frame table runs out of memory.
+static int load_page(Simulator *sim, int pid, long long page, const PolicyAccess *access) {
+    int victim_dirty = 0;
+    if (sim->memory.used == sim->memory.frame_count) {
+        // Perform eviction using selected page replacement algorithm
+        victim_dirty = evict_page(sim, access);
+    }
+
+    int frame = frame_table_insert(&sim->memory, pid, page);
+    if (frame < 0)
+        return -1;
+    sim->memory.dirty[frame] = (unsigned char)access->write;
+    if (sim->swap.enabled)
+        swap_page_in(sim, frame, victim_dirty);
+    sim->memory.frames[frame].last_access_time = sim->access_time;
+    sim->policy->on_miss(sim->policy_state, frame, access);
+    sim_stats_fault(&sim->stats, pid, frame);
+    if (sim->timeline.enabled)
+        timeline_fault(&sim->timeline, frame, pid);
+
+    if (sim->verbosity >= SIM_VERBOSITY_FAULTS)
+        emit_event(sim, SIM_EVENT_FAULT, pid, page, frame);
+    return sim->prefetching ? run_prefetcher(sim, pid, page, frame, 0, access) : 0;
+}
+
+// Grows the reference string geometrically so appends stay amortized O(1)
+static int reserve_references(Simulator *sim, long long needed) {
+    if (needed <= sim->reference_capacity)
+        return 0;
+    if (needed > INT_MAX)
+        return -1;
+    long long capacity = sim->reference_capacity > 0 ? sim->reference_capacity : DEFAULT_REFERENCE_CAPACITY;
+    while (capacity < needed)
+        capacity *= 2;
+    if (capacity > INT_MAX)
+        capacity = INT_MAX;
+    PageReference *grown = realloc(sim->reference_string, (size_t)capacity * sizeof(PageReference));
+    if (!grown)
+        return -1;
+    sim->reference_string = grown;
+    sim->reference_capacity = (int)capacity;
+    return 0;
+}
 
-    } else if (strcmp(sim->algorithm, "optimal") == 0) {
-        // Optimal: Evict the page with the farthest next use or never used again
-        int farthest_future_use = -1;
-        int page_to_evict_mem_idx = -1;
-
-        for (int i = 0; i < sim->memory_usage; i++) {
-            int pid = sim->memory[i].process_id;
-            int page = sim->memory[i].page;
-            int next_use_idx = INT_MAX;
-
-            for (int k = current_ref_idx + 1; k < sim->reference_string_len; k++) {
-                if (sim->reference_string[k].pid == pid &&
-                    sim->reference_string[k].page_num == page) {
-                    next_use_idx = k;
-                    break;
-                }
-            }
-
-            if (next_use_idx == INT_MAX) {
-                page_to_evict_mem_idx = i;
-                break;
-            } else if (next_use_idx > farthest_future_use) {
-                farthest_future_use = next_use_idx;
-                page_to_evict_mem_idx = i;
-            }
+// Clears memory, counters and events before a run and starts its clocks;
+// returns -1 if the statistics cannot be sized for this run
+static int reset_run(Simulator *sim) {
+    frame_table_reset(&sim->memory);
+    event_ring_reset(&sim->events);
+    sim->access_time = 0;
+    sim->trace_hash = CHECKPOINT_HASH_SEED;
+    sim->hits = sim->faults = sim->evictions = sim->writebacks = 0;
+    memset(&sim->prefetch, 0, sizeof(sim->prefetch));
+    sim->prefetching = sim->prefetcher && !sim->policy->needs_future;
+    if (sim->prefetching)
+        sim->prefetcher->reset(sim->prefetch_state);
+    if (sim_stats_reset(&sim->stats, sim->memory.frame_count) != 0 ||
+        swap_device_reset(&sim->swap, sim->memory.frame_count, sim->page_size) != 0 ||
+        timeline_reset(&sim->timeline, &sim->memory, 0) != 0)
+        return -1;
+    mmu_reset(&sim->mmu, sim->page_size);
+    if (sim->stats.perf_requested)
+        sim_stats_perf_open(&sim->stats);
+    sim_stats_phase_begin(&sim->stats);
+    return 0;
+}
+
+// Simulates a batch of accesses; first_index is the position of refs[0] in
+// the whole run, which policies such as Optimal key their metadata on.
+// Returns -1 at a pid or page number page_key() cannot tell apart, or if
+// memory runs out.
+static int simulate_references(Simulator *sim, const PageReference *refs, int count, long long first_index) {
+    int modeled = sim->swap.enabled;
+    PolicyCleanFn clean = modeled && sim->swap.config.writeback == SWAP_WRITEBACK_ASYNC ? clean_frame : NULL;
+    for (int i = 0; i < count; i++) {
+        sim->access_time++;
+        sim->trace_hash = checkpoint_hash_reference(sim->trace_hash, refs[i].pid, refs[i].page_num, refs[i].write);
+        if (modeled)
+            sim->swap.now += sim->swap.config.access_ns;
+        int current_pid = refs[i].pid;
+        long long current_page = refs[i].page_num;
+        if (!page_fits_key(current_page) || current_pid < 0 || current_pid > UINT16_MAX)
+            return -1; // Its key would alias another page's
+
+        if (sim->verbosity >= SIM_VERBOSITY_FULL)
+            emit_event(sim, SIM_EVENT_ACCESS, current_pid, current_page, -1);
+        if (sim->mmu.enabled)
+            mmu_translate(&sim->mmu, current_pid, current_page);
+
+        PolicyAccess access = {page_key(current_pid, current_page), first_index + i, refs[i].write,
+                               sim->memory.dirty, clean, sim, -1};
+        int frame = is_page_in_memory(sim, current_pid, current_page, &access);
+        if (frame == -1) {
+            // Page fault → trigger page load and possible eviction
+            sim->faults++;
+            if (load_page(sim, current_pid, current_page, &access) != 0)
+                return -1;
+        } else {
+            // Page hit: already in memory
+            sim->hits++;
+            if (sim->verbosity >= SIM_VERBOSITY_FULL)
+                emit_event(sim, SIM_EVENT_HIT, current_pid, current_page, frame);
+            if (sim->memory.prefetched[frame] && prefetch_used(sim, current_pid, current_page, frame, &access) != 0)
+                return -1;
         }
-        victim_frame_idx = page_to_evict_mem_idx;
-    } else {
-        // Fallback: default to FIFO
-        victim_frame_idx = 0;
+        if (sim->timeline.enabled)
+            timeline_access(&sim->timeline, frame == -1);
+    }
+    return 0;
+}
+
+// Hands the last events to the sink and closes the run's statistics
+static void finish_run(Simulator *sim) {
+    event_ring_flush(&sim->events);
+    sim_stats_phase_end(&sim->stats, SIM_PHASE_FORMAT);
+    sim_stats_finish(&sim->stats);
+    if (sim->stats.perf_requested) {
+        sim_stats_perf_read(&sim->stats);
+        sim_stats_perf_close(&sim->stats);
     }
+}
 
-    PageFrame victim = sim->memory[victim_frame_idx];
-    snprintf(msg, sizeof(msg), "Page-Out: Process %d Page %d from Frame %d (Algorithm: %s)\n",
-             victim.process_id, victim.page, victim.frame, sim->algorithm);
-    strcat(log_output, msg);
+// Simulates one batch with the hardware counters running, if they are open
+static int simulate_batch(Simulator *sim, const PageReference *refs, int count, long long first_index) {
+    sim_stats_perf_enable(&sim->stats, 1);
+    int status = simulate_references(sim, refs, count, first_index);
+    sim_stats_perf_enable(&sim->stats, 0);
+    sim_stats_phase_end(&sim->stats, SIM_PHASE_SIMULATE);
+    return status;
+}
 
-    int freed_frame = victim.frame;
+// Between batches: hands buffered events to the sink so output keeps pace,
+// then asks the progress callback whether to go on
+static int batch_done(Simulator *sim, long long done, long long total) {
+    if (!sim->progress)
+        return 0;
+    event_ring_flush(&sim->events);
+    int cancel = sim->progress(done, total, sim->progress_data);
+    sim_stats_phase_end(&sim->stats, SIM_PHASE_FORMAT);
+    return cancel ? SIM_CANCELLED : 0;
+}
 
-    // Remove victim from memory and shift remaining frames
-    for (int i = victim_frame_idx; i < sim->memory_usage - 1; i++) {
-        sim->memory[i] = sim->memory[i + 1];
+// Simulates refs from position `first` to the end and closes the run
+static int simulate_array_from(Simulator *sim, const PageReference *refs, int len, int first) {
+    int status = 0;
+    for (int done = first; done < len && status == 0;) {
+        int count = len - done < SIM_BATCH_SIZE ? len - done : SIM_BATCH_SIZE;
+        status = simulate_batch(sim, refs + done, count, done);
+        done += count;
+        if (status == 0)
+            status = batch_done(sim, done, len);
     }
-    sim->memory_usage--;
+    finish_run(sim);
+    return status;
+}
 
-    return freed_frame;
+// Replays refs from the start; refs is only read, so several simulators
+// may share one array across threads
+static int simulate_reference_array(Simulator *sim, const PageReference *refs, int len) {
+    // Optimal precomputes every reference's next use here in one backward pass
+    if (sim->policy->reset(sim->policy_state, refs, len) != 0)
+        return -1;
+    return simulate_array_from(sim, refs, len, 0);
 }
 
-// Loads a page into memory; triggers eviction if memory full
-static void load_page(Simulator *sim, int pid, int page, char *log_output, int current_ref_idx) {
-    int frame;
-    char msg[100];
+// Simulates the rest of src batch by batch and closes the run
+static int simulate_stream(Simulator *sim, RefSource *src) {
+    PageReference *batch = malloc(SIM_BATCH_SIZE * sizeof(PageReference));
+    if (!batch)
+        return -1;
+    int status = 0;
+    size_t n;
+    while (status == 0 && (n = src->read(src, batch, SIM_BATCH_SIZE)) > 0) {
+        sim_stats_phase_end(&sim->stats, SIM_PHASE_GENERATE);
+        status = simulate_batch(sim, batch, (int)n, sim->access_time);
+        if (status == 0)
+            status = batch_done(sim, sim->access_time, -1);
+    }
+    sim_stats_phase_end(&sim->stats, SIM_PHASE_GENERATE);
+    free(batch);
+    finish_run(sim);
+    return status;
+}
 
-    if (sim->memory_usage < FRAME_COUNT) {
-        frame = sim->memory_usage;
-    } else {
-        // Perform eviction using selected page replacement algorithm
-        frame = evict_page(sim, log_output, current_ref_idx);
+// Replays the materialized reference string from the start
+static int simulate_reference_string(Simulator *sim) {
+    return simulate_reference_array(sim, sim->reference_string, sim->reference_string_len);
+}
+
+// The built-in workload: every page of P0 in order, then every page of P1,
+// and so on
+static void classic_workload(const Simulator *sim, Generator *gen) {
+    GenProcessSpec specs[MAX_PROCESSES];
+    for (int pid = 0; pid < sim->process_count; pid++) {
+        long long pages = ((long long)sim->process_sizes[pid] * 1024) / sim->page_size;
+        gen_process_defaults(&specs[pid], GEN_SEQUENTIAL, pages);
+        specs[pid].length = pages > 0 ? pages : 0;
     }
+    generator_init(gen, specs, sim->process_count, 0, 0, 0);
+}
 
-    sim->memory[sim->memory_usage].process_id = pid;
-    sim->memory[sim->memory_usage].page = page;
-    sim->memory[sim->memory_usage].frame = frame;
-    sim->memory[sim->memory_usage].last_access_time = global_access_time;
+// Fills reference_string with the built-in workload. Returns -1 if the
+// references do not fit in memory.
+int simulator_generate_references(Simulator *sim) {
+    Generator gen;
+    classic_workload(sim, &gen);
+    return simulator_load_source(sim, &gen.source);
+}
 
-    sim->memory_usage++;
+// Collects the whole of src into reference_string; the time it takes is
+// the GENERATE phase of the runs that replay it
+int simulator_load_source(Simulator *sim, RefSource *src) {
+    sim->reference_string_len = 0;
+    sim->stats.phases[SIM_PHASE_GENERATE] = (SimPhaseTime){0, 0};
+    sim_stats_phase_begin(&sim->stats);
+    for (;;) {
+        if (reserve_references(sim, (long long)sim->reference_string_len + SIM_BATCH_SIZE) != 0)
+            return -1;
+        size_t n = src->read(src, sim->reference_string + sim->reference_string_len, SIM_BATCH_SIZE);
+        if (n == 0)
+            break;
+        sim->reference_string_len += (int)n;
+    }
+    sim_stats_phase_end(&sim->stats, SIM_PHASE_GENERATE);
+    return 0;
+}
+
+// Executes the simulation of memory accesses with page replacement over
+// the built-in workload, streamed unless the policy needs the future.
+// Events go to sim->events according to sim->verbosity; returns -1 if
+// memory for the reference string or the Optimal index runs out, and
+// SIM_CANCELLED if the progress callback stopped the run.
+int simulator_run(Simulator *sim) {
+    Generator gen;
+    classic_workload(sim, &gen);
+    return simulator_run_source(sim, &gen.source);
+}
 
-    snprintf(msg, sizeof(msg), "Page-In:  Process %d Page %d -> Frame %d\n", pid, page, frame);
-    strcat(log_output, msg);
+// Runs the simulation over a caller-owned reference array without copying it
+int simulator_run_references(Simulator *sim, const PageReference *refs, int len) {
+    if (reset_run(sim) != 0)
+        return -1;
+    return simulate_reference_array(sim, refs, len);
 }
 
-// Executes the simulation of memory accesses with page replacement
-void simulator_run(Simulator *sim, char *log_output) {
-    sim->memory_usage = 0;
-    memset(sim->memory, 0, sizeof(sim->memory));
-    global_access_time = 0;
+// Runs the simulation over references pulled from src. Each batch goes
+// straight into the simulation loop; only Optimal, which needs the future,
+// first collects the whole stream into reference_string.
+int simulator_run_source(Simulator *sim, RefSource *src) {
     sim->reference_string_len = 0;
+    sim->stats.phases[SIM_PHASE_GENERATE] = (SimPhaseTime){0, 0};
+    if (reset_run(sim) != 0)
+        return -1;
 
-    // Generate reference string based on process sizes
-    for (int pid = 0; pid < sim->process_count; pid++) {
-        int num_pages = (sim->process_sizes[pid] * 1024) / sim->page_size;
-        for (int page = 0; page < num_pages; page++) {
-            if (sim->reference_string_len < MAX_REFERENCES) {
-                sim->reference_string[sim->reference_string_len].pid = pid;
-                sim->reference_string[sim->reference_string_len].page_num = page;
-                sim->reference_string_len++;
-            } else {
-                strcat(log_output, "Warning: Reference string exceeded MAX_REFERENCES. Simulation truncated.\n");
-                goto end_reference_string_generation;
-            }
-        }
+    if (sim->policy->needs_future) {
+        if (simulator_load_source(sim, src) != 0)
+            return -1;
+        sim_stats_phase_begin(&sim->stats);
+        return simulate_reference_string(sim);
     }
 
-end_reference_string_generation:
-    strcat(log_output, "Reference String Generated. Total Accesses: ");
-    char ref_len_str[16];
-    sprintf(ref_len_str, "%d\n\n", sim->reference_string_len);
-    strcat(log_output, ref_len_str);
+    if (sim->policy->reset(sim->policy_state, NULL, 0) != 0)
+        return -1;
+    return simulate_stream(sim, src);
+}
 
-    // Simulate page accesses and apply page replacement logic
-    for (int i = 0; i < sim->reference_string_len; i++) {
-        global_access_time++;
-        int current_pid = sim->reference_string[i].pid;
-        int current_page = sim->reference_string[i].page_num;
+// Picks a stopped run up again: one the progress callback cancelled, or
+// one simulator_load_checkpoint() restored
+static void reopen_run(Simulator *sim) {
+    event_ring_reset(&sim->events);
+    sim_stats_reopen(&sim->stats);
+    if (sim->stats.perf_requested)
+        sim_stats_perf_open(&sim->stats); // Counts only what is left of the run
+    sim_stats_phase_begin(&sim->stats);
+}
 
-        char current_access_msg[64];
-        snprintf(current_access_msg, sizeof(current_access_msg), "Accessing P%d, Page %d (Time %ld)\n",
-                 current_pid, current_page, global_access_time);
-        strcat(log_output, current_access_msg);
+// Simulates the rest of a stopped run over the references in src that
+// follow the ones it has simulated. A run that needs the future goes on
+// over reference_string instead, which it was started on.
+int simulator_continue_source(Simulator *sim, RefSource *src) {
+    if (sim->policy->needs_future)
+        return simulator_continue_references(sim, sim->reference_string, sim->reference_string_len);
+    reopen_run(sim);
+    return simulate_stream(sim, src);
+}
 
-        if (is_page_in_memory(sim, current_pid, current_page) == -1) {
-            // Page fault → trigger page load and possible eviction
-            load_page(sim, current_pid, current_page, log_output, i);
-        } else {
-            // Page hit: already in memory
-            char msg[64];
-            snprintf(msg, sizeof(msg), "Access:   Process %d Page %d (In Memory)\n", current_pid, current_page);
-            strcat(log_output, msg);
-        }
+// Simulates the rest of a stopped run over refs, the whole of the run it
+// was started on
+int simulator_continue_references(Simulator *sim, const PageReference *refs, int len) {
+    if (sim->access_time > len)
+        return -1;
+    reopen_run(sim);
+    return simulate_array_from(sim, refs, len, (int)sim->access_time);
+}
+
+// Reads past the references a run restored from a checkpoint has already
+// simulated, so that simulator_continue_source() gets the ones after them.
+// Returns -1 if src ends first or starts with other references than the
+// checkpointed run saw.
+int simulator_skip_source(Simulator *sim, RefSource *src) {
+    PageReference *batch = malloc(SIM_BATCH_SIZE * sizeof(PageReference));
+    if (!batch)
+        return -1;
+    uint64_t hash = CHECKPOINT_HASH_SEED;
+    long long left = sim->access_time;
+    size_t n = 1;
+    while (left > 0 && n > 0) {
+        n = src->read(src, batch, left < SIM_BATCH_SIZE ? (size_t)left : SIM_BATCH_SIZE);
+        for (size_t i = 0; i < n; i++)
+            hash = checkpoint_hash_reference(hash, batch[i].pid, batch[i].page_num, batch[i].write);
+        left -= (long long)n;
+    }
+    free(batch);
+    return left == 0 && hash == sim->trace_hash ? 0 : -1;
+}
+
+// Stepped runs, for callers that drive several simulators over one pass of
+// the references: begin, then step through consecutive batches, then end.
+// refs/len is the whole run for policies that need the future, NULL/0
+// otherwise; the batches must then be those same references in order.
+int simulator_begin_run(Simulator *sim, const PageReference *refs, int len) {
+    if (reset_run(sim) != 0)
+        return -1;
+    return sim->policy->reset(sim->policy_state, refs, len);
+}
+
+// Simulates the next count references; first_index is the position of
+// refs[0] in the run. Returns -1 as simulate_references() does; the run
+// cannot go on then.
+int simulator_step(Simulator *sim, const PageReference *refs, int count, long long first_index) {
+    return simulate_batch(sim, refs, count, first_index);
+}
+
+void simulator_end_run(Simulator *sim) {
+    finish_run(sim);
+}
+
+typedef struct {
+    long time;
+    int frame;
+} ResidentFrame;
+
+static int by_last_access(const void *a, const void *b) {
+    long x = ((const ResidentFrame *)a)->time, y = ((const ResidentFrame *)b)->time;
+    return (x > y) - (x < y);
+}
+
+// Gives a stepped run `frames` frames from here on, keeping at most `keep`
+// of the resident pages: the most recently used ones. The rest are evicted.
+// The policy starts over with the kept pages loaded in order of last use,
+// so recency survives but other history, such as reference bits, does not.
+// Returns -1 with memory unchanged if frames < 1, if the policy needs the
+// future or the swap model is on, or if memory runs out.
+int simulator_resize_memory(Simulator *sim, int frames, int keep) {
+    FrameTable *ft = &sim->memory;
+    if (frames < 1 || sim->policy->needs_future || sim->swap.enabled)
+        return -1;
+    ResidentFrame *resident = malloc((size_t)(ft->used > 0 ? ft->used : 1) * sizeof(ResidentFrame));
+    void *state = sim->policy->create(frames);
+    FrameTable resized;
+    if (!resident || !state || sim->policy->reset(state, NULL, 0) != 0 ||
+        sim_stats_grow_frames(&sim->stats, frames) != 0 || frame_table_init(&resized, frames) != 0) {
+        free(resident);
+        if (state)
+            sim->policy->destroy(state);
+        return -1;
+    }
 
-        // Print memory state after each access
-        strcat(log_output, "Current Memory State: [");
-        for (int j = 0; j < FRAME_COUNT; j++) {
-            if (j < sim->memory_usage) {
-                char frame_info[32];
-                snprintf(frame_info, sizeof(frame_info), "F%d:P%d.P%d(T%ld)", 
-                         sim->memory[j].frame, sim->memory[j].process_id, 
-                         sim->memory[j].page, sim->memory[j].last_access_time);
-                strcat(log_output, frame_info);
-            } else {
-                strcat(log_output, "Empty");
-            }
-            if (j < FRAME_COUNT - 1) strcat(log_output, ", ");
+    int count = 0;
+    for (int f = 0; f < ft->frame_count; f++) {
+        if (ft->keys[f] != PAGEMAP_EMPTY)
+            resident[count++] = (ResidentFrame){ft->frames[f].last_access_time, f};
+    }
+    qsort(resident, (size_t)count, sizeof(ResidentFrame), by_last_access);
+    if (keep > frames)
+        keep = frames;
+    int drop = count > keep ? count - keep : 0;
+    for (int i = 0; i < count; i++) {
+        int f = resident[i].frame;
+        PageFrame *page = &ft->frames[f];
+        if (i < drop) {
+            if (sim->verbosity >= SIM_VERBOSITY_FAULTS)
+                emit_event(sim, SIM_EVENT_EVICT, page->process_id, page->page, f);
+            sim->evictions++;
+            sim->writebacks += ft->dirty[f];
+            sim_stats_evict(&sim->stats, page->process_id, f);
+            if (sim->mmu.enabled)
+                mmu_invalidate(&sim->mmu, page->process_id, page->page);
+            continue;
         }
-        strcat(log_output, "]\n\n");
+        int moved = frame_table_insert(&resized, page->process_id, page->page);
+        resized.frames[moved].last_access_time = page->last_access_time;
+        resized.dirty[moved] = ft->dirty[f];
+        resized.prefetched[moved] = ft->prefetched[f];
+        PolicyAccess access = {ft->keys[f], sim->access_time, 0, resized.dirty, NULL, NULL, -1};
+        sim->policy->on_miss(state, moved, &access);
     }
-}
\ No newline at end of file
+    free(resident);
+
+    frame_table_free(ft);
+    *ft = resized;
+    sim->policy->destroy(sim->policy_state);
+    sim->policy_state = state;
+    return 0;
+}
+
+// Writes the end-of-run counters as text
+size_t simulator_format_summary(const Simulator *sim, char *buf, size_t size) {
+    long long accesses = sim->hits + sim->faults;
+    double fault_rate = accesses > 0 ? 100.0 * (double)sim->faults / (double)accesses : 0.0;
+    int len = snprintf(buf, size,
+                       "Total Accesses: %lld\nPage Faults: %lld\nPage Hits: %lld\nEvictions: %lld\nFault Rate: %.2f%%\n",
+                       accesses, sim->faults, sim->hits, sim->evictions, fault_rate);
+    if (len >= 0 && (size_t)len < size && (sim->writebacks > 0 || sim->swap.enabled))
+        len += snprintf(buf + len, size - (size_t)len, "Write-backs: %lld\n", sim->writebacks);
+    if (len >= 0 && (size_t)len < size && sim->prefetching) {
+        const PrefetchCounts *pf = &sim->prefetch;
+        len += snprintf(buf + len, size - (size_t)len,
+                        "Prefetcher: %s\nPrefetches: %lld\nPrefetch Hits: %lld (accuracy %.2f%%, coverage %.2f%%)\n"
+                        "Wasted Prefetches: %lld\nPrefetch Evictions: %lld\n",
+                        sim->prefetcher->name, pf->issued, pf->hits,
+                        pf->issued > 0 ? 100.0 * (double)pf->hits / (double)pf->issued : 0.0,
+                        pf->hits + sim->faults > 0 ? 100.0 * (double)pf->hits / (double)(pf->hits + sim->faults) : 0.0,
+                        pf->wasted, pf->evictions);
+    }
+    if (len >= 0 && (size_t)len < size && sim->mmu.enabled) {
+        const MmuCounts *mc = &sim->mmu.counts;
+        long long lookups = mc->tlb_hits + mc->tlb_misses;
+        len += snprintf(buf + len, size - (size_t)len,
+                        "TLB Hits: %lld\nTLB Misses: %lld (%.2f%%)\nPage Walk References: %lld (%.2f per miss, "
+                        "%lld walk cache hits)\nTranslation Time: %.6f s\n",
+                        mc->tlb_hits, mc->tlb_misses,
+                        lookups > 0 ? 100.0 * (double)mc->tlb_misses / (double)lookups : 0.0, mc->walk_refs,
+                        mc->tlb_misses > 0 ? (double)mc->walk_refs / (double)mc->tlb_misses : 0.0, mc->pwc_hits,
+                        (double)mc->walk_refs * sim->mmu.config.walk_ref_ns / 1e9);
+    }
+    if (len >= 0 && (size_t)len < size && sim->swap.enabled) {
+        double total = sim->swap.now / 1e9, stall = sim->swap.stall_ns / 1e9;
+        len += snprintf(buf + len, size - (size_t)len, "Modeled Time: %.6f s\nStall Time: %.6f s (%.1f%%)\n", total,
+                        stall, total > 0 ? 100.0 * stall / total : 0.0);
+    }
+    if (len < 0)
+        return 0;
+    return (size_t)len < size ? (size_t)len : size - 1;
+}
@@ -1,44 +1,133 @@
 #ifndef SIMULATOR_H
 #define SIMULATOR_H
 
-#include <gtk/gtk.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "events.h"
+#include "frame_table.h"
+#include "mmu.h"
+#include "policy.h"
+#include "prefetch.h"
+#include "stats.h"
+#include "swap.h"
+#include "timeline.h"
 
 #define MAX_PROCESSES 10
-#define FRAME_COUNT 4
+#define FRAME_COUNT 4 // Default number of physical frames
 
-#define MAX_REFERENCES 500000 // Maximum total page accesses in a simulation run
+#define DEFAULT_REFERENCE_CAPACITY 1024 // Initial reference string allocation
 
-typedef struct {
-    int process_id;
-    int page;
-    int frame;
-    long last_access_time; 
-} PageFrame;
-
-// Structure to hold a page reference for the Optimal algorithm
-typedef struct {
+// A single page access by a process
+typedef struct PageReference {
     int pid;
-    int page_num;
+    unsigned char write; // 1 for a store, 0 for a load or fetch
+    long long page_num;
 } PageReference;
 
+#define SIM_BATCH_SIZE 4096 // References pulled from a RefSource at a time
+
+// Pull-based stream of references. read() fills up to max entries and
+// returns how many it wrote, 0 once the stream is exhausted.
+typedef struct RefSource {
+    size_t (*read)(struct RefSource *src, PageReference *out, size_t max);
+} RefSource;
+
+#define SIM_CANCELLED (-2) // Run stopped because the progress callback asked to
+
+// Called after every batch of references with the number simulated so far
+// and the run length (-1 when streaming). Returning nonzero cancels the run.
+typedef int (*SimProgressFn)(long long done, long long total, void *user_data);
+
 typedef struct {
     int page_size;
     int process_count;
     int process_sizes[MAX_PROCESSES]; 
-    char algorithm[10];
-    PageFrame memory[FRAME_COUNT];
-    int memory_usage;
+    char algorithm[16];
+    FrameTable memory;
 
-    // For Optimal Algorithm:
-    PageReference reference_string[MAX_REFERENCES];
+    // Replacement policy, selected once in simulator_set_algorithm()
+    const ReplacementPolicy *policy;
+    void *policy_state;
+
+    // Materialized references (Optimal needs the future); grows on demand:
+    PageReference *reference_string;
     int reference_string_len;
+    int reference_capacity;
+
+    // Current access; stamped on frames as last_access_time
+    long access_time;
+    uint64_t trace_hash; // Of the references simulated so far, to match checkpoints to traces
+
+    // Output: events per verbosity level, plus end-of-run counters
+    SimVerbosity verbosity;
+    EventRing events;
+    long long hits;
+    long long faults;
+    long long evictions;
+    long long writebacks; // Dirty pages written out, on eviction or ahead of it
+    SimStats stats; // Breakdown of the counters above, plus timing
+
+    // The caller's sink; the ring's sink times it on the way through
+    SimEventSink sink;
+    void *sink_data;
+
+    SimProgressFn progress;
+    void *progress_data;
+
+    // Optional cost model; off unless simulator_set_swap() turned it on
+    SwapDevice swap;
+
+    // Optional TLB and page walk model; off unless simulator_set_mmu() turned it on
+    Mmu mmu;
+
+    // Optional prefetcher. It sits out runs of policies that need the
+    // future, whose precomputed next uses only cover demand references.
+    const Prefetcher *prefetcher;
+    void *prefetch_state;
+    int prefetching; // The prefetcher took part in the last run
+    PrefetchCounts prefetch;
+
+    // Optional summary over time; off unless simulator_set_timeline() turned it on
+    Timeline timeline;
 } Simulator;
 
-void simulator_init(Simulator *sim);
-void simulator_set_algorithm(Simulator *sim, const char *algorithm);
+Simulator *simulator_create(int frames, int capacity);
+void simulator_destroy(Simulator *sim);
+int simulator_set_frame_count(Simulator *sim, int frames);
+int simulator_set_algorithm(Simulator *sim, const char *algorithm);
 void simulator_set_page_size(Simulator *sim, int page_size);
 void simulator_set_process_count(Simulator *sim, int count);
 void simulator_set_process_size(Simulator *sim, int index, int size);
-void simulator_run(Simulator *sim, char *log_output);
+void simulator_set_verbosity(Simulator *sim, SimVerbosity verbosity);
+void simulator_set_event_sink(Simulator *sim, SimEventSink sink, void *user_data);
+void simulator_set_progress(Simulator *sim, SimProgressFn progress, void *user_data);
+void simulator_set_stats_window(Simulator *sim, long long window);
+void simulator_set_perf_counters(Simulator *sim, int enabled);
+int simulator_set_swap(Simulator *sim, const SwapConfig *config);
+int simulator_set_mmu(Simulator *sim, const MmuConfig *config);
+int simulator_set_prefetcher(Simulator *sim, const char *name, int degree);
+int simulator_set_timeline(Simulator *sim, int enabled, int rate_window);
+int simulator_generate_references(Simulator *sim);
+int simulator_load_source(Simulator *sim, RefSource *src);
+int simulator_run(Simulator *sim);
+int simulator_run_references(Simulator *sim, const PageReference *refs, int len);
+int simulator_run_source(Simulator *sim, RefSource *src);
+int simulator_begin_run(Simulator *sim, const PageReference *refs, int len);
+int simulator_step(Simulator *sim, const PageReference *refs, int count, long long first_index);
+void simulator_end_run(Simulator *sim);
+int simulator_continue_source(Simulator *sim, RefSource *src);
+int simulator_continue_references(Simulator *sim, const PageReference *refs, int len);
+int simulator_skip_source(Simulator *sim, RefSource *src);
+int simulator_resize_memory(Simulator *sim, int frames, int keep);
+size_t simulator_format_summary(const Simulator *sim, char *buf, size_t size);
+
+// Defined in stats.c
+int simulator_write_stats_json(const Simulator *sim, FILE *out);
+int simulator_write_stats_csv(const Simulator *sim, FILE *out);
+
+// Defined in checkpoint.c
+int simulator_save_checkpoint(const Simulator *sim, FILE *out);
+int simulator_load_checkpoint(Simulator *sim, FILE *in);
 
 #endif 
\ No newline at end of file
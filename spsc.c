@@ -0,0 +1,152 @@
+#include "spsc.h"
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+static inline void cpu_relax(void) {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_ia32_pause();
+#elif defined(__GNUC__) && defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+// slots is rounded up to a power of two; slot_bytes is the room in each
+int spsc_ring_init(SpscRing *ring, size_t slots, size_t slot_bytes, int spin) {
+    memset(ring, 0, sizeof(*ring));
+    size_t rounded = 1;
+    while (rounded < slots)
+        rounded <<= 1;
+    ring->slots = malloc(rounded * slot_bytes);
+    ring->counts = calloc(rounded, sizeof(size_t));
+    if (!ring->slots || !ring->counts) {
+        free(ring->slots);
+        free(ring->counts);
+        return -1;
+    }
+    ring->capacity = rounded;
+    ring->slot_bytes = slot_bytes;
+    ring->spin = spin > 0 ? spin : 0;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->closed, 0);
+    atomic_init(&ring->sleepers, 0);
+    pthread_mutex_init(&ring->lock, NULL);
+    pthread_cond_init(&ring->moved, NULL);
+    return 0;
+}
+
+void spsc_ring_free(SpscRing *ring) {
+    free(ring->slots);
+    free(ring->counts);
+    ring->slots = NULL;
+    ring->counts = NULL;
+    pthread_mutex_destroy(&ring->lock);
+    pthread_cond_destroy(&ring->moved);
+}
+
+// Wakes the other side if it went to sleep. The store before this and the
+// load of sleepers are both sequentially consistent, and a sleeper rechecks
+// under the lock after announcing itself, so a wakeup cannot fall between.
+static void wake(SpscRing *ring) {
+    if (atomic_load(&ring->sleepers) == 0)
+        return;
+    pthread_mutex_lock(&ring->lock);
+    pthread_cond_broadcast(&ring->moved);
+    pthread_mutex_unlock(&ring->lock);
+}
+
+// Either side may close: the producer at the end of its stream, after
+// which the consumer drains what is left, or the consumer to make the
+// producer stop early
+void spsc_ring_close(SpscRing *ring) {
+    atomic_store(&ring->closed, 1);
+    pthread_mutex_lock(&ring->lock);
+    pthread_cond_broadcast(&ring->moved);
+    pthread_mutex_unlock(&ring->lock);
+}
+
+static int ring_full(SpscRing *ring) {
+    if (atomic_load_explicit(&ring->head, memory_order_relaxed) - ring->cached_tail < ring->capacity)
+        return 0;
+    ring->cached_tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    return atomic_load_explicit(&ring->head, memory_order_relaxed) - ring->cached_tail == ring->capacity;
+}
+
+static int ring_empty(SpscRing *ring) {
+    if (ring->cached_head != atomic_load_explicit(&ring->tail, memory_order_relaxed))
+        return 0;
+    ring->cached_head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    return ring->cached_head == atomic_load_explicit(&ring->tail, memory_order_relaxed);
+}
+
+// Polls, then sleeps, until blocked() turns false or the ring is closed
+static void wait_while(SpscRing *ring, int (*blocked)(SpscRing *)) {
+    for (int i = 0; i < ring->spin; i++) {
+        cpu_relax();
+        if (!blocked(ring) || atomic_load_explicit(&ring->closed, memory_order_relaxed))
+            return;
+    }
+    sched_yield();
+    pthread_mutex_lock(&ring->lock);
+    atomic_fetch_add(&ring->sleepers, 1);
+    atomic_thread_fence(memory_order_seq_cst);
+    while (blocked(ring) && !atomic_load(&ring->closed))
+        pthread_cond_wait(&ring->moved, &ring->lock);
+    atomic_fetch_sub(&ring->sleepers, 1);
+    pthread_mutex_unlock(&ring->lock);
+}
+
+static void *head_slot(SpscRing *ring) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    return ring->slots + (head & (ring->capacity - 1)) * ring->slot_bytes;
+}
+
+// Producer: the next free slot, waiting while the ring is full; NULL once
+// the ring is closed
+void *spsc_ring_begin_write(SpscRing *ring) {
+    if (ring_full(ring)) {
+        ring->full_waits++;
+        while (ring_full(ring) && !atomic_load(&ring->closed))
+            wait_while(ring, ring_full);
+    }
+    return atomic_load(&ring->closed) ? NULL : head_slot(ring);
+}
+
+// Producer: the next free slot, or NULL at once if the ring is full or closed
+void *spsc_ring_try_write(SpscRing *ring) {
+    if (ring_full(ring)) {
+        ring->full_waits++;
+        return NULL;
+    }
+    return atomic_load_explicit(&ring->closed, memory_order_relaxed) ? NULL : head_slot(ring);
+}
+
+// Producer: publishes the slot from begin_write/try_write holding count items
+void spsc_ring_commit_write(SpscRing *ring, size_t count) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    ring->counts[head & (ring->capacity - 1)] = count;
+    atomic_store(&ring->head, head + 1);
+    wake(ring);
+}
+
+// Consumer: the oldest published slot and its item count, waiting while
+// the ring is empty; NULL once it is closed and drained
+const void *spsc_ring_begin_read(SpscRing *ring, size_t *count) {
+    if (ring_empty(ring)) {
+        ring->empty_waits++;
+        while (ring_empty(ring) && !atomic_load(&ring->closed))
+            wait_while(ring, ring_empty);
+        if (ring_empty(ring))
+            return NULL;
+    }
+    size_t index = atomic_load_explicit(&ring->tail, memory_order_relaxed) & (ring->capacity - 1);
+    *count = ring->counts[index];
+    return ring->slots + index * ring->slot_bytes;
+}
+
+// Consumer: hands the slot from begin_read back to the producer
+void spsc_ring_end_read(SpscRing *ring) {
+    atomic_store(&ring->tail, atomic_load_explicit(&ring->tail, memory_order_relaxed) + 1);
+    wake(ring);
+}
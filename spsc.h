@@ -0,0 +1,49 @@
+#ifndef SPSC_H
+#define SPSC_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+// Single-producer single-consumer ring of fixed-size slots. The producer
+// fills the slot at head and publishes it, the consumer reads the slot at
+// tail and hands it back; while the ring is neither full nor empty neither
+// side takes a lock. A side that finds it full or empty polls `spin` times,
+// then sleeps until the other side moves or the ring is closed.
+
+#define SPSC_CACHE_LINE 64
+
+typedef struct {
+    unsigned char *slots;
+    size_t *counts;    // Items in each published slot
+    size_t slot_bytes;
+    size_t capacity;   // Slots; always a power of two
+    int spin;
+
+    // Written by the producer only, apart from `closed`
+    _Alignas(SPSC_CACHE_LINE) _Atomic size_t head;
+    size_t cached_tail;
+    unsigned long long full_waits; // begin_write calls that found the ring full
+
+    // Written by the consumer only
+    _Alignas(SPSC_CACHE_LINE) _Atomic size_t tail;
+    size_t cached_head;
+    unsigned long long empty_waits; // begin_read calls that found the ring empty
+
+    _Alignas(SPSC_CACHE_LINE) _Atomic int closed;
+    _Atomic int sleepers;
+    pthread_mutex_t lock;
+    pthread_cond_t moved; // head or tail advanced, or the ring was closed
+} SpscRing;
+
+int spsc_ring_init(SpscRing *ring, size_t slots, size_t slot_bytes, int spin);
+void spsc_ring_free(SpscRing *ring);
+void spsc_ring_close(SpscRing *ring);
+
+void *spsc_ring_begin_write(SpscRing *ring);
+void *spsc_ring_try_write(SpscRing *ring);
+void spsc_ring_commit_write(SpscRing *ring, size_t count);
+const void *spsc_ring_begin_read(SpscRing *ring, size_t *count);
+void spsc_ring_end_read(SpscRing *ring);
+
+#endif
@@ -0,0 +1,362 @@
+#include "stats.h"
+#include <stdlib.h>
+#include <string.h>
+#include "simulator.h"
+#include "timing.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static const char *const phase_names[SIM_PHASE_COUNT] = {"generate", "simulate", "format"};
+static const char *const perf_names[SIM_PERF_COUNT] = {"cycles", "instructions", "cache_misses"};
+
+const char *sim_phase_name(SimPhase phase) {
+    return phase_names[phase];
+}
+
+const char *sim_perf_name(SimPerfCounter counter) {
+    return perf_names[counter];
+}
+
+int sim_stats_init(SimStats *stats, int frame_count) {
+    memset(stats, 0, sizeof(*stats));
+    stats->window = SIM_STATS_DEFAULT_WINDOW;
+    for (int c = 0; c < SIM_PERF_COUNT; c++)
+        stats->perf_fds[c] = -1;
+    stats->process_capacity = MAX_PROCESSES;
+    stats->processes = calloc((size_t)stats->process_capacity, sizeof(SimCounts));
+    if (!stats->processes)
+        return -1;
+    return sim_stats_reset(stats, frame_count);
+}
+
+void sim_stats_free(SimStats *stats) {
+    sim_stats_perf_close(stats);
+    free(stats->processes);
+    free(stats->frames);
+    free(stats->window_fault_counts);
+    memset(stats, 0, sizeof(*stats));
+}
+
+// Zeroes everything a run collects except the GENERATE phase, which
+// belongs to whoever produced the references. Returns -1 if the per-frame
+// counts cannot be resized.
+int sim_stats_reset(SimStats *stats, int frame_count) {
+    if (frame_count != stats->frame_count) {
+        SimCounts *frames = realloc(stats->frames, (size_t)frame_count * sizeof(SimCounts));
+        if (!frames)
+            return -1;
+        stats->frames = frames;
+        stats->frame_count = frame_count;
+    }
+    memset(stats->frames, 0, (size_t)frame_count * sizeof(SimCounts));
+    memset(stats->processes, 0, (size_t)stats->process_capacity * sizeof(SimCounts));
+    stats->process_count = 0;
+    stats->processes_incomplete = 0;
+    stats->window_accesses = stats->window_faults = 0;
+    stats->window_count = 0;
+    stats->windows_incomplete = 0;
+    stats->phases[SIM_PHASE_SIMULATE] = stats->phases[SIM_PHASE_FORMAT] = (SimPhaseTime){0, 0};
+    for (int c = 0; c < SIM_PERF_COUNT; c++)
+        stats->perf_values[c] = 0;
+    return 0;
+}
+
+// Slow path of sim_stats_process(): makes room for pid
+int sim_stats_grow_processes(SimStats *stats, int pid) {
+    if (stats->processes_incomplete)
+        return -1;
+    int capacity = stats->process_capacity;
+    while (capacity <= pid)
+        capacity *= 2;
+    SimCounts *grown = realloc(stats->processes, (size_t)capacity * sizeof(SimCounts));
+    if (!grown) {
+        stats->processes_incomplete = 1;
+        return -1;
+    }
+    memset(grown + stats->process_capacity, 0, (size_t)(capacity - stats->process_capacity) * sizeof(SimCounts));
+    stats->processes = grown;
+    stats->process_capacity = capacity;
+    return 0;
+}
+
+// Makes room for per-frame counts of frame_count frames in the middle of a
+// run, keeping what the existing frames have counted
+int sim_stats_grow_frames(SimStats *stats, int frame_count) {
+    if (frame_count <= stats->frame_count)
+        return 0;
+    SimCounts *frames = realloc(stats->frames, (size_t)frame_count * sizeof(SimCounts));
+    if (!frames)
+        return -1;
+    memset(frames + stats->frame_count, 0, (size_t)(frame_count - stats->frame_count) * sizeof(SimCounts));
+    stats->frames = frames;
+    stats->frame_count = frame_count;
+    return 0;
+}
+
+// Records the faults of the window that just filled (or of the short last
+// one) and starts the next
+void sim_stats_close_window(SimStats *stats) {
+    if (stats->window_count == stats->window_capacity && !stats->windows_incomplete) {
+        size_t capacity = stats->window_capacity ? stats->window_capacity * 2 : 1024;
+        int *grown = realloc(stats->window_fault_counts, capacity * sizeof(int));
+        if (grown) {
+            stats->window_fault_counts = grown;
+            stats->window_capacity = capacity;
+        } else {
+            stats->windows_incomplete = 1;
+        }
+    }
+    if (stats->window_count < stats->window_capacity)
+        stats->window_fault_counts[stats->window_count++] = (int)stats->window_faults;
+    stats->window_faults = 0;
+    stats->window_accesses = 0;
+}
+
+// End of run: keeps the partial last window
+void sim_stats_finish(SimStats *stats) {
+    long long last = stats->window_accesses > 0 ? stats->window_accesses : stats->window;
+    if (stats->window && stats->window_accesses > 0)
+        sim_stats_close_window(stats);
+    stats->window_accesses = last; // Length of the last window, for the writers
+}
+
+// Undoes sim_stats_finish() for a run that goes on: a short last window
+// is taken back and filled up again
+void sim_stats_reopen(SimStats *stats) {
+    if (stats->window && stats->window_accesses < stats->window && stats->window_count > 0 &&
+        !stats->windows_incomplete) {
+        stats->window_faults = stats->window_fault_counts[--stats->window_count];
+    } else {
+        stats->window_faults = 0;
+        stats->window_accesses = 0;
+    }
+}
+
+void sim_stats_phase_begin(SimStats *stats) {
+    stats->phase_wall_start = timing_wall_seconds();
+    stats->phase_cpu_start = timing_cpu_seconds();
+}
+
+// Charges the time since sim_stats_phase_begin() to phase and starts the
+// next interval, so consecutive phases need one clock read each
+void sim_stats_phase_end(SimStats *stats, SimPhase phase) {
+    double wall = timing_wall_seconds(), cpu = timing_cpu_seconds();
+    stats->phases[phase].wall_seconds += wall - stats->phase_wall_start;
+    stats->phases[phase].cpu_seconds += cpu - stats->phase_cpu_start;
+    stats->phase_wall_start = wall;
+    stats->phase_cpu_start = cpu;
+}
+
+// Opens user-space cycle, instruction and cache-miss counters for the
+// calling thread as one group, stopped until sim_stats_perf_enable().
+// Counters only see their own thread, so the simulating thread opens them.
+// Returns -1 where perf_event_open() is missing or not permitted.
+int sim_stats_perf_open(SimStats *stats) {
+    sim_stats_perf_close(stats);
+    stats->perf_status = -1;
+#ifdef __linux__
+    static const unsigned long long configs[SIM_PERF_COUNT] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES};
+    for (int c = 0; c < SIM_PERF_COUNT; c++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[c];
+        attr.disabled = c == 0; // Members follow the leader
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        int leader = stats->perf_fds[0];
+        stats->perf_fds[c] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, c == 0 ? -1 : leader, 0);
+        if (stats->perf_fds[0] < 0)
+            return -1;
+    }
+    stats->perf_status = 0;
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+void sim_stats_perf_close(SimStats *stats) {
+#ifdef __linux__
+    for (int c = 0; c < SIM_PERF_COUNT; c++) {
+        if (stats->perf_fds[c] >= 0)
+            close(stats->perf_fds[c]);
+    }
+#endif
+    for (int c = 0; c < SIM_PERF_COUNT; c++)
+        stats->perf_fds[c] = -1;
+}
+
+// Starts or stops the counters, which keep their totals while stopped
+void sim_stats_perf_enable(SimStats *stats, int on) {
+#ifdef __linux__
+    if (stats->perf_fds[0] >= 0)
+        ioctl(stats->perf_fds[0], on ? PERF_EVENT_IOC_ENABLE : PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+#else
+    (void)on;
+    (void)stats;
+#endif
+}
+
+// Copies the counter totals into perf_values, -1 for any that did not open
+void sim_stats_perf_read(SimStats *stats) {
+#ifdef __linux__
+    for (int c = 0; c < SIM_PERF_COUNT; c++) {
+        unsigned long long value;
+        if (stats->perf_fds[c] >= 0 && read(stats->perf_fds[c], &value, sizeof(value)) == (ssize_t)sizeof(value))
+            stats->perf_values[c] = (long long)value;
+        else
+            stats->perf_values[c] = -1;
+    }
+#else
+    (void)stats;
+#endif
+}
+
+static double ratio(long long part, long long whole) {
+    return whole > 0 ? (double)part / (double)whole : 0.0;
+}
+
+static long long window_length(const SimStats *stats, size_t w) {
+    return w + 1 == stats->window_count ? stats->window_accesses : stats->window;
+}
+
+static void write_counts_json(FILE *out, const char *key, const char *id, const SimCounts *counts, int n) {
+    fprintf(out, "  \"%s\": [", key);
+    for (int i = 0; i < n; i++) {
+        const SimCounts *c = &counts[i];
+        fprintf(out, "%s\n    {\"%s\": %d, \"hits\": %lld, \"faults\": %lld, \"evictions\": %lld}", i ? "," : "", id,
+                i, c->hits, c->faults, c->evictions);
+    }
+    fprintf(out, "%s],\n", n ? "\n  " : "");
+}
+
+// Everything the last run collected as one JSON object
+int simulator_write_stats_json(const Simulator *sim, FILE *out) {
+    const SimStats *stats = &sim->stats;
+    long long accesses = sim->hits + sim->faults;
+    fprintf(out, "{\n  \"algorithm\": \"%s\",\n  \"frames\": %d,\n  \"page_size\": %d,\n", sim->policy->name,
+            sim->memory.frame_count, sim->page_size);
+    fprintf(out,
+            "  \"accesses\": %lld,\n  \"hits\": %lld,\n  \"faults\": %lld,\n  \"evictions\": %lld,\n"
+            "  \"writebacks\": %lld,\n  \"fault_rate\": %.6f,\n",
+            accesses, sim->hits, sim->faults, sim->evictions, sim->writebacks, ratio(sim->faults, accesses));
+    const SwapDevice *swap = &sim->swap;
+    if (swap->enabled)
+        fprintf(out,
+                "  \"swap\": {\"modeled_seconds\": %.9f, \"stall_seconds\": %.9f, \"reads\": %lld, \"writes\": %lld, "
+                "\"queue_full\": %lld},\n",
+                swap->now / 1e9, swap->stall_ns / 1e9, swap->reads, swap->writes, swap->queue_full);
+    else
+        fprintf(out, "  \"swap\": null,\n");
+    const PrefetchCounts *pf = &sim->prefetch;
+    if (sim->prefetching)
+        fprintf(out,
+                "  \"prefetch\": {\"prefetcher\": \"%s\", \"issued\": %lld, \"hits\": %lld, \"wasted\": %lld, "
+                "\"evictions\": %lld, \"accuracy\": %.6f, \"coverage\": %.6f},\n",
+                sim->prefetcher->name, pf->issued, pf->hits, pf->wasted, pf->evictions, ratio(pf->hits, pf->issued),
+                ratio(pf->hits, pf->hits + sim->faults));
+    else
+        fprintf(out, "  \"prefetch\": null,\n");
+    const MmuCounts *mc = &sim->mmu.counts;
+    if (sim->mmu.enabled)
+        fprintf(out,
+                "  \"mmu\": {\"tlb_hits\": %lld, \"tlb_misses\": %lld, \"misses_4k\": %lld, \"misses_2m\": %lld, "
+                "\"misses_1g\": %lld, \"walk_refs\": %lld, \"pwc_hits\": %lld, \"invalidations\": %lld, "
+                "\"translation_seconds\": %.9f},\n",
+                mc->tlb_hits, mc->tlb_misses, mc->misses[MMU_PAGE_4K], mc->misses[MMU_PAGE_2M], mc->misses[MMU_PAGE_1G],
+                mc->walk_refs, mc->pwc_hits, mc->invalidations,
+                (double)mc->walk_refs * sim->mmu.config.walk_ref_ns / 1e9);
+    else
+        fprintf(out, "  \"mmu\": null,\n");
+    write_counts_json(out, "processes", "pid", stats->processes, stats->process_count);
+    write_counts_json(out, "frame_counts", "frame", stats->frames, stats->frame_count);
+
+    fprintf(out, "  \"window\": %lld,\n  \"window_fault_rates\": [", stats->window);
+    for (size_t w = 0; w < stats->window_count; w++)
+        fprintf(out, "%s%.6f", w ? ", " : "", ratio(stats->window_fault_counts[w], window_length(stats, w)));
+    fprintf(out, "],\n  \"phases\": {");
+    for (int p = 0; p < SIM_PHASE_COUNT; p++)
+        fprintf(out, "%s\n    \"%s\": {\"wall_seconds\": %.6f, \"cpu_seconds\": %.6f}", p ? "," : "",
+                phase_names[p], stats->phases[p].wall_seconds, stats->phases[p].cpu_seconds);
+    fprintf(out, "\n  },\n  \"perf\": ");
+    if (stats->perf_requested && stats->perf_status == 0) {
+        fprintf(out, "{");
+        // A counter the group could not take is null rather than a count
+        for (int c = 0; c < SIM_PERF_COUNT; c++) {
+            fprintf(out, "%s\"%s\": ", c ? ", " : "", perf_names[c]);
+            if (stats->perf_values[c] < 0)
+                fprintf(out, "null");
+            else
+                fprintf(out, "%lld", stats->perf_values[c]);
+        }
+        fprintf(out, "}\n}\n");
+    } else {
+        fprintf(out, "null\n}\n");
+    }
+    return ferror(out) ? -1 : 0;
+}
+
+static void write_counts_csv(FILE *out, const char *scope, const SimCounts *counts, int n) {
+    for (int i = 0; i < n; i++) {
+        fprintf(out, "%s,%d,hits,%lld\n%s,%d,faults,%lld\n%s,%d,evictions,%lld\n", scope, i, counts[i].hits, scope, i,
+                counts[i].faults, scope, i, counts[i].evictions);
+    }
+}
+
+// The same as simulator_write_stats_json(), one value per row:
+// scope,id,metric,value
+int simulator_write_stats_csv(const Simulator *sim, FILE *out) {
+    const SimStats *stats = &sim->stats;
+    long long accesses = sim->hits + sim->faults;
+    fprintf(out, "scope,id,metric,value\n");
+    fprintf(out, "run,,algorithm,%s\nrun,,frames,%d\nrun,,page_size,%d\n", sim->policy->name, sim->memory.frame_count,
+            sim->page_size);
+    fprintf(out, "run,,accesses,%lld\nrun,,hits,%lld\nrun,,faults,%lld\nrun,,evictions,%lld\nrun,,writebacks,%lld\n"
+            "run,,fault_rate,%.6f\n",
+            accesses, sim->hits, sim->faults, sim->evictions, sim->writebacks, ratio(sim->faults, accesses));
+    if (sim->swap.enabled)
+        fprintf(out, "swap,,modeled_seconds,%.9f\nswap,,stall_seconds,%.9f\nswap,,reads,%lld\nswap,,writes,%lld\n"
+                "swap,,queue_full,%lld\n",
+                sim->swap.now / 1e9, sim->swap.stall_ns / 1e9, sim->swap.reads, sim->swap.writes,
+                sim->swap.queue_full);
+    if (sim->prefetching) {
+        const PrefetchCounts *pf = &sim->prefetch;
+        fprintf(out, "prefetch,,prefetcher,%s\nprefetch,,issued,%lld\nprefetch,,hits,%lld\nprefetch,,wasted,%lld\n"
+                "prefetch,,evictions,%lld\nprefetch,,accuracy,%.6f\nprefetch,,coverage,%.6f\n",
+                sim->prefetcher->name, pf->issued, pf->hits, pf->wasted, pf->evictions, ratio(pf->hits, pf->issued),
+                ratio(pf->hits, pf->hits + sim->faults));
+    }
+    if (sim->mmu.enabled) {
+        const MmuCounts *mc = &sim->mmu.counts;
+        fprintf(out, "mmu,,tlb_hits,%lld\nmmu,,tlb_misses,%lld\n", mc->tlb_hits, mc->tlb_misses);
+        for (int c = 0; c < MMU_PAGE_CLASSES; c++)
+            fprintf(out, "mmu,%s,tlb_misses,%lld\n", mmu_page_class_name((MmuPageClass)c), mc->misses[c]);
+        fprintf(out, "mmu,,walk_refs,%lld\nmmu,,pwc_hits,%lld\nmmu,,invalidations,%lld\nmmu,,translation_seconds,%.9f\n",
+                mc->walk_refs, mc->pwc_hits, mc->invalidations,
+                (double)mc->walk_refs * sim->mmu.config.walk_ref_ns / 1e9);
+    }
+    write_counts_csv(out, "process", stats->processes, stats->process_count);
+    write_counts_csv(out, "frame", stats->frames, stats->frame_count);
+    for (size_t w = 0; w < stats->window_count; w++)
+        fprintf(out, "window,%zu,fault_rate,%.6f\n", w, ratio(stats->window_fault_counts[w], window_length(stats, w)));
+    for (int p = 0; p < SIM_PHASE_COUNT; p++)
+        fprintf(out, "phase,%s,wall_seconds,%.6f\nphase,%s,cpu_seconds,%.6f\n", phase_names[p],
+                stats->phases[p].wall_seconds, phase_names[p], stats->phases[p].cpu_seconds);
+    if (stats->perf_requested && stats->perf_status == 0) {
+        for (int c = 0; c < SIM_PERF_COUNT; c++) {
+            if (stats->perf_values[c] < 0)
+                fprintf(out, "perf,,%s,\n", perf_names[c]); // Did not open
+            else
+                fprintf(out, "perf,,%s,%lld\n", perf_names[c], stats->perf_values[c]);
+        }
+    }
+    return ferror(out) ? -1 : 0;
+}
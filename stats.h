@@ -0,0 +1,124 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stddef.h>
+
+// Counters the simulator keeps on every run, cheap enough to stay on in
+// the hot path, plus optional hardware counters around the main loop
+
+typedef struct {
+    long long hits;
+    long long faults;
+    long long evictions; // Pages of this process, or out of this frame
+} SimCounts;
+
+typedef enum {
+    SIM_PHASE_GENERATE, // Producing references: generator, trace parsing or decoding
+    SIM_PHASE_SIMULATE, // The replacement loop itself
+    SIM_PHASE_FORMAT,   // Inside the event sink, i.e. turning events into output
+    SIM_PHASE_COUNT
+} SimPhase;
+
+typedef struct {
+    double wall_seconds;
+    double cpu_seconds; // Of the simulating thread
+} SimPhaseTime;
+
+typedef enum {
+    SIM_PERF_CYCLES,
+    SIM_PERF_INSTRUCTIONS,
+    SIM_PERF_CACHE_MISSES,
+    SIM_PERF_COUNT
+} SimPerfCounter;
+
+#define SIM_STATS_DEFAULT_WINDOW 10000 // Accesses per fault-rate window
+
+typedef struct {
+    // Per-process counts grow with the highest pid seen; a pid that cannot
+    // be tracked for lack of memory is left out and sets processes_incomplete
+    SimCounts *processes;
+    int process_count;    // Highest pid seen + 1
+    int process_capacity;
+    int processes_incomplete;
+    SimCounts *frames;
+    int frame_count;
+
+    // Faults per window of `window` accesses; the last window may be short
+    long long window;
+    long long window_accesses;
+    long long window_faults;
+    int *window_fault_counts;
+    size_t window_count;
+    size_t window_capacity;
+    int windows_incomplete;
+
+    // GENERATE covers the reads of a streaming run; a run over an array
+    // keeps the time of the simulator_load_source() that filled it
+    SimPhaseTime phases[SIM_PHASE_COUNT];
+    double phase_wall_start;
+    double phase_cpu_start;
+
+    // perf_event_open() counters, opened for each run when perf_requested;
+    // perf_status is -1 if they were asked for but are not available
+    int perf_requested;
+    int perf_status;
+    int perf_fds[SIM_PERF_COUNT];
+    long long perf_values[SIM_PERF_COUNT];
+} SimStats;
+
+int sim_stats_init(SimStats *stats, int frame_count);
+void sim_stats_free(SimStats *stats);
+int sim_stats_reset(SimStats *stats, int frame_count);
+int sim_stats_grow_processes(SimStats *stats, int pid);
+int sim_stats_grow_frames(SimStats *stats, int frame_count);
+void sim_stats_close_window(SimStats *stats);
+void sim_stats_finish(SimStats *stats);
+void sim_stats_reopen(SimStats *stats);
+
+void sim_stats_phase_begin(SimStats *stats);
+void sim_stats_phase_end(SimStats *stats, SimPhase phase);
+
+int sim_stats_perf_open(SimStats *stats);
+void sim_stats_perf_close(SimStats *stats);
+void sim_stats_perf_enable(SimStats *stats, int on);
+void sim_stats_perf_read(SimStats *stats);
+
+const char *sim_phase_name(SimPhase phase);
+const char *sim_perf_name(SimPerfCounter counter);
+
+static inline SimCounts *sim_stats_process(SimStats *stats, int pid) {
+    if (pid >= stats->process_count) {
+        if (pid >= stats->process_capacity && sim_stats_grow_processes(stats, pid) != 0)
+            return NULL;
+        stats->process_count = pid + 1;
+    }
+    return &stats->processes[pid];
+}
+
+static inline void sim_stats_hit(SimStats *stats, int pid, int frame) {
+    SimCounts *p = sim_stats_process(stats, pid);
+    if (p)
+        p->hits++;
+    stats->frames[frame].hits++;
+    if (stats->window && ++stats->window_accesses == stats->window)
+        sim_stats_close_window(stats);
+}
+
+static inline void sim_stats_fault(SimStats *stats, int pid, int frame) {
+    SimCounts *p = sim_stats_process(stats, pid);
+    if (p)
+        p->faults++;
+    stats->frames[frame].faults++;
+    stats->window_faults++;
+    if (stats->window && ++stats->window_accesses == stats->window)
+        sim_stats_close_window(stats);
+}
+
+static inline void sim_stats_evict(SimStats *stats, int pid, int frame) {
+    SimCounts *p = sim_stats_process(stats, pid);
+    if (p)
+        p->evictions++;
+    stats->frames[frame].evictions++;
+}
+
+#endif
@@ -0,0 +1,86 @@
+#include "swap.h"
+#include <stdlib.h>
+#include <string.h>
+
+void swap_config_defaults(SwapConfig *config) {
+    config->read_latency_us = SWAP_DEFAULT_READ_US;
+    config->write_latency_us = SWAP_DEFAULT_WRITE_US;
+    config->bandwidth_mb_s = SWAP_DEFAULT_BANDWIDTH_MB_S;
+    config->queue_depth = SWAP_DEFAULT_QUEUE_DEPTH;
+    config->access_ns = SWAP_DEFAULT_ACCESS_NS;
+    config->writeback = SWAP_WRITEBACK_SYNC;
+}
+
+// Turns the model on with config, or off when config is NULL. Returns -1
+// and leaves the device off if config is out of range or memory runs out.
+int swap_device_configure(SwapDevice *dev, const SwapConfig *config) {
+    swap_device_free(dev);
+    if (!config)
+        return 0;
+    if (config->queue_depth <= 0 || config->read_latency_us < 0 || config->write_latency_us < 0 ||
+        config->bandwidth_mb_s < 0 || config->access_ns < 0)
+        return -1;
+    dev->slot_free = calloc((size_t)config->queue_depth, sizeof(double));
+    if (!dev->slot_free)
+        return -1;
+    dev->config = *config;
+    dev->enabled = 1;
+    return 0;
+}
+
+void swap_device_free(SwapDevice *dev) {
+    free(dev->slot_free);
+    free(dev->frame_ready);
+    memset(dev, 0, sizeof(*dev));
+}
+
+// Idles the device and zeroes the clock before a run
+int swap_device_reset(SwapDevice *dev, int frame_count, int page_size) {
+    if (!dev->enabled)
+        return 0;
+    if (frame_count != dev->frame_count) {
+        double *ready = realloc(dev->frame_ready, (size_t)frame_count * sizeof(double));
+        if (!ready)
+            return -1;
+        dev->frame_ready = ready;
+        dev->frame_count = frame_count;
+    }
+    memset(dev->frame_ready, 0, (size_t)frame_count * sizeof(double));
+    memset(dev->slot_free, 0, (size_t)dev->config.queue_depth * sizeof(double));
+    dev->transfer_ns = dev->config.bandwidth_mb_s > 0 ? (double)page_size * 1000.0 / dev->config.bandwidth_mb_s : 0.0;
+    dev->link_free = dev->now = dev->stall_ns = 0;
+    dev->reads = dev->writes = dev->queue_full = 0;
+    return 0;
+}
+
+// Issues one page transfer no earlier than at and returns when it
+// completes. It takes the slot that frees up first; the latency overlaps
+// with other requests, the transfer itself has the link to itself.
+double swap_submit(SwapDevice *dev, double at, int write) {
+    int slot = 0;
+    for (int i = 1; i < dev->config.queue_depth; i++) {
+        if (dev->slot_free[i] < dev->slot_free[slot])
+            slot = i;
+    }
+    double start = at > dev->slot_free[slot] ? at : dev->slot_free[slot];
+    double ready = start + 1000.0 * (write ? dev->config.write_latency_us : dev->config.read_latency_us);
+    if (ready < dev->link_free)
+        ready = dev->link_free;
+    double done = ready + dev->transfer_ns;
+    dev->link_free = done;
+    dev->slot_free[slot] = done;
+    if (write)
+        dev->writes++;
+    else
+        dev->reads++;
+    return done;
+}
+
+// Whether every slot is still busy at time at
+int swap_queue_full(const SwapDevice *dev, double at) {
+    for (int i = 0; i < dev->config.queue_depth; i++) {
+        if (dev->slot_free[i] <= at)
+            return 0;
+    }
+    return 1;
+}
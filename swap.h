@@ -0,0 +1,55 @@
+#ifndef SWAP_H
+#define SWAP_H
+
+// A swap device model that prices the page traffic of a run. Page-ins and
+// write-backs go through a queue of fixed depth: each request waits for a
+// free slot, pays the device latency and then moves the page over a link
+// of limited bandwidth. Simulated time advances by a fixed cost per access
+// plus whatever a fault has to wait for; that wait is the stall time.
+
+// A frame only takes its new page once the old one is on the device, so a
+// fault on a dirty victim waits for the write and then the read
+typedef enum {
+    SWAP_WRITEBACK_SYNC, // Dirty pages are written when they are evicted and not before
+    SWAP_WRITEBACK_ASYNC // Policies may also clean dirty frames ahead of eviction
+} SwapWriteback;
+
+typedef struct {
+    double read_latency_us;
+    double write_latency_us;
+    double bandwidth_mb_s; // 0 for an unlimited link
+    int queue_depth;       // Requests the device works on at once
+    double access_ns;      // Cost of an access that does not fault
+    SwapWriteback writeback;
+} SwapConfig;
+
+#define SWAP_DEFAULT_READ_US 100.0
+#define SWAP_DEFAULT_WRITE_US 300.0
+#define SWAP_DEFAULT_BANDWIDTH_MB_S 500.0
+#define SWAP_DEFAULT_QUEUE_DEPTH 32
+#define SWAP_DEFAULT_ACCESS_NS 100.0
+
+// Times are in nanoseconds from the start of the run
+typedef struct {
+    SwapConfig config;
+    int enabled;
+    double transfer_ns;  // One page over the link
+    double *slot_free;   // When each queue slot next falls idle
+    double link_free;
+    double *frame_ready; // When the frame's last early write-back or prefetch completes
+    int frame_count;
+    double now;
+    double stall_ns;
+    long long reads;
+    long long writes;
+    long long queue_full; // Early cleaning refused for want of a free slot
+} SwapDevice;
+
+void swap_config_defaults(SwapConfig *config);
+int swap_device_configure(SwapDevice *dev, const SwapConfig *config);
+void swap_device_free(SwapDevice *dev);
+int swap_device_reset(SwapDevice *dev, int frame_count, int page_size);
+double swap_submit(SwapDevice *dev, double at, int write);
+int swap_queue_full(const SwapDevice *dev, double at);
+
+#endif
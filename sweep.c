@@ -0,0 +1,154 @@
+#include "sweep.h"
+#include "threadpool.h"
+#include "timing.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Byte addresses turned into page numbers for one page size
+typedef struct {
+    const PageReference *addresses;
+    int len;
+    int page_size;
+    PageReference *pages; // Shared by every run at this page size once built
+    int owned;
+} PagedTrace;
+
+typedef struct {
+    const PagedTrace *trace;
+    SweepResult *result;
+} SweepJob;
+
+static void translate_task(void *arg) {
+    PagedTrace *pt = arg;
+    if (pt->page_size == 1) {
+        pt->pages = (PageReference *)pt->addresses;
+        return;
+    }
+    pt->pages = malloc((size_t)(pt->len > 0 ? pt->len : 1) * sizeof(PageReference));
+    if (!pt->pages)
+        return;
+    pt->owned = 1;
+    int shift = -1;
+    if ((pt->page_size & (pt->page_size - 1)) == 0) {
+        shift = 0;
+        while ((1 << shift) < pt->page_size)
+            shift++;
+    }
+    for (int i = 0; i < pt->len; i++) {
+        long long addr = pt->addresses[i].page_num;
+        pt->pages[i].pid = pt->addresses[i].pid;
+        pt->pages[i].write = pt->addresses[i].write;
+        pt->pages[i].page_num = shift >= 0 ? addr >> shift : addr / pt->page_size;
+    }
+}
+
+static void run_task(void *arg) {
+    SweepJob *job = arg;
+    SweepResult *r = job->result;
+    double start = timing_wall_seconds();
+    r->status = -1;
+
+    Simulator *sim = simulator_create(r->frames, 1);
+    if (sim && job->trace->pages) {
+        simulator_set_verbosity(sim, SIM_VERBOSITY_NONE);
+        simulator_set_page_size(sim, r->page_size);
+        if (simulator_set_algorithm(sim, r->policy->name) == 0 &&
+            simulator_run_references(sim, job->trace->pages, job->trace->len) == 0) {
+            r->hits = sim->hits;
+            r->faults = sim->faults;
+            r->evictions = sim->evictions;
+            r->status = 0;
+        }
+    }
+    simulator_destroy(sim);
+    r->wall_seconds = timing_wall_seconds() - start;
+}
+
+// Runs every combination in spec over addresses, where each entry's
+// page_num holds a byte address (e.g. a TraceReader opened with page size
+// 1). Returns -1 on bad input or if the sweep cannot be set up; individual
+// runs that fail are marked in their result's status.
+int sweep_run(const PageReference *addresses, int len, const SweepSpec *spec, SweepTable *table) {
+    memset(table, 0, sizeof(*table));
+    if (len < 0 || (len > 0 && !addresses) || spec->page_size_count <= 0 ||
+        spec->frame_count_count <= 0 || spec->algorithm_count <= 0)
+        return -1;
+    for (int i = 0; i < spec->page_size_count; i++) {
+        if (spec->page_sizes[i] <= 0)
+            return -1;
+    }
+    for (int i = 0; i < spec->frame_count_count; i++) {
+        if (spec->frame_counts[i] <= 0)
+            return -1;
+    }
+    for (int i = 0; i < spec->algorithm_count; i++) {
+        if (!policy_find(spec->algorithms[i]))
+            return -1;
+    }
+
+    double start = timing_wall_seconds();
+    int count = spec->page_size_count * spec->frame_count_count * spec->algorithm_count;
+    PagedTrace *traces = calloc((size_t)spec->page_size_count, sizeof(PagedTrace));
+    SweepJob *jobs = malloc((size_t)count * sizeof(SweepJob));
+    table->results = calloc((size_t)count, sizeof(SweepResult));
+    ThreadPool *pool = traces && jobs && table->results ? threadpool_create(spec->threads) : NULL;
+    if (!pool) {
+        free(traces);
+        free(jobs);
+        sweep_table_free(table);
+        return -1;
+    }
+    table->count = count;
+
+    int status = 0;
+    for (int p = 0; p < spec->page_size_count && status == 0; p++) {
+        traces[p].addresses = addresses;
+        traces[p].len = len;
+        traces[p].page_size = spec->page_sizes[p];
+        status = threadpool_submit(pool, translate_task, &traces[p]);
+    }
+    threadpool_wait(pool);
+
+    int n = 0;
+    for (int p = 0; p < spec->page_size_count; p++) {
+        for (int f = 0; f < spec->frame_count_count; f++) {
+            for (int a = 0; a < spec->algorithm_count; a++, n++) {
+                SweepResult *r = &table->results[n];
+                r->page_size = spec->page_sizes[p];
+                r->frames = spec->frame_counts[f];
+                r->policy = policy_find(spec->algorithms[a]);
+                r->status = -1;
+                jobs[n].trace = &traces[p];
+                jobs[n].result = r;
+                if (status == 0)
+                    status = threadpool_submit(pool, run_task, &jobs[n]);
+            }
+        }
+    }
+    threadpool_wait(pool);
+    threadpool_destroy(pool);
+
+    for (int p = 0; p < spec->page_size_count; p++) {
+        if (traces[p].owned)
+            free(traces[p].pages);
+    }
+    free(traces);
+    free(jobs);
+    table->wall_seconds = timing_wall_seconds() - start;
+    return status;
+}
+
+void sweep_table_free(SweepTable *table) {
+    free(table->results);
+    table->results = NULL;
+    table->count = 0;
+}
+
+void sweep_write_csv(const SweepTable *table, FILE *out) {
+    fprintf(out, "page_size,frames,algorithm,faults,hits,evictions,wall_seconds,status\n");
+    for (int i = 0; i < table->count; i++) {
+        const SweepResult *r = &table->results[i];
+        fprintf(out, "%d,%d,%s,%lld,%lld,%lld,%.6f,%s\n", r->page_size, r->frames, r->policy->name, r->faults,
+                r->hits, r->evictions, r->wall_seconds, r->status == 0 ? "ok" : "failed");
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <stdio.h>
+#include "simulator.h"
+
+// Parameter sweep over page_size x frames x algorithm. Every combination
+// gets its own Simulator on a thread pool; runs at one page size share a
+// single read-only page reference string.
+typedef struct {
+    const int *page_sizes;
+    int page_size_count;
+    const int *frame_counts;
+    int frame_count_count;
+    const char *const *algorithms; // Registry names
+    int algorithm_count;
+    int threads;                   // 0: one per online CPU
+} SweepSpec;
+
+typedef struct {
+    int page_size;
+    int frames;
+    const ReplacementPolicy *policy;
+    long long hits;
+    long long faults;
+    long long evictions;
+    double wall_seconds;
+    int status; // 0, or -1 if the run ran out of memory
+} SweepResult;
+
+// Results ordered by page size, then frame count, then algorithm, as listed in the spec
+typedef struct {
+    SweepResult *results;
+    int count;
+    double wall_seconds; // Whole sweep, including page translation
+} SweepTable;
+
+int sweep_run(const PageReference *addresses, int len, const SweepSpec *spec, SweepTable *table);
+void sweep_table_free(SweepTable *table);
+void sweep_write_csv(const SweepTable *table, FILE *out);
+
+#endif
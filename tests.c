@@ -0,0 +1,1062 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bintrace.h"
+#include "compare.h"
+#include "framelist.h"
+#include "generator.h"
+#include "mrc.h"
+#include "partition.h"
+#include "pipeline.h"
+#include "probe.h"
+#include "shards.h"
+#include "simulator.h"
+#include "sweep.h"
+#include "trace.h"
+
+// Checks the engine against simple models of its parts, and the different
+// ways of running the same references against each other. Scratch files go
+// in the working directory, which ctest sets to the build tree.
+
+#define TEST_FRAMES 64
+#define TEST_ACCESSES 60000 // Spans many SIM_BATCH_SIZE batches
+#define TEST_PAGE_SIZE 4096
+#define TEST_SEED 7
+#define TEST_MRC_FRAMES 48
+#define TEST_MAX_POLICIES 16
+#define TEST_OPTIMAL_ACCESSES 3000 // Belady by brute force is quadratic
+#define TEST_MAP_KEYS 4096
+#define TEST_MAP_OPS 200000
+#define TEST_SCAN_PAGES 5000
+#define TEST_TEXT_TRACE "vmsim-tests.trace"
+#define TEST_BINARY_TRACE "vmsim-tests.vmtrace"
+
+static int failures;
+
+#define CHECK(cond, ...)                                                 \
+    do {                                                                 \
+        if (!(cond)) {                                                   \
+            fprintf(stderr, "%s:%d: %s: ", __FILE__, __LINE__, #cond);   \
+            fprintf(stderr, __VA_ARGS__);                                \
+            fputc('\n', stderr);                                         \
+            failures++;                                                  \
+        }                                                                \
+    } while (0)
+
+typedef struct {
+    long long hits;
+    long long faults;
+    long long evictions;
+    long long writebacks;
+} Counts;
+
+static Counts counts_of(const Simulator *sim) {
+    return (Counts){sim->hits, sim->faults, sim->evictions, sim->writebacks};
+}
+
+static int counts_equal(const Counts *a, const Counts *b) {
+    return a->hits == b->hits && a->faults == b->faults && a->evictions == b->evictions &&
+           a->writebacks == b->writebacks;
+}
+
+// Deterministic stand-in for rand(), so every platform checks the same cases
+static uint64_t next_random(uint64_t *state) {
+    *state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return *state >> 33;
+}
+
+// Three processes of different locality taking turns, with stores
+static void workload(Generator *gen) {
+    static const GenPattern patterns[] = {GEN_ZIPF, GEN_PHASED, GEN_UNIFORM};
+    GenProcessSpec specs[3];
+    for (int i = 0; i < 3; i++) {
+        gen_process_defaults(&specs[i], patterns[i], 4 * TEST_FRAMES);
+        specs[i].working_set = TEST_FRAMES / 2;
+        specs[i].phase_length = 5000;
+        specs[i].write_fraction = 0.3;
+    }
+    generator_init(gen, specs, 3, TEST_ACCESSES, 100, TEST_SEED);
+}
+
+static PageReference *workload_references(void) {
+    PageReference *refs = malloc(TEST_ACCESSES * sizeof(PageReference));
+    Generator gen;
+    workload(&gen);
+    size_t produced = 0, got;
+    while (refs && (got = generator_read(&gen, refs + produced, TEST_ACCESSES - produced)) > 0)
+        produced += got;
+    return refs;
+}
+
+static Simulator *new_simulator(const char *algorithm, int frames) {
+    Simulator *sim = simulator_create(frames, 1);
+    if (sim && simulator_set_algorithm(sim, algorithm) != 0) {
+        simulator_destroy(sim);
+        return NULL;
+    }
+    if (sim) {
+        simulator_set_page_size(sim, TEST_PAGE_SIZE);
+        simulator_set_verbosity(sim, SIM_VERBOSITY_SUMMARY);
+    }
+    return sim;
+}
+
+// One run of algorithm over the whole workload, streamed from the generator
+static int separate_run(const char *algorithm, int frames, Counts *out) {
+    Simulator *sim = new_simulator(algorithm, frames);
+    if (!sim)
+        return -1;
+    Generator gen;
+    workload(&gen);
+    int status = simulator_run_source(sim, &gen.source);
+    *out = counts_of(sim);
+    simulator_destroy(sim);
+    return status;
+}
+
+// Stops the run once it is past the first stop_after references
+static int stop_at(long long done, long long total, void *user_data) {
+    (void)total;
+    return done >= *(const long long *)user_data;
+}
+
+// Belady's rule by brute force: a full memory gives up the page whose next
+// use is furthest ahead, found by scanning forward. Fills fault_at with the
+// position of every fault and returns how many there were.
+static int belady_faults(const PageReference *refs, int len, int frames, int *fault_at) {
+    uint64_t resident[TEST_FRAMES];
+    int used = 0, faults = 0;
+    for (int i = 0; i < len; i++) {
+        uint64_t key = page_key(refs[i].pid, refs[i].page_num);
+        int frame = 0;
+        while (frame < used && resident[frame] != key)
+            frame++;
+        if (frame < used)
+            continue;
+        fault_at[faults++] = i;
+        if (used < frames) {
+            resident[used++] = key;
+            continue;
+        }
+        int victim = 0, furthest = -1;
+        for (int f = 0; f < used; f++) {
+            int next = i + 1;
+            while (next < len && page_key(refs[next].pid, refs[next].page_num) != resident[f])
+                next++;
+            if (next > furthest) {
+                furthest = next;
+                victim = f;
+            }
+        }
+        resident[victim] = key;
+    }
+    return faults;
+}
+
+typedef struct {
+    int *times;
+    int count;
+    int capacity;
+} FaultLog;
+
+static void log_faults(const SimEvent *events, size_t count, void *user_data) {
+    FaultLog *log = user_data;
+    for (size_t i = 0; i < count; i++) {
+        if (events[i].type == SIM_EVENT_FAULT && log->count < log->capacity)
+            log->times[log->count++] = (int)events[i].time;
+    }
+}
+
+static void test_optimal(const PageReference *refs) {
+    static const int frame_counts[] = {1, 3, 16, TEST_FRAMES};
+    int *expected = malloc(TEST_OPTIMAL_ACCESSES * sizeof(int));
+    FaultLog log = {malloc(TEST_OPTIMAL_ACCESSES * sizeof(int)), 0, TEST_OPTIMAL_ACCESSES};
+    CHECK(expected && log.times, "out of memory");
+    for (size_t k = 0; expected && log.times && k < sizeof(frame_counts) / sizeof(frame_counts[0]); k++) {
+        int frames = frame_counts[k];
+        int faults = belady_faults(refs, TEST_OPTIMAL_ACCESSES, frames, expected);
+        Simulator *sim = new_simulator("optimal", frames);
+        CHECK(sim != NULL, "optimal at %d frames", frames);
+        if (!sim)
+            break;
+        log.count = 0;
+        simulator_set_verbosity(sim, SIM_VERBOSITY_FAULTS);
+        simulator_set_event_sink(sim, log_faults, &log);
+        CHECK(simulator_run_references(sim, refs, TEST_OPTIMAL_ACCESSES) == 0, "optimal at %d frames", frames);
+        CHECK(sim->faults == faults, "%d frames: %lld faults, Belady has %d", frames, sim->faults, faults);
+        // Event times count accesses from 1
+        int same = log.count == faults;
+        for (int i = 0; same && i < faults; i++)
+            same = log.times[i] == expected[i] + 1;
+        CHECK(same, "%d frames: the faults fall on other accesses than Belady's", frames);
+        simulator_destroy(sim);
+    }
+    free(expected);
+    free(log.times);
+}
+
+// Random puts, removes and lookups against an array indexed by key number.
+// Keys of four pids share page numbers, and the map starts small, so probe
+// chains wrap, grow and get shifted back by removes.
+static void test_pagemap(void) {
+    static int model[TEST_MAP_KEYS]; // Value for key k, -1 while absent
+    PageMap map;
+    CHECK(pagemap_init(&map, 4) == 0, "pagemap_init");
+    for (int k = 0; k < TEST_MAP_KEYS; k++)
+        model[k] = -1;
+    uint64_t seed = TEST_SEED;
+    size_t count = 0;
+    for (int op = 0; op < TEST_MAP_OPS; op++) {
+        int k = (int)(next_random(&seed) % TEST_MAP_KEYS);
+        uint64_t key = page_key(k % 4, (long long)(k / 4) * 977);
+        int *value = pagemap_lookup(&map, key);
+        CHECK(model[k] < 0 ? value == NULL : value && *value == model[k], "key %d after %d operations", k, op);
+        switch (next_random(&seed) % 3) {
+        case 0:
+            CHECK(pagemap_put(&map, key, op) == 0, "put");
+            count += model[k] < 0;
+            model[k] = op;
+            break;
+        case 1:
+            CHECK(pagemap_remove(&map, key) == (model[k] < 0 ? -1 : 0), "remove key %d", k);
+            count -= model[k] >= 0;
+            model[k] = -1;
+            break;
+        default:
+            break;
+        }
+        CHECK(map.count == count, "%zu entries, expected %zu", map.count, count);
+    }
+    for (int k = 0; k < TEST_MAP_KEYS; k++) {
+        int *value = pagemap_lookup(&map, page_key(k % 4, (long long)(k / 4) * 977));
+        CHECK(model[k] < 0 ? value == NULL : value && *value == model[k], "key %d at the end", k);
+    }
+    pagemap_free(&map);
+}
+
+// Fills and drains a frame table at random, checking lookups, the free
+// frames and the load-order list against an array of owners
+static void test_frame_table(void) {
+    FrameTable ft;
+    CHECK(frame_table_init(&ft, TEST_FRAMES) == 0, "frame_table_init");
+    uint64_t owner[TEST_FRAMES]; // Key in each frame, PAGEMAP_EMPTY while free
+    int loaded[TEST_FRAMES];
+    for (int f = 0; f < TEST_FRAMES; f++)
+        owner[f] = PAGEMAP_EMPTY;
+    uint64_t seed = TEST_SEED;
+    for (int op = 0; op < TEST_MAP_OPS / 10; op++) {
+        int pid = (int)(next_random(&seed) % 3);
+        long long page = (long long)(next_random(&seed) % (2 * TEST_FRAMES));
+        uint64_t key = page_key(pid, page);
+        int expected = 0;
+        while (expected < TEST_FRAMES && owner[expected] != key)
+            expected++;
+        int frame = frame_table_lookup(&ft, pid, page);
+        CHECK(frame == (expected < TEST_FRAMES ? expected : -1), "pid %d page %lld in frame %d", pid, page, frame);
+        if (frame >= 0) {
+            frame_table_remove(&ft, frame);
+            owner[frame] = PAGEMAP_EMPTY;
+            continue;
+        }
+        int was_full = ft.used == TEST_FRAMES;
+        frame = frame_table_insert(&ft, pid, page);
+        CHECK((frame < 0) == was_full, "insert gave frame %d with %d in use", frame, ft.used);
+        if (frame < 0)
+            continue;
+        CHECK(owner[frame] == PAGEMAP_EMPTY, "frame %d handed out twice", frame);
+        owner[frame] = key;
+        loaded[frame] = op;
+    }
+    // Oldest first, every resident frame once
+    int listed = 0, previous = -1;
+    for (int f = ft.oldest; f >= 0 && listed <= TEST_FRAMES; f = ft.load_next[f]) {
+        CHECK(owner[f] != PAGEMAP_EMPTY && loaded[f] > previous, "frame %d out of load order", f);
+        previous = loaded[f];
+        listed++;
+    }
+    CHECK(listed == ft.used, "%d frames on the load list, %d in use", listed, ft.used);
+    frame_table_free(&ft);
+}
+
+// References whose keys page_key() cannot tell apart stop the run, and a
+// trace skips their lines
+static void test_key_range(void) {
+    static const PageReference bad[][2] = {
+        {{0, 0, 1}, {0, 0, 1LL << PAGE_NUMBER_BITS}},
+        {{0, 0, 1}, {UINT16_MAX, 0, PAGE_NUMBER_LIMIT}},
+        {{0, 0, 1}, {0, 0, -1}},
+        {{0, 0, 1}, {UINT16_MAX + 1, 0, 1}},
+    };
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        Simulator *sim = new_simulator("lru", 4);
+        CHECK(sim && simulator_run_references(sim, bad[i], 2) == -1, "reference %zu accepted", i);
+        simulator_destroy(sim);
+    }
+    static const PageReference edge[] = {
+        {UINT16_MAX, 0, PAGE_NUMBER_LIMIT - 1},
+        {0, 0, PAGE_NUMBER_LIMIT - 1},
+    };
+    Simulator *sim = new_simulator("lru", 4);
+    CHECK(sim && simulator_run_references(sim, edge, 2) == 0 && sim->faults == 2, "largest pid and page");
+    simulator_destroy(sim);
+
+    FILE *text = fopen(TEST_TEXT_TRACE, "w");
+    CHECK(text != NULL, "cannot create %s", TEST_TEXT_TRACE);
+    if (!text)
+        return;
+    fprintf(text, "0 0x1000 R\n0 0x%llx R\n0 0x2000 W\n", 1ULL << (PAGE_NUMBER_BITS + 12));
+    CHECK(fclose(text) == 0, "writing %s", TEST_TEXT_TRACE);
+    TraceReader trace;
+    CHECK(trace_reader_open(&trace, TEST_TEXT_TRACE, TRACE_FORMAT_TEXT, TEST_PAGE_SIZE) == 0, "open text");
+    PageReference got[4];
+    CHECK(trace_reader_read(&trace, got, 4) == 2 && trace.skipped == 1, "%lld lines skipped", trace.skipped);
+    trace_reader_close(&trace);
+    remove(TEST_TEXT_TRACE);
+}
+
+static void test_mrc(const PageReference *refs) {
+    MissRatioCurve mrc;
+    int status = mrc_compute(refs, TEST_ACCESSES, TEST_MRC_FRAMES, 1, &mrc);
+    CHECK(status == 0, "mrc_compute");
+    if (status != 0)
+        return;
+    CHECK(mrc.accesses == TEST_ACCESSES, "%lld accesses", mrc.accesses);
+    for (int frames = 1; frames <= TEST_MRC_FRAMES; frames++) {
+        const char *names[] = {"lru", "optimal"};
+        const long long *curves[] = {mrc.lru_faults, mrc.opt_faults};
+        for (int k = 0; k < 2; k++) {
+            Simulator *sim = new_simulator(names[k], frames);
+            CHECK(sim && simulator_run_references(sim, refs, TEST_ACCESSES) == 0, "%s at %d frames", names[k],
+                  frames);
+            if (sim)
+                CHECK(curves[k][frames] == sim->faults, "%s at %d frames: curve %lld, run %lld", names[k], frames,
+                      curves[k][frames], sim->faults);
+            simulator_destroy(sim);
+        }
+    }
+    mrc_free(&mrc);
+
+    long long stop_after = TEST_ACCESSES;
+    CHECK(mrc_compute_progress(refs, TEST_ACCESSES, TEST_MRC_FRAMES, 1, stop_at, &stop_after, &mrc) == SIM_CANCELLED,
+          "mrc_compute_progress ran past a cancel");
+}
+
+// Every sweep result against a run of its own over the same pages
+static void test_sweep(const PageReference *refs) {
+    static const int page_sizes[] = {TEST_PAGE_SIZE, 4 * TEST_PAGE_SIZE, 3000};
+    static const int frame_counts[] = {8, TEST_FRAMES};
+    static const char *const algorithms[] = {"fifo", "lru", "arc", "optimal"};
+    PageReference *addresses = malloc(TEST_ACCESSES * sizeof(PageReference));
+    PageReference *pages = malloc(TEST_ACCESSES * sizeof(PageReference));
+    CHECK(addresses && pages, "out of memory");
+    if (!addresses || !pages) {
+        free(addresses);
+        free(pages);
+        return;
+    }
+    for (int i = 0; i < TEST_ACCESSES; i++) {
+        addresses[i] = refs[i];
+        addresses[i].page_num = refs[i].page_num * TEST_PAGE_SIZE + (long long)i * 37 % TEST_PAGE_SIZE;
+    }
+    SweepSpec spec = {page_sizes, 3, frame_counts, 2, algorithms, 4, 2};
+    SweepTable table;
+    CHECK(sweep_run(addresses, TEST_ACCESSES, &spec, &table) == 0, "sweep_run");
+    CHECK(table.count == 3 * 2 * 4, "%d results", table.count);
+    for (int i = 0; i < table.count; i++) {
+        const SweepResult *r = &table.results[i];
+        for (int k = 0; k < TEST_ACCESSES; k++) {
+            pages[k] = addresses[k];
+            pages[k].page_num = addresses[k].page_num / r->page_size;
+        }
+        Simulator *sim = new_simulator(r->policy->name, r->frames);
+        CHECK(sim && simulator_run_references(sim, pages, TEST_ACCESSES) == 0, "%s", r->policy->name);
+        if (sim)
+            CHECK(r->status == 0 && r->hits == sim->hits && r->faults == sim->faults &&
+                      r->evictions == sim->evictions,
+                  "%s, %d frames of %d bytes: %lld faults in the sweep, %lld alone", r->policy->name, r->frames,
+                  r->page_size, r->faults, sim->faults);
+        simulator_destroy(sim);
+    }
+    sweep_table_free(&table);
+    free(addresses);
+    free(pages);
+}
+
+// The same seed gives the same references however they are read
+static void test_generator(const PageReference *refs) {
+    static const size_t batches[] = {1, 7, SIM_BATCH_SIZE};
+    static PageReference batch[SIM_BATCH_SIZE];
+    for (size_t b = 0; b < sizeof(batches) / sizeof(batches[0]); b++) {
+        Generator gen;
+        workload(&gen);
+        size_t produced = 0, got;
+        int same = 1;
+        while ((got = generator_read(&gen, batch, batches[b])) > 0) {
+            for (size_t i = 0; i < got && same; i++) {
+                const PageReference *ref = &refs[produced + i];
+                same = produced + i < TEST_ACCESSES && batch[i].pid == ref->pid &&
+                       batch[i].page_num == ref->page_num && batch[i].write == ref->write;
+            }
+            produced += got;
+        }
+        CHECK(same && produced == TEST_ACCESSES, "read %zu at a time: %zu references", batches[b], produced);
+    }
+}
+
+// Runs algorithm over src to the end
+static int source_run(const char *algorithm, RefSource *src, Counts *out) {
+    Simulator *sim = new_simulator(algorithm, TEST_FRAMES);
+    if (!sim)
+        return -1;
+    int status = simulator_run_source(sim, src);
+    *out = counts_of(sim);
+    simulator_destroy(sim);
+    return status;
+}
+
+static void test_bintrace(const PageReference *refs) {
+    FILE *text = fopen(TEST_TEXT_TRACE, "w");
+    CHECK(text != NULL, "cannot create %s", TEST_TEXT_TRACE);
+    if (!text)
+        return;
+    for (int i = 0; i < TEST_ACCESSES; i++)
+        fprintf(text, "%d 0x%llx %c\n", refs[i].pid, (unsigned long long)refs[i].page_num * TEST_PAGE_SIZE,
+                refs[i].write ? 'W' : 'R');
+    CHECK(fclose(text) == 0, "writing %s", TEST_TEXT_TRACE);
+
+    // What vmsim-convert does
+    TraceReader trace;
+    BinTraceWriter writer;
+    CHECK(trace_reader_open(&trace, TEST_TEXT_TRACE, TRACE_FORMAT_TEXT, TEST_PAGE_SIZE) == 0, "open text");
+    CHECK(bintrace_writer_open(&writer, TEST_BINARY_TRACE, TEST_PAGE_SIZE, BINTRACE_FLAG_CRC, 1000) == 0,
+          "open binary");
+    PageReference *batch = malloc(SIM_BATCH_SIZE * sizeof(PageReference));
+    size_t got;
+    while (batch && (got = trace_reader_read(&trace, batch, SIM_BATCH_SIZE)) > 0)
+        CHECK(bintrace_writer_append(&writer, batch, got) == 0, "append");
+    free(batch);
+    CHECK(trace.skipped == 0, "%lld lines skipped", trace.skipped);
+    trace_reader_close(&trace);
+    CHECK(bintrace_writer_close(&writer) == 0, "close binary");
+    CHECK(writer.record_count == TEST_ACCESSES, "%llu records", (unsigned long long)writer.record_count);
+
+    for (int i = 0; i < policy_count(); i++) {
+        const char *name = policy_at(i)->name;
+        Counts from_array = {0}, from_text = {0}, from_binary = {0};
+        Simulator *sim = new_simulator(name, TEST_FRAMES);
+        CHECK(sim && simulator_run_references(sim, refs, TEST_ACCESSES) == 0, "%s", name);
+        if (sim)
+            from_array = counts_of(sim);
+        simulator_destroy(sim);
+        if (!sim)
+            continue;
+
+        CHECK(trace_reader_open(&trace, TEST_TEXT_TRACE, TRACE_FORMAT_TEXT, TEST_PAGE_SIZE) == 0, "reopen text");
+        CHECK(source_run(name, &trace.source, &from_text) == 0, "%s over text", name);
+        trace_reader_close(&trace);
+        BinTraceReader binary;
+        int opened = bintrace_reader_open(&binary, TEST_BINARY_TRACE, TEST_PAGE_SIZE) == 0;
+        CHECK(opened, "open binary");
+        if (!opened)
+            continue;
+        CHECK(source_run(name, &binary.source, &from_binary) == 0, "%s over binary", name);
+        CHECK(!binary.corrupt, "%s is corrupt", TEST_BINARY_TRACE);
+        bintrace_reader_close(&binary);
+
+        CHECK(counts_equal(&from_array, &from_text), "%s: %lld faults from the array, %lld from text", name,
+              from_array.faults, from_text.faults);
+        CHECK(counts_equal(&from_text, &from_binary), "%s: %lld faults from text, %lld from binary", name,
+              from_text.faults, from_binary.faults);
+    }
+    remove(TEST_TEXT_TRACE);
+
+    // A page page_key() cannot keep fails the whole file
+    PageReference too_far = {0, 0, PAGE_NUMBER_LIMIT};
+    CHECK(bintrace_writer_open(&writer, TEST_BINARY_TRACE, TEST_PAGE_SIZE, 0, 1000) == 0, "reopen binary");
+    CHECK(bintrace_writer_append(&writer, &too_far, 1) == -1, "page %lld appended", too_far.page_num);
+    CHECK(bintrace_writer_close(&writer) == -1, "closed after a failed append");
+    remove(TEST_BINARY_TRACE);
+}
+
+// Every kernel against a plain loop, for keys present, absent and empty
+static void test_probe(void) {
+    uint64_t keys[TEST_FRAMES];
+    uint64_t seed = TEST_SEED;
+    for (int count = KEY_PROBE_PAD; count <= TEST_FRAMES; count += KEY_PROBE_PAD) {
+        for (int i = 0; i < count; i++)
+            keys[i] = next_random(&seed) % 4 == 0 ? PAGEMAP_EMPTY : page_key(i % 3, (long long)next_random(&seed));
+        for (int k = 0; k < key_probe_count(); k++) {
+            const KeyProbe *probe = key_probe_at(k);
+            for (int i = 0; i <= count; i++) {
+                uint64_t key = i < count ? keys[i] : page_key(3, 0);
+                if (key == PAGEMAP_EMPTY)
+                    continue; // Never looked up, and in many slots
+                int expected = 0;
+                while (expected < count && keys[expected] != key)
+                    expected++;
+                int found = probe->find(keys, count, key);
+                CHECK(found == (expected < count ? expected : -1), "%s over %d keys: slot %d, expected %d",
+                      probe->name, count, found, expected);
+            }
+        }
+    }
+}
+
+// Whether file, read from the start, contains text
+static int file_contains(FILE *file, const char *text) {
+    static char buf[16384];
+    rewind(file);
+    size_t len = fread(buf, 1, sizeof(buf) - 1, file);
+    buf[len] = '\0';
+    return strstr(buf, text) != NULL;
+}
+
+// A counter that did not open exports as null in JSON and as an empty
+// field in CSV, never as a number
+static void test_stats_export(const PageReference *refs) {
+    Simulator *sim = new_simulator("lru", TEST_FRAMES);
+    FILE *json = tmpfile(), *csv = tmpfile();
+    CHECK(sim && json && csv && simulator_run_references(sim, refs, TEST_ACCESSES) == 0, "setup");
+    if (sim && json && csv) {
+        sim->stats.perf_requested = 1;
+        sim->stats.perf_status = 0;
+        sim->stats.perf_values[SIM_PERF_CYCLES] = 12345;
+        sim->stats.perf_values[SIM_PERF_INSTRUCTIONS] = -1;
+        sim->stats.perf_values[SIM_PERF_CACHE_MISSES] = 0;
+        CHECK(simulator_write_stats_json(sim, json) == 0, "JSON");
+        CHECK(simulator_write_stats_csv(sim, csv) == 0, "CSV");
+        CHECK(file_contains(json, "\"cycles\": 12345, \"instructions\": null, \"cache_misses\": 0"), "JSON perf");
+        CHECK(file_contains(csv, "perf,,instructions,\n") && file_contains(csv, "perf,,cache_misses,0\n"),
+              "CSV perf");
+    }
+    if (json)
+        fclose(json);
+    if (csv)
+        fclose(csv);
+    simulator_destroy(sim);
+}
+
+typedef struct {
+    RefSource source; // Must stay first: simulator_run_source() takes &source
+    const PageReference *refs;
+    size_t len;
+    size_t next;
+} ArraySource;
+
+static size_t array_read(RefSource *src, PageReference *out, size_t max) {
+    ArraySource *a = (ArraySource *)src;
+    size_t n = a->len - a->next < max ? a->len - a->next : max;
+    memcpy(out, a->refs + a->next, n * sizeof(PageReference));
+    a->next += n;
+    return n;
+}
+
+// Sampling every key reproduces the exact curve and run. Sampling some of
+// them keeps the exact curve within the reported error once the memory
+// holds at least two sampled pages, i.e. from 2 / rate frames up.
+static void test_shards(const PageReference *refs) {
+    static const ShardsConfig configs[] = {
+        {SHARDS_FIXED_RATE, 1.0, 0, 0},
+        {SHARDS_FIXED_RATE, 0.1, 0, 1},
+        {SHARDS_FIXED_SIZE, 0.0, 100, 1},
+    };
+    MissRatioCurve exact;
+    int status = mrc_compute(refs, TEST_ACCESSES, TEST_MRC_FRAMES, 0, &exact);
+    CHECK(status == 0, "mrc_compute");
+    for (size_t k = 0; status == 0 && k < sizeof(configs) / sizeof(configs[0]); k++) {
+        ArraySource src = {{array_read}, refs, TEST_ACCESSES, 0};
+        ShardsMrc mrc;
+        CHECK(shards_mrc_source(&src.source, &configs[k], TEST_MRC_FRAMES, &mrc) == 0, "shards_mrc_source");
+        CHECK(mrc.accesses == TEST_ACCESSES, "%lld accesses", mrc.accesses);
+        for (int c = 1; mrc.miss_ratio && c <= TEST_MRC_FRAMES; c++) {
+            double ratio = (double)exact.lru_faults[c] / TEST_ACCESSES;
+            if (mrc.rate == 1.0)
+                CHECK(fabs(mrc.miss_ratio[c] - ratio) < 1e-9, "%d frames: %f sampled, %f exact", c,
+                      mrc.miss_ratio[c], ratio);
+            else if (c * mrc.rate >= 2.0)
+                CHECK(fabs(mrc.miss_ratio[c] - ratio) <= mrc.error[c], "rate %f, %d frames: %f +- %f, exact %f",
+                      mrc.rate, c, mrc.miss_ratio[c], mrc.error[c], ratio);
+        }
+        shards_mrc_free(&mrc);
+    }
+    if (status == 0)
+        mrc_free(&exact);
+
+    Simulator *sim = new_simulator("lru", TEST_FRAMES);
+    ArraySource src = {{array_read}, refs, TEST_ACCESSES, 0};
+    ShardsEstimate estimate;
+    Counts alone = {0};
+    CHECK(sim && shards_simulate(sim, &src.source, &configs[0], &estimate) == 0, "shards_simulate");
+    CHECK(separate_run("lru", TEST_FRAMES, &alone) == 0 && estimate.sampled_faults == alone.faults,
+          "%lld faults sampled, %lld run", estimate.sampled_faults, alone.faults);
+    simulator_destroy(sim);
+}
+
+static void count_events(const SimEvent *events, size_t count, void *user_data) {
+    (void)events;
+    *(long long *)user_data += (long long)count;
+}
+
+static void test_pipeline(void) {
+    for (int i = 0; i < policy_count(); i++) {
+        const char *name = policy_at(i)->name;
+        Counts runs[2];
+        long long events[2] = {0, 0};
+        for (int pipelined = 0; pipelined < 2; pipelined++) {
+            Simulator *sim = new_simulator(name, TEST_FRAMES);
+            CHECK(sim != NULL, "%s", name);
+            if (!sim)
+                return;
+            simulator_set_verbosity(sim, SIM_VERBOSITY_FAULTS);
+            simulator_set_event_sink(sim, count_events, &events[pipelined]);
+            Generator gen;
+            workload(&gen);
+            PipelineConfig config;
+            pipeline_config_defaults(&config);
+            config.spin = 0; // The test machine may have fewer cores than stages
+            int status = pipelined ? simulator_run_pipelined(sim, &gen.source, &config, NULL)
+                                   : simulator_run_source(sim, &gen.source);
+            CHECK(status == 0, "%s pipelined=%d", name, pipelined);
+            runs[pipelined] = counts_of(sim);
+            simulator_destroy(sim);
+        }
+        CHECK(counts_equal(&runs[0], &runs[1]), "%s: %lld faults sequential, %lld pipelined", name, runs[0].faults,
+              runs[1].faults);
+        CHECK(events[0] == events[1], "%s: %lld events sequential, %lld pipelined", name, events[0], events[1]);
+    }
+}
+
+static void check_table(const CompareTable *table, const char *how) {
+    for (int i = 0; i < table->count; i++) {
+        const CompareResult *r = &table->results[i];
+        Counts alone, together = {r->hits, r->faults, r->evictions, r->writebacks};
+        CHECK(separate_run(r->policy->name, table->frames, &alone) == 0, "%s", r->policy->name);
+        CHECK(counts_equal(&together, &alone), "%s %s: %lld faults side by side, %lld alone", how,
+              r->policy->name, together.faults, alone.faults);
+    }
+}
+
+static void test_compare(const PageReference *refs) {
+    const char *all[TEST_MAX_POLICIES];
+    const char *streamed[TEST_MAX_POLICIES];
+    int all_count = 0, streamed_count = 0;
+    for (int i = 0; i < policy_count() && all_count < TEST_MAX_POLICIES; i++) {
+        all[all_count++] = policy_at(i)->name;
+        if (!policy_at(i)->needs_future)
+            streamed[streamed_count++] = policy_at(i)->name;
+    }
+
+    CompareSpec spec = {TEST_FRAMES, all, all_count, NULL, NULL, NULL, NULL, 0};
+    CompareTable table;
+    CHECK(compare_run_references(refs, TEST_ACCESSES, &spec, &table) == 0, "compare over an array");
+    check_table(&table, "array");
+    compare_table_free(&table);
+
+    // Without a policy that needs the future the source is streamed batch by batch
+    spec.algorithms = streamed;
+    spec.algorithm_count = streamed_count;
+    Generator gen;
+    workload(&gen);
+    CHECK(compare_run_source(&gen.source, &spec, &table) == 0, "compare over a stream");
+    CHECK(table.accesses == TEST_ACCESSES, "%lld accesses", table.accesses);
+    check_table(&table, "stream");
+    compare_table_free(&table);
+
+    // A reference no policy can key fails the comparison, in the second batch
+    static PageReference bad[SIM_BATCH_SIZE + 1];
+    memcpy(bad, refs, sizeof(bad));
+    bad[SIM_BATCH_SIZE].page_num = -1;
+    ArraySource src = {{array_read}, bad, SIM_BATCH_SIZE + 1, 0};
+    CHECK(compare_run_references(bad, SIM_BATCH_SIZE + 1, &spec, &table) == -1, "bad page over an array");
+    CHECK(compare_run_source(&src.source, &spec, &table) == -1, "bad page over a stream");
+}
+
+// Every access faults on a new page into one frame with one queue slot, so
+// each fault waits for exactly its own transfers
+static void test_swap(void) {
+    enum { PAGES = 100 };
+    PageReference refs[PAGES];
+    for (int write = 0; write < 2; write++) {
+        for (int i = 0; i < PAGES; i++)
+            refs[i] = (PageReference){0, (unsigned char)write, i};
+        for (int link = 0; link < 2; link++) {
+            SwapConfig config;
+            swap_config_defaults(&config);
+            config.queue_depth = 1;
+            config.bandwidth_mb_s = link ? SWAP_DEFAULT_BANDWIDTH_MB_S : 0;
+            Simulator *sim = new_simulator("fifo", 1);
+            CHECK(sim && simulator_set_swap(sim, &config) == 0, "simulator_set_swap");
+            if (!sim)
+                return;
+            CHECK(simulator_run_references(sim, refs, PAGES) == 0, "write=%d link=%d", write, link);
+            double transfer = link ? TEST_PAGE_SIZE * 1000.0 / SWAP_DEFAULT_BANDWIDTH_MB_S : 0.0;
+            double read = 1000.0 * SWAP_DEFAULT_READ_US + transfer;
+            double written = 1000.0 * SWAP_DEFAULT_WRITE_US + transfer;
+            // Every fault but the first writes its dirty victim back first
+            double stall = PAGES * read + (write ? (PAGES - 1) * written : 0.0);
+            CHECK(fabs(sim->swap.stall_ns - stall) < 1e-3, "write=%d link=%d: %.0f ns stalled, expected %.0f", write,
+                  link, sim->swap.stall_ns, stall);
+            CHECK(fabs(sim->swap.now - stall - PAGES * SWAP_DEFAULT_ACCESS_NS) < 1e-3, "write=%d link=%d: %.0f ns",
+                  write, link, sim->swap.now);
+            CHECK(sim->swap.reads == PAGES && sim->swap.writes == (write ? PAGES - 1 : 0) &&
+                      sim->writebacks == sim->swap.writes,
+                  "write=%d: %lld reads, %lld writes", write, sim->swap.reads, sim->swap.writes);
+            simulator_destroy(sim);
+        }
+    }
+}
+
+// Every prefetched page is used, wasted or still waiting at the end, and
+// the summary's accuracy and coverage follow from those counts. In a scan
+// that touches each page once, every access either faults or is the first
+// use of a prefetch.
+static void test_prefetch(const PageReference *refs) {
+    PageReference *scan = malloc(TEST_SCAN_PAGES * sizeof(PageReference));
+    CHECK(scan != NULL, "out of memory");
+    if (!scan)
+        return;
+    for (int i = 0; i < TEST_SCAN_PAGES; i++)
+        scan[i] = (PageReference){0, 0, i};
+    for (int p = 0; p < prefetcher_count(); p++) {
+        const char *name = prefetcher_at(p)->name;
+        for (int scanning = 0; scanning < 2; scanning++) {
+            Simulator *sim = new_simulator("lru", TEST_FRAMES);
+            CHECK(sim && simulator_set_prefetcher(sim, name, 0) == 0, "%s", name);
+            if (!sim)
+                continue;
+            int len = scanning ? TEST_SCAN_PAGES : TEST_ACCESSES;
+            CHECK(simulator_run_references(sim, scanning ? scan : refs, len) == 0, "%s", name);
+            const PrefetchCounts *pf = &sim->prefetch;
+            long long waiting = 0;
+            for (int f = 0; f < sim->memory.frame_count; f++)
+                waiting += sim->memory.frames[f].process_id >= 0 && sim->memory.prefetched[f];
+            CHECK(pf->issued == pf->hits + pf->wasted + waiting, "%s: %lld issued, %lld used, %lld wasted, %lld left",
+                  name, pf->issued, pf->hits, pf->wasted, waiting);
+            if (scanning)
+                CHECK(pf->hits + sim->faults == TEST_SCAN_PAGES, "%s: %lld prefetch hits, %lld faults", name,
+                      pf->hits, sim->faults);
+            char summary[2048], expected[128];
+            simulator_format_summary(sim, summary, sizeof(summary));
+            snprintf(expected, sizeof(expected), "(accuracy %.2f%%, coverage %.2f%%)",
+                     pf->issued > 0 ? 100.0 * (double)pf->hits / (double)pf->issued : 0.0,
+                     100.0 * (double)pf->hits / (double)(pf->hits + sim->faults));
+            CHECK(strstr(summary, expected) != NULL, "%s: summary lacks %s", name, expected);
+            simulator_destroy(sim);
+        }
+    }
+    free(scan);
+}
+
+// two_list_save() writes four per-frame arrays (prev, next, frame_list and
+// frame_key), then the two resident and the two ghost FrameLists, and ends
+// with p; this reads the list sizes and p back out of it
+static void two_list_sizes(const unsigned char *saved, long size, int frames, int sizes[4], int *p) {
+    FrameList lists[4]; // T1 or A1in, T2 or Am, B1 or A1out, B2
+    memcpy(lists, saved + (size_t)frames * (2 * sizeof(int) + 1 + sizeof(uint64_t)), sizeof(lists));
+    for (int l = 0; l < 4; l++)
+        sizes[l] = lists[l].size;
+    memcpy(p, saved + size - (long)sizeof(int), sizeof(int));
+}
+
+// Checkpoints state and loads it into a fresh one, which checks its links
+// against the resident frames; for 2Q and ARC also checks the list sizes
+static void check_policy_state(const ReplacementPolicy *policy, const void *state, int used, int index) {
+    unsigned char resident[TEST_FRAMES] = {0};
+    memset(resident, 1, (size_t)used);
+    FILE *file = tmpfile();
+    void *copy = policy->create(TEST_FRAMES);
+    CHECK(file && copy && policy->save(state, file) == 0, "%s: save", policy->name);
+    long size = file ? ftell(file) : 0;
+    unsigned char *saved = size > 0 ? malloc((size_t)size) : NULL;
+    if (saved && copy) {
+        rewind(file);
+        CHECK(fread(saved, 1, (size_t)size, file) == (size_t)size, "%s: reread", policy->name);
+        rewind(file);
+        policy->reset(copy, NULL, 0);
+        CHECK(policy->load(copy, file, resident) == 0, "%s: inconsistent after %d accesses", policy->name, index);
+    }
+    int arc = policy == &policy_arc;
+    if (saved && (arc || policy == &policy_2q)) {
+        int s[4], p;
+        two_list_sizes(saved, size, TEST_FRAMES, s, &p);
+        CHECK(s[0] + s[1] == used, "%s: %d + %d pages listed, %d resident", policy->name, s[0], s[1], used);
+        if (arc)
+            CHECK(s[0] + s[2] <= TEST_FRAMES && s[0] + s[1] + s[2] + s[3] <= 2 * TEST_FRAMES && p >= 0 &&
+                      p <= TEST_FRAMES,
+                  "arc after %d accesses: T1 %d, T2 %d, B1 %d, B2 %d, p %d", index, s[0], s[1], s[2], s[3], p);
+        else
+            CHECK(s[2] <= TEST_FRAMES / 2 && s[3] == 0, "2q after %d accesses: A1out %d", index, s[2]);
+    }
+    free(saved);
+    if (copy)
+        policy->destroy(copy);
+    if (file)
+        fclose(file);
+}
+
+// Brings key into memory through policy the way the simulator does and
+// returns its frame, or -1 if the policy gave up a frame it may not
+static int policy_load(const ReplacementPolicy *policy, void *state, uint64_t *keys, int *used, uint64_t key,
+                       int index, int pinned) {
+    static const unsigned char clean[TEST_FRAMES];
+    PolicyAccess access = {key, index, 0, clean, NULL, NULL, pinned};
+    int frame = *used < TEST_FRAMES ? (*used)++ : policy->choose_victim(state, &access);
+    if (frame < 0 || frame >= TEST_FRAMES || frame == pinned)
+        return -1;
+    keys[frame] = key;
+    policy->on_miss(state, frame, &access);
+    return frame;
+}
+
+// Drives every policy that checkpoints straight through its ops. Each
+// fault also prefetches the next page with the faulting frame pinned, so
+// prefetches hit ghosts too.
+static void test_policy_state(const PageReference *refs) {
+    for (int i = 0; i < policy_count(); i++) {
+        const ReplacementPolicy *policy = policy_at(i);
+        if (!policy->save || policy->needs_future)
+            continue;
+        void *state = policy->create(TEST_FRAMES);
+        CHECK(state && policy->reset(state, NULL, 0) == 0, "%s", policy->name);
+        if (!state)
+            continue;
+        uint64_t keys[TEST_FRAMES];
+        int used = 0, frame = 0;
+        for (int k = 0; k < TEST_ACCESSES / 4 && frame >= 0; k++) {
+            uint64_t key = page_key(refs[k].pid, refs[k].page_num);
+            uint64_t next = page_key(refs[k].pid, refs[k].page_num + 1);
+            frame = 0;
+            while (frame < used && keys[frame] != key)
+                frame++;
+            if (frame < used) {
+                PolicyAccess access = {key, k, 0, NULL, NULL, NULL, -1};
+                policy->on_hit(state, frame, &access);
+            } else {
+                frame = policy_load(policy, state, keys, &used, key, k, -1);
+                int present = 0;
+                while (present < used && keys[present] != next)
+                    present++;
+                if (frame >= 0 && present == used)
+                    frame = policy_load(policy, state, keys, &used, next, k, frame) >= 0 ? frame : -1;
+                CHECK(frame >= 0, "%s gave up a pinned or free frame", policy->name);
+            }
+            if (k % 61 == 0)
+                check_policy_state(policy, state, used, k);
+        }
+        policy->destroy(state);
+    }
+}
+
+// A TLB one entry bigger than memory: evicted pages lose their entries,
+// so every resident page keeps one and the TLB misses exactly when the
+// simulator faults. Without walk caches every walk reads every level.
+static void test_mmu(const PageReference *refs) {
+    MmuConfig config;
+    mmu_config_defaults(&config);
+    config.tlb_entries = config.tlb_ways = TEST_FRAMES + 1;
+    config.pwc_entries = 0;
+    Simulator *sim = new_simulator("lru", TEST_FRAMES);
+    CHECK(sim && simulator_set_mmu(sim, &config) == 0, "simulator_set_mmu");
+    if (!sim)
+        return;
+    const MmuCounts *c = &sim->mmu.counts;
+    CHECK(simulator_run_references(sim, refs, TEST_ACCESSES) == 0, "run");
+    CHECK(c->tlb_hits + c->tlb_misses == TEST_ACCESSES, "%lld hits, %lld misses", c->tlb_hits, c->tlb_misses);
+    CHECK(c->tlb_misses == sim->faults && c->misses[MMU_PAGE_4K] == c->tlb_misses, "%lld TLB misses, %lld faults",
+          c->tlb_misses, sim->faults);
+    CHECK(c->invalidations == sim->evictions, "%lld invalidations, %lld evictions", c->invalidations,
+          sim->evictions);
+    CHECK(c->walk_refs == c->tlb_misses * config.levels && c->pwc_hits == 0, "%lld walk references",
+          c->walk_refs);
+
+    // Walk caches only ever shorten walks
+    config.pwc_entries = MMU_DEFAULT_PWC_ENTRIES;
+    CHECK(simulator_set_mmu(sim, &config) == 0 && simulator_run_references(sim, refs, TEST_ACCESSES) == 0, "pwc");
+    CHECK(c->pwc_hits > 0 && c->walk_refs < c->tlb_misses * config.levels && c->walk_refs >= c->tlb_misses,
+          "%lld walk references, %lld walk cache hits", c->walk_refs, c->pwc_hits);
+    simulator_destroy(sim);
+}
+
+// No epoch hands out more frames than there are, every running process
+// has at least one, and every reference is simulated once
+static void test_partition(const PageReference *refs) {
+    static const int frame_counts[] = {2, 4, TEST_FRAMES};
+    for (int a = PARTITION_FIXED; a <= PARTITION_PFF; a++) {
+        const char *name = partition_allocator_name((PartitionAllocator)a);
+        for (size_t f = 0; f < sizeof(frame_counts) / sizeof(frame_counts[0]); f++) {
+            for (int load_control = 0; load_control < 2; load_control++) {
+                PartitionSpec spec;
+                partition_spec_defaults(&spec, frame_counts[f], "lru");
+                spec.allocator = (PartitionAllocator)a;
+                spec.epoch = 2000;
+                spec.load_control = load_control;
+                spec.threads = 2;
+                PartitionReport report;
+                CHECK(partition_run_references(refs, TEST_ACCESSES, &spec, &report) == 0, "%s", name);
+                long long accesses = 0;
+                for (int p = 0; p < report.process_count; p++)
+                    accesses += report.processes[p].accesses;
+                CHECK(report.accesses == TEST_ACCESSES && accesses == TEST_ACCESSES,
+                      "%s: %lld accesses, %lld over the processes", name, report.accesses, accesses);
+                for (size_t s = 0; s < report.sample_count;) {
+                    long long epoch = report.samples[s].epoch;
+                    int allocated = 0;
+                    for (; s < report.sample_count && report.samples[s].epoch == epoch; s++) {
+                        const PartitionSample *sample = &report.samples[s];
+                        allocated += sample->allocation;
+                        CHECK(sample->suspended ? sample->accesses == 0
+                                                : sample->allocation >= 1 && sample->resident <= sample->allocation,
+                              "%s, epoch %lld, pid %d: %d frames, %d resident", name, epoch, sample->pid,
+                              sample->allocation, sample->resident);
+                    }
+                    CHECK(allocated <= frame_counts[f], "%s on %d frames, load control %d, epoch %lld: %d handed out",
+                          name, frame_counts[f], load_control, epoch, allocated);
+                }
+                partition_report_free(&report);
+            }
+        }
+    }
+}
+
+// Runs algorithm with run_frames until stop_after, checkpoints it, and
+// finishes it in a fresh simulator created with resume_frames
+static int resumed_run(const char *algorithm, int run_frames, int resume_frames, long long stop_after, Counts *out) {
+    Simulator *sim = new_simulator(algorithm, run_frames);
+    FILE *checkpoint = tmpfile();
+    if (!sim || !checkpoint) {
+        simulator_destroy(sim);
+        if (checkpoint)
+            fclose(checkpoint);
+        return -1;
+    }
+    Generator gen;
+    workload(&gen);
+    simulator_set_progress(sim, stop_at, &stop_after);
+    int status = simulator_run_source(sim, &gen.source) == SIM_CANCELLED ? 0 : -1;
+    if (status == 0)
+        status = simulator_save_checkpoint(sim, checkpoint);
+    simulator_destroy(sim);
+
+    sim = status == 0 ? new_simulator(algorithm, resume_frames) : NULL;
+    rewind(checkpoint);
+    if (!sim || simulator_load_checkpoint(sim, checkpoint) != 0 || sim->memory.frame_count != run_frames)
+        status = -1;
+    workload(&gen);
+    if (status == 0 && simulator_skip_source(sim, &gen.source) != 0)
+        status = -1;
+    if (status == 0)
+        status = simulator_continue_source(sim, &gen.source);
+    if (status == 0)
+        *out = counts_of(sim);
+    simulator_destroy(sim);
+    fclose(checkpoint);
+    return status;
+}
+
+static void test_resume(void) {
+    for (int i = 0; i < policy_count(); i++) {
+        const ReplacementPolicy *policy = policy_at(i);
+        if (policy->needs_future)
+            continue; // Cannot be checkpointed
+        Counts whole = {0}, resumed = {0};
+        CHECK(separate_run(policy->name, TEST_FRAMES, &whole) == 0, "%s", policy->name);
+        CHECK(resumed_run(policy->name, TEST_FRAMES, TEST_FRAMES, TEST_ACCESSES / 3, &resumed) == 0, "%s resumed",
+              policy->name);
+        CHECK(counts_equal(&whole, &resumed), "%s: %lld faults whole, %lld resumed", policy->name, whole.faults,
+              resumed.faults);
+        // The checkpoint's frame count wins over the one the simulator was created with
+        CHECK(resumed_run(policy->name, TEST_FRAMES, TEST_FRAMES / 2 + 1, TEST_ACCESSES / 2, &resumed) == 0,
+              "%s resumed with other frames", policy->name);
+        CHECK(counts_equal(&whole, &resumed), "%s: %lld faults whole, %lld resumed with other frames", policy->name,
+              whole.faults, resumed.faults);
+    }
+}
+
+// Whether two files hold the same bytes
+static int files_equal(FILE *a, FILE *b) {
+    rewind(a);
+    rewind(b);
+    int ca, cb;
+    do {
+        ca = fgetc(a);
+        cb = fgetc(b);
+    } while (ca == cb && ca != EOF);
+    return ca == cb;
+}
+
+// The buckets add up to the run's counters, with prefetches apart from
+// faults, and a saved timeline loads back the same
+static void test_timeline(const PageReference *refs) {
+    Simulator *sim = new_simulator("lru", TEST_FRAMES);
+    CHECK(sim && simulator_set_timeline(sim, 1, TIMELINE_DEFAULT_RATE_WINDOW) == 0 &&
+              simulator_set_prefetcher(sim, "readahead", 0) == 0,
+          "setup");
+    if (!sim)
+        return;
+    CHECK(simulator_run_references(sim, refs, TEST_ACCESSES) == 0, "run");
+    const Timeline *tl = &sim->timeline;
+    long long accesses = 0, faults = 0, prefetches = 0;
+    for (int i = 0; i <= tl->levels[0].count; i++) {
+        const TimelineBucket *b = i < tl->levels[0].count ? &tl->levels[0].buckets[i] : &tl->open;
+        accesses += b->accesses;
+        faults += b->faults;
+        prefetches += b->prefetches;
+    }
+    CHECK(accesses == TEST_ACCESSES && faults == sim->faults, "%lld accesses, %lld faults", accesses, faults);
+    CHECK(prefetches == sim->prefetch.issued && prefetches > 0, "%lld prefetches, %lld issued", prefetches,
+          sim->prefetch.issued);
+
+    Timeline loaded = {0};
+    FILE *saved = tmpfile(), *before = tmpfile(), *after = tmpfile();
+    CHECK(saved && before && after && timeline_save(tl, saved) == 0, "timeline_save");
+    if (saved && before && after) {
+        rewind(saved);
+        CHECK(timeline_load(&loaded, saved) == 0, "timeline_load");
+        CHECK(timeline_write_csv(tl, before) == 0 && timeline_write_csv(&loaded, after) == 0, "CSV");
+        CHECK(files_equal(before, after), "the loaded timeline differs");
+    }
+    timeline_free(&loaded);
+    if (saved)
+        fclose(saved);
+    if (before)
+        fclose(before);
+    if (after)
+        fclose(after);
+    simulator_destroy(sim);
+}
+
+int main(void) {
+    PageReference *refs = workload_references();
+    if (!refs) {
+        fprintf(stderr, "vmsim-tests: out of memory\n");
+        return 1;
+    }
+    test_optimal(refs);
+    test_pagemap();
+    test_frame_table();
+    test_key_range();
+    test_mrc(refs);
+    test_sweep(refs);
+    test_generator(refs);
+    test_bintrace(refs);
+    test_probe();
+    test_stats_export(refs);
+    test_shards(refs);
+    test_pipeline();
+    test_compare(refs);
+    test_swap();
+    test_prefetch(refs);
+    test_policy_state(refs);
+    test_mmu(refs);
+    test_partition(refs);
+    test_resume();
+    test_timeline(refs);
+    free(refs);
+    if (failures) {
+        fprintf(stderr, "vmsim-tests: %d checks failed\n", failures);
+        return 1;
+    }
+    printf("vmsim-tests: all checks passed\n");
+    return 0;
+}
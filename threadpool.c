@@ -0,0 +1,235 @@
+#include "threadpool.h"
+#include <pthread.h>
+#include <stdlib.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+typedef struct {
+    PoolTaskFn fn;
+    void *arg;
+} PoolTask;
+
+// Ring of tasks: the owner pushes and pops at the tail, thieves take the head
+typedef struct {
+    pthread_mutex_t lock;
+    PoolTask *tasks;
+    int head;
+    int count;
+    int capacity;
+} PoolDeque;
+
+typedef struct {
+    ThreadPool *pool;
+    int index;
+    pthread_t thread;
+} PoolWorker;
+
+struct ThreadPool {
+    PoolWorker *workers;
+    PoolDeque *deques;
+    int thread_count;
+    int started;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;  // queued went above zero, or shutdown
+    pthread_cond_t all_done;    // pending dropped to zero
+    long queued;                // Tasks sitting in some deque
+    long pending;               // Tasks submitted and not yet finished
+    int shutdown;
+    unsigned next_deque;        // Round-robin target for outside submissions
+};
+
+// Worker running on this thread, so nested submissions stay local
+static _Thread_local PoolWorker *current_worker;
+
+int threadpool_cpu_count(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#endif
+}
+
+static int deque_push(PoolDeque *dq, PoolTask task) {
+    pthread_mutex_lock(&dq->lock);
+    if (dq->count == dq->capacity) {
+        int capacity = dq->capacity > 0 ? dq->capacity * 2 : 64;
+        PoolTask *tasks = malloc((size_t)capacity * sizeof(PoolTask));
+        if (!tasks) {
+            pthread_mutex_unlock(&dq->lock);
+            return -1;
+        }
+        for (int i = 0; i < dq->count; i++)
+            tasks[i] = dq->tasks[(dq->head + i) % dq->capacity];
+        free(dq->tasks);
+        dq->tasks = tasks;
+        dq->head = 0;
+        dq->capacity = capacity;
+    }
+    dq->tasks[(dq->head + dq->count++) % dq->capacity] = task;
+    pthread_mutex_unlock(&dq->lock);
+    return 0;
+}
+
+// Takes the newest task (owner) or the oldest one (thief); 0 if empty
+static int deque_take(PoolDeque *dq, int steal, PoolTask *out) {
+    pthread_mutex_lock(&dq->lock);
+    int found = dq->count > 0;
+    if (found) {
+        if (steal) {
+            *out = dq->tasks[dq->head];
+            dq->head = (dq->head + 1) % dq->capacity;
+        } else {
+            *out = dq->tasks[(dq->head + dq->count - 1) % dq->capacity];
+        }
+        dq->count--;
+    }
+    pthread_mutex_unlock(&dq->lock);
+    return found;
+}
+
+static int find_task(PoolWorker *worker, PoolTask *out) {
+    ThreadPool *pool = worker->pool;
+    if (deque_take(&pool->deques[worker->index], 0, out))
+        return 1;
+    for (int i = 1; i < pool->thread_count; i++) {
+        int victim = (worker->index + i) % pool->thread_count;
+        if (deque_take(&pool->deques[victim], 1, out))
+            return 1;
+    }
+    return 0;
+}
+
+static void *worker_main(void *arg) {
+    PoolWorker *worker = arg;
+    ThreadPool *pool = worker->pool;
+    current_worker = worker;
+    for (;;) {
+        PoolTask task;
+        if (find_task(worker, &task)) {
+            pthread_mutex_lock(&pool->lock);
+            pool->queued--;
+            pthread_mutex_unlock(&pool->lock);
+
+            task.fn(task.arg);
+
+            pthread_mutex_lock(&pool->lock);
+            if (--pool->pending == 0)
+                pthread_cond_broadcast(&pool->all_done);
+            pthread_mutex_unlock(&pool->lock);
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        while (pool->queued <= 0 && !pool->shutdown)
+            pthread_cond_wait(&pool->work_ready, &pool->lock);
+        int stop = pool->shutdown && pool->queued <= 0;
+        pthread_mutex_unlock(&pool->lock);
+        if (stop)
+            break;
+    }
+    current_worker = NULL;
+    return NULL;
+}
+
+// Starts `threads` workers; 0 or less means one per online CPU
+ThreadPool *threadpool_create(int threads) {
+    if (threads <= 0)
+        threads = threadpool_cpu_count();
+    ThreadPool *pool = calloc(1, sizeof(ThreadPool));
+    if (!pool)
+        return NULL;
+    pool->workers = calloc((size_t)threads, sizeof(PoolWorker));
+    pool->deques = calloc((size_t)threads, sizeof(PoolDeque));
+    if (!pool->workers || !pool->deques) {
+        free(pool->workers);
+        free(pool->deques);
+        free(pool);
+        return NULL;
+    }
+    pool->thread_count = threads;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_ready, NULL);
+    pthread_cond_init(&pool->all_done, NULL);
+    for (int i = 0; i < threads; i++)
+        pthread_mutex_init(&pool->deques[i].lock, NULL);
+
+    for (int i = 0; i < threads; i++) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].index = i;
+        if (pthread_create(&pool->workers[i].thread, NULL, worker_main, &pool->workers[i]) != 0)
+            break;
+        pool->started++;
+    }
+    if (pool->started < threads) {
+        threadpool_destroy(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+// Finishes queued work, then joins the workers
+void threadpool_destroy(ThreadPool *pool) {
+    if (!pool)
+        return;
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 0; i < pool->started; i++)
+        pthread_join(pool->workers[i].thread, NULL);
+
+    for (int i = 0; i < pool->thread_count; i++) {
+        pthread_mutex_destroy(&pool->deques[i].lock);
+        free(pool->deques[i].tasks);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work_ready);
+    pthread_cond_destroy(&pool->all_done);
+    free(pool->workers);
+    free(pool->deques);
+    free(pool);
+}
+
+int threadpool_thread_count(const ThreadPool *pool) {
+    return pool->thread_count;
+}
+
+// Queues fn(arg); a task may itself submit more work. Returns -1 if the
+// task cannot be queued.
+int threadpool_submit(ThreadPool *pool, PoolTaskFn fn, void *arg) {
+    PoolTask task = {fn, arg};
+    pthread_mutex_lock(&pool->lock);
+    int target = current_worker && current_worker->pool == pool
+                     ? current_worker->index
+                     : (int)(pool->next_deque++ % (unsigned)pool->thread_count);
+    pool->pending++;
+    pthread_mutex_unlock(&pool->lock);
+    if (deque_push(&pool->deques[target], task) != 0) {
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->pending == 0)
+            pthread_cond_broadcast(&pool->all_done);
+        pthread_mutex_unlock(&pool->lock);
+        return -1;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->queued++;
+    pthread_cond_signal(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+    return 0;
+}
+
+// Blocks until every submitted task has finished; not for use inside a task
+void threadpool_wait(ThreadPool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending > 0)
+        pthread_cond_wait(&pool->all_done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
@@ -0,0 +1,18 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+// Work-stealing thread pool: every worker owns a deque, pops its own work
+// LIFO and, when empty, steals FIFO from the other workers. Tasks submitted
+// from outside the pool are dealt round-robin across the deques.
+typedef void (*PoolTaskFn)(void *arg);
+
+typedef struct ThreadPool ThreadPool;
+
+int threadpool_cpu_count(void);
+ThreadPool *threadpool_create(int threads);
+void threadpool_destroy(ThreadPool *pool);
+int threadpool_thread_count(const ThreadPool *pool);
+int threadpool_submit(ThreadPool *pool, PoolTaskFn fn, void *arg);
+void threadpool_wait(ThreadPool *pool);
+
+#endif
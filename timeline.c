@@ -0,0 +1,337 @@
+#include "timeline.h"
+#include <stdlib.h>
+#include <string.h>
+#include "checkpoint.h"
+
+// Turns the timeline on for later runs, or off. Returns -1 and leaves it
+// off if rate_window is not positive or memory runs out.
+int timeline_configure(Timeline *tl, int enabled, int rate_window) {
+    timeline_free(tl);
+    if (!enabled)
+        return 0;
+    if (rate_window <= 0)
+        return -1;
+    for (int k = 0; k < TIMELINE_LEVELS; k++) {
+        size_t buckets = TIMELINE_BUCKETS >> k;
+        tl->levels[k].buckets = malloc(buckets * sizeof(TimelineBucket));
+        tl->levels[k].cells = malloc(buckets * TIMELINE_MAX_ROWS * sizeof(TimelineCell));
+        if (!tl->levels[k].buckets || !tl->levels[k].cells) {
+            timeline_free(tl);
+            return -1;
+        }
+    }
+    tl->open_cells = malloc(TIMELINE_MAX_ROWS * sizeof(TimelineCell));
+    tl->recent = calloc((size_t)rate_window, 1);
+    tl->row_pid = malloc(TIMELINE_MAX_ROWS * sizeof(int));
+    tl->row_used = malloc(TIMELINE_MAX_ROWS * sizeof(unsigned short));
+    if (!tl->open_cells || !tl->recent || !tl->row_pid || !tl->row_used) {
+        timeline_free(tl);
+        return -1;
+    }
+    tl->rate_window = rate_window;
+    tl->enabled = 1;
+    return 0;
+}
+
+void timeline_free(Timeline *tl) {
+    for (int k = 0; k < TIMELINE_LEVELS; k++) {
+        free(tl->levels[k].buckets);
+        free(tl->levels[k].cells);
+    }
+    free(tl->open_cells);
+    free(tl->recent);
+    free(tl->frame_pid);
+    free(tl->row_pid);
+    free(tl->row_used);
+    memset(tl, 0, sizeof(*tl));
+}
+
+static int size_frames(Timeline *tl, int frame_count) {
+    if (frame_count != tl->frame_count) {
+        int *pids = realloc(tl->frame_pid, (size_t)frame_count * sizeof(int));
+        if (!pids)
+            return -1;
+        tl->frame_pid = pids;
+        tl->frame_count = frame_count;
+    }
+    tl->rows = frame_count < TIMELINE_MAX_ROWS ? frame_count : TIMELINE_MAX_ROWS;
+    return 0;
+}
+
+// Starts the next level 0 bucket, every row as the last one left it
+static void open_bucket(Timeline *tl) {
+    tl->open = (TimelineBucket){0, 0, 0, 1.0f, 0.0f};
+    for (int r = 0; r < tl->rows; r++)
+        tl->open_cells[r] = (TimelineCell){0, tl->row_pid[r], tl->row_pid[r], tl->row_used[r]};
+}
+
+// Empties the timeline for a run that is at access start with memory as it
+// is now: empty for a new run, restored for one from a checkpoint
+int timeline_reset(Timeline *tl, const FrameTable *memory, long long start) {
+    if (!tl->enabled)
+        return 0;
+    if (size_frames(tl, memory->frame_count) != 0)
+        return -1;
+    for (int r = 0; r < tl->rows; r++) {
+        tl->row_pid[r] = -1;
+        tl->row_used[r] = 0;
+    }
+    for (int f = 0; f < tl->frame_count; f++) {
+        int pid = memory->frames[f].process_id, row = timeline_row(tl, f);
+        tl->frame_pid[f] = pid;
+        if (pid >= 0) {
+            tl->row_pid[row] = pid;
+            tl->row_used[row]++;
+        }
+    }
+    for (int k = 0; k < TIMELINE_LEVELS; k++)
+        tl->levels[k].count = 0;
+    memset(tl->recent, 0, (size_t)tl->rate_window);
+    tl->recent_pos = tl->recent_faults = 0;
+    tl->start = start;
+    tl->span = 1;
+    tl->time = 0;
+    open_bucket(tl);
+    return 0;
+}
+
+// Frame now holds a page of pid; returns the open cell of its row
+static TimelineCell *occupy(Timeline *tl, int frame, int pid) {
+    int row = timeline_row(tl, frame);
+    if (tl->frame_pid[frame] < 0)
+        tl->row_used[row]++;
+    tl->frame_pid[frame] = pid;
+    tl->row_pid[row] = pid;
+
+    TimelineCell *cell = &tl->open_cells[row];
+    if (cell->min_pid < 0 || pid < cell->min_pid)
+        cell->min_pid = pid;
+    if (pid > cell->max_pid)
+        cell->max_pid = pid;
+    cell->used = tl->row_used[row];
+    return cell;
+}
+
+// A page of pid was loaded into frame on a fault
+void timeline_fault(Timeline *tl, int frame, int pid) {
+    occupy(tl, frame, pid)->faults++;
+}
+
+// A page of pid was prefetched into frame. The row shows its owner and use
+// like a fault's, but it counts in the bucket's prefetches, not its faults.
+void timeline_prefetch(Timeline *tl, int frame, int pid) {
+    occupy(tl, frame, pid);
+    tl->open.prefetches++;
+}
+
+static TimelineBucket merge_buckets(const TimelineBucket *a, const TimelineBucket *b) {
+    return (TimelineBucket){a->accesses + b->accesses, a->faults + b->faults, a->prefetches + b->prefetches,
+                            a->min_rate < b->min_rate ? a->min_rate : b->min_rate,
+                            a->max_rate > b->max_rate ? a->max_rate : b->max_rate};
+}
+
+static TimelineCell merge_cells(const TimelineCell *a, const TimelineCell *b) {
+    TimelineCell c = {a->faults + b->faults, a->min_pid, a->max_pid > b->max_pid ? a->max_pid : b->max_pid, b->used};
+    if (c.min_pid < 0 || (b->min_pid >= 0 && b->min_pid < c.min_pid))
+        c.min_pid = b->min_pid;
+    return c;
+}
+
+static void append(Timeline *tl, int k, const TimelineBucket *bucket, const TimelineCell *cells) {
+    TimelineLevel *level = &tl->levels[k];
+    level->buckets[level->count] = *bucket;
+    memcpy(level->cells + (size_t)level->count * tl->rows, cells, (size_t)tl->rows * sizeof(TimelineCell));
+    level->count++;
+}
+
+// Level k's last two buckets make the next one of level k + 1
+static void fold_up(Timeline *tl, int k) {
+    TimelineLevel *level = &tl->levels[k];
+    TimelineLevel *up = &tl->levels[k + 1];
+    const TimelineBucket *b = &level->buckets[level->count - 2];
+    const TimelineCell *left = level->cells + (size_t)(level->count - 2) * tl->rows;
+    const TimelineCell *right = left + tl->rows;
+    TimelineCell *cells = up->cells + (size_t)up->count * tl->rows;
+    up->buckets[up->count] = merge_buckets(&b[0], &b[1]);
+    for (int r = 0; r < tl->rows; r++)
+        cells[r] = merge_cells(&left[r], &right[r]);
+    up->count++;
+}
+
+static void close_bucket(Timeline *tl) {
+    append(tl, 0, &tl->open, tl->open_cells);
+    for (int k = 0; k + 1 < TIMELINE_LEVELS && tl->levels[k].count % 2 == 0; k++)
+        fold_up(tl, k);
+
+    if (tl->levels[0].count == TIMELINE_BUCKETS) {
+        // Level k + 1 already holds level k at twice the span
+        for (int k = 0; k + 1 < TIMELINE_LEVELS; k++) {
+            TimelineLevel *level = &tl->levels[k], *up = &tl->levels[k + 1];
+            memcpy(level->buckets, up->buckets, (size_t)up->count * sizeof(TimelineBucket));
+            memcpy(level->cells, up->cells, (size_t)up->count * tl->rows * sizeof(TimelineCell));
+            level->count = up->count;
+        }
+        tl->levels[TIMELINE_LEVELS - 1].count = 0;
+        tl->span *= 2;
+    }
+    open_bucket(tl);
+}
+
+// One access, after timeline_fault() if it faulted
+void timeline_access(Timeline *tl, int fault) {
+    tl->recent_faults += fault - tl->recent[tl->recent_pos];
+    tl->recent[tl->recent_pos] = (unsigned char)fault;
+    if (++tl->recent_pos == tl->rate_window)
+        tl->recent_pos = 0;
+    tl->time++;
+    float rate = (float)tl->recent_faults / (float)(tl->time < tl->rate_window ? tl->time : tl->rate_window);
+
+    TimelineBucket *open = &tl->open;
+    open->accesses++;
+    open->faults += fault;
+    if (rate < open->min_rate)
+        open->min_rate = rate;
+    if (rate > open->max_rate)
+        open->max_rate = rate;
+    if (open->accesses == tl->span)
+        close_bucket(tl);
+}
+
+// Copies src into dst, which is zeroed or an earlier copy, for reading
+// while src goes on filling; -1 if memory runs out
+int timeline_copy(Timeline *dst, const Timeline *src) {
+    if (!src->enabled) {
+        timeline_free(dst);
+        return 0;
+    }
+    if ((!dst->enabled || dst->rate_window != src->rate_window) &&
+        timeline_configure(dst, 1, src->rate_window) != 0)
+        return -1;
+    if (size_frames(dst, src->frame_count) != 0)
+        return -1;
+    for (int k = 0; k < TIMELINE_LEVELS; k++) {
+        const TimelineLevel *from = &src->levels[k];
+        TimelineLevel *to = &dst->levels[k];
+        memcpy(to->buckets, from->buckets, (size_t)from->count * sizeof(TimelineBucket));
+        memcpy(to->cells, from->cells, (size_t)from->count * src->rows * sizeof(TimelineCell));
+        to->count = from->count;
+    }
+    dst->open = src->open;
+    memcpy(dst->open_cells, src->open_cells, (size_t)src->rows * sizeof(TimelineCell));
+    memcpy(dst->recent, src->recent, (size_t)src->rate_window);
+    memcpy(dst->frame_pid, src->frame_pid, (size_t)src->frame_count * sizeof(int));
+    memcpy(dst->row_pid, src->row_pid, (size_t)src->rows * sizeof(int));
+    memcpy(dst->row_used, src->row_used, (size_t)src->rows * sizeof(unsigned short));
+    dst->recent_pos = src->recent_pos;
+    dst->recent_faults = src->recent_faults;
+    dst->start = src->start;
+    dst->span = src->span;
+    dst->time = src->time;
+    return 0;
+}
+
+// Writes everything timeline_load() needs to go on from here, in the
+// checkpoint byte order and word sizes; -1 on a write error
+int timeline_save(const Timeline *tl, FILE *out) {
+    if (checkpoint_write(out, &tl->enabled, sizeof(int)) != 0)
+        return -1;
+    if (!tl->enabled)
+        return 0;
+    size_t rows = (size_t)tl->rows;
+    if (checkpoint_write(out, &tl->rate_window, sizeof(int)) != 0 ||
+        checkpoint_write(out, &tl->frame_count, sizeof(int)) != 0 ||
+        checkpoint_write(out, &tl->start, sizeof(long long)) != 0 ||
+        checkpoint_write(out, &tl->span, sizeof(long long)) != 0 ||
+        checkpoint_write(out, &tl->time, sizeof(long long)) != 0)
+        return -1;
+    for (int k = 0; k < TIMELINE_LEVELS; k++) {
+        const TimelineLevel *level = &tl->levels[k];
+        if (checkpoint_write(out, &level->count, sizeof(int)) != 0 ||
+            checkpoint_write(out, level->buckets, (size_t)level->count * sizeof(TimelineBucket)) != 0 ||
+            checkpoint_write(out, level->cells, (size_t)level->count * rows * sizeof(TimelineCell)) != 0)
+            return -1;
+    }
+    if (checkpoint_write(out, &tl->open, sizeof(TimelineBucket)) != 0 ||
+        checkpoint_write(out, tl->open_cells, rows * sizeof(TimelineCell)) != 0 ||
+        checkpoint_write(out, tl->recent, (size_t)tl->rate_window) != 0 ||
+        checkpoint_write(out, &tl->recent_pos, sizeof(int)) != 0 ||
+        checkpoint_write(out, &tl->recent_faults, sizeof(int)) != 0 ||
+        checkpoint_write(out, tl->frame_pid, (size_t)tl->frame_count * sizeof(int)) != 0 ||
+        checkpoint_write(out, tl->row_pid, rows * sizeof(int)) != 0 ||
+        checkpoint_write(out, tl->row_used, rows * sizeof(unsigned short)) != 0)
+        return -1;
+    return 0;
+}
+
+// Reads what timeline_save() wrote into tl, which is zeroed or configured,
+// turning it on or off to match. Returns -1 on a short read, a timeline
+// that does not hang together or if memory runs out, with tl off.
+int timeline_load(Timeline *tl, FILE *in) {
+    int enabled, rate_window, frame_count;
+    if (checkpoint_read(in, &enabled, sizeof(int)) != 0)
+        goto fail;
+    if (!enabled) {
+        timeline_free(tl);
+        return 0;
+    }
+    if (checkpoint_read(in, &rate_window, sizeof(int)) != 0 || checkpoint_read(in, &frame_count, sizeof(int)) != 0 ||
+        rate_window <= 0 || frame_count <= 0)
+        goto fail;
+    if ((!tl->enabled || tl->rate_window != rate_window) && timeline_configure(tl, 1, rate_window) != 0)
+        goto fail;
+    if (size_frames(tl, frame_count) != 0)
+        goto fail;
+    size_t rows = (size_t)tl->rows;
+    if (checkpoint_read(in, &tl->start, sizeof(long long)) != 0 ||
+        checkpoint_read(in, &tl->span, sizeof(long long)) != 0 ||
+        checkpoint_read(in, &tl->time, sizeof(long long)) != 0 || tl->span <= 0)
+        goto fail;
+    for (int k = 0; k < TIMELINE_LEVELS; k++) {
+        TimelineLevel *level = &tl->levels[k];
+        if (checkpoint_read(in, &level->count, sizeof(int)) != 0 || level->count < 0 ||
+            level->count > TIMELINE_BUCKETS >> k ||
+            checkpoint_read(in, level->buckets, (size_t)level->count * sizeof(TimelineBucket)) != 0 ||
+            checkpoint_read(in, level->cells, (size_t)level->count * rows * sizeof(TimelineCell)) != 0)
+            goto fail;
+    }
+    if (checkpoint_read(in, &tl->open, sizeof(TimelineBucket)) != 0 ||
+        checkpoint_read(in, tl->open_cells, rows * sizeof(TimelineCell)) != 0 ||
+        checkpoint_read(in, tl->recent, (size_t)rate_window) != 0 ||
+        checkpoint_read(in, &tl->recent_pos, sizeof(int)) != 0 ||
+        checkpoint_read(in, &tl->recent_faults, sizeof(int)) != 0 ||
+        checkpoint_read(in, tl->frame_pid, (size_t)frame_count * sizeof(int)) != 0 ||
+        checkpoint_read(in, tl->row_pid, rows * sizeof(int)) != 0 ||
+        checkpoint_read(in, tl->row_used, rows * sizeof(unsigned short)) != 0 || tl->recent_pos < 0 ||
+        tl->recent_pos >= rate_window || tl->open.accesses >= tl->span)
+        goto fail;
+    return 0;
+fail:
+    timeline_free(tl);
+    return -1;
+}
+
+// The finest level that shows `accesses` of the run in at most `columns`
+// buckets, so that drawing costs about one bucket per column
+int timeline_pick_level(const Timeline *tl, long long accesses, int columns) {
+    int k = 0;
+    if (columns < 1)
+        columns = 1;
+    while (k + 1 < TIMELINE_LEVELS && (tl->span << k) * columns < accesses)
+        k++;
+    return k;
+}
+
+// One row per level 0 bucket, the one still filling last:
+// start,accesses,faults,fault_rate,min_rate,max_rate,prefetches
+int timeline_write_csv(const Timeline *tl, FILE *out) {
+    const TimelineLevel *level = &tl->levels[0];
+    fprintf(out, "start,accesses,faults,fault_rate,min_rate,max_rate,prefetches\n");
+    for (int i = 0; i <= level->count; i++) {
+        const TimelineBucket *b = i < level->count ? &level->buckets[i] : &tl->open;
+        if (b->accesses == 0)
+            continue;
+        fprintf(out, "%lld,%lld,%lld,%.6f,%.6f,%.6f,%lld\n", tl->start + i * tl->span, b->accesses, b->faults,
+                (double)b->faults / (double)b->accesses, b->min_rate, b->max_rate, b->prefetches);
+    }
+    return ferror(out) ? -1 : 0;
+}
@@ -0,0 +1,88 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <stdio.h>
+#include "frame_table.h"
+
+// A summary of a run over time, kept at several resolutions so a view of
+// any stretch of it can be drawn from about as many buckets as it has
+// pixels. Level 0 holds up to TIMELINE_BUCKETS buckets of `span` accesses;
+// each level above pairs up the buckets of the one below. When level 0
+// fills, every level moves down one and span doubles, so memory stays
+// fixed however long the run is and the finest detail coarsens with it.
+//
+// Each bucket has the accesses, faults and prefetched page-ins in it and
+// the range of the rolling fault rate, the share of faults over the last `rate_window`
+// accesses. Each also has one cell per row of frames; frames are grouped
+// into at most TIMELINE_MAX_ROWS rows.
+
+#define TIMELINE_BUCKETS 2048 // Level 0; a power of two
+#define TIMELINE_LEVELS 12    // Down to 1 bucket
+#define TIMELINE_MAX_ROWS 128
+#define TIMELINE_DEFAULT_RATE_WINDOW 1000
+
+typedef struct {
+    long long accesses;
+    long long faults;
+    long long prefetches; // Pages loaded ahead of a fault, not counted in faults
+    float min_rate; // Rolling fault rate over the bucket
+    float max_rate;
+} TimelineBucket;
+
+// Demand page-ins into a row's frames, and the processes whose pages it held:
+// the owner of its last page-in before the bucket and of every one in it.
+// min_pid is -1 while none of the row's frames has been used.
+typedef struct {
+    unsigned int faults;
+    int min_pid;
+    int max_pid;
+    unsigned short used; // Frames of the row in use at the end of the bucket
+} TimelineCell;
+
+typedef struct {
+    TimelineBucket *buckets;
+    TimelineCell *cells; // rows per bucket, bucket after bucket
+    int count;
+} TimelineLevel;
+
+typedef struct {
+    int enabled;
+    int rate_window;
+    int frame_count;
+    int rows;
+    long long start; // Access the run was at when the timeline started
+    long long span;  // Accesses per level 0 bucket
+    long long time;  // Accesses recorded
+    TimelineLevel levels[TIMELINE_LEVELS];
+
+    // The level 0 bucket being filled
+    TimelineBucket open;
+    TimelineCell *open_cells;
+
+    unsigned char *recent; // Fault or not, for the last rate_window accesses
+    int recent_pos;
+    int recent_faults;
+
+    int *frame_pid; // Owner of each frame's page, -1 if free
+    int *row_pid;   // Owner of each row's last page-in
+    unsigned short *row_used;
+} Timeline;
+
+int timeline_configure(Timeline *tl, int enabled, int rate_window);
+void timeline_free(Timeline *tl);
+int timeline_reset(Timeline *tl, const FrameTable *memory, long long start);
+void timeline_fault(Timeline *tl, int frame, int pid);
+void timeline_prefetch(Timeline *tl, int frame, int pid);
+void timeline_access(Timeline *tl, int fault);
+int timeline_copy(Timeline *dst, const Timeline *src);
+int timeline_save(const Timeline *tl, FILE *out);
+int timeline_load(Timeline *tl, FILE *in);
+int timeline_pick_level(const Timeline *tl, long long accesses, int columns);
+int timeline_write_csv(const Timeline *tl, FILE *out);
+
+// Row of frame f
+static inline int timeline_row(const Timeline *tl, int frame) {
+    return (int)((long long)frame * tl->rows / tl->frame_count);
+}
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+double timing_wall_seconds(void);
+double timing_cpu_seconds(void);
+long timing_peak_rss_kb(void);
+
+#endif
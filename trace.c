@@ -0,0 +1,250 @@
+#include "trace.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define TRACE_MAX_PIDS 65536 // Dense pids must fit the 16 bits page_key() and SimEvent keep
+
+int mapped_file_open(MappedFile *mf, const char *path) {
+    memset(mf, 0, sizeof(*mf));
+#ifdef _WIN32
+    mf->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                           FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (mf->file == INVALID_HANDLE_VALUE)
+        return -1;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(mf->file, &size)) {
+        CloseHandle(mf->file);
+        return -1;
+    }
+    mf->size = (size_t)size.QuadPart;
+    if (mf->size == 0)
+        return 0;
+    mf->mapping = CreateFileMappingA(mf->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mf->mapping)
+        mf->data = MapViewOfFile(mf->mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!mf->data) {
+        if (mf->mapping)
+            CloseHandle(mf->mapping);
+        CloseHandle(mf->file);
+        return -1;
+    }
+#else
+    mf->fd = open(path, O_RDONLY);
+    if (mf->fd < 0)
+        return -1;
+    struct stat st;
+    if (fstat(mf->fd, &st) != 0) {
+        close(mf->fd);
+        mf->fd = -1;
+        return -1;
+    }
+    mf->size = (size_t)st.st_size;
+    if (mf->size == 0)
+        return 0;
+    void *data = mmap(NULL, mf->size, PROT_READ, MAP_PRIVATE, mf->fd, 0);
+    if (data == MAP_FAILED) {
+        close(mf->fd);
+        mf->fd = -1;
+        return -1;
+    }
+    madvise(data, mf->size, MADV_SEQUENTIAL);
+    mf->data = data;
+#endif
+    return 0;
+}
+
+void mapped_file_close(MappedFile *mf) {
+#ifdef _WIN32
+    if (mf->data)
+        UnmapViewOfFile(mf->data);
+    if (mf->mapping)
+        CloseHandle(mf->mapping);
+    if (mf->file && mf->file != INVALID_HANDLE_VALUE)
+        CloseHandle(mf->file);
+#else
+    if (mf->data)
+        munmap((void *)mf->data, mf->size);
+    if (mf->fd >= 0)
+        close(mf->fd);
+#endif
+    memset(mf, 0, sizeof(*mf));
+#ifndef _WIN32
+    mf->fd = -1;
+#endif
+}
+
+// Lets the OS drop already-consumed pages so resident memory stays bounded
+// while streaming files larger than RAM; offset must be page aligned
+void mapped_file_release(MappedFile *mf, size_t offset, size_t length) {
+#ifdef _WIN32
+    (void)mf;
+    (void)offset;
+    (void)length;
+#else
+    if (mf->data && length > 0)
+        madvise((void *)(mf->data + offset), length, MADV_DONTNEED);
+#endif
+}
+
+static size_t source_read(RefSource *src, PageReference *out, size_t max) {
+    return trace_reader_read((TraceReader *)src, out, max);
+}
+
+int trace_reader_open(TraceReader *tr, const char *path, TraceFormat format, int page_size) {
+    memset(tr, 0, sizeof(*tr));
+    if (mapped_file_open(&tr->file, path) != 0)
+        return -1;
+    if (pagemap_init(&tr->pids, 64) != 0) {
+        mapped_file_close(&tr->file);
+        return -1;
+    }
+    tr->source.read = source_read;
+    tr->format = format;
+    tr->page_size = page_size > 0 ? page_size : 4096;
+    tr->page_shift = -1;
+    if ((tr->page_size & (tr->page_size - 1)) == 0) {
+        tr->page_shift = 0;
+        while ((1LL << tr->page_shift) < tr->page_size)
+            tr->page_shift++;
+    }
+    return 0;
+}
+
+void trace_reader_close(TraceReader *tr) {
+    mapped_file_close(&tr->file);
+    pagemap_free(&tr->pids);
+}
+
+static const char *skip_blanks(const char *p, const char *end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+        p++;
+    return p;
+}
+
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+// Parses an unsigned number in place; returns NULL if there are no digits
+static const char *parse_number(const char *p, const char *end, int hex, unsigned long long *out) {
+    unsigned long long value = 0;
+    const char *start = p;
+    if (hex) {
+        int d;
+        while (p < end && (d = hex_digit(*p)) >= 0) {
+            value = (value << 4) | (unsigned long long)d;
+            p++;
+        }
+    } else {
+        while (p < end && *p >= '0' && *p <= '9') {
+            value = value * 10 + (unsigned long long)(*p - '0');
+            p++;
+        }
+    }
+    *out = value;
+    return p > start ? p : NULL;
+}
+
+// Address with an optional 0x prefix selecting hex
+static const char *parse_address(const char *p, const char *end, unsigned long long *addr) {
+    if (end - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+        return parse_number(p + 2, end, 1, addr);
+    return parse_number(p, end, 0, addr);
+}
+
+static int is_lackey_line(const char *p, const char *end) {
+    return end - p >= 2 && (p[0] == 'I' || p[0] == 'L' || p[0] == 'S' || p[0] == 'M') &&
+           (p[1] == ' ' || p[1] == '\t');
+}
+
+// Maps a raw pid to its dense id, assigning the next one on first sight
+static int dense_pid(TraceReader *tr, unsigned long long raw) {
+    int *known = pagemap_lookup(&tr->pids, raw);
+    if (known)
+        return *known;
+    if (tr->pid_count >= TRACE_MAX_PIDS || pagemap_put(&tr->pids, raw, tr->pid_count) != 0)
+        return -1;
+    return tr->pid_count++;
+}
+
+// Parses one line; returns 1 and fills ref if it describes an access
+static int parse_line(TraceReader *tr, const char *p, const char *end, PageReference *ref) {
+    unsigned long long raw_pid = 0, addr;
+    int write;
+    p = skip_blanks(p, end);
+    if (p == end || *p == '#' || *p == '=')
+        return 0;
+
+    int lackey = tr->format == TRACE_FORMAT_LACKEY ||
+                 (tr->format == TRACE_FORMAT_AUTO && is_lackey_line(p, end));
+    if (lackey) {
+        if (!is_lackey_line(p, end))
+            return 0;
+        write = p[0] == 'S' || p[0] == 'M';
+        p = skip_blanks(p + 1, end);
+        if (!parse_number(p, end, 1, &addr))
+            return 0;
+    } else {
+        p = parse_number(p, end, 0, &raw_pid);
+        if (!p)
+            return 0;
+        p = skip_blanks(p, end);
+        p = parse_address(p, end, &addr);
+        if (!p)
+            return 0;
+        p = skip_blanks(p, end);
+        write = p < end && (*p == 'W' || *p == 'w');
+    }
+
+    unsigned long long page = tr->page_shift >= 0 ? addr >> tr->page_shift : addr / (unsigned long long)tr->page_size;
+    if (page >= (unsigned long long)PAGE_NUMBER_LIMIT)
+        return 0; // Its key would alias another page's
+    int pid = dense_pid(tr, raw_pid);
+    if (pid < 0)
+        return 0;
+    ref->pid = pid;
+    ref->write = (unsigned char)write;
+    ref->page_num = (long long)page;
+    return 1;
+}
+
+// Fills out with up to max references parsed from where the last call
+// stopped; returns 0 at end of file
+size_t trace_reader_read(TraceReader *tr, PageReference *out, size_t max) {
+    const char *data = tr->file.data;
+    size_t size = tr->file.size;
+    size_t produced = 0;
+
+    while (produced < max && tr->cursor < size) {
+        const char *line = data + tr->cursor;
+        const char *newline = memchr(line, '\n', size - tr->cursor);
+        const char *end = newline ? newline : data + size;
+        tr->cursor = (size_t)(end - data) + (newline ? 1 : 0);
+        tr->lines++;
+
+        if (parse_line(tr, line, end, &out[produced]))
+            produced++;
+        else
+            tr->skipped++;
+    }
+
+    if (tr->cursor - tr->released >= TRACE_RELEASE_BYTES) {
+        size_t length = (tr->cursor - tr->released) / TRACE_RELEASE_BYTES * TRACE_RELEASE_BYTES;
+        mapped_file_release(&tr->file, tr->released, length);
+        tr->released += length;
+    }
+    return produced;
+}
@@ -0,0 +1,57 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stddef.h>
+#include "pagemap.h"
+#include "simulator.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// Read-only memory mapping of a whole file
+typedef struct {
+    const char *data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#else
+    int fd;
+#endif
+} MappedFile;
+
+int mapped_file_open(MappedFile *mf, const char *path);
+void mapped_file_close(MappedFile *mf);
+void mapped_file_release(MappedFile *mf, size_t offset, size_t length);
+
+typedef enum {
+    TRACE_FORMAT_AUTO,   // Decide per line
+    TRACE_FORMAT_TEXT,   // "pid addr [R|W]"; addr is hex with 0x, decimal otherwise
+    TRACE_FORMAT_LACKEY  // Valgrind lackey: "I  addr,size", " L addr,size", " S ...", " M ..."
+} TraceFormat;
+
+#define TRACE_RELEASE_BYTES (64u << 20) // Consumed input is dropped from memory in steps this large
+
+// Streams an address trace straight out of a memory-mapped file. Addresses
+// become pages with a shift when page_size is a power of two, and raw pids
+// are renumbered densely from 0 in order of first appearance.
+typedef struct {
+    RefSource source; // Must stay first: simulator_run_source() takes &source
+    MappedFile file;
+    size_t cursor;
+    size_t released;
+    TraceFormat format;
+    int page_shift;   // -1 when page_size is not a power of two
+    long long page_size;
+    PageMap pids;
+    int pid_count;
+    long long lines;
+    long long skipped; // Blank, comment or malformed lines
+} TraceReader;
+
+int trace_reader_open(TraceReader *tr, const char *path, TraceFormat format, int page_size);
+void trace_reader_close(TraceReader *tr);
+size_t trace_reader_read(TraceReader *tr, PageReference *out, size_t max);
+
+#endif
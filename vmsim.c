@@ -0,0 +1,829 @@
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bintrace.h"
+#include "checkpoint.h"
+#include "compare.h"
+#include "generator.h"
+#include "mrc.h"
+#include "partition.h"
+#include "pipeline.h"
+#include "shards.h"
+#include "simulator.h"
+#include "sweep.h"
+#include "trace.h"
+
+// Headless driver: same engine as the GUI, output on stdout
+
+#define VMSIM_MAX_COMPARE 32 // Policies in one --compare run
+#define VMSIM_MAX_SWEEP 64   // Frame counts or page sizes in one --sweep
+
+static void usage(FILE *out) {
+    fprintf(out,
+            "Usage: vmsim [options]\n"
+            "  --algo NAME         Replacement policy (default lru)\n"
+            "  --list-algos        Print the available policies\n"
+            "  --compare LIST      Run the comma-separated policies, or all, in one pass and\n"
+            "                      print them side by side\n"
+            "  --frames N          Physical frames (default %d)\n"
+            "  --page-size BYTES   Page size (default 4096)\n"
+            "  --trace FILE        Address trace, text or binary (see vmsim-convert); without\n"
+            "                      it the synthetic workload runs\n"
+            "  --trace-format F    auto, text or lackey (default auto; binary is detected)\n"
+            "  --process KB        Add a process of KB kilobytes to the synthetic workload\n"
+            "  --workload PATTERN  Generate references lazily instead: sequential, stride,\n"
+            "                      uniform, zipf, hot-cold or phased over each --process\n"
+            "  --accesses N        Length of a --workload run (default 1000000)\n"
+            "  --seed N            Seed of a --workload run (default 1)\n"
+            "  --quantum N         References per process turn in a --workload run (default 100)\n"
+            "  --zipf-s X          Zipf exponent (default 1.0)\n"
+            "  --prefetch NAME     Prefetch into memory alongside demand faults: readahead,\n"
+            "                      stride or markov; not with policies that need the future\n"
+            "  --prefetch-degree N Largest readahead window, pages ahead for stride, or\n"
+            "                      successors remembered for markov (default 32, 4, 2)\n"
+            "  --write-ratio X     Share of --workload references that are stores (default 0)\n"
+            "  --verbosity LEVEL   none, summary, faults or full (default summary)\n"
+            "  --mrc N             Print the LRU/Optimal miss-ratio curve for 1..N frames as CSV\n"
+            "  --shards-rate R     Estimate from a hashed sample of R of the pages: the fault\n"
+            "                      rate of a run with frames scaled by R, or with --mrc the\n"
+            "                      LRU curve, each with a 95%% error bound\n"
+            "  --shards-size N     Like --shards-rate for --mrc, but sample at most N pages\n"
+            "  --pipeline          Decode, simulate and print on separate threads (with\n"
+            "                      --trace or --workload)\n"
+            "  --pipeline-slots N  Batches in flight between two stages (default %d)\n"
+            "  --backpressure B    block, or drop events the printer cannot keep up with\n"
+            "                      (default block)\n"
+            "  --swap              Price faults and write-backs with a swap device model and\n"
+            "                      report modeled time and stall time; --compare then ranks\n"
+            "                      by modeled time. Any option below implies it\n"
+            "  --swap-read-us N    Device read latency in microseconds (default %g)\n"
+            "  --swap-write-us N   Device write latency in microseconds (default %g)\n"
+            "  --swap-bandwidth N  Transfer rate in MB/s, 0 for unlimited (default %g)\n"
+            "  --swap-queue N      Requests the device works on at once (default %d)\n"
+            "  --writeback MODE    sync writes a dirty page only when it is evicted; async\n"
+            "                      also lets nru and wsclock clean pages ahead of eviction\n"
+            "                      (default sync)\n"
+            "  --tlb               Translate every access through a TLB and a radix page\n"
+            "                      table and report hits, misses and walk references. Any\n"
+            "                      option below implies it\n"
+            "  --tlb-entries N     TLB entries (default %d)\n"
+            "  --tlb-ways N        TLB associativity (default %d)\n"
+            "  --page-levels N     Page table levels, 2 to 4 (default %d)\n"
+            "  --walk-caches N     Entries in each upper level's walk cache, 0 for none\n"
+            "                      (default %d)\n"
+            "  --walk-ns X         Cost of one page-table reference (default %g)\n"
+            "  --huge-pages [P=]S  Map process P, or every process, with 4k, 2m or 1g pages\n"
+            "  --partition A       Give every process frames of its own and replace locally;\n"
+            "                      A sizes them: fixed shares, ws (working set) or pff\n"
+            "                      (page-fault frequency). Prints a table per process\n"
+            "  --partition-epoch N References between two allocations (default %d)\n"
+            "  --ws-window N       Working-set window in a process's own references\n"
+            "                      (default %d)\n"
+            "  --pff-low X         Fault rate below which pff shrinks a process (default %g)\n"
+            "  --pff-high X        Fault rate above which pff grows a process (default %g)\n"
+            "  --load-control      Suspend processes while their demand exceeds memory\n"
+            "                      rather than squeeze everyone\n"
+            "  --partition-csv F   Write each process's fault rate and resident set per\n"
+            "                      epoch to F\n"
+            "  --sweep LIST        Run --algo, or every --compare policy, at each of the\n"
+            "                      comma-separated frame counts in parallel and print CSV;\n"
+            "                      needs a text --trace\n"
+            "  --sweep-page-sizes LIST\n"
+            "                      Page sizes for --sweep (default --page-size)\n"
+            "  --threads N         Partitions or sweep runs simulated at once (default one\n"
+            "                      per CPU)\n"
+            "  --timeline FILE     Write the fault rate over time as CSV, one row per bucket of\n"
+            "                      a summary that keeps at most 2048 buckets however long the run\n"
+            "  --checkpoint FILE   Save the run to FILE when it ends, or when Ctrl-C stops it\n"
+            "                      (with --trace or --workload)\n"
+            "  --resume FILE       Go on from a checkpoint over the same --trace or\n"
+            "                      --workload, or a longer one that starts the same way\n"
+            "  --cache DIR         Keep finished runs in DIR and answer a repeated run, same\n"
+            "                      trace and format or workload, policy, frames, page size and\n"
+            "                      stats window, from there\n"
+            "  --stats FILE        Write run statistics to FILE: CSV if it ends in .csv, else JSON\n"
+            "  --stats-window N    Accesses per fault-rate window in --stats (default %d)\n"
+            "  --perf              Add cycle, instruction and cache-miss counters to --stats\n"
+            "  --help              Show this help\n",
+            FRAME_COUNT, PIPELINE_DEFAULT_SLOTS, SWAP_DEFAULT_READ_US, SWAP_DEFAULT_WRITE_US,
+            SWAP_DEFAULT_BANDWIDTH_MB_S, SWAP_DEFAULT_QUEUE_DEPTH, MMU_DEFAULT_TLB_ENTRIES, MMU_DEFAULT_TLB_WAYS,
+            MMU_DEFAULT_LEVELS, MMU_DEFAULT_PWC_ENTRIES, MMU_DEFAULT_WALK_REF_NS, PARTITION_DEFAULT_EPOCH,
+            PARTITION_DEFAULT_WS_WINDOW, PARTITION_DEFAULT_PFF_LOW, PARTITION_DEFAULT_PFF_HIGH, SIM_STATS_DEFAULT_WINDOW);
+}
+
+static int parse_int(const char *text, int *out) {
+    char *end;
+    long value = strtol(text, &end, 10);
+    if (*text == '\0' || *end != '\0' || value <= 0 || value > 1 << 30)
+        return -1;
+    *out = (int)value;
+    return 0;
+}
+
+static int parse_long(const char *text, long long *out) {
+    char *end;
+    long long value = strtoll(text, &end, 10);
+    if (*text == '\0' || *end != '\0' || value < 0)
+        return -1;
+    *out = value;
+    return 0;
+}
+
+static int parse_verbosity(const char *text, SimVerbosity *out) {
+    static const char *const names[] = {"none", "summary", "faults", "full"};
+    for (int i = 0; i < 4; i++) {
+        if (strcmp(text, names[i]) == 0) {
+            *out = (SimVerbosity)(SIM_VERBOSITY_NONE + i);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// Comma-separated positive numbers
+static int parse_int_list(const char *text, int *out, int max, int *count) {
+    *count = 0;
+    for (;;) {
+        char *end;
+        long value = strtol(text, &end, 10);
+        if (end == text || value <= 0 || value > 1 << 30 || *count == max || (*end != ',' && *end != '\0'))
+            return -1;
+        out[(*count)++] = (int)value;
+        if (*end == '\0')
+            return 0;
+        text = end + 1;
+    }
+}
+
+// Comma-separated registry names, or "all"; names point into text or the registry
+static int parse_algorithms(char *text, const char **names, int max, int *count) {
+    *count = 0;
+    if (strcmp(text, "all") == 0) {
+        for (int i = 0; i < policy_count() && *count < max; i++)
+            names[(*count)++] = policy_at(i)->name;
+        return 0;
+    }
+    for (char *name = strtok(text, ","); name; name = strtok(NULL, ",")) {
+        if (*count == max || !policy_find(name))
+            return -1;
+        names[(*count)++] = name;
+    }
+    return *count > 0 ? 0 : -1;
+}
+
+// SIZE for every process, or PID=SIZE for one
+static int parse_huge_pages(const char *text, MmuConfig *mmu) {
+    MmuPageClass page_class;
+    const char *eq = strchr(text, '=');
+    if (!eq)
+        return mmu_page_class_parse(text, &mmu->default_page);
+    char *end;
+    long pid = strtol(text, &end, 10);
+    if (end != eq || pid < 0 || pid >= MMU_MAX_PIDS || mmu_page_class_parse(eq + 1, &page_class) != 0)
+        return -1;
+    mmu->pid_page[pid] = (unsigned char)(page_class + 1);
+    return 0;
+}
+
+static int parse_trace_format(const char *text, TraceFormat *out) {
+    if (strcmp(text, "auto") == 0)
+        *out = TRACE_FORMAT_AUTO;
+    else if (strcmp(text, "text") == 0)
+        *out = TRACE_FORMAT_TEXT;
+    else if (strcmp(text, "lackey") == 0)
+        *out = TRACE_FORMAT_LACKEY;
+    else
+        return -1;
+    return 0;
+}
+
+typedef struct {
+    LogFormatter formatter;
+    FILE *out;
+} CliLog;
+
+static void print_events(const SimEvent *events, size_t count, void *user_data) {
+    CliLog *log = user_data;
+    char line[LOG_LINE_MAX];
+    for (size_t i = 0; i < count; i++) {
+        size_t len = log_formatter_format(&log->formatter, &events[i], line, sizeof(line));
+        fwrite(line, 1, len, log->out);
+    }
+}
+
+// CSV for a .csv name, JSON otherwise
+static int write_stats(const Simulator *sim, const char *path) {
+    FILE *out = fopen(path, "w");
+    if (!out)
+        return -1;
+    size_t len = strlen(path);
+    int csv = len >= 4 && strcmp(path + len - 4, ".csv") == 0;
+    int status = csv ? simulator_write_stats_csv(sim, out) : simulator_write_stats_json(sim, out);
+    if (fclose(out) != 0)
+        status = -1;
+    return status;
+}
+
+static int write_timeline(const Simulator *sim, const char *path) {
+    FILE *out = fopen(path, "w");
+    if (!out)
+        return -1;
+    int status = timeline_write_csv(&sim->timeline, out);
+    if (fclose(out) != 0)
+        status = -1;
+    return status;
+}
+
+static int write_partition_csv(const PartitionReport *report, const char *path) {
+    FILE *out = fopen(path, "w");
+    if (!out)
+        return -1;
+    int status = partition_write_csv(report, out);
+    if (fclose(out) != 0)
+        status = -1;
+    return status;
+}
+
+static int save_checkpoint(const Simulator *sim, const char *path) {
+    FILE *out = fopen(path, "wb");
+    if (!out)
+        return -1;
+    int status = simulator_save_checkpoint(sim, out);
+    if (fclose(out) != 0)
+        status = -1;
+    return status;
+}
+
+static int load_checkpoint(Simulator *sim, const char *path) {
+    FILE *in = fopen(path, "rb");
+    if (!in)
+        return -1;
+    int status = simulator_load_checkpoint(sim, in);
+    fclose(in);
+    return status;
+}
+
+// Ctrl-C during a --checkpoint run stops it after the current batch
+static volatile sig_atomic_t stop_requested;
+
+static void request_stop(int signal_number) {
+    (void)signal_number;
+    stop_requested = 1;
+}
+
+static int check_stop(long long done, long long total, void *user_data) {
+    (void)done;
+    (void)total;
+    (void)user_data;
+    return stop_requested;
+}
+
+// What a --cache entry is keyed on besides the policy, frames, page size and
+// stats window. A text trace read as another format gives other references.
+static int hash_input(const char *trace_path, TraceFormat trace_format, const GenProcessSpec *specs,
+                      int process_count, long long accesses, long long quantum, long long seed, uint64_t *out) {
+    if (trace_path) {
+        uint64_t hash;
+        int format = (int)trace_format;
+        if (checkpoint_hash_file(trace_path, &hash) != 0)
+            return -1;
+        *out = checkpoint_hash_bytes(hash, &format, sizeof(format));
+        return 0;
+    }
+    uint64_t hash = checkpoint_hash_bytes(CHECKPOINT_HASH_SEED, specs, (size_t)process_count * sizeof(*specs));
+    hash = checkpoint_hash_bytes(hash, &accesses, sizeof(accesses));
+    hash = checkpoint_hash_bytes(hash, &quantum, sizeof(quantum));
+    *out = checkpoint_hash_bytes(hash, &seed, sizeof(seed));
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    const char *algorithm = "lru";
+    const char *trace_path = NULL;
+    TraceFormat trace_format = TRACE_FORMAT_AUTO;
+    int frames = FRAME_COUNT, page_size = 4096, mrc_frames = 0;
+    int process_sizes[MAX_PROCESSES], process_count = 0;
+    int sweep_frames[VMSIM_MAX_SWEEP], sweep_frame_count = 0;
+    int sweep_page_sizes[VMSIM_MAX_SWEEP], sweep_page_size_count = 0;
+    SimVerbosity verbosity = SIM_VERBOSITY_SUMMARY;
+    const char *workload = NULL;
+    GenPattern pattern = GEN_SEQUENTIAL;
+    long long accesses = 1000000, seed = 1, quantum = 100;
+    double zipf_s = 1.0, write_ratio = 0;
+    const char *stats_path = NULL;
+    long long stats_window = SIM_STATS_DEFAULT_WINDOW;
+    int perf = 0;
+    ShardsConfig shards = {SHARDS_FIXED_RATE, 0, 0, 0};
+    int sampling = 0;
+    PipelineConfig pipeline;
+    pipeline_config_defaults(&pipeline);
+    int pipelined = 0;
+    SwapConfig swap;
+    swap_config_defaults(&swap);
+    int swapping = 0;
+    MmuConfig mmu;
+    mmu_config_defaults(&mmu);
+    int translating = 0;
+    const char *prefetcher = NULL;
+    int prefetch_degree = 0;
+    PartitionSpec partition;
+    partition_spec_defaults(&partition, 0, NULL);
+    int partitioned = 0;
+    const char *partition_csv = NULL;
+    const char *checkpoint_path = NULL, *resume_path = NULL, *cache_dir = NULL, *timeline_path = NULL;
+    const char *compare_names[VMSIM_MAX_COMPARE];
+    int compare_count = 0;
+    char *compare_list = NULL; // Owns the names in compare_names
+
+    for (int i = 1; i < argc; i++) {
+        const char *opt = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        int bad = 0;
+        if (strcmp(opt, "--help") == 0 || strcmp(opt, "-h") == 0) {
+            usage(stdout);
+            return 0;
+        } else if (strcmp(opt, "--perf") == 0) {
+            perf = 1;
+            continue;
+        } else if (strcmp(opt, "--pipeline") == 0) {
+            pipelined = 1;
+            continue;
+        } else if (strcmp(opt, "--swap") == 0) {
+            swapping = 1;
+            continue;
+        } else if (strcmp(opt, "--tlb") == 0) {
+            translating = 1;
+            continue;
+        } else if (strcmp(opt, "--load-control") == 0) {
+            partition.load_control = 1;
+            continue;
+        } else if (strcmp(opt, "--list-algos") == 0) {
+            for (int p = 0; p < policy_count(); p++)
+                printf("%s\n", policy_at(p)->name);
+            return 0;
+        } else if (!value) {
+            bad = 1;
+        } else if (strcmp(opt, "--algo") == 0) {
+            algorithm = value;
+            bad = !policy_find(value);
+        } else if (strcmp(opt, "--compare") == 0) {
+            free(compare_list);
+            compare_list = strdup(value);
+            bad = !compare_list || parse_algorithms(compare_list, compare_names, VMSIM_MAX_COMPARE, &compare_count) != 0;
+        } else if (strcmp(opt, "--frames") == 0) {
+            bad = parse_int(value, &frames) != 0;
+        } else if (strcmp(opt, "--page-size") == 0) {
+            bad = parse_int(value, &page_size) != 0;
+        } else if (strcmp(opt, "--trace") == 0) {
+            trace_path = value;
+        } else if (strcmp(opt, "--trace-format") == 0) {
+            bad = parse_trace_format(value, &trace_format) != 0;
+        } else if (strcmp(opt, "--process") == 0) {
+            bad = process_count == MAX_PROCESSES || parse_int(value, &process_sizes[process_count++]) != 0;
+        } else if (strcmp(opt, "--workload") == 0) {
+            workload = value;
+            bad = gen_pattern_parse(value, &pattern) != 0;
+        } else if (strcmp(opt, "--accesses") == 0) {
+            bad = parse_long(value, &accesses) != 0 || accesses == 0;
+        } else if (strcmp(opt, "--seed") == 0) {
+            bad = parse_long(value, &seed) != 0;
+        } else if (strcmp(opt, "--quantum") == 0) {
+            bad = parse_long(value, &quantum) != 0 || quantum > 1 << 30;
+        } else if (strcmp(opt, "--zipf-s") == 0) {
+            zipf_s = atof(value);
+            bad = !(zipf_s > 0);
+        } else if (strcmp(opt, "--prefetch") == 0) {
+            prefetcher = value;
+            bad = !prefetcher_find(value);
+        } else if (strcmp(opt, "--prefetch-degree") == 0) {
+            bad = parse_int(value, &prefetch_degree) != 0;
+        } else if (strcmp(opt, "--write-ratio") == 0) {
+            write_ratio = atof(value);
+            bad = !(write_ratio >= 0 && write_ratio <= 1);
+        } else if (strcmp(opt, "--swap-read-us") == 0) {
+            swap.read_latency_us = atof(value);
+            swapping = 1;
+            bad = !(swap.read_latency_us >= 0);
+        } else if (strcmp(opt, "--swap-write-us") == 0) {
+            swap.write_latency_us = atof(value);
+            swapping = 1;
+            bad = !(swap.write_latency_us >= 0);
+        } else if (strcmp(opt, "--swap-bandwidth") == 0) {
+            swap.bandwidth_mb_s = atof(value);
+            swapping = 1;
+            bad = !(swap.bandwidth_mb_s >= 0);
+        } else if (strcmp(opt, "--swap-queue") == 0) {
+            swapping = 1;
+            bad = parse_int(value, &swap.queue_depth) != 0;
+        } else if (strcmp(opt, "--writeback") == 0) {
+            swapping = 1;
+            if (strcmp(value, "sync") == 0)
+                swap.writeback = SWAP_WRITEBACK_SYNC;
+            else if (strcmp(value, "async") == 0)
+                swap.writeback = SWAP_WRITEBACK_ASYNC;
+            else
+                bad = 1;
+        } else if (strcmp(opt, "--verbosity") == 0) {
+            bad = parse_verbosity(value, &verbosity) != 0;
+        } else if (strcmp(opt, "--mrc") == 0) {
+            bad = parse_int(value, &mrc_frames) != 0;
+        } else if (strcmp(opt, "--shards-rate") == 0) {
+            shards.mode = SHARDS_FIXED_RATE;
+            shards.rate = atof(value);
+            sampling = 1;
+            bad = !(shards.rate > 0 && shards.rate <= 1);
+        } else if (strcmp(opt, "--shards-size") == 0) {
+            shards.mode = SHARDS_FIXED_SIZE;
+            sampling = 1;
+            bad = parse_int(value, &shards.max_keys) != 0;
+        } else if (strcmp(opt, "--pipeline-slots") == 0) {
+            bad = parse_int(value, &pipeline.ref_slots) != 0;
+            pipeline.event_slots = pipeline.ref_slots;
+        } else if (strcmp(opt, "--backpressure") == 0) {
+            if (strcmp(value, "block") == 0)
+                pipeline.backpressure = PIPELINE_BLOCK;
+            else if (strcmp(value, "drop") == 0)
+                pipeline.backpressure = PIPELINE_DROP;
+            else
+                bad = 1;
+        } else if (strcmp(opt, "--tlb-entries") == 0) {
+            translating = 1;
+            bad = parse_int(value, &mmu.tlb_entries) != 0;
+        } else if (strcmp(opt, "--tlb-ways") == 0) {
+            translating = 1;
+            bad = parse_int(value, &mmu.tlb_ways) != 0;
+        } else if (strcmp(opt, "--page-levels") == 0) {
+            translating = 1;
+            bad = parse_int(value, &mmu.levels) != 0 || mmu.levels < 2 || mmu.levels > MMU_MAX_LEVELS;
+        } else if (strcmp(opt, "--walk-caches") == 0) {
+            long long entries;
+            translating = 1;
+            bad = parse_long(value, &entries) != 0 || entries > 1 << 20;
+            mmu.pwc_entries = (int)entries;
+        } else if (strcmp(opt, "--walk-ns") == 0) {
+            translating = 1;
+            mmu.walk_ref_ns = atof(value);
+            bad = !(mmu.walk_ref_ns >= 0);
+        } else if (strcmp(opt, "--huge-pages") == 0) {
+            translating = 1;
+            bad = parse_huge_pages(value, &mmu) != 0;
+        } else if (strcmp(opt, "--partition") == 0) {
+            partitioned = 1;
+            bad = partition_allocator_parse(value, &partition.allocator) != 0;
+        } else if (strcmp(opt, "--partition-epoch") == 0) {
+            bad = parse_long(value, &partition.epoch) != 0 || partition.epoch == 0 || partition.epoch > 1 << 30;
+        } else if (strcmp(opt, "--ws-window") == 0) {
+            bad = parse_long(value, &partition.ws_window) != 0 || partition.ws_window == 0 ||
+                  partition.ws_window > 1 << 30;
+        } else if (strcmp(opt, "--pff-low") == 0) {
+            partition.pff_low = atof(value);
+            bad = !(partition.pff_low >= 0 && partition.pff_low <= 1);
+        } else if (strcmp(opt, "--pff-high") == 0) {
+            partition.pff_high = atof(value);
+            bad = !(partition.pff_high >= 0 && partition.pff_high <= 1);
+        } else if (strcmp(opt, "--partition-csv") == 0) {
+            partition_csv = value;
+        } else if (strcmp(opt, "--sweep") == 0) {
+            bad = parse_int_list(value, sweep_frames, VMSIM_MAX_SWEEP, &sweep_frame_count) != 0;
+        } else if (strcmp(opt, "--sweep-page-sizes") == 0) {
+            bad = parse_int_list(value, sweep_page_sizes, VMSIM_MAX_SWEEP, &sweep_page_size_count) != 0;
+        } else if (strcmp(opt, "--threads") == 0) {
+            bad = parse_int(value, &partition.threads) != 0;
+        } else if (strcmp(opt, "--timeline") == 0) {
+            timeline_path = value;
+        } else if (strcmp(opt, "--checkpoint") == 0) {
+            checkpoint_path = value;
+        } else if (strcmp(opt, "--resume") == 0) {
+            resume_path = value;
+        } else if (strcmp(opt, "--cache") == 0) {
+            cache_dir = value;
+        } else if (strcmp(opt, "--stats") == 0) {
+            stats_path = value;
+        } else if (strcmp(opt, "--stats-window") == 0) {
+            bad = parse_long(value, &stats_window) != 0;
+        } else {
+            bad = 1;
+        }
+        if (bad) {
+            fprintf(stderr, "vmsim: invalid option or value: %s%s%s\n", opt, value ? " " : "", value ? value : "");
+            usage(stderr);
+            free(compare_list);
+            return 2;
+        }
+        i++;
+    }
+    if (!trace_path && process_count == 0) {
+        fprintf(stderr, "vmsim: give a --trace file or at least one --process size\n");
+        return 2;
+    }
+    if (sampling && ((!trace_path && !workload) || (shards.mode == SHARDS_FIXED_SIZE && mrc_frames == 0))) {
+        fprintf(stderr, "vmsim: sampling needs --trace or --workload, and --shards-size needs --mrc\n");
+        return 2;
+    }
+
+    int sweeping = sweep_frame_count > 0;
+    if (sweeping && (!trace_path || bintrace_is_binary(trace_path) || partitioned || mrc_frames > 0 || sampling ||
+                     pipelined || swapping || translating || prefetcher)) {
+        fprintf(stderr, "vmsim: --sweep takes a text --trace, whose byte addresses it pages at every size,\n"
+                        "       and runs plain policies without the other modes or models\n");
+        return 2;
+    }
+    if (sweep_page_size_count == 0)
+        sweep_page_sizes[sweep_page_size_count++] = page_size;
+
+    int single = !partitioned && compare_count == 0 && mrc_frames == 0 && !sampling && !sweeping;
+    if ((checkpoint_path || resume_path || cache_dir) &&
+        (!single || (!trace_path && !workload) || pipelined || swapping || translating || prefetcher ||
+         policy_find(algorithm)->needs_future)) {
+        fprintf(stderr, "vmsim: --checkpoint, --resume and --cache take a single unpipelined run over --trace\n"
+                        "       or --workload, without the swap, TLB or prefetch models or a policy that needs\n"
+                        "       the future\n");
+        return 2;
+    }
+    if (timeline_path && !single) {
+        fprintf(stderr, "vmsim: --timeline takes a single run\n");
+        return 2;
+    }
+    if (partitioned && (compare_count > 0 || mrc_frames > 0 || sampling || pipelined || swapping || translating ||
+                        prefetcher || policy_find(algorithm)->needs_future || partition.pff_low > partition.pff_high)) {
+        fprintf(stderr, "vmsim: --partition runs one policy that does not need the future, on its own, and\n"
+                        "       --pff-low may not exceed --pff-high\n");
+        return 2;
+    }
+
+    Simulator *sim = simulator_create(frames, 0);
+    if (!sim || simulator_set_algorithm(sim, algorithm) != 0) {
+        fprintf(stderr, "vmsim: out of memory\n");
+        simulator_destroy(sim);
+        return 1;
+    }
+    simulator_set_page_size(sim, page_size);
+    simulator_set_process_count(sim, process_count);
+    for (int i = 0; i < process_count; i++)
+        simulator_set_process_size(sim, i, process_sizes[i]);
+    simulator_set_verbosity(sim, verbosity);
+    simulator_set_stats_window(sim, stats_window);
+    simulator_set_perf_counters(sim, perf);
+    if (translating && mmu.tlb_entries % mmu.tlb_ways != 0) {
+        fprintf(stderr, "vmsim: --tlb-entries must be a multiple of --tlb-ways\n");
+        simulator_destroy(sim);
+        return 2;
+    }
+    if ((swapping && simulator_set_swap(sim, &swap) != 0) || (translating && simulator_set_mmu(sim, &mmu) != 0) ||
+        (prefetcher && simulator_set_prefetcher(sim, prefetcher, prefetch_degree) != 0) ||
+        (timeline_path && simulator_set_timeline(sim, 1, TIMELINE_DEFAULT_RATE_WINDOW) != 0)) {
+        fprintf(stderr, "vmsim: out of memory\n");
+        simulator_destroy(sim);
+        return 1;
+    }
+    if (prefetcher && sim->policy->needs_future && compare_count == 0)
+        fprintf(stderr, "vmsim: %s needs the future, so it runs without the prefetcher\n", sim->algorithm);
+
+    // References come from the trace, a lazy generator, or the built-in workload
+    RefSource *source = NULL;
+    TraceReader trace;
+    BinTraceReader bintrace;
+    int binary = trace_path && bintrace_is_binary(trace_path);
+    Generator gen;
+    GenProcessSpec specs[MAX_PROCESSES];
+    memset(specs, 0, sizeof(specs));
+    if (binary) {
+        if (bintrace_reader_open(&bintrace, trace_path, page_size) != 0) {
+            fprintf(stderr, "vmsim: %s is not a valid binary trace for page size %d\n", trace_path, page_size);
+            simulator_destroy(sim);
+            return 1;
+        }
+        source = &bintrace.source;
+    } else if (trace_path) {
+        // A sweep pages the byte addresses itself
+        if (trace_reader_open(&trace, trace_path, trace_format, sweeping ? 1 : page_size) != 0) {
+            fprintf(stderr, "vmsim: cannot open trace file %s\n", trace_path);
+            simulator_destroy(sim);
+            return 1;
+        }
+        source = &trace.source;
+    } else if (workload) {
+        for (int i = 0; i < process_count; i++) {
+            gen_process_defaults(&specs[i], pattern, ((long long)process_sizes[i] * 1024) / sim->page_size);
+            specs[i].zipf_s = zipf_s;
+            specs[i].write_fraction = write_ratio;
+        }
+        if (generator_init(&gen, specs, process_count, accesses, (int)quantum, (uint64_t)seed) != 0) {
+            fprintf(stderr, "vmsim: invalid workload parameters\n");
+            simulator_destroy(sim);
+            return 2;
+        }
+        source = &gen.source;
+    }
+
+    int status;
+    if (sweeping) {
+        SweepSpec spec = {sweep_page_sizes, sweep_page_size_count, sweep_frames, sweep_frame_count,
+                          compare_count > 0 ? compare_names : &algorithm, compare_count > 0 ? compare_count : 1,
+                          partition.threads};
+        SweepTable table;
+        status = simulator_load_source(sim, source);
+        if (status == 0)
+            status = sweep_run(sim->reference_string, sim->reference_string_len, &spec, &table);
+        if (status == 0) {
+            int failed = 0;
+            sweep_write_csv(&table, stdout);
+            for (int i = 0; i < table.count; i++)
+                failed += table.results[i].status != 0;
+            fprintf(stderr, "Sweep: %d runs, %d failed; %.3f s\n", table.count, failed, table.wall_seconds);
+            status = failed ? -1 : 0;
+            sweep_table_free(&table);
+        }
+    } else if (partitioned) {
+        PartitionReport report;
+        partition.frames = frames;
+        partition.algorithm = algorithm;
+        if (source) {
+            status = partition_run_source(source, &partition, &report);
+        } else {
+            status = simulator_generate_references(sim);
+            if (status == 0)
+                status = partition_run_references(sim->reference_string, sim->reference_string_len, &partition,
+                                                  &report);
+        }
+        if (status == 0) {
+            char line[PARTITION_LINE_MAX];
+            printf("Algorithm: %s\nFrames: %d\nPage Size: %d\nAllocator: %s%s\nTotal Accesses: %lld\n\n", algorithm,
+                   frames, sim->page_size, partition_allocator_name(partition.allocator),
+                   partition.load_control ? ", load control" : "", report.accesses);
+            for (int row = -1; row < report.process_count; row++) {
+                partition_format_line(&report, row, line, sizeof(line));
+                fputs(line, stdout);
+            }
+            printf("\nEpochs: %lld, %lld thrashing; %.3f s\n", report.epochs, report.thrashing_epochs,
+                   report.wall_seconds);
+            if (partition_csv && write_partition_csv(&report, partition_csv) != 0) {
+                fprintf(stderr, "vmsim: cannot write partition samples to %s\n", partition_csv);
+                status = 1;
+            }
+            partition_report_free(&report);
+        }
+    } else if (compare_count > 0) {
+        CompareSpec spec = {frames, compare_names, compare_count, NULL, NULL, swapping ? &swap : NULL, prefetcher,
+                            prefetch_degree};
+        CompareTable table;
+        if (source) {
+            status = compare_run_source(source, &spec, &table);
+        } else {
+            status = simulator_generate_references(sim);
+            if (status == 0)
+                status = compare_run_references(sim->reference_string, sim->reference_string_len, &spec, &table);
+        }
+        if (status == 0) {
+            char line[COMPARE_LINE_MAX];
+            printf("Frames: %d\nPage Size: %d\nTotal Accesses: %lld\n\n", frames, sim->page_size, table.accesses);
+            for (int row = -1; row < table.count; row++) {
+                compare_format_line(&table, row, line, sizeof(line));
+                fputs(line, stdout);
+            }
+            printf("\nRead once in %.3f s; %.3f s in all\n", table.read_seconds, table.wall_seconds);
+            compare_table_free(&table);
+        }
+    } else if (sampling && mrc_frames > 0) {
+        ShardsMrc mrc;
+        status = shards_mrc_source(source, &shards, mrc_frames, &mrc);
+        if (status == 0) {
+            shards_mrc_write_csv(&mrc, stdout);
+            fprintf(stderr, "Sampled %lld of %lld references, final rate %.6f\n", mrc.sampled, mrc.accesses, mrc.rate);
+            shards_mrc_free(&mrc);
+        }
+    } else if (sampling) {
+        ShardsEstimate est;
+        status = shards_simulate(sim, source, &shards, &est);
+        if (status == 0 && verbosity >= SIM_VERBOSITY_SUMMARY) {
+            printf("Algorithm: %s\nFrames: %d (%d simulated)\nPage Size: %d\n", sim->algorithm, frames,
+                   est.scaled_frames, sim->page_size);
+            printf("Sampled References: %lld of %lld (rate %.6f)\n", est.sampled, est.accesses, est.rate);
+            printf("Estimated Fault Rate: %.2f%% +/- %.2f%%\n", 100.0 * est.fault_rate, 100.0 * est.error);
+        }
+    } else if (mrc_frames > 0) {
+        // Optimal needs the whole reference string, so materialize it either way
+        MissRatioCurve mrc;
+        status = source ? simulator_load_source(sim, source) : simulator_generate_references(sim);
+        if (status == 0)
+            status = mrc_compute(sim->reference_string, sim->reference_string_len, mrc_frames, 1, &mrc);
+        if (status == 0) {
+            mrc_write_csv(&mrc, stdout);
+            mrc_free(&mrc);
+        }
+    } else {
+        CliLog log = {.out = stdout};
+        int logging = verbosity >= SIM_VERBOSITY_FAULTS;
+        int cached = 0, stopped = 0;
+        char cache_path[1024];
+        uint64_t input_hash;
+        if (cache_dir && (hash_input(trace_path, trace_format, specs, process_count, accesses, quantum, seed,
+                                     &input_hash) != 0 ||
+                          checkpoint_cache_path(cache_path, sizeof(cache_path), cache_dir, input_hash, sim->algorithm,
+                                                frames, sim->page_size, sim->stats.window) != 0)) {
+            fprintf(stderr, "vmsim: cannot key the cache on %s\n", trace_path ? trace_path : "this workload");
+            cache_dir = NULL;
+        }
+        // A logged run has to be simulated to print its events, and a timeline to draw one
+        if (cache_dir && !logging && !resume_path && !timeline_path)
+            cached = load_checkpoint(sim, cache_path) == 0;
+        if (resume_path && load_checkpoint(sim, resume_path) != 0) {
+            fprintf(stderr, "vmsim: %s is not a checkpoint this build can resume\n", resume_path);
+            status = 1;
+            goto done;
+        }
+        if (resume_path && simulator_skip_source(sim, source) != 0) {
+            fprintf(stderr, "vmsim: the references do not match checkpoint %s (same --page-size?)\n", resume_path);
+            status = 1;
+            goto done;
+        }
+        if (checkpoint_path) {
+            signal(SIGINT, request_stop);
+            simulator_set_progress(sim, check_stop, NULL);
+        }
+        if (logging) {
+            // A checkpoint brings its own frame count and resident pages
+            log_formatter_init(&log.formatter, sim->memory.frame_count, sim->algorithm,
+                               verbosity == SIM_VERBOSITY_FULL);
+            for (int f = sim->memory.oldest; f >= 0; f = sim->memory.load_next[f])
+                log_formatter_resident(&log.formatter, f, sim->memory.frames[f].process_id,
+                                       sim->memory.frames[f].page, sim->memory.frames[f].last_access_time);
+            simulator_set_event_sink(sim, print_events, &log);
+        }
+        PipelineStats stages;
+        if (cached)
+            status = 0;
+        else if (resume_path)
+            status = simulator_continue_source(sim, source);
+        else if (pipelined && source)
+            status = simulator_run_pipelined(sim, source, &pipeline, &stages);
+        else
+            status = source ? simulator_run_source(sim, source) : simulator_run(sim);
+        if (logging)
+            log_formatter_free(&log.formatter);
+        if (status == SIM_CANCELLED && checkpoint_path) {
+            stopped = 1;
+            status = 0;
+        }
+        if (status == 0 && checkpoint_path && save_checkpoint(sim, checkpoint_path) != 0) {
+            fprintf(stderr, "vmsim: cannot write checkpoint %s\n", checkpoint_path);
+            status = 1;
+        }
+        if (status == 0 && stopped)
+            fprintf(stderr, "vmsim: stopped after %ld references; --resume %s goes on from there\n",
+                    sim->access_time, checkpoint_path);
+        else if (status == 0 && cache_dir && !cached && save_checkpoint(sim, cache_path) != 0)
+            fprintf(stderr, "vmsim: cannot cache the run in %s\n", cache_dir);
+        if (status == 0 && !stopped && verbosity >= SIM_VERBOSITY_SUMMARY) {
+            char summary[LOG_LINE_MAX];
+            printf("Algorithm: %s\nFrames: %d\nPage Size: %d\n", sim->algorithm, sim->memory.frame_count,
+                   sim->page_size);
+            if (cached)
+                printf("Cached: %s\n", cache_path);
+            else if (resume_path)
+                printf("Resumed: %s\n", resume_path);
+            if (cached && trace_path)
+                printf("Trace: %s\n", trace_path);
+            else if (binary)
+                printf("Trace: %s (%u processes, binary)\n", trace_path, bintrace.pid_count);
+            else if (trace_path)
+                printf("Trace: %s (%d processes, %lld lines skipped)\n", trace_path, trace.pid_count, trace.skipped);
+            else if (workload)
+                printf("Workload: %s, seed %lld, quantum %lld\n", gen_pattern_name(pattern), seed, quantum);
+            simulator_format_summary(sim, summary, sizeof(summary));
+            fputs(summary, stdout);
+            if (pipelined && source)
+                printf("Pipeline: decode %.3f s, report %.3f s busy; stalls %llu decoder, %llu input, %llu output; "
+                       "%llu events dropped\n",
+                       stages.decode_seconds, stages.report_seconds, stages.decoder_stalls, stages.input_stalls,
+                       stages.output_stalls, stages.events_dropped);
+        }
+        if (status == 0 && !stopped && stats_path && write_stats(sim, stats_path) != 0) {
+            fprintf(stderr, "vmsim: cannot write statistics to %s\n", stats_path);
+            status = 1;
+        }
+        if (status == 0 && !stopped && timeline_path && write_timeline(sim, timeline_path) != 0) {
+            fprintf(stderr, "vmsim: cannot write the timeline to %s\n", timeline_path);
+            status = 1;
+        }
+        if (status == 0 && perf && sim->stats.perf_status != 0)
+            fprintf(stderr, "vmsim: hardware counters are not available here\n");
+    }
+
+    if (status == 0 && binary && bintrace.corrupt) {
+        fprintf(stderr, "vmsim: %s is corrupt after reference %llu\n", trace_path,
+                (unsigned long long)bintrace.position);
+        status = 1;
+    } else if (status != 0) {
+        fprintf(stderr, "vmsim: not enough memory for this simulation\n");
+    }
+done:
+    if (binary)
+        bintrace_reader_close(&bintrace);
+    else if (trace_path)
+        trace_reader_close(&trace);
+    simulator_destroy(sim);
+    free(compare_list);
+    return status == 0 ? 0 : 1;
+}